@@ -6,10 +6,24 @@
         This file contains the ADC module. This module initializes,
         ADC10 : PB5
 
+        It also measures AVcc (AVcc/4 against the internal 2.56V reference)
+        and the internal temperature sensor (against the internal 1.1V
+        reference), one of them per telemetry measurement. AVcc is the
+        node's regulated rail, not the vehicle supply: the supply only shows
+        in it once it has dropped below what the regulator needs.
+
+        The first conversion after the reference changes is thrown away and
+        the ADC runs another, as the reference needs time to settle.
+
     External Functions Required:
 
     Public Functions:
         void Init_ADC_Module(void)
+        uint16_t Get_ADC_Result(void)
+        void Start_ADC_Measurement(void)
+        void Start_ADC_Telemetry_Measurement(void)
+        uint16_t Get_AVcc_MV(void)
+        int8_t Get_Temperature_C(void)
                 
 *******************************************************************************/
 
@@ -33,10 +47,32 @@
 // Interrupts
 #include <avr/interrupt.h>
 
+// Atomic Read/Write operations
+#include <util/atomic.h>
+
 // #############################################################################
 // ------------ MODULE DEFINITIONS
 // #############################################################################
 
+// ADMUX reference and input selections
+#define ADC_ADMUX_MASK              ((1<<REFS1)|(1<<REFS0)|(1<<MUX4)|(1<<MUX3)|(1<<MUX2)|(1<<MUX1)|(1<<MUX0))
+#define ADC_REFERENCE_MASK          ((1<<REFS1)|(1<<REFS0))
+#define ADC_INPUT_ADMUX             ((1<<MUX3))                                   // PB7 against Vcc
+#define ADC_AVCC_ADMUX              ((1<<REFS1)|(1<<REFS0)|(1<<MUX3)|(1<<MUX2))   // AVcc/4 against 2.56V
+#define ADC_TEMPERATURE_ADMUX       ((1<<REFS1)|(1<<MUX3)|(1<<MUX1)|(1<<MUX0))    // Sensor against 1.1V
+
+// Telemetry channels
+#define ADC_TELEMETRY_AVCC          (0)
+#define ADC_TELEMETRY_TEMPERATURE   (1)
+#define NUM_ADC_TELEMETRY           (2)
+#define ADC_TELEMETRY_NONE          (0xFF)      // Measuring the PB7 input
+
+// Conversions
+// AVcc: AVcc/4 against 2.56V, 2560*4/1024 = 10 mV per count
+#define AVCC_MV_PER_COUNT           (10)
+// Temperature: about 1 count per degree, 300 counts at 25C (uncalibrated)
+#define TEMPERATURE_OFFSET_COUNTS   (275)
+
 
 
 // #############################################################################
@@ -53,10 +89,18 @@
 // *Note: We have a 10-bit ADC so a full 16-bit number is impossible
 static uint16_t Last_ADC_Value = IMPOSSIBLE_ADC_COUNT;
 
+// Last telemetry results, and the channel being measured
+static uint16_t Telemetry_Results[NUM_ADC_TELEMETRY] = {IMPOSSIBLE_ADC_COUNT, IMPOSSIBLE_ADC_COUNT};
+static uint8_t Telemetry_Channel = ADC_TELEMETRY_NONE;
+
+// Set when the reference changed, the next conversion is thrown away
+static bool Discard_Conversion = false;
+
 // #############################################################################
 // ------------ PRIVATE FUNCTION PROTOTYPES
 // #############################################################################
 
+static void select_adc_input(uint8_t admux);
 
 
 // #############################################################################
@@ -120,10 +164,103 @@ uint16_t Get_ADC_Result(void)
 ****************************************************************************/
 void Start_ADC_Measurement(void)
 {
+    // Switch back to PB7 if we were measuring telemetry
+    if (ADC_TELEMETRY_NONE != Telemetry_Channel)
+    {
+        Telemetry_Channel = ADC_TELEMETRY_NONE;
+        select_adc_input(ADC_INPUT_ADMUX);
+    }
+
     // Writing this bit kicks off the ADC measurement
     ADCSRA |= (1<<ADSC);
 }
 
+/****************************************************************************
+    Public Function
+        Start_ADC_Telemetry_Measurement
+
+    Parameters
+        None
+
+    Description
+        Measures the next telemetry channel (AVcc and temperature
+        take turns). Does nothing if a conversion is in progress.
+
+****************************************************************************/
+void Start_ADC_Telemetry_Measurement(void)
+{
+    if (ADCSRA & (1<<ADSC)) return;
+
+    // Take turns between the channels
+    if (ADC_TELEMETRY_AVCC == Telemetry_Channel)
+    {
+        Telemetry_Channel = ADC_TELEMETRY_TEMPERATURE;
+        select_adc_input(ADC_TEMPERATURE_ADMUX);
+    }
+    else
+    {
+        Telemetry_Channel = ADC_TELEMETRY_AVCC;
+        select_adc_input(ADC_AVCC_ADMUX);
+    }
+
+    // Writing this bit kicks off the ADC measurement
+    ADCSRA |= (1<<ADSC);
+}
+
+/****************************************************************************
+    Public Function
+        Get_AVcc_MV
+
+    Parameters
+        None
+
+    Description
+        Returns the last measured AVcc (the regulated rail) in mV
+
+****************************************************************************/
+uint16_t Get_AVcc_MV(void)
+{
+    uint16_t result;
+
+    ATOMIC_BLOCK(ATOMIC_RESTORESTATE)
+    {
+        result = Telemetry_Results[ADC_TELEMETRY_AVCC];
+    }
+
+    if (IMPOSSIBLE_ADC_COUNT == result) return UNKNOWN_AVCC_MV;
+    return (result*AVCC_MV_PER_COUNT);
+}
+
+/****************************************************************************
+    Public Function
+        Get_Temperature_C
+
+    Parameters
+        None
+
+    Description
+        Returns the last measured chip temperature in degrees C
+
+****************************************************************************/
+int8_t Get_Temperature_C(void)
+{
+    uint16_t result;
+    int16_t temperature;
+
+    ATOMIC_BLOCK(ATOMIC_RESTORESTATE)
+    {
+        result = Telemetry_Results[ADC_TELEMETRY_TEMPERATURE];
+    }
+
+    if (IMPOSSIBLE_ADC_COUNT == result) return UNKNOWN_TEMPERATURE_C;
+
+    // Keep it inside an int8_t
+    temperature = (int16_t) result-TEMPERATURE_OFFSET_COUNTS;
+    if (INT8_MAX < temperature) return INT8_MAX;
+    if ((INT8_MIN+1) > temperature) return (INT8_MIN+1);
+    return (int8_t) temperature;
+}
+
 // #############################################################################
 // ------------ INTERRUPT SERVICE ROUTINE
 // #############################################################################
@@ -143,13 +280,46 @@ ISR(ADC_vect)
 {
     // Clear ADC Interrupt Flag
     ADCSRA |= (1<<ADIF);
+
+    // The reference was still settling, convert again
+    if (Discard_Conversion)
+    {
+        Discard_Conversion = false;
+        ADCSRA |= (1<<ADSC);
+        return;
+    }
+
     // Get ADC from 2, 8-bit regs,
     //      no need for atomic because we are
     //      in an ISR which is technically an
     //      atomic section
     Last_ADC_Value = ADC;
+
+    // Keep telemetry results apart
+    if (ADC_TELEMETRY_NONE != Telemetry_Channel)
+    {
+        Telemetry_Results[Telemetry_Channel] = Last_ADC_Value;
+    }
 }
 
 // #############################################################################
 // ------------ PRIVATE FUNCTIONS
 // #############################################################################
+
+/****************************************************************************
+    Private Function
+        select_adc_input
+
+    Parameters
+        uint8_t admux: reference and input selection bits
+
+    Description
+        Selects the next conversion's reference and input. If the
+        reference changes, the conversion after it is thrown away.
+
+****************************************************************************/
+static void select_adc_input(uint8_t admux)
+{
+    if ((ADMUX ^ admux) & ADC_REFERENCE_MASK) Discard_Conversion = true;
+    ADMUX = (ADMUX & ~ADC_ADMUX_MASK)|admux;
+}
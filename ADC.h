@@ -7,6 +7,10 @@
 
 #define IMPOSSIBLE_ADC_COUNT        UINT16_MAX
 
+// Returned before the first telemetry measurement has finished
+#define UNKNOWN_AVCC_MV             (0)
+#define UNKNOWN_TEMPERATURE_C       (INT8_MIN)
+
 // #############################################################################
 // ------------ PUBLIC FUNCTION PROTOTYPES
 // #############################################################################
@@ -14,5 +18,8 @@
 void Init_ADC_Module(void);
 uint16_t Get_ADC_Result(void);
 void Start_ADC_Measurement(void);
+void Start_ADC_Telemetry_Measurement(void);
+uint16_t Get_AVcc_MV(void);
+int8_t Get_Temperature_C(void);
 
 #endif // ADC_H
@@ -39,6 +39,9 @@
 // Include CAN Header
 #include "CAN.h"
 
+// Received frames go to the receive FIFO
+#include "can_rx_fifo.h"
+
 // Interrupts
 #include <avr/interrupt.h>
 
@@ -46,7 +49,52 @@
 // ------------ MODULE DEFINITIONS
 // #############################################################################
 
-
+// Bit timing, from the config.h inputs (MCP25625 datasheet, Bit Timing)
+//  A bit is SyncSeg (1 TQ) + PropSeg + PS1 + PS2, 8 to 25 time quanta
+//  of 2*(BRP+1) oscillator periods. The most TQ per bit that the
+//  oscillator divides into exactly is used. The sample point falls
+//  between PS1 and PS2, PS1 is PS2+1 if PropSeg can take the rest.
+#define BIT_CLOCKS          (CAN_OSC_HZ/CAN_BITRATE)
+#define BIT_TQ_FITS(n)      ((0 == (BIT_CLOCKS % (2*(n)))) && ((2*64*(n)) >= BIT_CLOCKS))
+#define BIT_TQ              (BIT_TQ_FITS(25) ? 25 : BIT_TQ_FITS(24) ? 24 : BIT_TQ_FITS(23) ? 23 : \
+                             BIT_TQ_FITS(22) ? 22 : BIT_TQ_FITS(21) ? 21 : BIT_TQ_FITS(20) ? 20 : \
+                             BIT_TQ_FITS(19) ? 19 : BIT_TQ_FITS(18) ? 18 : BIT_TQ_FITS(17) ? 17 : \
+                             BIT_TQ_FITS(16) ? 16 : BIT_TQ_FITS(15) ? 15 : BIT_TQ_FITS(14) ? 14 : \
+                             BIT_TQ_FITS(13) ? 13 : BIT_TQ_FITS(12) ? 12 : BIT_TQ_FITS(11) ? 11 : \
+                             BIT_TQ_FITS(10) ? 10 : BIT_TQ_FITS(9) ? 9 : BIT_TQ_FITS(8) ? 8 : 0)
+#define BIT_BRP             ((BIT_CLOCKS/(2*BIT_TQ)) - 1)
+#define BIT_PS2             (BIT_TQ - (((BIT_TQ*CAN_SAMPLE_POINT_PERMILLE) + 500)/1000))
+#define BIT_SEG1            (BIT_TQ - 1 - BIT_PS2)                      // PropSeg + PS1
+#define BIT_PS1_MIN         (((BIT_PS2 + 1) > (BIT_SEG1 - 8)) ? (BIT_PS2 + 1) : (BIT_SEG1 - 8))
+#define BIT_PS1_MAX         ((8 < (BIT_SEG1 - 1)) ? 8 : (BIT_SEG1 - 1))
+#define BIT_PS1             ((BIT_PS1_MIN < BIT_PS1_MAX) ? BIT_PS1_MIN : BIT_PS1_MAX)
+#define BIT_PROP            (BIT_SEG1 - BIT_PS1)
+
+#if (0 != (CAN_OSC_HZ % CAN_BITRATE)) || (0 == BIT_TQ)
+#error "CAN_BITRATE can't be made from CAN_OSC_HZ with 8 to 25 TQ per bit"
+#endif
+#if (2 > BIT_PS2) || (8 < BIT_PS2)
+#error "CAN_SAMPLE_POINT_PERMILLE leaves PS2 out of 2 to 8 TQ"
+#endif
+#if (1 > BIT_PS1) || (8 < BIT_PS1) || (1 > BIT_PROP) || (8 < BIT_PROP)
+#error "CAN_SAMPLE_POINT_PERMILLE leaves PropSeg or PS1 out of 1 to 8 TQ"
+#endif
+#if (BIT_SEG1 < BIT_PS2)
+#error "CAN_SAMPLE_POINT_PERMILLE is too early, PropSeg + PS1 must be at least PS2"
+#endif
+#if (1 > CAN_SJW_TQ) || (4 < CAN_SJW_TQ) || (BIT_PS2 <= CAN_SJW_TQ)
+#error "CAN_SJW_TQ must be 1 to 4 TQ, and less than PS2"
+#endif
+
+// CNF registers, PS2 set by CNF3, 3 samples per bit, SOF signal on CLKOUT
+#define CNF1_VALUE          ((uint8_t) (((CAN_SJW_TQ - 1) << 6) | BIT_BRP))
+#define CNF2_VALUE          ((uint8_t) (BTLMODE | SAMPLE_3X | ((BIT_PS1 - 1) << 3) | (BIT_PROP - 1)))
+#define CNF3_VALUE          ((uint8_t) (SOF_ENABLE | WAKFIL_DISABLE | (BIT_PS2 - 1)))
+
+// TX Buffer n: LOAD TX BUFFER instruction and TXBnCTRL address
+#define TX_BUFFER_LOAD(n)   (MCP_LOAD_TX0_SIDH + (2*(n)))
+#define TX_BUFFER_CTRL(n)   (MCP_TXB0CTRL + (0x10*(n)))
+#define TX_BUFFER_FLAGS     (MCP_TX0IF|MCP_TX1IF|MCP_TX2IF)
 
 // #############################################################################
 // ------------ TYPE DEFINITIONS
@@ -59,17 +107,21 @@
 // #############################################################################
 
 static uint8_t TX_Data[1] = {0};
-static uint8_t* RX_Data[1] = {0};
-static uint8_t Recv_Byte = 0;
 
-// The address to the array of addresses where we will store the incoming
-// CAN messages
-static uint8_t * * a_p_Recv_List;
+// TX Buffers loaded and not yet sent, one TXnIF bit each
+static uint8_t TX_Busy = 0;
+
+// The frame being read, it goes to the receive FIFO once the read completes
+static uint8_t RX_Frame[CAN_FRAME_LEN];
+static uint8_t * RX_Frame_List[1] = {RX_Frame};
 
 // #############################################################################
 // ------------ PRIVATE FUNCTION PROTOTYPES
 // #############################################################################
 
+static void write_id_registers(uint8_t First_Register, uint8_t Count, const uint16_t* SIDs);
+static void rx_frame_read(void);
+
 
 // #############################################################################
 // ------------ PUBLIC FUNCTIONS
@@ -86,11 +138,9 @@ static uint8_t * * a_p_Recv_List;
         Initializes the CAN module MCP25625
 
 ****************************************************************************/
-void CAN_Initialize_1(uint8_t * * p_data_store)
+void CAN_Initialize_1(void)
 {   
-    // Save away the address to the array of addresses to the locations we will
-    // fill in data
-    a_p_Recv_List = p_data_store;
+    uint8_t Bit_Timing[3] = {CNF3_VALUE, CNF2_VALUE, CNF1_VALUE};
 
     // Reset the CAN Module and enter in configuration mode
     CAN_Reset();
@@ -103,19 +153,9 @@ void CAN_Initialize_1(uint8_t * * p_data_store)
     TX_Data[0] = CLKOUT_DISABLE;
     CAN_Bit_Modify(MCP_CANCTRL, (1 << 2), TX_Data);
 	
-    // Set CNF Bit Time registers for Baud Rate = 312500 b/s
-	TX_Data[0] = 0x41;
-	CAN_Bit_Modify(MCP_CNF1, (1 << 0), TX_Data);
-	TX_Data[0] = 0xF1;
-	CAN_Bit_Modify(MCP_CNF2, ((1 << 0)|(1 << 1)|(1 << 2)), TX_Data);
-	TX_Data[0] = 0xF1;
-	CAN_Bit_Modify(MCP_CNF2, ((1 << 3)|(1 << 4)|(1 << 5)), TX_Data);
-	TX_Data[0] = 0xF1;
-	CAN_Bit_Modify(MCP_CNF2, ((1 << 7)|(1 << 6)), TX_Data);
-	TX_Data[0] = 0x85;
-    CAN_Write(MCP_CNF3, TX_Data);
-	TX_Data[0] = 0x41;
-	CAN_Bit_Modify(MCP_CNF1, ((1 << 7)|(1 << 6)), TX_Data);
+    // Set CNF Bit Time registers for CAN_BITRATE, CNF3, CNF2 and CNF1
+    // are consecutive and written with one command
+    CAN_Write_Registers(MCP_CNF3, 3, Bit_Timing);
 }
 
 /****************************************************************************
@@ -134,38 +174,34 @@ void CAN_Initialize_2(void)
 {
     // Set interrupt registers
     
-    // Enable all interrupts
-    TX_Data[0] = 0xFF;
+    // Enable the receive, TX Buffer and error interrupts, CAN_Service.c
+    // services them
+    TX_Data[0] = (MCP_RX0IF|MCP_RX1IF|MCP_TX0IF|MCP_TX1IF|MCP_TX2IF|MCP_ERRIF);
     CAN_Write(MCP_CANINTE, TX_Data);
 
-    // Set up TX Buffer 0
-    TX_Data[0] = MCP_TXB_TXP10_M; // Highest message priority
-    CAN_Write(MCP_TXB0CTRL, TX_Data);
-    
     // Set RTS pins as digital inputs
     TX_Data[0] = 0;
     CAN_Write(MCP_RTSCTRL, TX_Data);
     
-    // Set identifier of TX Buffer 0 to 1
-    TX_Data[0] = 0;
-    CAN_Write(MCP_TXB0SIDH, TX_Data);
-    TX_Data[0] = 0x20;
-    CAN_Write(MCP_TXB0SIDL, TX_Data);
-    
-    // Set identifier of RX Buffer 0 to 0
-    TX_Data[0] = 0;
-    CAN_Write(MCP_RXF0SIDH, TX_Data);
-    CAN_Write(MCP_RXF0SIDL, TX_Data);
+    // Acceptance filters and masks from config.h, only the frames they
+    // accept reach the RX Buffers
+    const uint16_t Filters[CAN_NUM_RX_FILTERS] = CAN_RX_FILTERS;
+    const uint16_t Masks[CAN_NUM_RX_MASKS] = CAN_RX_MASKS;
+    write_id_registers(MCP_RXF0SIDH, 3, &Filters[0]);
+    write_id_registers(MCP_RXF3SIDH, 3, &Filters[3]);
+    write_id_registers(MCP_RXM0SIDH, CAN_NUM_RX_MASKS, Masks);
     
-    TX_Data[0] = 0x60;
+    // Both RX Buffers receive the frames their filters accept, a frame
+    // for RX Buffer 0 rolls over to RX Buffer 1 while RX Buffer 0 is full
+    TX_Data[0] = (MCP_RXB_RX_STDEXT|MCP_RXB_BUKT_MASK);
     CAN_Write(MCP_RXB0CTRL, TX_Data);
+    TX_Data[0] = MCP_RXB_RX_STDEXT;
+    CAN_Write(MCP_RXB1CTRL, TX_Data);
     
-    // Switch to Normal Mode
+    // Switch to Normal Mode, and end the abort of all transmissions
+    // CAN_Initialize_1 requested, or no frame could be sent
     TX_Data[0] = (MCP_NORMAL);
-    CAN_Bit_Modify(MCP_CANCTRL, ((1 << 5)|(1 << 6)|(1 << 7)), TX_Data);
-    
-    RX_Data[0] = &Recv_Byte;
-    CAN_Read(MCP_CANSTAT, RX_Data);
+    CAN_Bit_Modify(MCP_CANCTRL, ((1 << 5)|(1 << 6)|(1 << 7)|ABORT_TX), TX_Data);
 }
 
 
@@ -228,10 +264,11 @@ void CAN_Read(uint8_t Register_2_Read, uint8_t** Variable_2_Set)
     Parameters
 		bool choice : True, read from Buffer 0
 					  False, read from Buffer 1
-		uint8** Variable_2_Set
+		uint8** Variable_2_Set: Variable_2_Set[0] points to CAN_FRAME_LEN bytes
 
     Description
-        Sends read command to CAN Module
+        Reads the identifier, DLC and data of a receive buffer with one
+        READ RX BUFFER command, which also clears the buffer's RXnIF
 
 ****************************************************************************/
 
@@ -239,18 +276,18 @@ void CAN_Read_RX_Buffer(bool choice, uint8_t** Variable_2_Set)
 {
 	// Define constants
 	#define READ_BUFFER_TX_LENGTH 1
-	#define READ_BUFFER_RX_LENGTH 1
+	#define READ_BUFFER_RX_LENGTH CAN_FRAME_LEN
 	
 	uint8_t Data_2_Write[READ_BUFFER_TX_LENGTH];
 	
 	// Set read information
 	if (choice)
 	{
-		Data_2_Write[0] = MCP_READ_RX0;		
+		Data_2_Write[0] = MCP_READ_RX0_SIDH;
 	}
 	else
 	{
-		Data_2_Write[0] = MCP_READ_RX1;
+		Data_2_Write[0] = MCP_READ_RX1_SIDH;
 	}
 	
 	// Call SPI command
@@ -283,6 +320,45 @@ void CAN_Write(uint8_t Register_2_Set, uint8_t* Value_2_Set)
 	Write_SPI(WRITE_TX_LENGTH, WRITE_RX_LENGTH, Data_2_Write, NULL);
 }
 
+/****************************************************************************
+    Public Function
+        CAN_Write_Registers
+
+    Parameters
+		uint8_t First_Register
+		uint8_t Count: registers to write (up to MAX_SPI_BURST_TX-2)
+		uint8_t* Values_2_Set
+
+    Description
+        Writes consecutive registers with one write command, the address
+        increments on every byte
+
+****************************************************************************/
+
+void CAN_Write_Registers(uint8_t First_Register, uint8_t Count, uint8_t* Values_2_Set)
+{
+	// Define constants
+	#define WRITE_BURST_HEADER_LENGTH 2
+	
+	uint8_t Data_2_Write[MAX_SPI_BURST_TX];
+	
+	// Doesn't fit one SPI command
+	if (Count > (MAX_SPI_BURST_TX - WRITE_BURST_HEADER_LENGTH))
+	{
+		return;
+	}
+	
+	Data_2_Write[0] = MCP_WRITE;
+	Data_2_Write[1] = First_Register;
+	for (int i = 0; i < Count; i++)
+	{
+		Data_2_Write[WRITE_BURST_HEADER_LENGTH + i] = Values_2_Set[i];
+	}
+	
+	// Call SPI command
+	Write_SPI(WRITE_BURST_HEADER_LENGTH + Count, WRITE_RX_LENGTH, Data_2_Write, NULL);
+}
+
 /****************************************************************************
     Public Function
         CAN_Load_TX_Buffer
@@ -420,10 +496,11 @@ void CAN_RX_Status(uint8_t** Variable_2_Set)
 
     Description
         Performs bit modify operation on CAN module
+        Returns false if the SPI command buffer is full
 
 ****************************************************************************/
 
-void CAN_Bit_Modify(uint8_t Register_2_Set, uint8_t Bits_2_Change, uint8_t* Value_2_Set)
+bool CAN_Bit_Modify(uint8_t Register_2_Set, uint8_t Bits_2_Change, uint8_t* Value_2_Set)
 {
     // Define constants
     #define BM_TX_LENGTH 4
@@ -433,7 +510,7 @@ void CAN_Bit_Modify(uint8_t Register_2_Set, uint8_t Bits_2_Change, uint8_t* Valu
     uint8_t Data_2_Write[BM_TX_LENGTH] = {MCP_BITMOD, Register_2_Set, Bits_2_Change, Value_2_Set[0]};
     
     // Call SPI command
-    Write_SPI(BM_TX_LENGTH, BM_RX_LENGTH, Data_2_Write, NULL);
+    return Write_SPI(BM_TX_LENGTH, BM_RX_LENGTH, Data_2_Write, NULL);
 }
 
 /****************************************************************************
@@ -441,32 +518,113 @@ void CAN_Bit_Modify(uint8_t Register_2_Set, uint8_t Bits_2_Change, uint8_t* Valu
         CAN_Send_Message
 
     Parameters
-		
+		uint8_t Priority: transmit priority (0 lowest to 3 highest)
+		uint8_t Msg_Length: number of bytes (0 to 8)
+		uint8_t* Transmit_Data: message bytes
 
     Description
         Sends a CAN Message on the CAN Bus
+        The identifier, DLC and data are loaded into a free TX Buffer with
+        one LOAD TX BUFFER command (it starts at TXBnSIDH and the address
+        increments on every byte), then writing TXBnCTRL sets the priority
+        and requests the transmission. The MCP25625 sends the pending
+        frame with the highest priority first, so a reply never waits
+        behind a report.
+        Returns the TX Buffer used, or CAN_TX_NO_BUFFER, and the frame is
+        not sent, if all 3 TX Buffers are busy or the SPI command buffer
+        has fewer than CAN_SEND_SPI_ROWS free rows (can_tx_queue.c queues
+        the frames until both have room).
 
 ****************************************************************************/
 
-void CAN_Send_Message(uint8_t Msg_Length, uint8_t* Transmit_Data)
+uint8_t CAN_Send_Message(uint8_t Priority, uint8_t Msg_Length, uint8_t* Transmit_Data)
 {	
+	// Define constants
+	#define LOAD_FRAME_HEADER_LENGTH 6     // Instruction, SIDH, SIDL, EID8, EID0, DLC
+	#define LOAD_FRAME_RX_LENGTH 0
+	
+	uint8_t Data_2_Write[LOAD_FRAME_HEADER_LENGTH + 8];
+	uint8_t buffer = 0;
+	
 	// If invalid CAN Message Length don't perform transmit
 	if (Msg_Length > 8)
 	{
-		return;
+		return CAN_TX_NO_BUFFER;
 	}
+	// Both the LOAD and the TXBnCTRL write must fit the SPI command buffer
+	if (Get_SPI_Free_Rows() < CAN_SEND_SPI_ROWS)
+	{
+		return CAN_TX_NO_BUFFER;
+	}
+	// Find a free TX Buffer
+	while (TX_Busy & CAN_TX_BUFFER_IF(buffer))
+	{
+		buffer++;
+		if (MCP_N_TXBUFFERS <= buffer)
+		{
+			return CAN_TX_NO_BUFFER;
+		}
+	}
+	// Load the TX Buffer starting at TXBnSIDH
+	Data_2_Write[0] = TX_BUFFER_LOAD(buffer);
+	// Standard identifier, no extended identifier
+	Data_2_Write[1] = CAN_SIDH(CAN_MASTER_TX_SID);
+	Data_2_Write[2] = CAN_SIDL(CAN_MASTER_TX_SID);
+	Data_2_Write[3] = 0;
+	Data_2_Write[4] = 0;
 	// Set message length
-	TX_Data[0] = Msg_Length;
-	CAN_Write(MCP_TXB0DLC, TX_Data);
-	// Write in transmit data to required registers
+	Data_2_Write[5] = Msg_Length;
+	// Transmit data follows the DLC
 	for (int i = 0; i < Msg_Length; i++)
 	{
-		TX_Data[0] = Transmit_Data[i];
-		CAN_Write(MCP_TXB0D0 + i, TX_Data);
+		Data_2_Write[LOAD_FRAME_HEADER_LENGTH + i] = Transmit_Data[i];
 	}
-	// Transmit message
-	TX_Data[0] = 0xFF;
-	CAN_Bit_Modify(MCP_TXB0CTRL, (1 << 3), TX_Data);
+	Write_SPI(LOAD_FRAME_HEADER_LENGTH + Msg_Length, LOAD_FRAME_RX_LENGTH, Data_2_Write, NULL);
+	// Transmit message with its priority
+	TX_Data[0] = (MCP_TXB_TXREQ_M|(Priority & MCP_TXB_TXP10_M));
+	CAN_Write(TX_BUFFER_CTRL(buffer), TX_Data);
+	TX_Busy |= CAN_TX_BUFFER_IF(buffer);
+	
+	return buffer;
+}
+
+/****************************************************************************
+    Public Function
+        CAN_Abort_TX
+
+    Parameters
+		uint8_t Buffer: TX Buffer (0 to 2)
+
+    Description
+        Clears TXREQ so the MCP25625 stops trying to send the frame. A
+        frame already on the bus still completes, the TX Buffer stays busy
+        until CAN_TX_Done() frees it.
+        Returns false if the SPI command buffer is full
+
+****************************************************************************/
+
+bool CAN_Abort_TX(uint8_t Buffer)
+{
+	TX_Data[0] = 0;
+	return CAN_Bit_Modify(TX_BUFFER_CTRL(Buffer), MCP_TXB_TXREQ_M, TX_Data);
+}
+
+/****************************************************************************
+    Public Function
+        CAN_TX_Done
+
+    Parameters
+		uint8_t TX_Flags: CANINTF as read, or CAN_TX_BUFFER_IF() bits
+
+    Description
+        Frees the TX Buffers whose TXnIF is set, their frames were sent
+        or aborted
+
+****************************************************************************/
+
+void CAN_TX_Done(uint8_t TX_Flags)
+{
+	TX_Busy &= ~(TX_Flags & TX_BUFFER_FLAGS);
 }
 
 /****************************************************************************
@@ -474,35 +632,120 @@ void CAN_Send_Message(uint8_t Msg_Length, uint8_t* Transmit_Data)
         CAN_Read_Message
 
     Parameters
-		
+		bool choice : True, read from Buffer 0
+					  False, read from Buffer 1
 
     Description
-        Reads CAN message from the CAN Bus
+        Reads CAN message from the CAN Bus with a single SPI command, the
+        frame is put in the receive FIFO when the command completes
 
 ****************************************************************************/
 
-void CAN_Read_Message(void)
+void CAN_Read_Message(bool choice)
 {
-	for (int i = 0; i < CAN_MODEM_PACKET_LEN; i++)
-	{
-		CAN_Read(MCP_RXB0D0 + i, &(*(a_p_Recv_List+i)));
-	}
+	uint8_t Data_2_Write[READ_BUFFER_TX_LENGTH] = {choice ? MCP_READ_RX0_SIDH : MCP_READ_RX1_SIDH};
+	
+	// Call SPI command
+	Write_SPI_Notify(READ_BUFFER_TX_LENGTH, READ_BUFFER_RX_LENGTH, Data_2_Write, RX_Frame_List, rx_frame_read);
 }
 
 
+/****************************************************************************
+    Public Function
+        CAN_Read_Int_Flags
+
+    Parameters
+		uint8_t* p_flags: CAN_INT_FLAGS_LEN bytes
+		spi_done_cb_t p_done_cb: called once they are read
+
+    Description
+        Reads CANINTF and EFLG (consecutive registers) with one READ command
+        Returns false, and p_done_cb isn't called, if the SPI command
+        buffer is full
+
+****************************************************************************/
+
+bool CAN_Read_Int_Flags(uint8_t* p_flags, spi_done_cb_t p_done_cb)
+{
+	return CAN_Read_Registers(MCP_CANINTF, CAN_INT_FLAGS_LEN, p_flags, p_done_cb);
+}
+
+/****************************************************************************
+    Public Function
+        CAN_Read_Registers
+
+    Parameters
+		uint8_t First_Register: first register to read
+		uint8_t Count: number of consecutive registers
+		uint8_t* p_values: Count bytes, written from the SPI interrupt
+		spi_done_cb_t p_done_cb: called once they are read, or NULL
+
+    Description
+        Reads consecutive registers with one READ command
+        Returns false, and p_done_cb isn't called, if the SPI command
+        buffer is full
+
+****************************************************************************/
+
+bool CAN_Read_Registers(uint8_t First_Register, uint8_t Count, uint8_t* p_values, spi_done_cb_t p_done_cb)
+{
+	// Define constants
+	#define READ_REGISTERS_TX_LENGTH 2
+	
+	uint8_t Data_2_Write[READ_REGISTERS_TX_LENGTH] = {MCP_READ, First_Register};
+	
+	// Call SPI command
+	return Write_SPI_Notify(READ_REGISTERS_TX_LENGTH, Count, Data_2_Write, &p_values, p_done_cb);
+}
+
 // #############################################################################
 // ------------ PRIVATE FUNCTIONS
 // #############################################################################
 
 /****************************************************************************
     Private Function
-        
+        write_id_registers
+
+    Parameters
+		uint8_t First_Register: SIDH of the first filter or mask
+		uint8_t Count: filters or masks to write (up to 3)
+		const uint16_t* SIDs: their standard identifiers
+
+    Description
+        Writes consecutive filters or masks (SIDH, SIDL, EID8, EID0 each)
+        with one write command
+
+****************************************************************************/
+static void write_id_registers(uint8_t First_Register, uint8_t Count, const uint16_t* SIDs)
+{
+	// Define constants
+	#define ID_REGISTERS 4
+	
+	uint8_t Values[3*ID_REGISTERS];
+	
+	for (int i = 0; i < Count; i++)
+	{
+		Values[(i*ID_REGISTERS) + 0] = CAN_SIDH(SIDs[i]);
+		Values[(i*ID_REGISTERS) + 1] = CAN_SIDL(SIDs[i]);
+		Values[(i*ID_REGISTERS) + 2] = 0;
+		Values[(i*ID_REGISTERS) + 3] = 0;
+	}
+	CAN_Write_Registers(First_Register, Count*ID_REGISTERS, Values);
+}
+
+/****************************************************************************
+    Private Function
+        rx_frame_read
 
     Parameters
         None
 
     Description
-        
+        Called from the SPI interrupt once RX_Frame is read
 
 ****************************************************************************/
+static void rx_frame_read(void)
+{
+	Put_CAN_RX_Frame(RX_Frame);
+}
 
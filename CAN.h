@@ -1,17 +1,50 @@
 #ifndef CAN_H
 #define CAN_H
 
+// SPI Module (spi_done_cb_t)
+#include "SPI.h"
+
 // #############################################################################
 // ------------ CAN DEFINITIONS
 // #############################################################################
 
+// Frame read with READ RX BUFFER, from RXBnSIDH to RXBnD7
+#define CAN_FRAME_SIDH_IDX  0
+#define CAN_FRAME_SIDL_IDX  1
+#define CAN_FRAME_EID8_IDX  2
+#define CAN_FRAME_EID0_IDX  3
+#define CAN_FRAME_DLC_IDX   4
+#define CAN_FRAME_DATA_IDX  5
+#define CAN_FRAME_LEN       13
+
+// CANINTF and EFLG, read with CAN_Read_Int_Flags()
+#define CAN_INT_FLAGS_LEN   2
+
+// Standard identifier in the SIDH and SIDL registers
+#define CAN_SIDH(sid)       ((uint8_t) ((sid) >> 3))
+#define CAN_SIDL(sid)       ((uint8_t) ((sid) << 5))
+
+// TXnIF bit of TX Buffer n, CAN_Send_Message() returns CAN_TX_NO_BUFFER
+//  when all 3 are busy
+#define CAN_TX_BUFFER_IF(n) (MCP_TX0IF << (n))
+#define CAN_TX_NO_BUFFER    0xFF
+
+// SPI command buffer rows CAN_Send_Message() and each step of the
+//  initialization take, they're only started if all fit
+#define CAN_SEND_SPI_ROWS   2
+#define CAN_INIT_1_SPI_ROWS 4
+#define CAN_INIT_2_SPI_ROWS 8
+
+// Acceptance filters and masks
+#define CAN_NUM_RX_FILTERS  6
+#define CAN_NUM_RX_MASKS    2
 
 
 // #############################################################################
 // ------------ PUBLIC FUNCTION PROTOTYPES
 // #############################################################################
 
-void CAN_Initialize_1(uint8_t * * p_data_store);
+void CAN_Initialize_1(void);
 void CAN_Initialize_2(void);
 
 // CAN Module SPI Commands
@@ -19,14 +52,19 @@ void CAN_Reset(void);
 void CAN_Read(uint8_t Register_2_Read, uint8_t** Variable_2_Set);
 void CAN_Read_RX_Buffer(bool choice, uint8_t** Variable_2_Set);
 void CAN_Write(uint8_t Register_2_Set, uint8_t* Value_2_Set);
+void CAN_Write_Registers(uint8_t First_Register, uint8_t Count, uint8_t* Values_2_Set);
 void CAN_Load_TX_Buffer(uint8_t choice, uint8_t* Value_2_Set);
 void CAN_RTS(uint8_t choice);
 void CAN_Read_Status(uint8_t** Variable_2_Set);
 void CAN_RX_Status(uint8_t** Variable_2_Set);
-void CAN_Bit_Modify(uint8_t Register_2_Set, uint8_t Bits_2_Change, uint8_t* Value_2_Set);
+bool CAN_Bit_Modify(uint8_t Register_2_Set, uint8_t Bits_2_Change, uint8_t* Value_2_Set);
 
 // CAN User Commands
-void CAN_Send_Message(uint8_t Msg_Length, uint8_t* Transmit_Data);
-void CAN_Read_Message(void);
+uint8_t CAN_Send_Message(uint8_t Priority, uint8_t Msg_Length, uint8_t* Transmit_Data);
+bool CAN_Abort_TX(uint8_t Buffer);
+void CAN_TX_Done(uint8_t TX_Flags);
+void CAN_Read_Message(bool choice);
+bool CAN_Read_Int_Flags(uint8_t * p_flags, spi_done_cb_t p_done_cb);
+bool CAN_Read_Registers(uint8_t First_Register, uint8_t Count, uint8_t * p_values, spi_done_cb_t p_done_cb);
 
 #endif // CAN_H
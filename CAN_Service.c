@@ -0,0 +1,305 @@
+/*******************************************************************************
+    File:
+        CAN_Service.c
+
+    Notes:
+        This file contains the service that handles the MCP25625 interrupt.
+
+        The INT0 interrupt only posts EVT_CAN_INTERRUPT, so every SPI command
+        is queued from the main loop. The service then reads CANINTF and
+        EFLG with one command and services what is flagged:
+            RX0IF, RX1IF:   the buffer is read with READ RX BUFFER (which
+                            clears its flag), the frame goes to the receive
+                            FIFO. RX Buffer 0 rolls over to RX Buffer 1,
+                            it's read first as it holds the older frame.
+            TXnIF:          the frame in the TX Buffer was sent, the
+                            transmit queue loads the next one.
+            TXnIF, ERRIF,
+            WAKIF, MERRF:   cleared together with one BIT MODIFY.
+            RXnOVR (EFLG):  a frame was lost in the MCP25625, counted in the
+                            receive FIFO meters and cleared.
+        The flags are read again after each pass, the INT pin only has a new
+        falling edge once they are all clear. A command that doesn't fit the
+        SPI command buffer is left for later: its flag is still set at the
+        next read, and a flags read is queued again at the next check.
+
+        Every CAN_CHECK_MS the service checks the transmit queue for frames
+        that could not be sent in time, and lets the error supervisor read
+        the error counters and recover from bus off.
+
+    External Functions Required:
+        Post_Event(), Register_Timer(), Start_Timer()
+
+    Public Functions:
+        void Init_CAN_Service(void)
+        void Run_CAN_Service(uint32_t event_mask)
+
+*******************************************************************************/
+
+// #############################################################################
+// ------------ INCLUDES
+// #############################################################################
+
+// Standard ANSI  99 C types for exact integer sizes and booleans
+#include <stdint.h>
+#include <stdbool.h>
+
+// Config file
+#include "config.h"
+
+// Framework
+#include "framework.h"
+
+// SPI Module
+#include "SPI.h"
+
+// CAN Module
+#include "CAN.h"
+
+// MCP25625 registers
+#include "MCP25625defs.h"
+
+// CAN receive FIFO
+#include "can_rx_fifo.h"
+
+// CAN transmit queue
+#include "can_tx_queue.h"
+
+// CAN error supervisor
+#include "can_error_supervisor.h"
+
+// Timer
+#include "timer.h"
+
+// This module's header file
+#include "CAN_Service.h"
+
+// #############################################################################
+// ------------ MODULE DEFINITIONS
+// #############################################################################
+
+// Bytes read by CAN_Read_Int_Flags()
+#define FLAGS_CANINTF_IDX       (0)
+#define FLAGS_EFLG_IDX          (1)
+
+// CANINTF flags cleared by reading a receive buffer
+#define RX_FLAGS                (MCP_RX0IF|MCP_RX1IF)
+
+// EFLG receive overflow flags
+#define RX_OVR_FLAGS            (MCP_EFLG_RX0OVR|MCP_EFLG_RX1OVR)
+
+// Transmit queue and error check interval
+#define CAN_CHECK_MS            (25)
+
+// #############################################################################
+// ------------ MODULE VARIABLES
+// #############################################################################
+
+// Always enter CAN service with idle state
+static CAN_State_t Current_State = CAN_IDLE_STATE;
+
+// CANINTF and EFLG, as last read
+static uint8_t Flags[CAN_INT_FLAGS_LEN] = {0};
+
+// INT0 fired while the flags were being read
+static bool Interrupt_Pending = false;
+
+// The flags read is in the SPI command buffer, it's queued again at the
+//  next check if the buffer was full
+static bool Read_Queued = false;
+
+// Transmit queue and error check timer
+static uint32_t Check_Timer = EVT_CAN_CHECK;
+
+// #############################################################################
+// ------------ PRIVATE FUNCTION PROTOTYPES
+// #############################################################################
+
+static void read_flags(void);
+static void flags_read(void);
+static bool service_flags(void);
+
+// #############################################################################
+// ------------ PUBLIC FUNCTIONS
+// #############################################################################
+
+/****************************************************************************
+    Public Function
+        Init_CAN_Service
+
+    Parameters
+        None
+
+    Description
+        Initializes the CAN Service
+
+****************************************************************************/
+void Init_CAN_Service(void)
+{
+    // Start State Machine from idle state
+    Current_State = CAN_IDLE_STATE;
+    Interrupt_Pending = false;
+    Read_Queued = false;
+
+    Init_CAN_TX_Queue();
+    Init_CAN_Error_Supervisor();
+
+    // Register and start the check timer
+    Register_Timer(&Check_Timer, Post_Event);
+    Start_Timer(&Check_Timer, CAN_CHECK_MS);
+}
+
+/****************************************************************************
+    Public Function
+        Run_CAN_Service
+
+    Parameters
+        uint32_t event_mask
+
+    Description
+        Processes events for the MCP25625 interrupt
+
+****************************************************************************/
+void Run_CAN_Service(uint32_t event_mask)
+{
+    // In any state, it doesn't use the SPI flags read
+    if (EVT_CAN_CHECK == event_mask)
+    {
+        // Each queues only the SPI commands that fit
+        Check_CAN_Errors();
+        Check_CAN_TX_Timeouts();
+        if ((CAN_FLAGS_STATE == Current_State) && !Read_Queued)
+        {
+            read_flags();
+        }
+        Start_Timer(&Check_Timer, CAN_CHECK_MS);
+        return;
+    }
+
+    switch (Current_State)
+    {
+        case CAN_IDLE_STATE:
+            if (EVT_CAN_INTERRUPT == event_mask)
+            {
+                read_flags();
+                Current_State = CAN_FLAGS_STATE;
+            }
+            break;
+
+        case CAN_FLAGS_STATE:
+            if (EVT_CAN_INTERRUPT == event_mask)
+            {
+                // The flags read in progress may have missed it
+                Interrupt_Pending = true;
+            }
+            else if (EVT_CAN_FLAGS_READ == event_mask)
+            {
+                Read_Queued = false;
+
+                // Service the flags and read them again, until none is set
+                if (service_flags() || Interrupt_Pending)
+                {
+                    read_flags();
+                }
+                else
+                {
+                    Current_State = CAN_IDLE_STATE;
+                }
+            }
+            else
+            {
+                // Do Nothing
+            }
+            break;
+
+        default:
+            // Do Nothing.
+            break;
+    }
+}
+
+// #############################################################################
+// ------------ PRIVATE FUNCTIONS
+// #############################################################################
+
+/****************************************************************************
+    Private Function
+        read_flags
+
+    Parameters
+        None
+
+    Description
+        Queues the read of CANINTF and EFLG, or leaves it to the next
+        check if the SPI command buffer is full
+
+****************************************************************************/
+static void read_flags(void)
+{
+    Interrupt_Pending = false;
+    Read_Queued = CAN_Read_Int_Flags(Flags, flags_read);
+}
+
+/****************************************************************************
+    Private Function
+        flags_read
+
+    Parameters
+        None
+
+    Description
+        Called from the SPI interrupt once the flags are read
+
+****************************************************************************/
+static void flags_read(void)
+{
+    Post_Event(EVT_CAN_FLAGS_READ);
+}
+
+/****************************************************************************
+    Private Function
+        service_flags
+
+    Parameters
+        None
+
+    Description
+        Queues the SPI commands that service the flags read, returns false
+        if none was set
+
+****************************************************************************/
+static bool service_flags(void)
+{
+    uint8_t other_flags = Flags[FLAGS_CANINTF_IDX] & ~RX_FLAGS;
+    uint8_t clear = 0;
+
+    // Receive buffers, reading them clears their flags
+    if (Flags[FLAGS_CANINTF_IDX] & MCP_RX0IF)
+    {
+        CAN_Read_Message(true);
+    }
+    if (Flags[FLAGS_CANINTF_IDX] & MCP_RX1IF)
+    {
+        CAN_Read_Message(false);
+    }
+
+    // Error passive and bus off
+    CAN_Error_Flags_Read(Flags[FLAGS_EFLG_IDX]);
+
+    // Frames the MCP25625 had no room for. A flag that isn't cleared,
+    //  because the SPI command buffer is full, is serviced at the next read
+    if ((Flags[FLAGS_EFLG_IDX] & RX_OVR_FLAGS) && CAN_Bit_Modify(MCP_EFLG, RX_OVR_FLAGS, &clear))
+    {
+        Count_CAN_RX_HW_Overflow();
+    }
+
+    // Transmit done, errors and the rest in one go. Queued before any TX
+    //  Buffer is loaded again, or the TXnIF of its new frame could be
+    //  cleared. Sent frames then free their TX Buffers for the waiting ones
+    if ((0 == other_flags) || CAN_Bit_Modify(MCP_CANINTF, other_flags, &clear))
+    {
+        CAN_TX_Queue_Sent(Flags[FLAGS_CANINTF_IDX]);
+    }
+
+    return (0 != Flags[FLAGS_CANINTF_IDX]);
+}
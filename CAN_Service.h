@@ -0,0 +1,17 @@
+#ifndef CAN_service_H
+#define CAN_service_H
+
+// #############################################################################
+// ------------ TYPE DEFINITIONS
+// #############################################################################
+
+typedef enum {CAN_IDLE_STATE, CAN_FLAGS_STATE} CAN_State_t;
+
+// #############################################################################
+// ------------ PUBLIC FUNCTION PROTOTYPES
+// #############################################################################
+
+void Init_CAN_Service(void);
+void Run_CAN_Service(uint32_t event_mask);
+
+#endif // CAN_service_H
@@ -0,0 +1,317 @@
+/*******************************************************************************
+    File:
+        LIN_diagnostics.c
+  
+    Notes:
+        This file contains the diagnostic services of a node. It answers
+        read by identifier requests with this node's data. The requests
+        come over the LIN diagnostic frames on a slave, or from the CAN
+        modem on the master.
+
+    External Functions Required:
+        Get_LIN_Counters()
+        Get_LIN_Error_Stats()
+        Get_LIN_Frame_Error_Count()
+        Get_LIN_Sleep_Stats()
+        Get_System_Time_MS()
+        Read_Data_From_EEPROM()
+
+    Public Functions:
+        uint8_t Process_Diag_Request(uint8_t * p_request, uint8_t request_len, uint8_t * p_response)
+          
+*******************************************************************************/
+
+// #############################################################################
+// ------------ INCLUDES
+// #############################################################################
+
+// Standard ANSI  99 C types for exact integer sizes and booleans
+#include <stdint.h>
+#include <stdbool.h>
+
+// Config file
+#include "config.h"
+
+// Framework
+#include "framework.h"
+
+// This module's header file
+#include "LIN_diagnostics.h"
+
+// Include other files below:
+
+// LIN top layer
+#include "MS_LIN_top_layer.h"
+
+// Timer
+#include "timer.h"
+
+// EEPROM
+#include "eeprom_storage.h"
+
+// CAN receive FIFO meters
+#include "can_rx_fifo.h"
+
+// CAN transmit queue meters
+#include "can_tx_queue.h"
+
+// CAN error state and counters
+#include "can_error_supervisor.h"
+
+// memcpy, memset
+#include <string.h>
+
+// #############################################################################
+// ------------ MODULE DEFINITIONS
+// #############################################################################
+
+// Request PDU layout
+#define DIAG_REQ_SID_INDEX          (0)
+#define DIAG_REQ_ID_INDEX           (1)
+#define DIAG_REQ_ARG0_INDEX         (2)
+#define DIAG_REQ_ARG1_INDEX         (3)
+#define DIAG_REQ_MIN_LEN            (2)         // SID and identifier
+
+// Positive response PDU layout
+#define DIAG_RSP_RSID_INDEX         (0)
+#define DIAG_RSP_ID_INDEX           (1)
+#define DIAG_RSP_DATA_INDEX         (2)
+
+// Negative response PDU layout
+#define DIAG_NEG_RSP_SID_INDEX      (1)
+#define DIAG_NEG_RSP_NRC_INDEX      (2)
+#define DIAG_NEG_RSP_LEN            (3)
+
+// #############################################################################
+// ------------ MODULE VARIABLES
+// #############################################################################
+
+
+
+// #############################################################################
+// ------------ PRIVATE FUNCTION PROTOTYPES
+// #############################################################################
+
+static uint8_t read_by_identifier(uint8_t identifier, uint8_t arg0, uint8_t arg1, uint8_t * p_data);
+static uint8_t write_negative_response(uint8_t * p_response, uint8_t sid, uint8_t nrc);
+
+// #############################################################################
+// ------------ PUBLIC FUNCTIONS
+// #############################################################################
+
+/****************************************************************************
+    Public Function
+        Process_Diag_Request
+
+    Parameters
+        uint8_t * p_request: request PDU
+        uint8_t request_len: length of the request PDU
+        uint8_t * p_response: where to build the response PDU
+
+    Description
+        Processes a diagnostic request and builds the positive or negative
+        response. Returns the length of the response PDU.
+
+****************************************************************************/
+uint8_t Process_Diag_Request(uint8_t * p_request, uint8_t request_len, uint8_t * p_response)
+{
+    uint8_t data_len;
+    uint8_t arg0;
+    uint8_t arg1;
+
+    // We need at least a SID and an identifier
+    if (DIAG_REQ_MIN_LEN > request_len)
+    {
+        return write_negative_response(p_response, p_request[DIAG_REQ_SID_INDEX], LIN_DIAG_NRC_OUT_OF_RANGE);
+    }
+
+    // Read by identifier is the only service we support
+    if (LIN_DIAG_SID_READ_BY_ID != p_request[DIAG_REQ_SID_INDEX])
+    {
+        return write_negative_response(p_response, p_request[DIAG_REQ_SID_INDEX], LIN_DIAG_NRC_NOT_SUPPORTED);
+    }
+
+    // Missing arguments read as zero
+    arg0 = (DIAG_REQ_ARG0_INDEX < request_len) ? p_request[DIAG_REQ_ARG0_INDEX] : 0;
+    arg1 = (DIAG_REQ_ARG1_INDEX < request_len) ? p_request[DIAG_REQ_ARG1_INDEX] : 0;
+
+    // Fill in the data for the identifier
+    data_len = read_by_identifier(p_request[DIAG_REQ_ID_INDEX], arg0, arg1, &p_response[DIAG_RSP_DATA_INDEX]);
+
+    // A zero length means we couldn't read the identifier
+    if (0 == data_len)
+    {
+        return write_negative_response(p_response, p_request[DIAG_REQ_SID_INDEX], LIN_DIAG_NRC_OUT_OF_RANGE);
+    }
+
+    // Positive response
+    p_response[DIAG_RSP_RSID_INDEX] = LIN_DIAG_SID_READ_BY_ID+LIN_DIAG_RSID_OFFSET;
+    p_response[DIAG_RSP_ID_INDEX] = p_request[DIAG_REQ_ID_INDEX];
+    return (DIAG_RSP_DATA_INDEX+data_len);
+}
+
+// #############################################################################
+// ------------ PRIVATE FUNCTIONS
+// #############################################################################
+
+/****************************************************************************
+    Private Function
+        read_by_identifier
+
+    Parameters
+        uint8_t identifier: identifier to read
+        uint8_t arg0, arg1: request arguments
+        uint8_t * p_data: where to write the data for the identifier
+
+    Description
+        Writes the data for the requested identifier and returns its length,
+        or 0 if the identifier is unknown or out of range.
+
+****************************************************************************/
+static uint8_t read_by_identifier(uint8_t identifier, uint8_t arg0, uint8_t arg1, uint8_t * p_data)
+{
+    lin_counters_t counters;
+    lin_error_stats_t error_stats;
+    lin_sleep_stats_t sleep_stats;
+    can_rx_stats_t can_stats;
+    can_tx_stats_t can_tx_stats;
+    can_error_stats_t can_error_stats;
+    uint16_t eeprom_address;
+    uint8_t index;
+    uint32_t now_ms;
+    uint32_t age_ms;
+
+    switch (identifier)
+    {
+        case DIAG_ID_FW_VERSION:
+            // Version and whether we are a master or slave
+            p_data[0] = FIRMWARE_VERSION_MAJOR;
+            p_data[1] = FIRMWARE_VERSION_MINOR;
+            p_data[2] = IS_MASTER_NODE ? master_node : slave_node;
+            return 3;
+
+        case DIAG_ID_LIN_COUNTERS:
+            // Error count, frames received, frames transmitted
+            Get_LIN_Counters(&counters);
+            p_data[0] = counters.error_count;
+            memcpy(&p_data[1], &counters.rx_frame_count, sizeof(counters.rx_frame_count));
+            memcpy(&p_data[3], &counters.tx_frame_count, sizeof(counters.tx_frame_count));
+            return 5;
+
+        case DIAG_ID_EEPROM:
+            // The arguments are the big endian EEPROM address
+            eeprom_address = ((uint16_t) arg0 << 8) | arg1;
+            if ((E2END+1) < (eeprom_address+DIAG_EEPROM_READ_LEN)) return 0;
+
+            // Unread bytes (if the EEPROM is busy writing) read as erased
+            memset(p_data, 0xFF, DIAG_EEPROM_READ_LEN);
+            Read_Data_From_EEPROM((uint8_t *) eeprom_address, p_data, DIAG_EEPROM_READ_LEN);
+            return DIAG_EEPROM_READ_LEN;
+
+        case DIAG_ID_TIMING_STATS:
+            // Uptime, and time since the last LIN response we received
+            Get_LIN_Counters(&counters);
+            now_ms = Get_System_Time_MS();
+            age_ms = now_ms-counters.last_rx_time_ms;
+            memcpy(&p_data[0], &now_ms, sizeof(now_ms));
+            memcpy(&p_data[4], &age_ms, sizeof(age_ms));
+            return 8;
+
+        case DIAG_ID_LIN_ERROR_CLASSES:
+            // For each error class (in LINERR bit order): total, recent
+            Get_LIN_Error_Stats(&error_stats);
+            for (index = 0; index < NUM_LIN_ERR_CLASSES; index++)
+            {
+                memcpy(&p_data[3*index], &error_stats.total[index], sizeof(error_stats.total[index]));
+                p_data[(3*index)+2] = error_stats.recent[index];
+            }
+            return (3*NUM_LIN_ERR_CLASSES);
+
+        case DIAG_ID_LIN_FRAME_ERRORS:
+            // Recent error counts for the frame IDs starting at arg0
+            if (LIN_DIAG_SLAVE_RESP_ID < arg0) return 0;
+            for (index = 0; index < DIAG_FRAME_ERRORS_READ_LEN; index++)
+            {
+                p_data[index] = Get_LIN_Frame_Error_Count(arg0+index);
+            }
+            return DIAG_FRAME_ERRORS_READ_LEN;
+
+        case DIAG_ID_SLEEP_STATS:
+            // Times the bus went to sleep, last wake up latency
+            Get_LIN_Sleep_Stats(&sleep_stats);
+            memcpy(&p_data[0], &sleep_stats.sleep_count, sizeof(sleep_stats.sleep_count));
+            memcpy(&p_data[2], &sleep_stats.wake_latency_ms, sizeof(sleep_stats.wake_latency_ms));
+            return 4;
+
+        case DIAG_ID_EXT_STATUS:
+            // The master's copy of a slave's last extended status
+            if (!IS_MASTER_NODE) return 0;
+            if (!Master_LIN_Get_Ext_Status(arg0, p_data)) return 0;
+            return LIN_EXT_STATUS_LEN;
+
+        case DIAG_ID_CAN_STATS:
+            // Frames received, dropped with the FIFO full, most waiting,
+            //  lost in the MCP25625
+            if (!IS_MASTER_NODE) return 0;
+            Get_CAN_RX_Stats(&can_stats);
+            memcpy(&p_data[0], &can_stats.received, sizeof(can_stats.received));
+            memcpy(&p_data[2], &can_stats.overflows, sizeof(can_stats.overflows));
+            p_data[4] = can_stats.max_fill;
+            memcpy(&p_data[5], &can_stats.hw_overflows, sizeof(can_stats.hw_overflows));
+            return 7;
+
+        case DIAG_ID_CAN_TX_STATS:
+            // Frames queued, sent, dropped with the queue full, aborted,
+            //  most waiting, longest and last time from queued to sent
+            if (!IS_MASTER_NODE) return 0;
+            Get_CAN_TX_Stats(&can_tx_stats);
+            memcpy(&p_data[0], &can_tx_stats.queued, sizeof(can_tx_stats.queued));
+            memcpy(&p_data[2], &can_tx_stats.sent, sizeof(can_tx_stats.sent));
+            memcpy(&p_data[4], &can_tx_stats.dropped, sizeof(can_tx_stats.dropped));
+            memcpy(&p_data[6], &can_tx_stats.timeouts, sizeof(can_tx_stats.timeouts));
+            p_data[8] = can_tx_stats.max_fill;
+            memcpy(&p_data[9], &can_tx_stats.max_send_ms, sizeof(can_tx_stats.max_send_ms));
+            memcpy(&p_data[11], &can_tx_stats.last_send_ms, sizeof(can_tx_stats.last_send_ms));
+            return 13;
+
+        case DIAG_ID_CAN_ERRORS:
+            // Error state (0 active, 1 warning, 2 passive, 3 bus off),
+            //  TEC, REC, their highest, times error passive, bus off and
+            //  reset to recover
+            if (!IS_MASTER_NODE) return 0;
+            Get_CAN_Error_Stats(&can_error_stats);
+            p_data[0] = can_error_stats.state;
+            p_data[1] = can_error_stats.tec;
+            p_data[2] = can_error_stats.rec;
+            p_data[3] = can_error_stats.max_tec;
+            p_data[4] = can_error_stats.max_rec;
+            memcpy(&p_data[5], &can_error_stats.passive_count, sizeof(can_error_stats.passive_count));
+            memcpy(&p_data[7], &can_error_stats.bus_off_count, sizeof(can_error_stats.bus_off_count));
+            memcpy(&p_data[9], &can_error_stats.reinit_count, sizeof(can_error_stats.reinit_count));
+            return 11;
+
+        default:
+            return 0;
+    }
+}
+
+/****************************************************************************
+    Private Function
+        write_negative_response
+
+    Parameters
+        uint8_t * p_response: where to build the response PDU
+        uint8_t sid: SID of the request
+        uint8_t nrc: negative response code
+
+    Description
+        Builds a negative response PDU and returns its length
+
+****************************************************************************/
+static uint8_t write_negative_response(uint8_t * p_response, uint8_t sid, uint8_t nrc)
+{
+    p_response[DIAG_RSP_RSID_INDEX] = LIN_DIAG_RSID_NEGATIVE;
+    p_response[DIAG_NEG_RSP_SID_INDEX] = sid;
+    p_response[DIAG_NEG_RSP_NRC_INDEX] = nrc;
+    return DIAG_NEG_RSP_LEN;
+}
@@ -0,0 +1,12 @@
+#ifndef LIN_diagnostics_H
+#define LIN_diagnostics_H
+
+// #############################################################################
+// ------------ PUBLIC FUNCTION PROTOTYPES
+// #############################################################################
+
+// Builds the response PDU for a diagnostic request PDU, returns its length.
+// p_response must be LIN_DIAG_MAX_PDU_LEN long.
+uint8_t Process_Diag_Request(uint8_t * p_request, uint8_t request_len, uint8_t * p_response);
+
+#endif // LIN_diagnostics_H
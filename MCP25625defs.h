@@ -129,18 +129,25 @@
 
 #define MCP_BITMOD          0x05
 
-#define MCP_LOAD_TX0        0x41
+#define MCP_LOAD_TX0        0x41                                    // Starts at TXBnD0
 #define MCP_LOAD_TX1        0x43
 #define MCP_LOAD_TX2        0x45
 
+#define MCP_LOAD_TX0_SIDH   0x40                                    // Starts at TXBnSIDH
+#define MCP_LOAD_TX1_SIDH   0x42
+#define MCP_LOAD_TX2_SIDH   0x44
+
 #define MCP_RTS_TX0         0x81
 #define MCP_RTS_TX1         0x82
 #define MCP_RTS_TX2         0x84
 #define MCP_RTS_ALL         0x87
 
-#define MCP_READ_RX0        0x92
+#define MCP_READ_RX0        0x92                                    // Starts at RXBnD0
 #define MCP_READ_RX1        0x96
 
+#define MCP_READ_RX0_SIDH   0x90                                    // Starts at RXBnSIDH
+#define MCP_READ_RX1_SIDH   0x94
+
 #define MCP_READ_STATUS     0xA0
 
 #define MCP_RX_STATUS       0xB0
@@ -6,6 +6,19 @@
         This file contains upper level implementation for LIN communication
         between the master and slave nodes of the 360 lighting system.
 
+        It also contains a minimal LIN 2.x diagnostic transport layer on the
+        master request (0x3C) and slave response (0x3D) frames. A PDU is sent
+        as a single frame (SF) when it fits in 6 bytes, otherwise as a first
+        frame (FF) followed by consecutive frames (CF).
+            SF: NAD, 0x0L, 6 data bytes (L = PDU length)
+            FF: NAD, 0x1H, LL, 5 data bytes (HLL = PDU length)
+            CF: NAD, 0x2N, 6 data bytes (N = frame sequence number)
+        Unused bytes are filled with 0xFF.
+
+        The master puts the bus to sleep with the go-to-sleep command, a
+        master request frame with a NAD of 0x00. The slaves then power down
+        until the master wakes the bus with a dominant pulse.
+
     External Functions Required:
         Post_Event_Slave_Service()
 
@@ -39,11 +52,135 @@
 // Command/Status helpers
 #include "cmd_sts_helpers.h"
 
+// Timer
+#include "timer.h"
+
+// memcpy
+#include <string.h>
+
+// Atomic Read/Write operations
+#include <util/atomic.h>
+
+// Power down
+#include <avr/sleep.h>
+
 // #############################################################################
 // ------------ MODULE DEFINITIONS
 // #############################################################################
 
+// Diagnostic frame layout
+#define LIN_DIAG_NAD_INDEX          (0)
+#define LIN_DIAG_PCI_INDEX          (1)
+#define LIN_DIAG_PCI_TYPE_MASK      (0xF0)
+#define LIN_DIAG_PCI_INFO_MASK      (0x0F)
+#define LIN_DIAG_PCI_SF             (0x00)
+#define LIN_DIAG_PCI_FF             (0x10)
+#define LIN_DIAG_PCI_CF             (0x20)
+#define LIN_DIAG_SF_DATA_INDEX      (2)
+#define LIN_DIAG_SF_MAX_LEN         (6)
+#define LIN_DIAG_FF_LEN_INDEX       (2)
+#define LIN_DIAG_FF_DATA_INDEX      (3)
+#define LIN_DIAG_FF_DATA_LEN        (5)
+#define LIN_DIAG_CF_DATA_INDEX      (2)
+#define LIN_DIAG_CF_DATA_LEN        (6)
+#define LIN_DIAG_FIRST_CF_SEQ       (1)
+#define LIN_DIAG_FILL_BYTE          (0xFF)
+
+// LIN error statistics
+// Recent error counts are halved this often
+#define LIN_ERR_DECAY_INTERVAL_MS   (1000)
+// After this many halvings every 8 bit count is 0
+#define LIN_ERR_MAX_HALVINGS        (8)
+// Per frame statistics are kept for every scheduled ID, plus the two
+//  diagnostic IDs in the last two slots
+#define LIN_ERR_NUM_SCHEDULE_IDS    (GET_SLAVE_BASE_ID((HIGHEST_SLAVE_NUMBER+1)))
+#define LIN_ERR_DIAG_REQ_SLOT       (LIN_ERR_NUM_SCHEDULE_IDS)
+#define LIN_ERR_DIAG_RESP_SLOT      (LIN_ERR_NUM_SCHEDULE_IDS+1)
+#define LIN_ERR_NUM_FRAME_SLOTS     (LIN_ERR_NUM_SCHEDULE_IDS+2)
+#define LIN_ERR_NO_FRAME_SLOT       (0xFF)
+// The per frame counts are 4 bits, two to a byte, and saturate
+#define LIN_ERR_FRAME_COUNT_MAX     (0x0F)
+#define LIN_ERR_FRAME_COUNT_BITS    (4)
+
+// LIN ID table
+// One entry per LIN ID: | action (2 bits) | store (1 bit) | slot (5 bits) |
+// The slot is the packet index in the store (slave number-1 on the master).
+// For special IDs the slot says which special frame it is.
+// Entries hold a slot rather than a pointer, because the live buffer of a
+//  store moves on every commit (and it keeps the table at 64 bytes).
+#define LIN_NUM_IDS                 (64)
+#define LIN_ACTION_MASK             (0xC0)
+#define LIN_ACTION_IGNORE           (0x00)      // Not for us
+#define LIN_ACTION_RX               (0x40)      // Receive into a store slot
+#define LIN_ACTION_TX               (0x80)      // Transmit from a store slot
+#define LIN_ACTION_SPECIAL          (0xC0)      // Handled by its own task
+#define LIN_ENTRY_STATUS_STORE      (0x20)      // Status store, else command store
+#define LIN_ENTRY_SLOT_MASK         (0x1F)
+#if (MAX_NUM_SLAVES > (LIN_ENTRY_SLOT_MASK+1))
+#error "LIN ID table slots can't address MAX_NUM_SLAVES"
+#endif
+#define LIN_SPECIAL_DIAG            (LIN_ACTION_SPECIAL|0x00)   // Diagnostic transport layer
+#define LIN_SPECIAL_EVENT           (LIN_ACTION_SPECIAL|0x01)   // Event-triggered status
+#define LIN_SPECIAL_EXT_STATUS      (LIN_ACTION_SPECIAL|0x02)   // Extended status
+#define LIN_SPECIAL_COMMIT          (LIN_ACTION_SPECIAL|0x03)   // Commit frame
+#define LIN_SPECIAL_SCENE           (LIN_ACTION_SPECIAL|0x04)   // Scene frame
+
+// Extended status slot while it's still being received
+#define EXT_STATUS_RECEIVING        (0x80)
+
+// Status slot when no status came since the master last took one
+#define STATUS_RX_NONE              (0xFF)
+
+// Bus meters (master)
+// Utilisation is the time from each header to the end of its frame, over
+//  a window of LIN_UTIL_WINDOW_US.
+// Status response latencies are binned per slave:
+//  below LIN_LATENCY_BUCKET_BASE_US, then LIN_LATENCY_BUCKET_WIDTH_US wide.
+//  A nominal status frame (34 bit header, 5 byte response) takes 4.4ms and
+//  a slot is 5ms, so the bins sit around 4.4ms: below 4.25ms (shorter than
+//  a status frame), 4.25-4.5ms (nominal), 4.5-4.75ms and 4.75ms or more
+//  (slow response space or inter-byte spaces).
+#define LIN_UTIL_WINDOW_US          (1000000UL)
+#define LIN_HEADER_US               (1771)  // 34 bits at 19200 baud
+#define LIN_LATENCY_BUCKET_BASE_US  (4250)
+#define LIN_LATENCY_BUCKET_WIDTH_US (250)
+// The buckets are 4 bits, the longest response a byte in these units
+#define LIN_LATENCY_BUCKET_MAX      (0x0F)
+#define LIN_LATENCY_BUCKET_BITS     (4)
+#define LIN_LATENCY_MAX_UNIT_US     (32)
+
+// How a slot ended
+#define LIN_SLOT_COMPLETE           (0)     // Response sent or received
+#define LIN_SLOT_FAILED             (1)     // Response missing or corrupted
+#define LIN_SLOT_SILENT             (2)     // Nobody had to answer
+
+// Number of empty slave response headers the master sends before it gives
+// up on a diagnostic response (one header per schedule round)
+#define LIN_DIAG_RESPONSE_POLLS     (10)
+
+// Slaves without a number answer at once, or not at all (auto-addressing)
+#define LIN_DIAG_UNASSIGNED_POLLS   (2)
+
+// #############################################################################
+// ------------ TYPE DEFINITIONS
+// #############################################################################
+
+// A diagnostic PDU being sent or reassembled
+typedef struct
+{
+    uint8_t         nad;                            // Node address
+    uint8_t         len;                            // PDU length, 0 if empty
+    uint8_t         index;                          // PDU bytes sent/received
+    uint8_t         seq;                            // Next CF sequence number
+    uint8_t         data[LIN_DIAG_MAX_PDU_LEN];     // PDU bytes
+} lin_diag_pdu_t;
 
+// Status response latency of one slave, as the master keeps it
+typedef struct
+{
+    uint16_t        buckets;            // Bucket n in bits 4n to 4n+3
+    uint8_t         max_latency;        // Longest response in LIN_LATENCY_MAX_UNIT_US
+} lin_latency_record_t;
 
 // #############################################################################
 // ------------ MODULE VARIABLES
@@ -51,20 +188,108 @@
 
 // Use pointers so the values can only exist in one place
 static uint8_t * p_My_Node_ID;          // Pointer to this node's ID
-static uint8_t * p_My_Command_Data;     // Pointer to this node's command store
-static uint8_t * p_My_Status_Data;      // Pointer to this node's status store
+static data_store_t * p_My_Command_Store;   // Pointer to this node's command store
+static data_store_t * p_My_Status_Store;    // Pointer to this node's status store (slave)
+
+// What to do with each LIN ID, built from our node ID
+static uint8_t LIN_ID_Table[LIN_NUM_IDS] = {0};
+
+// LIN error and frame counters
+static lin_counters_t My_LIN_Counters = {0};
+
+// Master: whether the response to the last header we sent completed
+static bool Last_Frame_OK = false;
+
+// Master: the last status received, polled or event-triggered, until the
+//  schedule takes it. At most one comes per slot, so the master keeps a
+//  bit per slave rather than every status (see Master_LIN_Get_Status()).
+static uint8_t Status_Rx_Data[LIN_PACKET_LEN] = {0};
+static uint8_t Status_Rx_Slot = STATUS_RX_NONE;     // Slave it came from
 
-// LIN error counters
-static uint8_t My_LIN_Error_Count = 0;
+// Event-triggered status frames
+static bool Event_Collision = false;                        // Master: last one collided
+static uint8_t Event_Tx_Frame[LIN_EVENT_FRAME_LEN];         // Slave: last status sent
+static uint8_t Last_Reported_Status[LIN_PACKET_LEN] = {0};  // Slave: status master has
+
+// Extended status frames
+// Master: the last one received, slave: ours
+static uint8_t Ext_Status_Data[LIN_EXT_STATUS_LEN] = {0};
+static uint8_t Ext_Status_Slot = EXT_STATUS_RECEIVING;  // Master: slave it came from
+static uint8_t Last_Header_ID = 0;          // ID of the header before this one
+
+// Commit frames (master)
+static uint8_t Commit_Frame[LIN_COMMIT_FRAME_LEN] = {0};
+
+// Scene frames
+// Master: the next one to send, slave: the last one received
+static uint8_t Scene_Frame[LIN_SCENE_FRAME_LEN] = {0};
+
+// Sleep and wake up
+static bool Sleep_Pending = false;              // Master: go-to-sleep command queued
+static bool Bus_Asleep = false;                 // Go-to-sleep command sent/received
+static bool Wake_Latency_Pending = false;       // Waiting for the first response
+static uint32_t Wake_Time_MS = 0;               // System time of the last wake up
+static lin_sleep_stats_t My_LIN_Sleep_Stats = {0};
+
+// Bus meters (master)
+#if IS_MASTER_NODE
+static lin_bus_stats_t My_LIN_Bus_Stats = {0};
+static lin_latency_record_t My_LIN_Latency_Stats[NUM_SLAVES] = {{0}};
+static bool Slot_Pending = false;               // Header sent, frame not over
+static uint8_t Slot_ID = 0;                     // ID of that header
+static uint32_t Slot_Start_US = 0;              // When that header was sent
+static uint32_t Util_Window_Start_US = 0;       // Start of the utilisation window
+static uint32_t Util_Busy_US = 0;               // Busy time in the window
+#endif
+
+// LIN error statistics, per error class and per frame ID
+// A noisy bus shows bit/checksum/parity errors spread over all frames, a dead
+//  slave shows time outs on its own status request only.
+static lin_error_stats_t My_LIN_Error_Stats = {{0}};
+static uint8_t My_LIN_Frame_Errors[(LIN_ERR_NUM_FRAME_SLOTS+1)/2] = {0};
+static uint32_t LIN_Error_Decay_Time_MS = 0;    // Time of the last decay step
+
+// Diagnostic transport
+// The master sends requests from Diag_Tx and reassembles responses in Diag_Rx,
+// a slave reassembles requests in Diag_Rx and sends responses from Diag_Tx.
+static lin_diag_pdu_t Diag_Tx = {0};
+static lin_diag_pdu_t Diag_Rx = {0};
+static uint8_t Diag_Tx_Chunk_Len = 0;       // PDU bytes in the frame being sent
+static bool Diag_Rx_Ready = false;          // Complete PDU (or timeout) ready
+static bool Diag_Awaiting_Response = false; // Master is polling for a response
+static uint8_t Diag_Polls_Left = 0;         // Master polls left before timeout
+static bool Diag_Collision = false;         // Master: several slaves answered
 
 // #############################################################################
 // ------------ PRIVATE FUNCTION PROTOTYPES
 // #############################################################################
 
 static void lin_id_task(void);
+static void diag_id_task(uint8_t lin_id);
+static void event_id_task(void);
+static void ext_status_id_task(void);
+static void commit_id_task(void);
+static void scene_id_task(void);
+static void receive_event_frame(void);
+static void receive_status(uint8_t slot, uint8_t * p_status);
 static void lin_rx_task(void);
 static void lin_tx_task(void);
-static void lin_err_task(void);
+static void lin_err_task(uint8_t error_status);
+static void decay_error_stats(void);
+static void start_slot_timing(uint8_t lin_id);
+static void end_slot_timing(uint8_t outcome);
+static uint8_t get_frame_error_slot(uint8_t lin_id);
+static uint8_t get_frame_error_count(uint8_t slot);
+static bool is_master(void);
+static data_store_t * get_entry_store(uint8_t entry);
+static uint8_t * get_slot_data(uint8_t * p_buffer, uint8_t entry);
+static uint8_t get_my_nad(void);
+static void transmit_sleep_frame(void);
+static void start_wake_latency(void);
+static void transmit_diag_frame(void);
+static void advance_diag_tx(void);
+static void receive_diag_frame(void);
+static bool parse_diag_frame(uint8_t * p_frame);
 
 // #############################################################################
 // ------------ PUBLIC FUNCTIONS
@@ -76,15 +301,20 @@ static void lin_err_task(void);
 
     Parameters
         uint8_t * p_this_node_id: pointer to this node's id
-        uint8_t * p_command_data: pointer to this node's command data store
-        uint8_t * p_status_data: pointer to this node's status data store
+        data_store_t * p_command_store: pointer to this node's command store
+        data_store_t * p_status_store: pointer to this node's status store,
+            NULL on the master (see Master_LIN_Get_Status())
 
     Description
         Initializes the LIN bus for the nodes based on ATtiny167
 
+        Whoever receives a store's data over LIN writes its shadow buffer
+        and commits it here, the service is the writer of the other store.
+        Responses are always sent from the live buffers.
+
 ****************************************************************************/
-void MS_LIN_Initialize(uint8_t * p_this_node_id, uint8_t * p_command_data, \
-    uint8_t * p_status_data)
+void MS_LIN_Initialize(uint8_t * p_this_node_id, data_store_t * p_command_store, \
+    data_store_t * p_status_store)
 {
     // 0. Enable the LIN transceiver via PB0 which is connected to 
     // ENABLE (ATA6617C: Pin 18) on our custom PCBs.
@@ -103,8 +333,80 @@ void MS_LIN_Initialize(uint8_t * p_this_node_id, uint8_t * p_command_data, \
     p_My_Node_ID = p_this_node_id;
 
     // 3. Save the pointers to the data stores
-    p_My_Command_Data = p_command_data;
-    p_My_Status_Data = p_status_data;
+    p_My_Command_Store = p_command_store;
+    p_My_Status_Store = p_status_store;
+
+    // 4. Build the LIN ID table for our node ID
+    MS_LIN_Update_ID_Table();
+}
+
+/****************************************************************************
+    Public Function
+        MS_LIN_Update_ID_Table
+
+    Parameters
+        None
+
+    Description
+        Rebuilds the table of what this node does with each LIN ID.
+        Call it whenever this node's ID changes.
+
+****************************************************************************/
+void MS_LIN_Update_ID_Table(void)
+{
+    uint8_t slave_base_id;
+
+    // Build the table in place with interrupts off, so the LIN ISR never
+    //  sees half of it (and we need no second copy of it on the stack)
+    ATOMIC_BLOCK(ATOMIC_RESTORESTATE)
+    {
+        memset(LIN_ID_Table, 0, LIN_NUM_IDS);
+
+        if (is_master())
+        {
+            // We send each slave's command and receive its status
+            for (uint8_t slave_num = LOWEST_SLAVE_NUMBER; slave_num <= HIGHEST_SLAVE_NUMBER; slave_num++)
+            {
+                slave_base_id = GET_SLAVE_BASE_ID(slave_num);
+                LIN_ID_Table[slave_base_id] = LIN_ACTION_TX|(slave_num-LOWEST_SLAVE_NUMBER);
+                LIN_ID_Table[slave_base_id|REQUEST_MASK] = LIN_ACTION_RX|LIN_ENTRY_STATUS_STORE|(slave_num-LOWEST_SLAVE_NUMBER);
+            }
+
+            // We receive changed stati in the event-triggered frame
+            LIN_ID_Table[LIN_EVENT_STATUS_ID] = LIN_SPECIAL_EVENT;
+
+            // We receive the slaves' telemetry in the extended status frame
+            LIN_ID_Table[LIN_EXT_STATUS_ID] = LIN_SPECIAL_EXT_STATUS;
+
+            // We tell the slaves when to apply their commands
+            LIN_ID_Table[LIN_COMMIT_ID] = LIN_SPECIAL_COMMIT;
+
+            // We send the requested location to every slave at once
+            LIN_ID_Table[LIN_SCENE_ID] = LIN_SPECIAL_SCENE;
+        }
+        else if (LIN_NUM_IDS > ((*p_My_Node_ID)|REQUEST_MASK))
+        {
+            // We receive our command and send our status
+            LIN_ID_Table[*p_My_Node_ID] = LIN_ACTION_RX;
+            LIN_ID_Table[(*p_My_Node_ID)|REQUEST_MASK] = LIN_ACTION_TX|LIN_ENTRY_STATUS_STORE;
+
+            // We send our status in the event-triggered frame when it changed
+            LIN_ID_Table[LIN_EVENT_STATUS_ID] = LIN_SPECIAL_EVENT;
+
+            // We send our telemetry in the extended status frame on our turn
+            LIN_ID_Table[LIN_EXT_STATUS_ID] = LIN_SPECIAL_EXT_STATUS;
+
+            // We apply our command when the master commits the scene
+            LIN_ID_Table[LIN_COMMIT_ID] = LIN_SPECIAL_COMMIT;
+
+            // We work out our own command from the requested location
+            LIN_ID_Table[LIN_SCENE_ID] = LIN_SPECIAL_SCENE;
+        }
+
+        // Everyone takes part in the diagnostic frames
+        LIN_ID_Table[LIN_DIAG_MASTER_REQ_ID] = LIN_SPECIAL_DIAG;
+        LIN_ID_Table[LIN_DIAG_SLAVE_RESP_ID] = LIN_SPECIAL_DIAG;
+    }
 }
 
 /****************************************************************************
@@ -120,145 +422,1766 @@ void MS_LIN_Initialize(uint8_t * p_this_node_id, uint8_t * p_command_data, \
 ****************************************************************************/
 void Master_LIN_Broadcast_ID(uint8_t slave_id)
 {
+    // The frame isn't complete until its response is
+    Last_Frame_OK = false;
+
+    // Time the slot
+    start_slot_timing(slave_id);
+
     // Broadcast the LIN header
     lin_tx_header((OUR_LIN_SPEC), slave_id, 0);
 }
 
-// #############################################################################
-// ------------ PRIVATE FUNCTIONS
-// #############################################################################
+/****************************************************************************
+    Public Function
+        Master_LIN_Event_Collision
+
+    Parameters
+        None
+
+    Description
+        Returns true if slaves collided in the response to the last
+        event-triggered status frame, so their stati must be polled
+
+****************************************************************************/
+bool Master_LIN_Event_Collision(void)
+{
+    return Event_Collision;
+}
 
 /****************************************************************************
-    Private Function
-        lin_id_task
+    Public Function
+        Master_LIN_Get_Status
 
     Parameters
-             
+        uint8_t * p_slave_number: where to put the number of the slave
+        uint8_t * p_status: where to copy its LIN_PACKET_LEN bytes of status
 
     Description
-        Process the LIN ID and does the appropriate task for that ID
+        Takes the status received since the last call, polled or from the
+        event-triggered frame, returns false if none came. Only the last
+        one is kept: at most one comes per slot, so the schedule takes it
+        before it sends the next header.
 
 ****************************************************************************/
-static void lin_id_task(void)
+bool Master_LIN_Get_Status(uint8_t * p_slave_number, uint8_t * p_status)
 {
-    // Create copy of ID, make sure this gives only the lower 6 bits
-    uint8_t temp_id = Lin_get_id();
+    bool found = false;
 
-    // This ID matches my ID. It must be a command sent from the master.
-    if (temp_id == *p_My_Node_ID)
+    ATOMIC_BLOCK(ATOMIC_RESTORESTATE)
     {
-        // Prepare LIN module for receive.
-        lin_rx_response((OUR_LIN_SPEC), (LIN_PACKET_LEN));
+        if (STATUS_RX_NONE != Status_Rx_Slot)
+        {
+            *p_slave_number = Status_Rx_Slot+LOWEST_SLAVE_NUMBER;
+            memcpy(p_status, Status_Rx_Data, LIN_PACKET_LEN);
+            Status_Rx_Slot = STATUS_RX_NONE;
+            found = true;
+        }
     }
 
-    // This ID matches my ID. It must be a status request from the master.
-    else if (temp_id == ((*p_My_Node_ID)|REQUEST_MASK))
-    {
-        // Prepare LIN module for transmit.
-        // We must be a slave so My_Command_Data is LIN_PACKET_LEN bytes long only.
-        lin_tx_response((OUR_LIN_SPEC), p_My_Status_Data, (LIN_PACKET_LEN));
-    }
+    return found;
+}
 
-    // This ID doesn't match my ID.
-    else
+/****************************************************************************
+    Public Function
+        Master_LIN_Get_Ext_Status
+
+    Parameters
+        uint8_t slave_number: slave to look up
+        uint8_t * p_ext_status: where to copy its LIN_EXT_STATUS_LEN bytes
+
+    Description
+        Copies the last extended status received, returns false if it
+        didn't come from this slave. Only the last one is kept: the slaves
+        take turns, so a slave's comes round again within NUM_SLAVES rounds.
+
+****************************************************************************/
+bool Master_LIN_Get_Ext_Status(uint8_t slave_number, uint8_t * p_ext_status)
+{
+    bool found = false;
+
+    ATOMIC_BLOCK(ATOMIC_RESTORESTATE)
     {
-        // If we're the master, we must have sent this ID
-        if (MASTER_NODE_ID == *p_My_Node_ID)
-        {
-            // Prepare LIN module for transmit if we sent a command.
-            if (0 == (temp_id & REQUEST_MASK))
-            {
-                // Make sure we send the right command based on the slave ID.
-                // The master has a My_Command_Data array that is LIN_PACKET_LEN*n bytes long.
-                // Where n is the number of slaves in the system.
-                lin_tx_response((OUR_LIN_SPEC), Get_Pointer_To_Slave_Data(p_My_Command_Data, GET_SLAVE_NUMBER(temp_id)), (LIN_PACKET_LEN));
-            }
-            // Prepare LIN module for receive if we sent a request.
-            else
-            {
-                lin_rx_response((OUR_LIN_SPEC), (LIN_PACKET_LEN));
-            }
-        }
-        // Otherwise, we are a slave and the ID isn't for us.
-        else
+        if ((slave_number-LOWEST_SLAVE_NUMBER) == Ext_Status_Slot)
         {
-            // Do nothing
+            memcpy(p_ext_status, Ext_Status_Data, LIN_EXT_STATUS_LEN);
+            found = true;
         }
     }
+
+    return found;
 }
 
 /****************************************************************************
-    Private Function
-        lin_rx_task
+    Public Function
+        Slave_LIN_Write_Ext_Status
 
     Parameters
-             
+        uint8_t * p_ext_status: our LIN_EXT_STATUS_LEN bytes of telemetry
 
     Description
-        Get the received data
+        Sets the extended status we send on our next turn.
+        EVT_SLAVE_EXT_STATUS_SENT is posted each time it has been sent.
 
 ****************************************************************************/
-static void lin_rx_task(void)
+void Slave_LIN_Write_Ext_Status(uint8_t * p_ext_status)
+{
+    ATOMIC_BLOCK(ATOMIC_RESTORESTATE)
+    {
+        memcpy(Ext_Status_Data, p_ext_status, LIN_EXT_STATUS_LEN);
+    }
+}
+
+/****************************************************************************
+    Public Function
+        Master_LIN_Write_Scene
+
+    Parameters
+        uint8_t * p_scene: LIN_SCENE_FRAME_LEN bytes, the requested location
+
+    Description
+        Sets the scene frame we send the next time the schedule sends
+        LIN_SCENE_ID
+
+****************************************************************************/
+void Master_LIN_Write_Scene(uint8_t * p_scene)
 {
-    // Copy the rx data to our appropriate data store
-    // If we're the master, copy to our status array and post event
-    if (MASTER_NODE_ID == *p_My_Node_ID)
+    ATOMIC_BLOCK(ATOMIC_RESTORESTATE)
     {
-        // TODO: Not entirely sure if the ID is saved during the receive...
-        lin_get_response(Get_Pointer_To_Slave_Data(p_My_Status_Data, GET_SLAVE_NUMBER(Lin_get_id())));
+        memcpy(Scene_Frame, p_scene, LIN_SCENE_FRAME_LEN);
+    }
+}
+
+/****************************************************************************
+    Public Function
+        Slave_LIN_Get_Scene
 
-        // Post event
-        Post_Event(EVT_MASTER_NEW_STS);
+    Parameters
+        uint8_t * p_scene: where to copy the LIN_SCENE_FRAME_LEN bytes
+
+    Description
+        Copies the last scene frame received. EVT_SLAVE_SCENE is posted each
+        time one comes in.
+
+****************************************************************************/
+void Slave_LIN_Get_Scene(uint8_t * p_scene)
+{
+    ATOMIC_BLOCK(ATOMIC_RESTORESTATE)
+    {
+        memcpy(p_scene, Scene_Frame, LIN_SCENE_FRAME_LEN);
     }
-    // If we're a slave, copy to our command array and post event
-    else
+}
+
+/****************************************************************************
+    Public Function
+        Master_LIN_Last_Frame_OK
+
+    Parameters
+        None
+
+    Description
+        Returns true if the response to the last header we broadcast was
+        received (or sent) without error. Call it before broadcasting the
+        next header.
+
+****************************************************************************/
+bool Master_LIN_Last_Frame_OK(void)
+{
+    return Last_Frame_OK;
+}
+
+/****************************************************************************
+    Public Function
+        Get_LIN_Counters
+
+    Parameters
+        lin_counters_t * p_counters: where to copy the counters
+
+    Description
+        Copies this node's LIN error and frame counters
+
+****************************************************************************/
+void Get_LIN_Counters(lin_counters_t * p_counters)
+{
+    // The counters are written from the LIN ISR, so copy them atomically
+    ATOMIC_BLOCK(ATOMIC_RESTORESTATE)
     {
-        // Copy command
-        lin_get_response(p_My_Command_Data);
+        memcpy(p_counters, &My_LIN_Counters, sizeof(My_LIN_Counters));
+    }
+}
 
-        // Post event
-        Post_Event(EVT_SLAVE_NEW_CMD);
+/****************************************************************************
+    Public Function
+        Get_LIN_Error_Stats
+
+    Parameters
+        lin_error_stats_t * p_stats: where to copy the statistics
+
+    Description
+        Copies this node's LIN error statistics per error class
+
+****************************************************************************/
+void Get_LIN_Error_Stats(lin_error_stats_t * p_stats)
+{
+    // The statistics are written from the LIN ISR, so copy them atomically
+    ATOMIC_BLOCK(ATOMIC_RESTORESTATE)
+    {
+        decay_error_stats();
+        memcpy(p_stats, &My_LIN_Error_Stats, sizeof(My_LIN_Error_Stats));
     }
 }
 
 /****************************************************************************
-    Private Function
-        lin_tx_task
+    Public Function
+        Get_LIN_Frame_Error_Count
 
     Parameters
-             
+        uint8_t lin_id: LIN frame ID
 
     Description
-        Updates the outgoing data if necessary
+        Returns the recent (decaying) error count for a LIN frame ID,
+        0 to 15, 0 for IDs we don't keep statistics for
 
 ****************************************************************************/
-static void lin_tx_task(void)
+uint8_t Get_LIN_Frame_Error_Count(uint8_t lin_id)
 {
-    // Update the outgoing data arrays, if necessary.
-    // We don't need to do this, because we are always pulling from
-    //  our real data stores.
-    // (When we tx, we will just send whatever is in the data store.)
+    uint8_t result = 0;
+    uint8_t slot = get_frame_error_slot(lin_id);
+
+    if (LIN_ERR_NO_FRAME_SLOT != slot)
+    {
+        ATOMIC_BLOCK(ATOMIC_RESTORESTATE)
+        {
+            decay_error_stats();
+            result = get_frame_error_count(slot);
+        }
+    }
 
-    // Do nothing.
+    return result;
 }
 
 /****************************************************************************
-    Private Function
-        lin_err_task
+    Public Function
+        Get_LIN_Sleep_Stats
 
     Parameters
-             
+        lin_sleep_stats_t * p_stats: where to copy the statistics
 
     Description
-        Processes the LIN error
+        Copies this node's LIN sleep statistics
 
 ****************************************************************************/
-static void lin_err_task(void)
+void Get_LIN_Sleep_Stats(lin_sleep_stats_t * p_stats)
 {
-    // Increment error count
-    My_LIN_Error_Count++;
+    ATOMIC_BLOCK(ATOMIC_RESTORESTATE)
+    {
+        memcpy(p_stats, &My_LIN_Sleep_Stats, sizeof(My_LIN_Sleep_Stats));
+    }
+}
 
-    // TODO: Deal with other errors accoridng to LIN 2.x spec.
+/****************************************************************************
+    Public Function
+        Get_LIN_Bus_Stats
+
+    Parameters
+        lin_bus_stats_t * p_stats: where to copy the statistics
+
+    Description
+        Copies the master's bus utilisation and slot statistics
+
+****************************************************************************/
+void Get_LIN_Bus_Stats(lin_bus_stats_t * p_stats)
+{
+#if IS_MASTER_NODE
+    ATOMIC_BLOCK(ATOMIC_RESTORESTATE)
+    {
+        memcpy(p_stats, &My_LIN_Bus_Stats, sizeof(My_LIN_Bus_Stats));
+    }
+#else
+    memset(p_stats, 0, sizeof(lin_bus_stats_t));
+#endif
+}
+
+/****************************************************************************
+    Public Function
+        Get_LIN_Latency_Stats
+
+    Parameters
+        uint8_t slave_number: slave to look up
+        lin_latency_stats_t * p_stats: where to copy the statistics
+
+    Description
+        Copies the status response latency distribution of a slave,
+        returns false if the slave number is invalid (always on a slave)
+
+****************************************************************************/
+bool Get_LIN_Latency_Stats(uint8_t slave_number, lin_latency_stats_t * p_stats)
+{
+#if IS_MASTER_NODE
+    lin_latency_record_t record;
+
+    if ((LOWEST_SLAVE_NUMBER > slave_number) || (HIGHEST_SLAVE_NUMBER < slave_number)) return false;
+
+    ATOMIC_BLOCK(ATOMIC_RESTORESTATE)
+    {
+        record = My_LIN_Latency_Stats[slave_number-LOWEST_SLAVE_NUMBER];
+    }
+
+    for (uint8_t index = 0; index < NUM_LIN_LATENCY_BUCKETS; index++)
+    {
+        p_stats->buckets[index] = (record.buckets>>(index*LIN_LATENCY_BUCKET_BITS)) & LIN_LATENCY_BUCKET_MAX;
+    }
+    p_stats->max_latency_us = (uint16_t) record.max_latency*LIN_LATENCY_MAX_UNIT_US;
+
+    return true;
+#else
+    return false;
+#endif
+}
+
+/****************************************************************************
+    Public Function
+        Master_LIN_Go_To_Sleep
+
+    Parameters
+        None
+
+    Description
+        Queues the go-to-sleep command, it is sent in the next spare schedule
+        slot. Any diagnostic request in progress is dropped.
+        Master_LIN_Is_Asleep() returns true once the command has been sent.
+
+****************************************************************************/
+void Master_LIN_Go_To_Sleep(void)
+{
+    ATOMIC_BLOCK(ATOMIC_RESTORESTATE)
+    {
+        // Drop any diagnostic traffic, report an empty response if
+        //  the service is waiting for one
+        Diag_Tx.len = 0;
+        if (Diag_Awaiting_Response)
+        {
+            Diag_Awaiting_Response = false;
+            Diag_Rx.len = 0;
+            Diag_Rx_Ready = true;
+            Post_Event(EVT_MASTER_DIAG_RESPONSE);
+        }
+
+        // Queue the command
+        Sleep_Pending = true;
+    }
+}
+
+/****************************************************************************
+    Public Function
+        Master_LIN_Is_Asleep
+
+    Parameters
+        None
+
+    Description
+        Returns true if the go-to-sleep command has been sent and the bus
+        has not been woken up since
+
+****************************************************************************/
+bool Master_LIN_Is_Asleep(void)
+{
+    return Bus_Asleep;
+}
+
+/****************************************************************************
+    Public Function
+        Master_LIN_Start_Wake_Up
+
+    Parameters
+        None
+
+    Description
+        Starts the wake up pulse by driving the bus dominant. The LIN spec
+        asks for 250us to 5ms, the caller ends the pulse with
+        Master_LIN_End_Wake_Up().
+
+****************************************************************************/
+void Master_LIN_Start_Wake_Up(void)
+{
+    // Release TXLIN from the LIN controller
+    Lin_full_reset();
+
+    // Drive TXLIN low, the transceiver drives the bus dominant
+    LIN_PORT_OUT &= ~(1<<LIN_OUTPUT_PIN);
+    LIN_PORT_DIR |= (1<<LIN_OUTPUT_PIN);
+
+    // Time how long it takes until a slave answers
+    start_wake_latency();
+}
+
+/****************************************************************************
+    Public Function
+        Master_LIN_End_Wake_Up
+
+    Parameters
+        None
+
+    Description
+        Ends the wake up pulse and gives TXLIN back to the LIN controller.
+        The LIN spec asks the master to wait 100ms before the next header.
+
+****************************************************************************/
+void Master_LIN_End_Wake_Up(void)
+{
+    // Release the bus
+    LIN_PORT_DIR &= ~(1<<LIN_OUTPUT_PIN);
+
+    // Restart the LIN controller
+    lin_init((OUR_LIN_SPEC), (CONF_LINBRR));
+
+    // The bus is awake
+    Bus_Asleep = false;
+}
+
+/****************************************************************************
+    Public Function
+        Slave_LIN_Power_Down
+
+    Parameters
+        None
+
+    Description
+        Puts the transceiver in silent mode and the MCU in power-down until
+        the bus is woken up, then restarts LIN. The caller should turn off
+        the loads first and call it from the main loop's idle point (see
+        Run_Slave_Idle()), not from an event handler. Returns once we are
+        awake.
+
+****************************************************************************/
+void Slave_LIN_Power_Down(void)
+{
+    uint8_t old_pcmsk0 = PCMSK0;
+
+    // 1. Stop the LIN controller
+    Lin_full_reset();
+
+    // 2. Put the transceiver in silent mode (EN low while TXD is high, TXD
+    //  is pulled up by lin_init). It keeps VCC up and pulls RXD low when
+    //  it sees a wake up pulse on the bus.
+    PORTB &= ~(1<<PINB0);
+
+    // 3. Wake up on a RXD pin change. The pin change ISR in buttons.c
+    //  runs, but all we need is an interrupt to wake the CPU.
+    PCMSK0 |= (1<<LIN_INPUT_PIN);
+    PCICR |= (1<<PCIE0);
+
+    // 4. Power down until RXD goes low
+    // *Note: The system timer is stopped while we are powered down, so the
+    //  system time (and every running timer) picks up where it left off.
+    My_LIN_Sleep_Stats.sleep_count++;
+    set_sleep_mode(SLEEP_MODE_PWR_DOWN);
+    while (LIN_PORT_IN & (1<<LIN_INPUT_PIN))
+    {
+        // Check the pin again with interrupts off, so we can't miss the
+        //  wake up between the check and going to sleep
+        cli();
+        if (LIN_PORT_IN & (1<<LIN_INPUT_PIN))
+        {
+            sleep_enable();
+            sei();
+            sleep_cpu();
+            sleep_disable();
+        }
+        sei();
+    }
+
+    // 5. We're awake, time how long it takes until we hear the master
+    PCMSK0 = old_pcmsk0;
+    start_wake_latency();
+
+    // 6. Put the transceiver back in normal mode and restart LIN
+    PORTB |= (1<<PINB0);
+    lin_init((OUR_LIN_SPEC), (CONF_LINBRR));
+    Bus_Asleep = false;
+}
+
+/****************************************************************************
+    Public Function
+        Master_LIN_Diag_Send_Request
+
+    Parameters
+        uint8_t nad: node address of the slave
+        uint8_t * p_pdu: request PDU (SID first)
+        uint8_t pdu_len: length of the request PDU
+
+    Description
+        Queues a diagnostic request. It is sent in the spare schedule slots,
+        and EVT_MASTER_DIAG_RESPONSE is posted when the response arrives
+        (or when the slave does not respond). Requests to the broadcast NAD
+        do not wait for a response, the event is posted with an empty one
+        once the request is sent.
+
+        Returns false if a request is already in progress.
+
+****************************************************************************/
+bool Master_LIN_Diag_Send_Request(uint8_t nad, uint8_t * p_pdu, uint8_t pdu_len)
+{
+    // Reject empty or oversized PDUs
+    if ((0 == pdu_len) || (LIN_DIAG_MAX_PDU_LEN < pdu_len)) return false;
+
+    // Reject if we are busy
+    if (Master_LIN_Diag_Is_Busy()) return false;
+
+    // The PDUs are used in the LIN and timer ISRs
+    ATOMIC_BLOCK(ATOMIC_RESTORESTATE)
+    {
+        // Load the request
+        Diag_Tx.nad = nad;
+        Diag_Tx.index = 0;
+        Diag_Tx.seq = LIN_DIAG_FIRST_CF_SEQ;
+        memcpy(Diag_Tx.data, p_pdu, pdu_len);
+        Diag_Tx.len = pdu_len;
+
+        // Clear any old response
+        Diag_Rx.len = 0;
+        Diag_Rx.index = 0;
+        Diag_Rx_Ready = false;
+        Diag_Collision = false;
+    }
+
+    return true;
+}
+
+/****************************************************************************
+    Public Function
+        Master_LIN_Diag_Get_Response
+
+    Parameters
+        uint8_t * p_pdu: where to copy the response PDU,
+            LIN_DIAG_MAX_PDU_LEN long
+
+    Description
+        Copies the diagnostic response and returns its length. A length of 0
+        after EVT_MASTER_DIAG_RESPONSE means the slave did not respond.
+
+****************************************************************************/
+uint8_t Master_LIN_Diag_Get_Response(uint8_t * p_pdu)
+{
+    uint8_t result = 0;
+
+    ATOMIC_BLOCK(ATOMIC_RESTORESTATE)
+    {
+        if (Diag_Rx_Ready)
+        {
+            result = Diag_Rx.len;
+            memcpy(p_pdu, Diag_Rx.data, result);
+            Diag_Rx_Ready = false;
+        }
+    }
+
+    return result;
+}
+
+/****************************************************************************
+    Public Function
+        Master_LIN_Diag_Collided
+
+    Parameters
+        None
+
+    Description
+        Returns true if the last request, sent to LIN_DIAG_NAD_UNASSIGNED,
+        got an empty response because several slaves answered at once
+
+****************************************************************************/
+bool Master_LIN_Diag_Collided(void)
+{
+    return Diag_Collision;
+}
+
+/****************************************************************************
+    Public Function
+        Master_LIN_Diag_Is_Busy
+
+    Parameters
+        None
+
+    Description
+        Returns true if a diagnostic request is being sent or answered
+
+****************************************************************************/
+bool Master_LIN_Diag_Is_Busy(void)
+{
+    bool result;
+
+    ATOMIC_BLOCK(ATOMIC_RESTORESTATE)
+    {
+        result = ((0 != Diag_Tx.len) || Diag_Awaiting_Response);
+    }
+
+    return result;
+}
+
+/****************************************************************************
+    Public Function
+        Master_LIN_Diag_Slot_ID
+
+    Parameters
+        None
+
+    Description
+        Called by the master schedule (in interrupt context) when it reaches
+        the spare diagnostic slot. Returns the diagnostic ID to broadcast, or
+        LIN_DIAG_NO_SLOT if there is nothing to do, in which case the slot is
+        skipped.
+
+****************************************************************************/
+uint8_t Master_LIN_Diag_Slot_ID(void)
+{
+    // The go-to-sleep command goes before everything else
+    if (Sleep_Pending) return LIN_DIAG_MASTER_REQ_ID;
+
+    // Send the rest of our request first
+    if (0 != Diag_Tx.len) return LIN_DIAG_MASTER_REQ_ID;
+
+    // Then poll the slave for its response
+    if (Diag_Awaiting_Response)
+    {
+        if (0 != Diag_Polls_Left)
+        {
+            Diag_Polls_Left--;
+            return LIN_DIAG_SLAVE_RESP_ID;
+        }
+
+        // The slave didn't respond in time, report an empty response
+        Diag_Awaiting_Response = false;
+        Diag_Rx.len = 0;
+        Diag_Rx_Ready = true;
+        Post_Event(EVT_MASTER_DIAG_RESPONSE);
+    }
+
+    return LIN_DIAG_NO_SLOT;
+}
+
+/****************************************************************************
+    Public Function
+        Slave_LIN_Diag_Get_Request
+
+    Parameters
+        uint8_t * p_nad: where to copy the NAD the request was sent to
+        uint8_t * p_pdu: where to copy the request PDU,
+            LIN_DIAG_MAX_PDU_LEN long
+
+    Description
+        Copies the diagnostic request addressed to us (or broadcast) and
+        returns its length (0 if there is none)
+
+****************************************************************************/
+uint8_t Slave_LIN_Diag_Get_Request(uint8_t * p_nad, uint8_t * p_pdu)
+{
+    uint8_t result = 0;
+
+    ATOMIC_BLOCK(ATOMIC_RESTORESTATE)
+    {
+        if (Diag_Rx_Ready)
+        {
+            result = Diag_Rx.len;
+            *p_nad = Diag_Rx.nad;
+            memcpy(p_pdu, Diag_Rx.data, result);
+            Diag_Rx_Ready = false;
+        }
+    }
+
+    return result;
+}
+
+/****************************************************************************
+    Public Function
+        Slave_LIN_Diag_Send_Response
+
+    Parameters
+        uint8_t * p_pdu: response PDU (RSID first)
+        uint8_t pdu_len: length of the response PDU
+
+    Description
+        Queues a diagnostic response. It is sent when the master polls with
+        the slave response header.
+
+****************************************************************************/
+void Slave_LIN_Diag_Send_Response(uint8_t * p_pdu, uint8_t pdu_len)
+{
+    // Reject empty or oversized PDUs
+    if ((0 == pdu_len) || (LIN_DIAG_MAX_PDU_LEN < pdu_len)) return;
+
+    ATOMIC_BLOCK(ATOMIC_RESTORESTATE)
+    {
+        Diag_Tx.nad = get_my_nad();
+        Diag_Tx.index = 0;
+        Diag_Tx.seq = LIN_DIAG_FIRST_CF_SEQ;
+        memcpy(Diag_Tx.data, p_pdu, pdu_len);
+        Diag_Tx.len = pdu_len;
+    }
+}
+
+// #############################################################################
+// ------------ PRIVATE FUNCTIONS
+// #############################################################################
+
+/****************************************************************************
+    Private Function
+        lin_id_task
+
+    Parameters
+             
+
+    Description
+        Process the LIN ID and does the appropriate task for that ID
+
+****************************************************************************/
+static void lin_id_task(void)
+{
+    // Look up what to do with this ID (Lin_get_id() is only 6 bits)
+    uint8_t entry = LIN_ID_Table[Lin_get_id()];
+    uint8_t * p_data;
+
+    switch (entry & LIN_ACTION_MASK)
+    {
+        // We receive the response into a store, e.g. a command sent from
+        //  the master or a slave's status
+        case LIN_ACTION_RX:
+            // Prepare LIN module for receive.
+            lin_rx_response((OUR_LIN_SPEC), (LIN_PACKET_LEN));
+            break;
+
+        // We send the response from a store, e.g. our status or a command
+        //  for a slave
+        case LIN_ACTION_TX:
+            // Prepare LIN module for transmit, always from the live buffer.
+            p_data = get_slot_data(get_entry_store(entry)->p_live, entry);
+
+            // A slave keeps the status it sends, see lin_tx_task()
+            if (entry & LIN_ENTRY_STATUS_STORE)
+            {
+                memcpy(&Event_Tx_Frame[EVENT_STATUS_DATA_INDEX], p_data, LIN_PACKET_LEN);
+            }
+
+            lin_tx_response((OUR_LIN_SPEC), p_data, (LIN_PACKET_LEN));
+            break;
+
+        // Event-triggered status frame
+        case LIN_ACTION_SPECIAL:
+            if (LIN_SPECIAL_EVENT == entry)
+            {
+                event_id_task();
+            }
+            // Extended status frame
+            else if (LIN_SPECIAL_EXT_STATUS == entry)
+            {
+                ext_status_id_task();
+            }
+            // Commit frame
+            else if (LIN_SPECIAL_COMMIT == entry)
+            {
+                commit_id_task();
+            }
+            // Scene frame
+            else if (LIN_SPECIAL_SCENE == entry)
+            {
+                scene_id_task();
+            }
+            // Diagnostic frames go to the transport layer
+            else
+            {
+                diag_id_task(Lin_get_id());
+            }
+            break;
+
+        // The ID isn't for us
+        default:
+            // Do nothing
+            break;
+    }
+
+    // The extended status frame depends on the header before it
+    Last_Header_ID = Lin_get_id();
+}
+
+/****************************************************************************
+    Private Function
+        diag_id_task
+
+    Parameters
+        uint8_t lin_id: LIN_DIAG_MASTER_REQ_ID or LIN_DIAG_SLAVE_RESP_ID
+
+    Description
+        Prepares the LIN module for a diagnostic frame
+
+****************************************************************************/
+static void diag_id_task(uint8_t lin_id)
+{
+    // Diagnostic master request, the master sends it and the slaves listen
+    if (LIN_DIAG_MASTER_REQ_ID == lin_id)
+    {
+        if (is_master() && Sleep_Pending)
+        {
+            transmit_sleep_frame();
+        }
+        else if (is_master())
+        {
+            transmit_diag_frame();
+        }
+        else
+        {
+            lin_rx_response((OUR_LIN_SPEC), (LIN_DIAG_FRAME_LEN));
+        }
+    }
+
+    // Diagnostic slave response, only the slave with a response sends it
+    else
+    {
+        if (is_master())
+        {
+            lin_rx_response((OUR_LIN_SPEC), (LIN_DIAG_FRAME_LEN));
+        }
+        else if (0 != Diag_Tx.len)
+        {
+            transmit_diag_frame();
+        }
+    }
+}
+
+/****************************************************************************
+    Private Function
+        event_id_task
+
+    Parameters
+        None
+
+    Description
+        Prepares the LIN module for an event-triggered status frame. The
+        master listens, a slave only answers if its status changed since it
+        last sent it.
+
+****************************************************************************/
+static void event_id_task(void)
+{
+    if (is_master())
+    {
+        Event_Collision = false;
+        lin_rx_response((OUR_LIN_SPEC), (LIN_EVENT_FRAME_LEN));
+    }
+    else if (0 != memcmp(p_My_Status_Store->p_live, Last_Reported_Status, LIN_PACKET_LEN))
+    {
+        // Tell the master which slave this is, then our status
+        Event_Tx_Frame[EVENT_STATUS_ID_INDEX] = (*p_My_Node_ID)|REQUEST_MASK;
+        memcpy(&Event_Tx_Frame[EVENT_STATUS_DATA_INDEX], p_My_Status_Store->p_live, LIN_PACKET_LEN);
+        lin_tx_response((OUR_LIN_SPEC), Event_Tx_Frame, (LIN_EVENT_FRAME_LEN));
+    }
+}
+
+/****************************************************************************
+    Private Function
+        ext_status_id_task
+
+    Parameters
+        None
+
+    Description
+        Prepares the LIN module for an extended status frame. It belongs to
+        the slave whose command header came just before it.
+
+****************************************************************************/
+static void ext_status_id_task(void)
+{
+    uint8_t last_entry = LIN_ID_Table[Last_Header_ID];
+
+    // Master: we just sent a slave's command, receive its telemetry
+    if (LIN_ACTION_TX == (last_entry & ~LIN_ENTRY_SLOT_MASK))
+    {
+        Ext_Status_Slot = (last_entry & LIN_ENTRY_SLOT_MASK)|EXT_STATUS_RECEIVING;
+        lin_rx_response((OUR_LIN_SPEC), (LIN_EXT_STATUS_LEN));
+    }
+    // Slave: we just received our command, send our telemetry
+    else if (LIN_ACTION_RX == last_entry)
+    {
+        lin_tx_response((OUR_LIN_SPEC), Ext_Status_Data, (LIN_EXT_STATUS_LEN));
+    }
+}
+
+/****************************************************************************
+    Private Function
+        commit_id_task
+
+    Parameters
+        None
+
+    Description
+        Prepares the LIN module for a commit frame, the master sends it and
+        every slave receives it
+
+****************************************************************************/
+static void commit_id_task(void)
+{
+    if (is_master())
+    {
+        lin_tx_response((OUR_LIN_SPEC), Commit_Frame, (LIN_COMMIT_FRAME_LEN));
+    }
+    else
+    {
+        lin_rx_response((OUR_LIN_SPEC), (LIN_COMMIT_FRAME_LEN));
+    }
+}
+
+/****************************************************************************
+    Private Function
+        scene_id_task
+
+    Parameters
+        None
+
+    Description
+        Prepares the LIN module for a scene frame, the master sends it and
+        every slave receives it
+
+****************************************************************************/
+static void scene_id_task(void)
+{
+    if (is_master())
+    {
+        lin_tx_response((OUR_LIN_SPEC), Scene_Frame, (LIN_SCENE_FRAME_LEN));
+    }
+    else
+    {
+        lin_rx_response((OUR_LIN_SPEC), (LIN_SCENE_FRAME_LEN));
+    }
+}
+
+/****************************************************************************
+    Private Function
+        lin_rx_task
+
+    Parameters
+             
+
+    Description
+        Get the received data
+
+****************************************************************************/
+static void lin_rx_task(void)
+{
+    // Count the frame
+    My_LIN_Counters.rx_frame_count++;
+    Last_Frame_OK = true;
+    end_slot_timing(LIN_SLOT_COMPLETE);
+    My_LIN_Counters.last_rx_time_ms = Get_System_Time_MS();
+
+    // The first response after a wake up ends the wake up latency
+    if (Wake_Latency_Pending)
+    {
+        My_LIN_Sleep_Stats.wake_latency_ms = My_LIN_Counters.last_rx_time_ms-Wake_Time_MS;
+        Wake_Latency_Pending = false;
+    }
+
+    // Look up where this frame goes
+    uint8_t entry = LIN_ID_Table[Lin_get_id()];
+    data_store_t * p_store;
+    uint8_t status[LIN_PACKET_LEN];
+
+    // Changed status from the event-triggered frame
+    if (LIN_SPECIAL_EVENT == entry)
+    {
+        receive_event_frame();
+    }
+    // A slave's telemetry
+    else if (LIN_SPECIAL_EXT_STATUS == entry)
+    {
+        lin_get_response(Ext_Status_Data);
+        Ext_Status_Slot &= ~EXT_STATUS_RECEIVING;
+    }
+    // The master committed the scene, apply our command
+    else if (LIN_SPECIAL_COMMIT == entry)
+    {
+        Post_Event(EVT_SLAVE_COMMIT);
+    }
+    // The master changed the scene, work out our command
+    else if (LIN_SPECIAL_SCENE == entry)
+    {
+        lin_get_response(Scene_Frame);
+        Post_Event(EVT_SLAVE_SCENE);
+    }
+    // Diagnostic frames go to the transport layer
+    else if (LIN_SPECIAL_DIAG == entry)
+    {
+        receive_diag_frame();
+    }
+    // The master receives stati
+    else if ((LIN_ACTION_RX|LIN_ENTRY_STATUS_STORE) == (entry & ~LIN_ENTRY_SLOT_MASK))
+    {
+        lin_get_response(status);
+        receive_status(entry & LIN_ENTRY_SLOT_MASK, status);
+    }
+    // A slave receives its command, copy it to the store and post event
+    else if (LIN_ACTION_RX == (entry & LIN_ACTION_MASK))
+    {
+        p_store = get_entry_store(entry);
+        lin_get_response(Get_Shadow_Slot(p_store, entry & LIN_ENTRY_SLOT_MASK));
+        Commit_Data_Store(p_store);
+        Post_Event(EVT_SLAVE_NEW_CMD);
+    }
+}
+
+/****************************************************************************
+    Private Function
+        receive_event_frame
+
+    Parameters
+        None
+
+    Description
+        Master: takes the status a slave sent in the event-triggered frame
+
+****************************************************************************/
+static void receive_event_frame(void)
+{
+    uint8_t frame[LIN_EVENT_FRAME_LEN];
+    uint8_t entry;
+
+    lin_get_response(frame);
+
+    // The first byte must be the status ID of one of our slaves
+    if (LIN_NUM_IDS <= frame[EVENT_STATUS_ID_INDEX]) return;
+    entry = LIN_ID_Table[frame[EVENT_STATUS_ID_INDEX]];
+    if ((LIN_ACTION_RX|LIN_ENTRY_STATUS_STORE) != (entry & ~LIN_ENTRY_SLOT_MASK)) return;
+
+    // Same as if we had polled its status frame
+    receive_status(entry & LIN_ENTRY_SLOT_MASK, &frame[EVENT_STATUS_DATA_INDEX]);
+}
+
+/****************************************************************************
+    Private Function
+        receive_status
+
+    Parameters
+        uint8_t slot: slave number-1
+        uint8_t * p_status: its LIN_PACKET_LEN bytes of status
+
+    Description
+        Master: keeps a slave's status for Master_LIN_Get_Status()
+
+****************************************************************************/
+static void receive_status(uint8_t slot, uint8_t * p_status)
+{
+    memcpy(Status_Rx_Data, p_status, LIN_PACKET_LEN);
+    Status_Rx_Slot = slot;
+    Post_Event(EVT_MASTER_NEW_STS);
+}
+
+/****************************************************************************
+    Private Function
+        lin_tx_task
+
+    Parameters
+             
+
+    Description
+        Updates the outgoing data if necessary
+
+****************************************************************************/
+static void lin_tx_task(void)
+{
+    uint8_t entry = LIN_ID_Table[Lin_get_id()];
+
+    // Count the frame
+    My_LIN_Counters.tx_frame_count++;
+    Last_Frame_OK = true;
+    end_slot_timing(LIN_SLOT_COMPLETE);
+
+    // A slave's status is reported once it is sent, in its own status
+    //  frame or the event-triggered one
+    if (    ((LIN_ACTION_TX|LIN_ENTRY_STATUS_STORE) == (entry & ~LIN_ENTRY_SLOT_MASK))
+            ||
+            (LIN_SPECIAL_EVENT == entry)
+       )
+    {
+        memcpy(Last_Reported_Status, &Event_Tx_Frame[EVENT_STATUS_DATA_INDEX], LIN_PACKET_LEN);
+    }
+
+    // Slave: our telemetry went out, the service refreshes it for next time
+    if (LIN_SPECIAL_EXT_STATUS == entry)
+    {
+        Post_Event(EVT_SLAVE_EXT_STATUS_SENT);
+    }
+
+    // Master: the next commit gets the next count
+    if (LIN_SPECIAL_COMMIT == entry)
+    {
+        Commit_Frame[COMMIT_COUNT_INDEX]++;
+    }
+
+    // Nothing more to do unless it was a diagnostic frame
+    if (LIN_SPECIAL_DIAG != entry) return;
+
+    // If we just sent the go-to-sleep command, the bus is asleep
+    if ((LIN_DIAG_MASTER_REQ_ID == Lin_get_id()) && Sleep_Pending)
+    {
+        Sleep_Pending = false;
+        Bus_Asleep = true;
+        My_LIN_Sleep_Stats.sleep_count++;
+    }
+    // Move on to the next diagnostic frame if we just sent one
+    else
+    {
+        advance_diag_tx();
+    }
+
+    // Update the outgoing data arrays, if necessary.
+    // We don't need to do this, because we are always pulling from
+    //  our real data stores.
+    // (When we tx, we will just send whatever is in the data store.)
+}
+
+/****************************************************************************
+    Private Function
+        lin_err_task
+
+    Parameters
+        uint8_t error_status: LINERR register
+
+    Description
+        Processes the LIN error, counting it per error class and per frame
+
+****************************************************************************/
+static void lin_err_task(uint8_t error_status)
+{
+    uint8_t error_class;
+    uint8_t slot;
+
+    Last_Frame_OK = false;
+
+    // Event-triggered status frame: no answer just means no status
+    //  changed, anything else is slaves answering at the same time
+    if (LIN_SPECIAL_EVENT == LIN_ID_Table[Lin_get_id()])
+    {
+        if ((1<<LIN_ERR_CLASS_TIMEOUT) == error_status)
+        {
+            end_slot_timing(LIN_SLOT_SILENT);
+            return;
+        }
+        Event_Collision = true;
+    }
+    end_slot_timing(LIN_SLOT_FAILED);
+
+    // The slaves without a number share a NAD, a corrupted response from
+    //  them is several answering at once. Report it now, polling again
+    //  only repeats the collision.
+    if  (   is_master() && Diag_Awaiting_Response
+            &&
+            (LIN_DIAG_SLAVE_RESP_ID == Lin_get_id())
+            &&
+            (LIN_DIAG_NAD_UNASSIGNED == Diag_Tx.nad)
+            &&
+            ((1<<LIN_ERR_CLASS_TIMEOUT) != error_status)
+        )
+    {
+        Diag_Awaiting_Response = false;
+        Diag_Collision = true;
+        Diag_Rx.len = 0;
+        Diag_Rx_Ready = true;
+        Post_Event(EVT_MASTER_DIAG_RESPONSE);
+    }
+
+    // Increment error count
+    My_LIN_Counters.error_count++;
+
+    // Age the recent counts before adding to them
+    decay_error_stats();
+
+    // Count each error class that is flagged
+    for (error_class = 0; error_class < NUM_LIN_ERR_CLASSES; error_class++)
+    {
+        if (error_status & (1<<error_class))
+        {
+            if (UINT16_MAX != My_LIN_Error_Stats.total[error_class])
+            {
+                My_LIN_Error_Stats.total[error_class]++;
+            }
+            if (UINT8_MAX != My_LIN_Error_Stats.recent[error_class])
+            {
+                My_LIN_Error_Stats.recent[error_class]++;
+            }
+        }
+    }
+
+    // Count the error against the frame it happened on
+    // (a parity error means the ID itself can't be trusted)
+    if (0 == (error_status & (1<<LIN_ERR_CLASS_PARITY)))
+    {
+        slot = get_frame_error_slot(Lin_get_id());
+        if ((LIN_ERR_NO_FRAME_SLOT != slot) && (LIN_ERR_FRAME_COUNT_MAX != get_frame_error_count(slot)))
+        {
+            // Counts in odd slots are in the high nibble
+            My_LIN_Frame_Errors[slot/2] += (1<<((slot & 1)*LIN_ERR_FRAME_COUNT_BITS));
+        }
+    }
+
+    // TODO: Deal with other errors accoridng to LIN 2.x spec.
+}
+
+/****************************************************************************
+    Private Function
+        decay_error_stats
+
+    Parameters
+        None
+
+    Description
+        Halves the recent error counts once for every LIN_ERR_DECAY_INTERVAL_MS
+        since the last decay. Must be called with interrupts disabled.
+
+****************************************************************************/
+static void decay_error_stats(void)
+{
+    uint32_t now_ms = Get_System_Time_MS();
+    uint8_t halvings = 0;
+    uint8_t index;
+
+    // Count the decay intervals that have passed
+    while ((LIN_ERR_DECAY_INTERVAL_MS <= (now_ms-LIN_Error_Decay_Time_MS)) \
+        && (LIN_ERR_MAX_HALVINGS > halvings))
+    {
+        LIN_Error_Decay_Time_MS += LIN_ERR_DECAY_INTERVAL_MS;
+        halvings++;
+    }
+
+    // Nothing to do yet
+    if (0 == halvings) return;
+
+    // Everything is 0 by now, resync to the current time
+    if (LIN_ERR_MAX_HALVINGS <= halvings)
+    {
+        LIN_Error_Decay_Time_MS = now_ms;
+    }
+
+    // Halve the counts
+    for (index = 0; index < NUM_LIN_ERR_CLASSES; index++)
+    {
+        My_LIN_Error_Stats.recent[index] >>= halvings;
+    }
+    for (index = 0; index < sizeof(My_LIN_Frame_Errors); index++)
+    {
+        My_LIN_Frame_Errors[index] = \
+            (((My_LIN_Frame_Errors[index]>>LIN_ERR_FRAME_COUNT_BITS)>>halvings)<<LIN_ERR_FRAME_COUNT_BITS)
+            | ((My_LIN_Frame_Errors[index] & LIN_ERR_FRAME_COUNT_MAX)>>halvings);
+    }
+}
+
+/****************************************************************************
+    Private Function
+        start_slot_timing
+
+    Parameters
+        uint8_t lin_id: ID of the header being sent
+
+    Description
+        Master: starts timing a slot. A slot still open from the last
+        header never completed. Also closes the utilisation window.
+
+****************************************************************************/
+static void start_slot_timing(uint8_t lin_id)
+{
+#if IS_MASTER_NODE
+    uint32_t now_us;
+    uint32_t window_us;
+
+    // The last slot never got a response or an error
+    end_slot_timing(LIN_SLOT_FAILED);
+
+    now_us = Get_System_Time_US();
+    Slot_Pending = true;
+    Slot_ID = lin_id;
+    Slot_Start_US = now_us;
+
+    // Update the utilisation at the end of each window
+    window_us = now_us-Util_Window_Start_US;
+    if (LIN_UTIL_WINDOW_US <= window_us)
+    {
+        My_LIN_Bus_Stats.utilisation_permille = ((Util_Busy_US < window_us) ?
+            ((Util_Busy_US*10)/(window_us/100)) : 1000);
+        Util_Window_Start_US = now_us;
+        Util_Busy_US = 0;
+    }
+#endif
+}
+
+/****************************************************************************
+    Private Function
+        end_slot_timing
+
+    Parameters
+        uint8_t outcome: LIN_SLOT_COMPLETE, LIN_SLOT_FAILED or LIN_SLOT_SILENT
+
+    Description
+        Master: ends the open slot, if any, and updates the bus meters
+
+****************************************************************************/
+static void end_slot_timing(uint8_t outcome)
+{
+#if IS_MASTER_NODE
+    uint32_t latency_us;
+    uint8_t entry;
+    uint8_t bucket;
+    lin_latency_record_t * p_latency;
+
+    if (!Slot_Pending) return;
+    Slot_Pending = false;
+
+    // Only the header went out if nobody had to answer
+    if (LIN_SLOT_SILENT == outcome)
+    {
+        Util_Busy_US += LIN_HEADER_US;
+        return;
+    }
+
+    latency_us = Get_System_Time_US()-Slot_Start_US;
+    if (UINT16_MAX < latency_us) latency_us = UINT16_MAX;
+    Util_Busy_US += latency_us;
+
+    if (LIN_SLOT_FAILED == outcome)
+    {
+        if (UINT16_MAX != My_LIN_Bus_Stats.incomplete_slots)
+        {
+            My_LIN_Bus_Stats.incomplete_slots++;
+        }
+        return;
+    }
+
+    if (My_LIN_Bus_Stats.max_latency_us < latency_us)
+    {
+        My_LIN_Bus_Stats.max_latency_us = latency_us;
+    }
+
+    // Bin the response latency of a slave's status frame
+    entry = LIN_ID_Table[Slot_ID];
+    if ((LIN_ACTION_RX|LIN_ENTRY_STATUS_STORE) != (entry & ~LIN_ENTRY_SLOT_MASK)) return;
+    p_latency = &My_LIN_Latency_Stats[entry & LIN_ENTRY_SLOT_MASK];
+
+    if (LIN_LATENCY_BUCKET_BASE_US > latency_us)
+    {
+        bucket = 0;
+    }
+    else
+    {
+        bucket = 1+((latency_us-LIN_LATENCY_BUCKET_BASE_US)/LIN_LATENCY_BUCKET_WIDTH_US);
+        if (NUM_LIN_LATENCY_BUCKETS <= bucket) bucket = NUM_LIN_LATENCY_BUCKETS-1;
+    }
+
+    // Halve all buckets when one fills up, to keep the distribution's shape
+    bucket *= LIN_LATENCY_BUCKET_BITS;
+    if (LIN_LATENCY_BUCKET_MAX == ((p_latency->buckets>>bucket) & LIN_LATENCY_BUCKET_MAX))
+    {
+        // Shift every nibble down one bit, without the bits of the next
+        p_latency->buckets = (p_latency->buckets>>1) & 0x7777;
+    }
+    p_latency->buckets += (1U<<bucket);
+
+    // Round up, so a longest response never reads shorter than it was
+    latency_us = (latency_us+LIN_LATENCY_MAX_UNIT_US-1)/LIN_LATENCY_MAX_UNIT_US;
+    if (UINT8_MAX < latency_us) latency_us = UINT8_MAX;
+    if (p_latency->max_latency < latency_us)
+    {
+        p_latency->max_latency = latency_us;
+    }
+#endif
+}
+
+/****************************************************************************
+    Private Function
+        get_frame_error_slot
+
+    Parameters
+        uint8_t lin_id: LIN frame ID
+
+    Description
+        Returns the index of the per frame statistics for an ID, or
+        LIN_ERR_NO_FRAME_SLOT if we don't keep statistics for it
+
+****************************************************************************/
+static uint8_t get_frame_error_slot(uint8_t lin_id)
+{
+    if (LIN_ERR_NUM_SCHEDULE_IDS > lin_id) return lin_id;
+    if (LIN_DIAG_MASTER_REQ_ID == lin_id) return LIN_ERR_DIAG_REQ_SLOT;
+    if (LIN_DIAG_SLAVE_RESP_ID == lin_id) return LIN_ERR_DIAG_RESP_SLOT;
+    return LIN_ERR_NO_FRAME_SLOT;
+}
+
+/****************************************************************************
+    Private Function
+        get_frame_error_count
+
+    Parameters
+        uint8_t slot: index of the per frame statistics
+
+    Description
+        Returns the recent error count kept for a frame slot
+
+****************************************************************************/
+static uint8_t get_frame_error_count(uint8_t slot)
+{
+    return (My_LIN_Frame_Errors[slot/2]>>((slot & 1)*LIN_ERR_FRAME_COUNT_BITS)) & LIN_ERR_FRAME_COUNT_MAX;
+}
+
+/****************************************************************************
+    Private Function
+        is_master
+
+    Parameters
+        None
+
+    Description
+        Returns true if this node is the master. Known at compile time, so
+        each image leaves out the other node's code and variables.
+
+****************************************************************************/
+static bool is_master(void)
+{
+    return IS_MASTER_NODE;
+}
+
+/****************************************************************************
+    Private Function
+        get_entry_store
+
+    Parameters
+        uint8_t entry: LIN ID table entry
+
+    Description
+        Returns the data store a LIN ID table entry refers to
+
+****************************************************************************/
+static data_store_t * get_entry_store(uint8_t entry)
+{
+    return (entry & LIN_ENTRY_STATUS_STORE) ? p_My_Status_Store : p_My_Command_Store;
+}
+
+/****************************************************************************
+    Private Function
+        get_slot_data
+
+    Parameters
+        uint8_t * p_buffer: store buffer (live or shadow)
+        uint8_t entry: LIN ID table entry
+
+    Description
+        Returns a pointer to the packet a LIN ID table entry refers to
+
+****************************************************************************/
+static uint8_t * get_slot_data(uint8_t * p_buffer, uint8_t entry)
+{
+    return (p_buffer+((entry & LIN_ENTRY_SLOT_MASK)*LIN_PACKET_LEN));
+}
+
+/****************************************************************************
+    Private Function
+        get_my_nad
+
+    Parameters
+        None
+
+    Description
+        Returns this slave's diagnostic node address
+
+****************************************************************************/
+static uint8_t get_my_nad(void)
+{
+    return GET_SLAVE_NAD(GET_SLAVE_NUMBER(*p_My_Node_ID));
+}
+
+/****************************************************************************
+    Private Function
+        transmit_sleep_frame
+
+    Parameters
+        None
+
+    Description
+        Starts transmitting the go-to-sleep command
+
+****************************************************************************/
+static void transmit_sleep_frame(void)
+{
+    uint8_t frame[LIN_DIAG_FRAME_LEN];
+
+    // NAD 0x00, all other bytes 0xFF
+    memset(frame, LIN_DIAG_FILL_BYTE, LIN_DIAG_FRAME_LEN);
+    frame[LIN_DIAG_NAD_INDEX] = LIN_DIAG_NAD_SLEEP;
+
+    // Prepare LIN module for transmit
+    lin_tx_response((OUR_LIN_SPEC), frame, (LIN_DIAG_FRAME_LEN));
+}
+
+/****************************************************************************
+    Private Function
+        start_wake_latency
+
+    Parameters
+        None
+
+    Description
+        Marks the wake up time, the next response we receive stops the
+        wake up latency measurement
+
+****************************************************************************/
+static void start_wake_latency(void)
+{
+    Wake_Time_MS = Get_System_Time_MS();
+    Wake_Latency_Pending = true;
+}
+
+/****************************************************************************
+    Private Function
+        transmit_diag_frame
+
+    Parameters
+        None
+
+    Description
+        Builds the next frame of the outgoing diagnostic PDU and starts
+        transmitting it (as a SF, FF or CF)
+
+****************************************************************************/
+static void transmit_diag_frame(void)
+{
+    uint8_t frame[LIN_DIAG_FRAME_LEN];
+    uint8_t data_index;
+    uint8_t remaining = Diag_Tx.len-Diag_Tx.index;
+
+    // Fill the frame so unused bytes are padded
+    memset(frame, LIN_DIAG_FILL_BYTE, LIN_DIAG_FRAME_LEN);
+    frame[LIN_DIAG_NAD_INDEX] = Diag_Tx.nad;
+
+    // Single frame
+    if ((0 == Diag_Tx.index) && (LIN_DIAG_SF_MAX_LEN >= Diag_Tx.len))
+    {
+        frame[LIN_DIAG_PCI_INDEX] = LIN_DIAG_PCI_SF|Diag_Tx.len;
+        data_index = LIN_DIAG_SF_DATA_INDEX;
+        Diag_Tx_Chunk_Len = Diag_Tx.len;
+    }
+    // First frame
+    else if (0 == Diag_Tx.index)
+    {
+        frame[LIN_DIAG_PCI_INDEX] = LIN_DIAG_PCI_FF;
+        frame[LIN_DIAG_FF_LEN_INDEX] = Diag_Tx.len;
+        data_index = LIN_DIAG_FF_DATA_INDEX;
+        Diag_Tx_Chunk_Len = LIN_DIAG_FF_DATA_LEN;
+    }
+    // Consecutive frame
+    else
+    {
+        frame[LIN_DIAG_PCI_INDEX] = LIN_DIAG_PCI_CF|(Diag_Tx.seq & LIN_DIAG_PCI_INFO_MASK);
+        data_index = LIN_DIAG_CF_DATA_INDEX;
+        Diag_Tx_Chunk_Len = (LIN_DIAG_CF_DATA_LEN < remaining) ? LIN_DIAG_CF_DATA_LEN : remaining;
+    }
+
+    // Copy the PDU bytes for this frame
+    memcpy(&frame[data_index], &Diag_Tx.data[Diag_Tx.index], Diag_Tx_Chunk_Len);
+
+    // Prepare LIN module for transmit
+    lin_tx_response((OUR_LIN_SPEC), frame, (LIN_DIAG_FRAME_LEN));
+}
+
+/****************************************************************************
+    Private Function
+        advance_diag_tx
+
+    Parameters
+        None
+
+    Description
+        Called after a diagnostic frame was transmitted, moves on to the
+        next frame of the PDU
+
+****************************************************************************/
+static void advance_diag_tx(void)
+{
+    // Nothing to do if the PDU was cleared while the frame was on the bus
+    if (0 == Diag_Tx.len) return;
+
+    // Move past the bytes we just sent
+    if (0 != Diag_Tx.index) Diag_Tx.seq++;
+    Diag_Tx.index += Diag_Tx_Chunk_Len;
+
+    // If the whole PDU has been sent, free it
+    if (Diag_Tx.len <= Diag_Tx.index)
+    {
+        Diag_Tx.len = 0;
+
+        // The master now polls for the response, unless nobody will answer
+        if (!is_master() || (LIN_DIAG_NAD_SLEEP == Diag_Tx.nad))
+        {
+            // Nothing more to do
+        }
+        else if (LIN_DIAG_NAD_BROADCAST == Diag_Tx.nad)
+        {
+            // Tell the service the request is out
+            Diag_Rx.len = 0;
+            Diag_Rx_Ready = true;
+            Post_Event(EVT_MASTER_DIAG_RESPONSE);
+        }
+        else
+        {
+            Diag_Awaiting_Response = true;
+            Diag_Polls_Left = (LIN_DIAG_NAD_UNASSIGNED == Diag_Tx.nad) ?
+                LIN_DIAG_UNASSIGNED_POLLS : LIN_DIAG_RESPONSE_POLLS;
+        }
+    }
+}
+
+/****************************************************************************
+    Private Function
+        receive_diag_frame
+
+    Parameters
+        None
+
+    Description
+        Passes a received diagnostic frame to the transport layer and alerts
+        the service when a whole PDU has arrived
+
+****************************************************************************/
+static void receive_diag_frame(void)
+{
+    uint8_t frame[LIN_DIAG_FRAME_LEN];
+
+    // Copy the frame
+    lin_get_response(frame);
+
+    // The go-to-sleep command is for every slave, the data bytes are ignored
+    if (!is_master() && (LIN_DIAG_NAD_SLEEP == frame[LIN_DIAG_NAD_INDEX]))
+    {
+        Bus_Asleep = true;
+        Post_Event(EVT_SLAVE_GO_TO_SLEEP);
+        return;
+    }
+
+    if (is_master())
+    {
+        // Only accept responses while we're waiting for one,
+        //  and only from the node we asked
+        if (!Diag_Awaiting_Response) return;
+        if (Diag_Tx.nad != frame[LIN_DIAG_NAD_INDEX]) return;
+
+        // The slave is answering, give it more time for the next frame
+        Diag_Polls_Left = LIN_DIAG_RESPONSE_POLLS;
+
+        if (parse_diag_frame(frame))
+        {
+            Diag_Awaiting_Response = false;
+            Diag_Rx_Ready = true;
+            Post_Event(EVT_MASTER_DIAG_RESPONSE);
+        }
+    }
+    else
+    {
+        // Only accept requests for us or for everyone
+        if  (   (get_my_nad() != frame[LIN_DIAG_NAD_INDEX])
+                &&
+                (LIN_DIAG_NAD_BROADCAST != frame[LIN_DIAG_NAD_INDEX])
+            )
+        {
+            return;
+        }
+
+        // A new request cancels any response we haven't sent yet
+        Diag_Tx.len = 0;
+
+        if (parse_diag_frame(frame))
+        {
+            Diag_Rx_Ready = true;
+            Post_Event(EVT_SLAVE_DIAG_REQUEST);
+        }
+    }
+}
+
+/****************************************************************************
+    Private Function
+        parse_diag_frame
+
+    Parameters
+        uint8_t * p_frame: received diagnostic frame
+
+    Description
+        Reassembles the incoming PDU in Diag_Rx. Returns true when the
+        frame completes the PDU. Frames out of sequence drop the PDU.
+
+****************************************************************************/
+static bool parse_diag_frame(uint8_t * p_frame)
+{
+    uint8_t pci = p_frame[LIN_DIAG_PCI_INDEX];
+    uint8_t remaining;
+    uint8_t chunk_len;
+
+    switch (pci & LIN_DIAG_PCI_TYPE_MASK)
+    {
+        case LIN_DIAG_PCI_SF:
+            // Ignore invalid lengths
+            if  (   (0 == (pci & LIN_DIAG_PCI_INFO_MASK))
+                    ||
+                    (LIN_DIAG_SF_MAX_LEN < (pci & LIN_DIAG_PCI_INFO_MASK))
+                )
+            {
+                return false;
+            }
+
+            // The whole PDU is in this frame
+            Diag_Rx.nad = p_frame[LIN_DIAG_NAD_INDEX];
+            Diag_Rx.len = pci & LIN_DIAG_PCI_INFO_MASK;
+            Diag_Rx.index = Diag_Rx.len;
+            memcpy(Diag_Rx.data, &p_frame[LIN_DIAG_SF_DATA_INDEX], Diag_Rx.len);
+            return true;
+
+        case LIN_DIAG_PCI_FF:
+            // Ignore PDUs we can't hold
+            if  (   (0 != (pci & LIN_DIAG_PCI_INFO_MASK))
+                    ||
+                    (LIN_DIAG_MAX_PDU_LEN < p_frame[LIN_DIAG_FF_LEN_INDEX])
+                    ||
+                    (LIN_DIAG_SF_MAX_LEN >= p_frame[LIN_DIAG_FF_LEN_INDEX])
+                )
+            {
+                Diag_Rx.len = 0;
+                return false;
+            }
+
+            // Start a new PDU
+            Diag_Rx.nad = p_frame[LIN_DIAG_NAD_INDEX];
+            Diag_Rx.len = p_frame[LIN_DIAG_FF_LEN_INDEX];
+            Diag_Rx.index = LIN_DIAG_FF_DATA_LEN;
+            Diag_Rx.seq = LIN_DIAG_FIRST_CF_SEQ;
+            memcpy(Diag_Rx.data, &p_frame[LIN_DIAG_FF_DATA_INDEX], LIN_DIAG_FF_DATA_LEN);
+            return false;
+
+        case LIN_DIAG_PCI_CF:
+            // Drop the PDU if this frame isn't the one we expect
+            if  (   (0 == Diag_Rx.len)
+                    ||
+                    (Diag_Rx.len <= Diag_Rx.index)
+                    ||
+                    ((Diag_Rx.seq & LIN_DIAG_PCI_INFO_MASK) != (pci & LIN_DIAG_PCI_INFO_MASK))
+                )
+            {
+                Diag_Rx.len = 0;
+                return false;
+            }
+
+            // Copy the next bytes
+            remaining = Diag_Rx.len-Diag_Rx.index;
+            chunk_len = (LIN_DIAG_CF_DATA_LEN < remaining) ? LIN_DIAG_CF_DATA_LEN : remaining;
+            memcpy(&Diag_Rx.data[Diag_Rx.index], &p_frame[LIN_DIAG_CF_DATA_INDEX], chunk_len);
+            Diag_Rx.index += chunk_len;
+            Diag_Rx.seq++;
+
+            // Done if we have all of it
+            return (Diag_Rx.len <= Diag_Rx.index);
+
+        default:
+            return false;
+    }
 }
 
 // #############################################################################
@@ -308,7 +2231,6 @@ ISR(LIN_TC_vect)
 ISR(LIN_ERR_vect)
 {
     // Get Error Status, do task, and clear int
-    Lin_get_error_status();
-    lin_err_task();
+    lin_err_task(Lin_get_error_status());
     Lin_clear_err_it();
 }
\ No newline at end of file
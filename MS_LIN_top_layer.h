@@ -1,12 +1,111 @@
 #ifndef MS_LIN_top_layer_H
 #define MS_LIN_top_layer_H
 
+// Command/Status helpers (data_store_t)
+#include "cmd_sts_helpers.h"
+
+// #############################################################################
+// ------------ LIN DEFINITIONS
+// #############################################################################
+
+// Returned by Master_LIN_Diag_Slot_ID() when there is no diagnostic traffic
+#define LIN_DIAG_NO_SLOT        (0xFF)
+
+// LIN error classes, numbered in LINERR bit order
+#define LIN_ERR_CLASS_BIT       (LBERR)         // Bit error
+#define LIN_ERR_CLASS_CHECKSUM  (LCERR)         // Checksum error
+#define LIN_ERR_CLASS_PARITY    (LPERR)         // Identifier parity error
+#define LIN_ERR_CLASS_SYNC      (LSERR)         // Synchronization error
+#define LIN_ERR_CLASS_FRAMING   (LFERR)         // Framing error
+#define LIN_ERR_CLASS_OVERRUN   (LOVERR)        // Overrun error
+#define LIN_ERR_CLASS_TIMEOUT   (LTOERR)        // Frame time out (no response)
+#define NUM_LIN_ERR_CLASSES     (7)
+
+// #############################################################################
+// ------------ TYPE DEFINITIONS
+// #############################################################################
+
+// LIN counters reported over diagnostics
+typedef struct
+{
+    uint8_t         error_count;        // Number of LIN errors
+    uint16_t        rx_frame_count;     // Number of responses received
+    uint16_t        tx_frame_count;     // Number of responses transmitted
+    uint32_t        last_rx_time_ms;    // System time of the last response received
+} lin_counters_t;
+
+// LIN error statistics per error class
+// The recent counts are halved every LIN_ERR_DECAY_INTERVAL_MS, so they
+//  read as a rate: a steady E errors per interval settles at about 2*E.
+typedef struct
+{
+    uint16_t        total[NUM_LIN_ERR_CLASSES];     // Errors since reset (saturating)
+    uint8_t         recent[NUM_LIN_ERR_CLASSES];    // Decaying error counts
+} lin_error_stats_t;
+
+// LIN sleep statistics reported over diagnostics
+typedef struct
+{
+    uint16_t        sleep_count;        // Number of times the bus went to sleep
+    uint16_t        wake_latency_ms;    // Last wake up to first response received
+} lin_sleep_stats_t;
+
+// LIN bus timing statistics (master)
+typedef struct
+{
+    uint16_t        utilisation_permille;   // Busy share of the last window
+    uint16_t        incomplete_slots;       // Headers without a complete response (saturating)
+    uint16_t        max_latency_us;         // Longest header to completion time
+} lin_bus_stats_t;
+
+// Status response latency of one slave (master)
+#define NUM_LIN_LATENCY_BUCKETS (4)
+typedef struct
+{
+    uint8_t         buckets[NUM_LIN_LATENCY_BUCKETS];   // Responses per latency range
+    uint16_t        max_latency_us;                     // Longest response
+} lin_latency_stats_t;
+
 // #############################################################################
 // ------------ PUBLIC FUNCTION PROTOTYPES
 // #############################################################################
 
-void MS_LIN_Initialize(uint8_t * p_this_node_id, uint8_t * p_command_data, \
-    uint8_t * p_status_data);
+void MS_LIN_Initialize(uint8_t * p_this_node_id, data_store_t * p_command_store, \
+    data_store_t * p_status_store);
+void MS_LIN_Update_ID_Table(void);
 void Master_LIN_Broadcast_ID(uint8_t slave_id);
+bool Master_LIN_Last_Frame_OK(void);
+bool Master_LIN_Event_Collision(void);
+bool Master_LIN_Get_Status(uint8_t * p_slave_number, uint8_t * p_status);
+bool Master_LIN_Get_Ext_Status(uint8_t slave_number, uint8_t * p_ext_status);
+void Slave_LIN_Write_Ext_Status(uint8_t * p_ext_status);
+void Master_LIN_Write_Scene(uint8_t * p_scene);
+void Slave_LIN_Get_Scene(uint8_t * p_scene);
+void Get_LIN_Counters(lin_counters_t * p_counters);
+void Get_LIN_Error_Stats(lin_error_stats_t * p_stats);
+uint8_t Get_LIN_Frame_Error_Count(uint8_t lin_id);
+void Get_LIN_Sleep_Stats(lin_sleep_stats_t * p_stats);
+void Get_LIN_Bus_Stats(lin_bus_stats_t * p_stats);
+bool Get_LIN_Latency_Stats(uint8_t slave_number, lin_latency_stats_t * p_stats);
+
+// Sleep and wake up (master)
+void Master_LIN_Go_To_Sleep(void);
+bool Master_LIN_Is_Asleep(void);
+void Master_LIN_Start_Wake_Up(void);
+void Master_LIN_End_Wake_Up(void);
+
+// Sleep and wake up (slave)
+void Slave_LIN_Power_Down(void);
+
+// Diagnostic transport layer (master)
+bool Master_LIN_Diag_Send_Request(uint8_t nad, uint8_t * p_pdu, uint8_t pdu_len);
+uint8_t Master_LIN_Diag_Get_Response(uint8_t * p_pdu);
+bool Master_LIN_Diag_Collided(void);
+bool Master_LIN_Diag_Is_Busy(void);
+uint8_t Master_LIN_Diag_Slot_ID(void);
+
+// Diagnostic transport layer (slave)
+uint8_t Slave_LIN_Diag_Get_Request(uint8_t * p_nad, uint8_t * p_pdu);
+void Slave_LIN_Diag_Send_Response(uint8_t * p_pdu, uint8_t pdu_len);
 
 #endif // MS_CAN_top_layer_H
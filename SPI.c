@@ -58,7 +58,8 @@
 
 static uint8_t Master_Slave_Identifier = 0; // Slave or master?
 static uint8_t Command_Buffer[COMMAND_BUFFER_SIZE][MAX_COMMAND_TX_SIZE]; // Create a command buffer to prevent overwrite
-static uint8_t * Receive_List[COMMAND_BUFFER_SIZE][MAX_COMMAND_RX_SIZE]; // List of pointers whose variables will be assigned based on SPI receive
+static uint8_t * Receive_List[COMMAND_BUFFER_SIZE]; // Where each command's receive bytes are stored, in order
+static spi_done_cb_t Done_List[COMMAND_BUFFER_SIZE]; // Called when each command completes, if not NULL
 static uint8_t Buffer_Index = 0; // Command buffer index variable
 static uint8_t Next_Available_Row = 0; // Provides row to fill in next command
 
@@ -240,15 +241,53 @@ void SPI_Transmit (void)
 
         uint8_t RX_Length
         uint8_t* Data_To_Write
+        uint8_t** Data2Receive: Data2Receive[0] points to RX_Length bytes
 
     Description
         Fills in current command into SPI command buffer
+        The bytes received are stored one after the other, so a burst
+        read fills a buffer with a single command
+        Returns false, and the command is dropped, if the command buffer
+        is full
 ****************************************************************************/
 
-void Write_SPI(uint8_t TX_Length, uint8_t RX_Length, uint8_t * Data2Write, uint8_t ** Data2Receive)
+bool Write_SPI(uint8_t TX_Length, uint8_t RX_Length, uint8_t * Data2Write, uint8_t ** Data2Receive)
+{
+    return Write_SPI_Notify(TX_Length, RX_Length, Data2Write, Data2Receive, NULL);
+}
+
+/****************************************************************************
+    Public Function
+        Write_SPI_Notify
+
+    Parameters
+        As Write_SPI
+        spi_done_cb_t p_done_cb: called once the command's receive bytes
+            are stored (interrupt context), or NULL
+
+    Description
+        Fills in current command into SPI command buffer, the caller is
+        told when it completes
+        Returns false, and the command is dropped, if the command buffer
+        is full
+****************************************************************************/
+
+bool Write_SPI_Notify(uint8_t TX_Length, uint8_t RX_Length, uint8_t * Data2Write, uint8_t ** Data2Receive, spi_done_cb_t p_done_cb)
 {
 	counter_value = query_counter();
 	
+    // Command doesn't fit a row of the command buffer
+    if (TX_Length > (MAX_COMMAND_TX_SIZE - LENGTH_BYTES))
+    {
+        return false;
+    }
+
+    // Command buffer full, the next row is still waiting to be sent
+    if (Command_Buffer[Next_Available_Row][TX_LENGTH_BYTE] != 0xFF)
+    {
+        return false;
+    }
+
     // Over all columns of next available command row
     for (int i = 0; i < (LENGTH_BYTES + TX_Length); i++)
     {
@@ -271,12 +310,10 @@ void Write_SPI(uint8_t TX_Length, uint8_t RX_Length, uint8_t * Data2Write, uint8
     // Data is expected to be received
     if (RX_Length > 0)
     {
-        for (int i = 0; i < RX_Length; i++)
-        {
-            // Add pointers to variables that shall be updated with receive data
-            Receive_List[Next_Available_Row][i] = *(Data2Receive + i);
-        }
+        // Add pointer to the variables that shall be updated with receive data
+        Receive_List[Next_Available_Row] = *Data2Receive;
     }
+    Done_List[Next_Available_Row] = p_done_cb;
     // If reached Command Buffer end
     if (Next_Available_Row == COMMAND_BUFFER_SIZE - 1)
     {
@@ -291,6 +328,34 @@ void Write_SPI(uint8_t TX_Length, uint8_t RX_Length, uint8_t * Data2Write, uint8
     {
         Post_Event(EVT_SPI_START);
     }
+    return true;
+}
+
+/****************************************************************************
+    Public Function
+        Get_SPI_Free_Rows
+
+    Parameters
+        None
+
+    Description
+        Returns the number of commands that can be queued before the
+        command buffer is full, so a caller can check a sequence of
+        commands fits before queuing the first
+****************************************************************************/
+
+uint8_t Get_SPI_Free_Rows(void)
+{
+    uint8_t Free_Rows = 0;
+    uint8_t Row = Next_Available_Row;
+
+    // Rows are freed in order, the free ones follow the last one filled
+    while ((Free_Rows < COMMAND_BUFFER_SIZE) && (Command_Buffer[Row][TX_LENGTH_BYTE] == 0xFF))
+    {
+        Free_Rows++;
+        Row = (Row == COMMAND_BUFFER_SIZE - 1) ? 0 : Row + 1;
+    }
+    return Free_Rows;
 }
 
 // #############################################################################
@@ -305,10 +370,13 @@ void Write_SPI(uint8_t TX_Length, uint8_t RX_Length, uint8_t * Data2Write, uint8
         None
 
     Description
-        Handles SPI transmission completed interrupts
+        Handles SPI transmission completed interrupts. Only the master
+        talks to the MCP25625, a slave leaves the vector out so the linker
+        drops the command buffer from its image.
 
 ****************************************************************************/
 
+#if IS_MASTER_NODE
 ISR(SPI_STC_vect)
 {
     if (Master_Slave_Identifier == SPI_MASTER)
@@ -343,13 +411,13 @@ ISR(SPI_STC_vect)
 		{
 			if (Expected_RX_Length > 0)
 			{
-                if (Receive_List[Buffer_Index][RX_Index] == NULL)
+                if (Receive_List[Buffer_Index] == NULL)
                 {
                     if (SPDR);
                 }
                 else
                 {
-                    *(Receive_List[Buffer_Index][RX_Index]) = SPDR;
+                    Receive_List[Buffer_Index][RX_Index] = SPDR;
                 }
 				RX_Index++;				
 			}
@@ -359,6 +427,11 @@ ISR(SPI_STC_vect)
 			}
 			else if (RX_Index >= Expected_RX_Length)
 			{
+                // Tell the caller its command is done
+                if (Done_List[Buffer_Index] != NULL)
+                {
+                    Done_List[Buffer_Index]();
+                }
                 Update_Buffer_Index();
 				Post_Event(EVT_SPI_END);
 			}
@@ -373,6 +446,7 @@ ISR(SPI_STC_vect)
 		// Not configured to be slave
 	}
 }
+#endif
 
 // #############################################################################
 // ------------ PRIVATE FUNCTIONS
@@ -401,10 +475,8 @@ static void Reset_Command_Receive_Buffer(void)
             Command_Buffer[row][col] = 0xFF;    // Set as unassigned
         }
         // Set all pointers of Receive List to NULL 
-        for (int col = 0; col < MAX_COMMAND_RX_SIZE; col++)
-        {
-            Receive_List[row][col] = NULL;     // Set as unassigned
-        }
+        Receive_List[row] = NULL;     // Set as unassigned
+        Done_List[row] = NULL;
     }
 }
 
@@ -429,10 +501,8 @@ static void Update_Buffer_Index(void)
         Command_Buffer[Buffer_Index][i] = 0xFF;
     }
     // Point current receive list row to NULL
-    for (int i = 0; i < MAX_COMMAND_RX_SIZE; i++)
-    {
-        Receive_List[Buffer_Index][i] = NULL;
-    }
+    Receive_List[Buffer_Index] = NULL;
+    Done_List[Buffer_Index] = NULL;
     // If at end of buffer
     if (Buffer_Index == COMMAND_BUFFER_SIZE - 1)
     {
@@ -9,8 +9,8 @@
 #define SPI_SLAVE       1
 
 #define COMMAND_BUFFER_SIZE 10
-#define MAX_COMMAND_TX_SIZE 6
-#define MAX_COMMAND_RX_SIZE 1
+#define MAX_SPI_BURST_TX    14  // LOAD TX BUFFER: instruction, ID, DLC, 8 bytes
+#define MAX_COMMAND_TX_SIZE (LENGTH_BYTES + MAX_SPI_BURST_TX)
 #define TX_LENGTH_BYTE      0
 #define RX_LENGTH_BYTE      1
 #define LENGTH_BYTES        2
@@ -25,6 +25,13 @@
 #define SCK             (PINA5)
 #define SS              (PINA6)
 
+// #############################################################################
+// ------------ TYPE DEFINITIONS
+// #############################################################################
+
+// Called from interrupt context when a command's last byte is clocked
+typedef void (*spi_done_cb_t) (void);
+
 // #############################################################################
 // ------------ PUBLIC FUNCTION PROTOTYPES
 // #############################################################################
@@ -33,6 +40,8 @@ void SPI_Initialize(void);
 void SPI_Transmit(void);
 void SPI_Start_Command (void);
 void SPI_End_Command (void);
-void Write_SPI(uint8_t TX_Length, uint8_t RX_Length, uint8_t * Data2Write, uint8_t * * Data2Receive);
+bool Write_SPI(uint8_t TX_Length, uint8_t RX_Length, uint8_t * Data2Write, uint8_t * * Data2Receive);
+bool Write_SPI_Notify(uint8_t TX_Length, uint8_t RX_Length, uint8_t * Data2Write, uint8_t * * Data2Receive, spi_done_cb_t p_done_cb);
+uint8_t Get_SPI_Free_Rows(void);
 
 #endif // SPI_H
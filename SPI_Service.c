@@ -29,7 +29,7 @@
 #include "SPI.h"
 
 // This module's header file
-#include "SPI_service.h"
+#include "SPI_Service.h"
 
 // #############################################################################
 // ------------ MODULE DEFINITIONS
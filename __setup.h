@@ -29,6 +29,8 @@
 
 #include "SPI_Service.h"
 
+#include "CAN_Service.h"
+
 #include "slave_service.h"
 
 #include "slave_number_setting_SM.h"
@@ -52,6 +54,7 @@
 #if IS_MASTER_NODE
     #define INITIALIZER_06          Init_SPI_Service
     #define INITIALIZER_07          Init_Master_Service
+    #define INITIALIZER_08          Init_CAN_Service
 #else
     #define INITIALIZER_06          Init_Analog_Servo_Driver
     #define INITIALIZER_07          Init_Slave_Service
@@ -67,17 +70,27 @@
 #if IS_MASTER_NODE
     #define SERVICE_01		        Run_Master_Service
     #define SERVICE_02              Run_SPI_Service
+    #define SERVICE_03              Run_CAN_Service
 #else
     #define SERVICE_01		        Run_Slave_Service
     #define SERVICE_02              Run_Slave_Number_Setting_SM
 #endif
 
+// #############################################################################
+// ------------ IDLE (must be a function of type "void f(void)", runs once no
+//  event is pending)
+// #############################################################################
+
+#if !IS_MASTER_NODE
+    #define IDLE_SERVICE            Run_Slave_Idle
+#endif
+
 // #############################################################################
 // ------------ EVENT DEFINITIONS
 // #############################################################################
 
 // Number of events we've defined
-#define NUM_EVENTS                      18
+#define NUM_EVENTS                      29
 
 #define NON_EVENT                       EVENT_NULL
        
@@ -105,6 +118,24 @@
 #define EVT_SPI_RECV_BYTE               EVENT_17
 #define EVT_SPI_END                     EVENT_18
 
+#define EVT_SLAVE_DIAG_REQUEST          EVENT_19
+#define EVT_MASTER_DIAG_RESPONSE        EVENT_20
+
+#define EVT_MASTER_HEALTH_CHANGE        EVENT_21
+
+#define EVT_SLAVE_GO_TO_SLEEP           EVENT_22
+
+#define EVT_SLAVE_EXT_STATUS_SENT       EVENT_23
+
+#define EVT_SLAVE_COMMIT                EVENT_24
+
+#define EVT_CAN_FRAME_RECEIVED          EVENT_25
+#define EVT_CAN_INTERRUPT               EVENT_26
+#define EVT_CAN_FLAGS_READ              EVENT_27
+#define EVT_CAN_CHECK                   EVENT_28
+
+#define EVT_SLAVE_SCENE                 EVENT_29
+
 // #############################################################################
 // ------------ END OF FILE
 // #############################################################################
@@ -65,6 +65,10 @@ static uint32_t Move_Timer = NON_EVENT;
 // Signal generate step
 static uint8_t Step = 0;
 
+// Position we last drove the servo to, and whether pulses are being sent
+static position_data_t Servo_Position = SERVO_STAY;
+static bool Servo_Moving = false;
+
 // #############################################################################
 // ------------ PRIVATE FUNCTION PROTOTYPES
 // #############################################################################
@@ -134,6 +138,7 @@ void Move_Analog_Servo_To_Position(position_data_t requested_position)
         // Start move timer (this module will send signals for this amount of time)
         // The cb function for this timer is stop_signal()
         Start_Timer(&Move_Timer, SERVO_DRIVE_TIME_MS);
+        Servo_Moving = true;
     }
 }
 
@@ -158,6 +163,7 @@ void Hold_Analog_Servo_Position(position_data_t requested_position)
 
         // Set pulse width for the requested position
         set_pulse_width(requested_position);
+        Servo_Moving = true;
     }
 }
 
@@ -178,6 +184,39 @@ void Release_Analog_Servo(void)
     stop_signal(NON_EVENT);
 }
 
+/****************************************************************************
+    Public Function
+        Get_Analog_Servo_Position
+
+    Parameters
+        None
+
+    Description
+        Returns the position the servo was last driven to, SERVO_STAY if
+        it hasn't been driven yet (an analog servo has no feedback)
+
+****************************************************************************/
+position_data_t Get_Analog_Servo_Position(void)
+{
+    return Servo_Position;
+}
+
+/****************************************************************************
+    Public Function
+        Is_Analog_Servo_Moving
+
+    Parameters
+        None
+
+    Description
+        Returns true while pulses are being sent to the servo
+
+****************************************************************************/
+bool Is_Analog_Servo_Moving(void)
+{
+    return Servo_Moving;
+}
+
 /****************************************************************************
     Private Function
         Is_Servo_Position_Valid
@@ -240,6 +279,7 @@ static void set_pulse_width(position_data_t this_position)
 
     // Compute what the register value should be for some pulse width
     OCR1B = (TIMER_1_TOP-(((uint32_t) pulse_width*TIMER_1_TOP)/US_IN_PWM_PERIOD));
+    Servo_Position = this_position;
 }
 
 /****************************************************************************
@@ -257,6 +297,7 @@ static void stop_signal(uint32_t unused)
 {
     // Set 0% duty cycle on PWM channel b
     Set_PWM_Duty_Cycle(ANALOG_SERVO_PWM_CH, 0);
+    Servo_Moving = false;
 }
 
 /****************************************************************************
@@ -29,6 +29,8 @@ void Init_Analog_Servo_Driver(void);
 void Move_Analog_Servo_To_Position(position_data_t requested_position);
 void Hold_Analog_Servo_Position(position_data_t requested_position);
 void Release_Analog_Servo(void);
+position_data_t Get_Analog_Servo_Position(void);
+bool Is_Analog_Servo_Moving(void);
 bool Is_Servo_Position_Valid(const slave_parameters_t * p_slave_params, position_data_t requested_position);
 
 #endif // ANALOG_SERVO_DRV_H
@@ -0,0 +1,708 @@
+/*******************************************************************************
+    File:
+        auto_addressing.c
+
+    Notes:
+        This file contains the automatic slave numbering, run by the master
+        over the LIN diagnostic frames (services in config.h).
+
+        The master broadcasts a start request. Each slave taking part draws
+        a random 32 bit serial and answers on the shared
+        LIN_DIAG_NAD_UNASSIGNED until it has a number:
+            LIN_DIAG_ADDR_MODE_NEW: only the slaves without a number take
+                part, e.g. a light that was just replaced. The numbers of
+                the slaves that answer are kept.
+            LIN_DIAG_ADDR_MODE_ALL: every slave gives up its number and the
+                slaves are numbered from LOWEST_SLAVE_NUMBER up.
+
+        The master then searches the serials bit by bit, MSB first. It asks
+        the slaves whose serial starts with the prefix found so far to
+        answer:
+            nobody:     move on to the next prefix.
+            one:        give that serial the lowest free number. The slave
+                        stores it in EEPROM and answers on its new NAD.
+            several:    the responses collide, look at both halves of the
+                        prefix (one more bit).
+        Every slave is found after a few queries, each of which takes 2-4
+        diagnostic slots. The master runs only those slots while numbering
+        (see master_service.c), 9 slaves take well under a second.
+
+        There is no unique ID in the ATtiny167, the serial comes from the
+        time since power up, which differs from slave to slave. If two
+        slaves draw the same serial the slaves without a number draw again.
+
+        The numbers follow the order the serials are found in, not the
+        positions of the lights on the vehicle.
+
+    External Functions Required:
+        Master_LIN_Diag_Send_Request(), Master_LIN_Diag_Get_Response(),
+        Master_LIN_Diag_Collided(), Get_System_Time_MS(),
+        Get_System_Time_US()
+
+    Public Functions:
+        bool Start_Auto_Addressing(uint8_t mode, uint32_t taken_bitmap)
+        bool Auto_Addressing_In_Progress(void)
+        bool Run_Auto_Addressing(void)
+        void Get_Auto_Addressing_Report(addressing_report_t * p_report)
+        bool Is_Addressing_Request(uint8_t * p_request)
+        uint8_t Process_Addressing_Request(uint8_t * p_request,
+            uint8_t request_len, uint8_t * p_response,
+            uint8_t * p_slave_number)
+
+*******************************************************************************/
+
+// #############################################################################
+// ------------ INCLUDES
+// #############################################################################
+
+// Standard ANSI  99 C types for exact integer sizes and booleans
+#include <stdint.h>
+#include <stdbool.h>
+
+// Config file
+#include "config.h"
+
+// Framework
+#include "framework.h"
+
+// This module's header file
+#include "auto_addressing.h"
+
+// Include other files below:
+
+// LIN top layer
+#include "MS_LIN_top_layer.h"
+
+// Timer
+#include "timer.h"
+
+// memset
+#include <string.h>
+
+// #############################################################################
+// ------------ MODULE DEFINITIONS
+// #############################################################################
+
+#define SERIAL_BITS                 (32)
+
+// Request PDU layout
+#define ADDR_SID_INDEX              (0)
+#define ADDR_START_MODE_INDEX       (1)
+#define ADDR_START_LEN              (2)
+#define ADDR_QUERY_BITS_INDEX       (1)
+#define ADDR_QUERY_SERIAL_INDEX     (2)
+#define ADDR_QUERY_LEN              (6)
+#define ADDR_ASSIGN_SERIAL_INDEX    (1)
+#define ADDR_ASSIGN_NAD_INDEX       (5)
+#define ADDR_ASSIGN_LEN             (6)
+
+// Positive response PDU layout
+#define ADDR_RSP_RSID_INDEX         (0)
+#define ADDR_RSP_SERIAL_INDEX       (1)
+#define ADDR_QUERY_RSP_LEN          (5)
+#define ADDR_ASSIGN_RSP_LEN         (1)
+
+// Times the slaves draw new serials before the master gives up
+#define ADDRESSING_MAX_REDRAWS      (3)
+
+// Serial bit a prefix of (bits) bits ends with, bits is 1 to SERIAL_BITS
+#define GET_PREFIX_BIT(bits)        (1UL<<(SERIAL_BITS-(bits)))
+
+// Bit of a slave number in a bitmap
+#define GET_NUMBER_BIT(slave_number)    (1UL<<(slave_number))
+
+// #############################################################################
+// ------------ TYPE DEFINITIONS
+// #############################################################################
+
+// Master auto-addressing states
+typedef enum
+{
+    addressing_idle = 0,
+    addressing_starting,        // Start request going out
+    addressing_querying,        // Asking the slaves under the prefix to answer
+    addressing_assigning        // Giving the slave found its number
+} addressing_state_t;
+
+// #############################################################################
+// ------------ MODULE VARIABLES
+// #############################################################################
+
+// Master
+static addressing_state_t Addressing_State = addressing_idle;
+static uint32_t Taken_Bitmap = 0;           // Numbers not to give out
+static uint32_t Search_Prefix = 0;          // Serial bits searched, MSB first
+static uint8_t Search_Bits = 0;             // Length of the prefix
+static uint32_t Found_Serial = 0;           // Slave being numbered
+static uint8_t Found_Number = 0;            // Its number
+static uint8_t Redraws_Left = 0;
+static uint32_t Start_Time_MS = 0;
+static addressing_report_t Report = {0};
+
+// Slave
+static bool Slave_Taking_Part = false;      // Drew a serial and has no number
+static uint32_t My_Serial = 0;
+
+// #############################################################################
+// ------------ PRIVATE FUNCTION PROTOTYPES
+// #############################################################################
+
+static void send_start(uint8_t mode);
+static void send_query(void);
+static void send_assign(void);
+static bool split_search(void);
+static bool next_search(void);
+static bool finish(addressing_result_t result);
+static uint8_t get_free_number(void);
+static bool is_under_prefix(uint32_t serial, uint32_t prefix, uint8_t bits);
+static uint32_t draw_serial(void);
+static uint32_t read_serial(uint8_t * p_source);
+static void write_serial(uint8_t * p_target, uint32_t serial);
+
+// #############################################################################
+// ------------ PUBLIC FUNCTIONS
+// #############################################################################
+
+/****************************************************************************
+    Public Function
+        Start_Auto_Addressing
+
+    Parameters
+        uint8_t mode: LIN_DIAG_ADDR_MODE_NEW or LIN_DIAG_ADDR_MODE_ALL
+        uint32_t taken_bitmap: numbers held by slaves that answer, bit n
+            is set for slave number n (ignored for LIN_DIAG_ADDR_MODE_ALL)
+
+    Description
+        Starts numbering the slaves. Returns false if a pass is already
+        running, the mode is unknown or a diagnostic request is in
+        progress. Run_Auto_Addressing() must be called on every
+        EVT_MASTER_DIAG_RESPONSE until it returns true.
+
+****************************************************************************/
+bool Start_Auto_Addressing(uint8_t mode, uint32_t taken_bitmap)
+{
+    if (addressing_idle != Addressing_State) return false;
+    if ((LIN_DIAG_ADDR_MODE_NEW != mode) && (LIN_DIAG_ADDR_MODE_ALL != mode)) return false;
+    if (Master_LIN_Diag_Is_Busy()) return false;
+
+    // Every number is free if everyone is renumbered
+    Taken_Bitmap = (LIN_DIAG_ADDR_MODE_ALL == mode) ? 0 : taken_bitmap;
+    Redraws_Left = ADDRESSING_MAX_REDRAWS;
+    Start_Time_MS = Get_System_Time_MS();
+    memset(&Report, 0, sizeof(Report));
+    Report.renumbered = (LIN_DIAG_ADDR_MODE_ALL == mode);
+
+    // Have the slaves draw their serials
+    send_start(mode);
+
+    return true;
+}
+
+/****************************************************************************
+    Public Function
+        Auto_Addressing_In_Progress
+
+    Parameters
+        None
+
+    Description
+        Returns true while the master is numbering the slaves. Also called
+        from interrupt context by the master schedule.
+
+****************************************************************************/
+bool Auto_Addressing_In_Progress(void)
+{
+    return (addressing_idle != Addressing_State);
+}
+
+/****************************************************************************
+    Public Function
+        Run_Auto_Addressing
+
+    Parameters
+        None
+
+    Description
+        Takes the response to the last request and sends the next one.
+        Returns true when the pass is over, Get_Auto_Addressing_Report()
+        then has the outcome.
+
+****************************************************************************/
+bool Run_Auto_Addressing(void)
+{
+    uint8_t response[LIN_DIAG_MAX_PDU_LEN];
+    uint8_t response_len = Master_LIN_Diag_Get_Response(response);
+
+    switch (Addressing_State)
+    {
+        case addressing_starting:
+            // The slaves have their serials, search from the top
+            Search_Prefix = 0;
+            Search_Bits = 0;
+            send_query();
+            break;
+
+        case addressing_querying:
+            // One slave answered, number it
+            if  (   (ADDR_QUERY_RSP_LEN == response_len)
+                    &&
+                    ((LIN_DIAG_SID_ADDR_QUERY+LIN_DIAG_RSID_OFFSET) == response[ADDR_RSP_RSID_INDEX])
+                    &&
+                    is_under_prefix(read_serial(&response[ADDR_RSP_SERIAL_INDEX]), Search_Prefix, Search_Bits)
+                )
+            {
+                Found_Serial = read_serial(&response[ADDR_RSP_SERIAL_INDEX]);
+                Found_Number = get_free_number();
+                if (INVALID_SLAVE_NUMBER == Found_Number)
+                {
+                    return finish(addressing_out_of_numbers);
+                }
+                send_assign();
+            }
+            // Several answered at once
+            else if (Master_LIN_Diag_Collided() || (0 != response_len))
+            {
+                return split_search();
+            }
+            // Nobody under this prefix
+            else
+            {
+                return next_search();
+            }
+            break;
+
+        case addressing_assigning:
+            // The slave has its number. It was alone under the prefix, or
+            //  its answer would have collided.
+            if  (   (ADDR_ASSIGN_RSP_LEN <= response_len)
+                    &&
+                    ((LIN_DIAG_SID_ASSIGN_NAD+LIN_DIAG_RSID_OFFSET) == response[ADDR_RSP_RSID_INDEX])
+                )
+            {
+                Taken_Bitmap |= GET_NUMBER_BIT(Found_Number);
+                Report.numbered++;
+                if (Report.highest_number < Found_Number)
+                {
+                    Report.highest_number = Found_Number;
+                }
+                return next_search();
+            }
+
+            // Nobody has that serial, the answer was a collision that
+            //  happened to look valid
+            return split_search();
+
+        default:
+            break;
+    }
+
+    return false;
+}
+
+/****************************************************************************
+    Public Function
+        Get_Auto_Addressing_Report
+
+    Parameters
+        addressing_report_t * p_report: where to copy the outcome
+
+    Description
+        Copies the outcome of the last auto-addressing pass
+
+****************************************************************************/
+void Get_Auto_Addressing_Report(addressing_report_t * p_report)
+{
+    *p_report = Report;
+}
+
+/****************************************************************************
+    Public Function
+        Is_Addressing_Request
+
+    Parameters
+        uint8_t * p_request: request PDU
+
+    Description
+        Returns true if the request is one of the auto-addressing services
+
+****************************************************************************/
+bool Is_Addressing_Request(uint8_t * p_request)
+{
+    return (    (LIN_DIAG_SID_ADDR_START == p_request[ADDR_SID_INDEX])
+                ||
+                (LIN_DIAG_SID_ADDR_QUERY == p_request[ADDR_SID_INDEX])
+                ||
+                (LIN_DIAG_SID_ASSIGN_NAD == p_request[ADDR_SID_INDEX])
+           );
+}
+
+/****************************************************************************
+    Public Function
+        Process_Addressing_Request
+
+    Parameters
+        uint8_t * p_request: request PDU
+        uint8_t request_len: length of the request PDU
+        uint8_t * p_response: where to build the response PDU
+        uint8_t * p_slave_number: our slave number, LIN_DIAG_NAD_UNASSIGNED
+            if we have none. Updated if the request changes it.
+
+    Description
+        Processes an auto-addressing request on a slave. Returns the length
+        of the response PDU, 0 if we must stay silent (the request wasn't
+        for us, and the other slaves without a number may be answering).
+        The response must be sent before we take on a new number.
+
+****************************************************************************/
+uint8_t Process_Addressing_Request(uint8_t * p_request, uint8_t request_len, uint8_t * p_response, \
+    uint8_t * p_slave_number)
+{
+    switch (p_request[ADDR_SID_INDEX])
+    {
+        case LIN_DIAG_SID_ADDR_START:
+            if (ADDR_START_LEN > request_len) return 0;
+
+            // Give up our number if everyone is renumbered
+            if (LIN_DIAG_ADDR_MODE_ALL == p_request[ADDR_START_MODE_INDEX])
+            {
+                *p_slave_number = LIN_DIAG_NAD_UNASSIGNED;
+            }
+
+            // Take part if we have no number
+            Slave_Taking_Part = (LIN_DIAG_NAD_UNASSIGNED == *p_slave_number);
+            My_Serial = draw_serial();
+            return 0;
+
+        case LIN_DIAG_SID_ADDR_QUERY:
+            if  (   !Slave_Taking_Part
+                    ||
+                    (LIN_DIAG_NAD_UNASSIGNED != *p_slave_number)
+                    ||
+                    (ADDR_QUERY_LEN > request_len)
+                    ||
+                    (SERIAL_BITS < p_request[ADDR_QUERY_BITS_INDEX])
+                )
+            {
+                return 0;
+            }
+
+            // Answer with our serial if it starts with the prefix
+            if (!is_under_prefix(My_Serial, read_serial(&p_request[ADDR_QUERY_SERIAL_INDEX]),
+                    p_request[ADDR_QUERY_BITS_INDEX]))
+            {
+                return 0;
+            }
+            p_response[ADDR_RSP_RSID_INDEX] = LIN_DIAG_SID_ADDR_QUERY+LIN_DIAG_RSID_OFFSET;
+            write_serial(&p_response[ADDR_RSP_SERIAL_INDEX], My_Serial);
+            return ADDR_QUERY_RSP_LEN;
+
+        case LIN_DIAG_SID_ASSIGN_NAD:
+            if  (   !Slave_Taking_Part
+                    ||
+                    (LIN_DIAG_NAD_UNASSIGNED != *p_slave_number)
+                    ||
+                    (ADDR_ASSIGN_LEN > request_len)
+                    ||
+                    (My_Serial != read_serial(&p_request[ADDR_ASSIGN_SERIAL_INDEX]))
+                )
+            {
+                return 0;
+            }
+
+            // Ignore numbers no master can have
+            if  (   (LOWEST_SLAVE_NUMBER > p_request[ADDR_ASSIGN_NAD_INDEX])
+                    ||
+                    (MAX_NUM_SLAVES < p_request[ADDR_ASSIGN_NAD_INDEX])
+                )
+            {
+                return 0;
+            }
+
+            // Take the number, and stop taking part
+            *p_slave_number = p_request[ADDR_ASSIGN_NAD_INDEX];
+            Slave_Taking_Part = false;
+            p_response[ADDR_RSP_RSID_INDEX] = LIN_DIAG_SID_ASSIGN_NAD+LIN_DIAG_RSID_OFFSET;
+            return ADDR_ASSIGN_RSP_LEN;
+
+        default:
+            break;
+    }
+
+    return 0;
+}
+
+// #############################################################################
+// ------------ PRIVATE FUNCTIONS
+// #############################################################################
+
+/****************************************************************************
+    Private Function
+        send_start
+
+    Parameters
+        uint8_t mode: LIN_DIAG_ADDR_MODE_NEW or LIN_DIAG_ADDR_MODE_ALL
+
+    Description
+        Broadcasts the start request, the slaves taking part draw serials
+
+****************************************************************************/
+static void send_start(uint8_t mode)
+{
+    uint8_t request[ADDR_START_LEN];
+
+    request[ADDR_SID_INDEX] = LIN_DIAG_SID_ADDR_START;
+    request[ADDR_START_MODE_INDEX] = mode;
+    Master_LIN_Diag_Send_Request(LIN_DIAG_NAD_BROADCAST, request, ADDR_START_LEN);
+    Addressing_State = addressing_starting;
+}
+
+/****************************************************************************
+    Private Function
+        send_query
+
+    Parameters
+        None
+
+    Description
+        Asks the slaves whose serial starts with the search prefix to answer
+
+****************************************************************************/
+static void send_query(void)
+{
+    uint8_t request[ADDR_QUERY_LEN];
+
+    request[ADDR_SID_INDEX] = LIN_DIAG_SID_ADDR_QUERY;
+    request[ADDR_QUERY_BITS_INDEX] = Search_Bits;
+    write_serial(&request[ADDR_QUERY_SERIAL_INDEX], Search_Prefix);
+    Master_LIN_Diag_Send_Request(LIN_DIAG_NAD_UNASSIGNED, request, ADDR_QUERY_LEN);
+    Addressing_State = addressing_querying;
+}
+
+/****************************************************************************
+    Private Function
+        send_assign
+
+    Parameters
+        None
+
+    Description
+        Gives the slave found its number
+
+****************************************************************************/
+static void send_assign(void)
+{
+    uint8_t request[ADDR_ASSIGN_LEN];
+
+    request[ADDR_SID_INDEX] = LIN_DIAG_SID_ASSIGN_NAD;
+    write_serial(&request[ADDR_ASSIGN_SERIAL_INDEX], Found_Serial);
+    request[ADDR_ASSIGN_NAD_INDEX] = GET_SLAVE_NAD(Found_Number);
+    Master_LIN_Diag_Send_Request(LIN_DIAG_NAD_UNASSIGNED, request, ADDR_ASSIGN_LEN);
+    Addressing_State = addressing_assigning;
+}
+
+/****************************************************************************
+    Private Function
+        split_search
+
+    Parameters
+        None
+
+    Description
+        Several slaves are under the search prefix, goes on with the lower
+        half of it. Slaves that collide with the whole serial searched have
+        the same serial, so the slaves without a number draw again and the
+        search starts over. Returns true if the pass is over.
+
+****************************************************************************/
+static bool split_search(void)
+{
+    if (SERIAL_BITS == Search_Bits)
+    {
+        if (0 == Redraws_Left)
+        {
+            return finish(addressing_duplicate_serials);
+        }
+        Redraws_Left--;
+        send_start(LIN_DIAG_ADDR_MODE_NEW);
+        return false;
+    }
+
+    // The new prefix bit is 0
+    Search_Bits++;
+    send_query();
+    return false;
+}
+
+/****************************************************************************
+    Private Function
+        next_search
+
+    Parameters
+        None
+
+    Description
+        Nobody is left under the search prefix, goes on with the upper half
+        of the longest prefix whose lower half was searched. Once all of
+        them are, asks everyone once more in case a slave missed its query.
+        Returns true if the pass is over.
+
+****************************************************************************/
+static bool next_search(void)
+{
+    bool was_top = (0 == Search_Bits);
+
+    while (0 != Search_Bits)
+    {
+        if (0 == (Search_Prefix & GET_PREFIX_BIT(Search_Bits)))
+        {
+            Search_Prefix |= GET_PREFIX_BIT(Search_Bits);
+            send_query();
+            return false;
+        }
+        Search_Prefix &= ~GET_PREFIX_BIT(Search_Bits);
+        Search_Bits--;
+    }
+
+    // Done once nobody answers from the top
+    if (was_top)
+    {
+        return finish(addressing_done);
+    }
+    send_query();
+    return false;
+}
+
+/****************************************************************************
+    Private Function
+        finish
+
+    Parameters
+        addressing_result_t result: how the pass ended
+
+    Description
+        Ends the pass and fills in the report. Returns true.
+
+****************************************************************************/
+static bool finish(addressing_result_t result)
+{
+    Addressing_State = addressing_idle;
+    Report.result = result;
+    Report.time_ms = (uint16_t) (Get_System_Time_MS()-Start_Time_MS);
+    return true;
+}
+
+/****************************************************************************
+    Private Function
+        get_free_number
+
+    Parameters
+        None
+
+    Description
+        Returns the lowest number the master has room for that isn't
+        taken, INVALID_SLAVE_NUMBER if there is none
+
+****************************************************************************/
+static uint8_t get_free_number(void)
+{
+    for (uint8_t slave_num = LOWEST_SLAVE_NUMBER; slave_num <= HIGHEST_SLAVE_NUMBER; slave_num++)
+    {
+        if (0 == (Taken_Bitmap & GET_NUMBER_BIT(slave_num)))
+        {
+            return slave_num;
+        }
+    }
+
+    return INVALID_SLAVE_NUMBER;
+}
+
+/****************************************************************************
+    Private Function
+        is_under_prefix
+
+    Parameters
+        uint32_t serial: serial to check
+        uint32_t prefix: prefix, only its first bits count
+        uint8_t bits: length of the prefix, 0 to SERIAL_BITS
+
+    Description
+        Returns true if the serial starts with the prefix
+
+****************************************************************************/
+static bool is_under_prefix(uint32_t serial, uint32_t prefix, uint8_t bits)
+{
+    // Everyone is under the empty prefix (and a shift by 32 is undefined)
+    if (0 == bits) return true;
+
+    return (0 == ((serial^prefix) & (UINT32_MAX<<(SERIAL_BITS-bits))));
+}
+
+/****************************************************************************
+    Private Function
+        draw_serial
+
+    Parameters
+        None
+
+    Description
+        Returns a new serial. The time since power up differs between
+        slaves (power up order, clock tolerance), mixing spreads those
+        differences over all the bits.
+
+****************************************************************************/
+static uint32_t draw_serial(void)
+{
+    uint32_t serial = Get_System_Time_US()^My_Serial;
+
+    // 32 bit finalizer of MurmurHash3
+    serial ^= serial>>16;
+    serial *= 0x85EBCA6BUL;
+    serial ^= serial>>13;
+    serial *= 0xC2B2AE35UL;
+    serial ^= serial>>16;
+
+    return serial;
+}
+
+/****************************************************************************
+    Private Function
+        read_serial
+
+    Parameters
+        uint8_t * p_source: serial in a PDU, MSB first
+
+    Description
+        Returns the serial
+
+****************************************************************************/
+static uint32_t read_serial(uint8_t * p_source)
+{
+    return (    ((uint32_t) p_source[0]<<24)
+                |
+                ((uint32_t) p_source[1]<<16)
+                |
+                ((uint32_t) p_source[2]<<8)
+                |
+                (uint32_t) p_source[3]
+           );
+}
+
+/****************************************************************************
+    Private Function
+        write_serial
+
+    Parameters
+        uint8_t * p_target: where in the PDU
+        uint32_t serial: serial to write, MSB first
+
+    Description
+        Writes the serial into a PDU
+
+****************************************************************************/
+static void write_serial(uint8_t * p_target, uint32_t serial)
+{
+    p_target[0] = (uint8_t) (serial>>24);
+    p_target[1] = (uint8_t) (serial>>16);
+    p_target[2] = (uint8_t) (serial>>8);
+    p_target[3] = (uint8_t) serial;
+}
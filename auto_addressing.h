@@ -0,0 +1,41 @@
+#ifndef AUTO_ADDRESSING_H
+#define AUTO_ADDRESSING_H
+
+// #############################################################################
+// ------------ TYPE DEFINITIONS
+// #############################################################################
+
+// How an auto-addressing pass ended
+typedef enum
+{
+    addressing_done = 0,            // Every slave found has a number
+    addressing_out_of_numbers,      // More slaves than the master has room for
+    addressing_duplicate_serials    // Slaves kept drawing the same serial
+} addressing_result_t;
+
+// Outcome of the last auto-addressing pass (master)
+typedef struct
+{
+    addressing_result_t result;
+    bool            renumbered;         // Every slave gave up its number
+    uint8_t         numbered;           // Slaves given a number
+    uint8_t         highest_number;     // Highest number given, 0 if none
+    uint16_t        time_ms;            // Start to end
+} addressing_report_t;
+
+// #############################################################################
+// ------------ PUBLIC FUNCTION PROTOTYPES
+// #############################################################################
+
+// Master
+bool Start_Auto_Addressing(uint8_t mode, uint32_t taken_bitmap);
+bool Auto_Addressing_In_Progress(void);
+bool Run_Auto_Addressing(void);
+void Get_Auto_Addressing_Report(addressing_report_t * p_report);
+
+// Slave
+bool Is_Addressing_Request(uint8_t * p_request);
+uint8_t Process_Addressing_Request(uint8_t * p_request, uint8_t request_len, uint8_t * p_response, \
+    uint8_t * p_slave_number);
+
+#endif // AUTO_ADDRESSING_H
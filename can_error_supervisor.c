@@ -0,0 +1,303 @@
+/*******************************************************************************
+    File:
+        can_error_supervisor.c
+
+    Notes:
+        This file contains the master's CAN error supervisor.
+
+        The error state comes from EFLG, both when the CAN service reads it
+        for an interrupt (ERRIF) and every CAN_ERROR_READ_MS with TEC and
+        REC. Going error passive and bus off are counted.
+
+        The MCP25625 leaves bus off by itself after 128 x 11 recessive bits.
+        If it's still bus off after the back-off time, it's reset and set up
+        again (CAN_Initialize_1() then, at the next check,
+        CAN_Initialize_2()). The back-off starts at CAN_BUS_OFF_BACKOFF_MS
+        and doubles on each reset, up to CAN_BUS_OFF_MAX_BACKOFF_MS. It
+        starts again from the shortest once the node has been on the bus
+        for CAN_BUS_OFF_MAX_BACKOFF_MS. Each read and reset step waits for
+        a check where the SPI command buffer has room for all its commands.
+
+        The reset empties the TX Buffers, so the transmit queue is stopped
+        with it: the frames in them complete as aborted and the waiting
+        ones are loaded after CAN_Initialize_2().
+
+    External Functions Required:
+        CAN_Read_Registers(), CAN_Initialize_1(), CAN_Initialize_2(),
+        Get_SPI_Free_Rows(), Stop_CAN_TX_Queue(), Start_CAN_TX_Queue(),
+        Get_System_Time_MS()
+
+    Public Functions:
+        void Init_CAN_Error_Supervisor(void)
+        void CAN_Error_Flags_Read(uint8_t eflg)
+        void Check_CAN_Errors(void)
+        void Get_CAN_Error_Stats(can_error_stats_t * p_stats)
+
+*******************************************************************************/
+
+// #############################################################################
+// ------------ INCLUDES
+// #############################################################################
+
+// Standard ANSI  99 C types for exact integer sizes and booleans
+#include <stdint.h>
+#include <stdbool.h>
+#include <string.h>
+
+// Config file
+#include "config.h"
+
+// Framework
+#include "framework.h"
+
+// This module's header file
+#include "can_error_supervisor.h"
+
+// Include other files below:
+
+// CAN driver
+#include "CAN.h"
+
+// MCP25625 registers
+#include "MCP25625defs.h"
+
+// CAN transmit queue
+#include "can_tx_queue.h"
+
+// System time
+#include "timer.h"
+
+// #############################################################################
+// ------------ MODULE DEFINITIONS
+// #############################################################################
+
+// Bytes read every CAN_ERROR_READ_MS, with two SPI commands
+#define READ_TEC_IDX            (0)
+#define READ_REC_IDX            (1)
+#define READ_EFLG_IDX           (2)
+#define READ_LEN                (3)
+#define READ_SPI_ROWS           (2)
+
+// EFLG bits of each state
+#define EFLG_PASSIVE            (MCP_EFLG_TXEP|MCP_EFLG_RXEP)
+
+// #############################################################################
+// ------------ MODULE VARIABLES
+// #############################################################################
+
+// Meters
+static can_error_stats_t Stats;
+
+// TEC, REC and EFLG, written from the SPI interrupt
+static uint8_t Read_Values[READ_LEN];
+static volatile bool Values_Read = false;
+
+// When TEC and REC were last read
+static uint32_t Last_Read_ms = 0;
+
+// Bus off recovery
+static uint32_t Bus_Off_Since_ms = 0;       // Bus off, or reset, since then
+static uint32_t On_Bus_Since_ms = 0;        // Left bus off since then
+static uint16_t Backoff_ms = CAN_BUS_OFF_BACKOFF_MS;
+static bool Reinit_Pending = false;         // CAN_Initialize_2() at next check
+
+// #############################################################################
+// ------------ PRIVATE FUNCTION PROTOTYPES
+// #############################################################################
+
+static void values_read(void);
+static void set_state(can_error_state_t new_state);
+
+// #############################################################################
+// ------------ PUBLIC FUNCTIONS
+// #############################################################################
+
+/****************************************************************************
+    Public Function
+        Init_CAN_Error_Supervisor
+
+    Parameters
+        None
+
+    Description
+        Starts error active and clears the meters
+
+****************************************************************************/
+void Init_CAN_Error_Supervisor(void)
+{
+    memset(&Stats, 0, sizeof(Stats));
+    Values_Read = false;
+    Last_Read_ms = Get_System_Time_MS();
+    On_Bus_Since_ms = Last_Read_ms;
+    Backoff_ms = CAN_BUS_OFF_BACKOFF_MS;
+    Reinit_Pending = false;
+}
+
+/****************************************************************************
+    Public Function
+        CAN_Error_Flags_Read
+
+    Parameters
+        uint8_t eflg: EFLG as read
+
+    Description
+        Updates the error state
+
+****************************************************************************/
+void CAN_Error_Flags_Read(uint8_t eflg)
+{
+    if (eflg & MCP_EFLG_TXBO)
+    {
+        set_state(can_bus_off);
+    }
+    else if (eflg & EFLG_PASSIVE)
+    {
+        set_state(can_error_passive);
+    }
+    else if (eflg & MCP_EFLG_EWARN)
+    {
+        set_state(can_error_warning);
+    }
+    else
+    {
+        set_state(can_error_active);
+    }
+}
+
+/****************************************************************************
+    Public Function
+        Check_CAN_Errors
+
+    Parameters
+        None
+
+    Description
+        Called periodically by the CAN service. Reads TEC, REC and EFLG and
+        resets the MCP25625 if it stays bus off.
+
+****************************************************************************/
+void Check_CAN_Errors(void)
+{
+    uint32_t now_ms = Get_System_Time_MS();
+
+    // Second step of a reset
+    if (Reinit_Pending)
+    {
+        if (CAN_INIT_2_SPI_ROWS <= Get_SPI_Free_Rows())
+        {
+            Reinit_Pending = false;
+            CAN_Initialize_2();
+            Start_CAN_TX_Queue();
+        }
+        return;
+    }
+
+    // Last read
+    if (Values_Read)
+    {
+        Values_Read = false;
+        Stats.tec = Read_Values[READ_TEC_IDX];
+        Stats.rec = Read_Values[READ_REC_IDX];
+        if (Stats.max_tec < Stats.tec) Stats.max_tec = Stats.tec;
+        if (Stats.max_rec < Stats.rec) Stats.max_rec = Stats.rec;
+        CAN_Error_Flags_Read(Read_Values[READ_EFLG_IDX]);
+    }
+
+    if (can_bus_off == Stats.state)
+    {
+        // Still bus off, reset it and wait twice as long next time
+        if ((Backoff_ms <= (now_ms - Bus_Off_Since_ms)) && (CAN_INIT_1_SPI_ROWS <= Get_SPI_Free_Rows()))
+        {
+            CAN_Initialize_1();
+            Stop_CAN_TX_Queue();
+            Reinit_Pending = true;
+            if (UINT16_MAX != Stats.reinit_count) Stats.reinit_count++;
+
+            Bus_Off_Since_ms = now_ms;
+            Backoff_ms = (CAN_BUS_OFF_MAX_BACKOFF_MS/2 < Backoff_ms) ? CAN_BUS_OFF_MAX_BACKOFF_MS : 2*Backoff_ms;
+            return;
+        }
+    }
+    else if (CAN_BUS_OFF_MAX_BACKOFF_MS <= (now_ms - On_Bus_Since_ms))
+    {
+        // On the bus long enough
+        Backoff_ms = CAN_BUS_OFF_BACKOFF_MS;
+    }
+
+    // Next read, the values are used at the check after it completes
+    if ((CAN_ERROR_READ_MS <= (now_ms - Last_Read_ms)) && (READ_SPI_ROWS <= Get_SPI_Free_Rows()))
+    {
+        Last_Read_ms = now_ms;
+        CAN_Read_Registers(MCP_TEC, 2, &Read_Values[READ_TEC_IDX], NULL);
+        CAN_Read_Registers(MCP_EFLG, 1, &Read_Values[READ_EFLG_IDX], values_read);
+    }
+}
+
+/****************************************************************************
+    Public Function
+        Get_CAN_Error_Stats
+
+    Parameters
+        can_error_stats_t * p_stats: where to copy the meters
+
+    Description
+        Copies the error state and meters
+
+****************************************************************************/
+void Get_CAN_Error_Stats(can_error_stats_t * p_stats)
+{
+    *p_stats = Stats;
+}
+
+// #############################################################################
+// ------------ PRIVATE FUNCTIONS
+// #############################################################################
+
+/****************************************************************************
+    Private Function
+        values_read
+
+    Parameters
+        None
+
+    Description
+        Called from the SPI interrupt once TEC, REC and EFLG are read
+
+****************************************************************************/
+static void values_read(void)
+{
+    Values_Read = true;
+}
+
+/****************************************************************************
+    Private Function
+        set_state
+
+    Parameters
+        can_error_state_t new_state
+
+    Description
+        Counts the transitions to error passive and bus off
+
+****************************************************************************/
+static void set_state(can_error_state_t new_state)
+{
+    if (new_state == Stats.state) return;
+
+    if (can_bus_off == new_state)
+    {
+        if (UINT16_MAX != Stats.bus_off_count) Stats.bus_off_count++;
+        Bus_Off_Since_ms = Get_System_Time_MS();
+    }
+    else if ((can_error_passive == new_state) && (can_error_passive > Stats.state))
+    {
+        if (UINT16_MAX != Stats.passive_count) Stats.passive_count++;
+    }
+
+    if (can_bus_off == Stats.state)
+    {
+        On_Bus_Since_ms = Get_System_Time_MS();
+    }
+
+    Stats.state = new_state;
+}
@@ -0,0 +1,39 @@
+#ifndef CAN_ERROR_SUPERVISOR_H
+#define CAN_ERROR_SUPERVISOR_H
+
+// #############################################################################
+// ------------ TYPE DEFINITIONS
+// #############################################################################
+
+// Error state of the MCP25625, from EFLG
+typedef enum
+{
+    can_error_active,
+    can_error_warning,                  // TEC or REC at 96 or more
+    can_error_passive,                  // TEC or REC at 128 or more
+    can_bus_off                         // TEC over 255
+} can_error_state_t;
+
+// Error supervisor meters (counters saturate)
+typedef struct
+{
+    uint8_t         state;              // can_error_state_t
+    uint8_t         tec;                // Transmit error counter, last read
+    uint8_t         rec;                // Receive error counter, last read
+    uint8_t         max_tec;            // Highest TEC read
+    uint8_t         max_rec;            // Highest REC read
+    uint16_t        passive_count;      // Times the node went error passive
+    uint16_t        bus_off_count;      // Times the node went bus off
+    uint16_t        reinit_count;       // Times the MCP25625 was reset to recover
+} can_error_stats_t;
+
+// #############################################################################
+// ------------ PUBLIC FUNCTION PROTOTYPES
+// #############################################################################
+
+void Init_CAN_Error_Supervisor(void);
+void CAN_Error_Flags_Read(uint8_t eflg);
+void Check_CAN_Errors(void);
+void Get_CAN_Error_Stats(can_error_stats_t * p_stats);
+
+#endif // CAN_ERROR_SUPERVISOR_H
@@ -0,0 +1,243 @@
+/*******************************************************************************
+    File:
+        can_rx_fifo.c
+
+    Notes:
+        This file contains the master's receive FIFO for CAN frames.
+
+        The CAN driver puts each frame in the FIFO when the SPI command that
+        read it from the MCP25625 completes (interrupt context), the master
+        service takes them out in order. A frame that arrives while the FIFO
+        is full is dropped and counted, never written over a waiting one.
+
+        EVT_CAN_FRAME_RECEIVED is posted for every frame put in the FIFO.
+
+    External Functions Required:
+        Get_System_Time_MS(), Post_Event()
+
+    Public Functions:
+        void Init_CAN_RX_FIFO(void)
+        void Put_CAN_RX_Frame(const uint8_t * p_raw_frame)
+        bool Get_CAN_RX_Frame(can_frame_t * p_frame)
+        uint8_t Get_CAN_RX_Count(void)
+        void Get_CAN_RX_Stats(can_rx_stats_t * p_stats)
+        void Count_CAN_RX_HW_Overflow(void)
+
+*******************************************************************************/
+
+// #############################################################################
+// ------------ INCLUDES
+// #############################################################################
+
+// Standard ANSI  99 C types for exact integer sizes and booleans
+#include <stdint.h>
+#include <stdbool.h>
+#include <string.h>
+
+// Config file
+#include "config.h"
+
+// Framework
+#include "framework.h"
+
+// This module's header file
+#include "can_rx_fifo.h"
+
+// Include other files below:
+
+// Frame layout
+#include "CAN.h"
+
+// MCP25625 register bits
+#include "MCP25625defs.h"
+
+// System time
+#include "timer.h"
+
+// Atomic Read/Write operations
+#include <util/atomic.h>
+
+// #############################################################################
+// ------------ MODULE DEFINITIONS
+// #############################################################################
+
+// Bits of the raw frame
+#define RAW_SIDL_SID_SHIFT      (5)
+#define RAW_SIDL_EID_MASK       (0x03)
+#define RAW_DLC_MASK            (0x0F)
+#define CAN_MAX_DLC             (8)
+
+// #############################################################################
+// ------------ MODULE VARIABLES
+// #############################################################################
+
+// The frames, oldest at Head_Index
+static can_frame_t Frames[CAN_RX_FIFO_DEPTH];
+static uint8_t Head_Index = 0;
+static uint8_t Frame_Count = 0;
+
+// Meters
+static can_rx_stats_t Stats;
+
+// #############################################################################
+// ------------ PUBLIC FUNCTIONS
+// #############################################################################
+
+/****************************************************************************
+    Public Function
+        Init_CAN_RX_FIFO
+
+    Parameters
+        None
+
+    Description
+        Empties the FIFO and clears its meters
+
+****************************************************************************/
+void Init_CAN_RX_FIFO(void)
+{
+    ATOMIC_BLOCK(ATOMIC_RESTORESTATE)
+    {
+        Head_Index = 0;
+        Frame_Count = 0;
+        memset(&Stats, 0, sizeof(Stats));
+    }
+}
+
+/****************************************************************************
+    Public Function
+        Put_CAN_RX_Frame
+
+    Parameters
+        const uint8_t * p_raw_frame: CAN_FRAME_LEN bytes, as read with READ
+            RX BUFFER (RXBnSIDH to RXBnD7)
+
+    Description
+        Decodes a received frame and puts it at the back of the FIFO.
+        Called from interrupt context.
+
+****************************************************************************/
+void Put_CAN_RX_Frame(const uint8_t * p_raw_frame)
+{
+    can_frame_t * p_frame;
+    uint8_t sidl = p_raw_frame[CAN_FRAME_SIDL_IDX];
+
+    ATOMIC_BLOCK(ATOMIC_RESTORESTATE)
+    {
+        // Full, drop the new frame
+        if (CAN_RX_FIFO_DEPTH <= Frame_Count)
+        {
+            if (UINT16_MAX != Stats.overflows) Stats.overflows++;
+        }
+        else
+        {
+            p_frame = &Frames[(Head_Index+Frame_Count) % CAN_RX_FIFO_DEPTH];
+
+            // Standard identifier, extended with the 18 more bits if IDE is set
+            p_frame->id = ((uint32_t) p_raw_frame[CAN_FRAME_SIDH_IDX] << 3) | (sidl >> RAW_SIDL_SID_SHIFT);
+            p_frame->extended = (0 != (sidl & MCP_RXB_IDE_M));
+            if (p_frame->extended)
+            {
+                p_frame->id = (p_frame->id << 18)
+                                | ((uint32_t) (sidl & RAW_SIDL_EID_MASK) << 16)
+                                | ((uint16_t) p_raw_frame[CAN_FRAME_EID8_IDX] << 8)
+                                | p_raw_frame[CAN_FRAME_EID0_IDX];
+            }
+
+            p_frame->dlc = p_raw_frame[CAN_FRAME_DLC_IDX] & RAW_DLC_MASK;
+            if (CAN_MAX_DLC < p_frame->dlc) p_frame->dlc = CAN_MAX_DLC;
+            memcpy(p_frame->data, &p_raw_frame[CAN_FRAME_DATA_IDX], CAN_MAX_DLC);
+            p_frame->time_ms = Get_System_Time_MS();
+
+            Frame_Count++;
+            if (UINT16_MAX != Stats.received) Stats.received++;
+            if (Stats.max_fill < Frame_Count) Stats.max_fill = Frame_Count;
+
+            // Tell the master now rather than at its next poll
+            Post_Event(EVT_CAN_FRAME_RECEIVED);
+        }
+    }
+}
+
+/****************************************************************************
+    Public Function
+        Get_CAN_RX_Frame
+
+    Parameters
+        can_frame_t * p_frame: where to copy the frame
+
+    Description
+        Takes the oldest frame out of the FIFO. Returns false if it's empty.
+
+****************************************************************************/
+bool Get_CAN_RX_Frame(can_frame_t * p_frame)
+{
+    bool got_frame = false;
+
+    ATOMIC_BLOCK(ATOMIC_RESTORESTATE)
+    {
+        if (0 != Frame_Count)
+        {
+            *p_frame = Frames[Head_Index];
+            Head_Index = (Head_Index+1) % CAN_RX_FIFO_DEPTH;
+            Frame_Count--;
+            got_frame = true;
+        }
+    }
+
+    return got_frame;
+}
+
+/****************************************************************************
+    Public Function
+        Get_CAN_RX_Count
+
+    Parameters
+        None
+
+    Description
+        Returns the number of frames waiting
+
+****************************************************************************/
+uint8_t Get_CAN_RX_Count(void)
+{
+    return Frame_Count;
+}
+
+/****************************************************************************
+    Public Function
+        Get_CAN_RX_Stats
+
+    Parameters
+        can_rx_stats_t * p_stats: where to copy the meters
+
+    Description
+        Copies the FIFO meters
+
+****************************************************************************/
+void Get_CAN_RX_Stats(can_rx_stats_t * p_stats)
+{
+    ATOMIC_BLOCK(ATOMIC_RESTORESTATE)
+    {
+        *p_stats = Stats;
+    }
+}
+
+/****************************************************************************
+    Public Function
+        Count_CAN_RX_HW_Overflow
+
+    Parameters
+        None
+
+    Description
+        Counts a frame the MCP25625 lost, its receive buffers were full
+
+****************************************************************************/
+void Count_CAN_RX_HW_Overflow(void)
+{
+    ATOMIC_BLOCK(ATOMIC_RESTORESTATE)
+    {
+        if (UINT16_MAX != Stats.hw_overflows) Stats.hw_overflows++;
+    }
+}
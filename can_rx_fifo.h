@@ -0,0 +1,38 @@
+#ifndef CAN_RX_FIFO_H
+#define CAN_RX_FIFO_H
+
+// #############################################################################
+// ------------ TYPE DEFINITIONS
+// #############################################################################
+
+// A received CAN frame
+typedef struct
+{
+    uint32_t        id;                 // 11 bit, or 29 bit if extended
+    bool            extended;
+    uint8_t         dlc;                // Data bytes (0 to 8)
+    uint8_t         data[8];
+    uint32_t        time_ms;            // When the frame was read
+} can_frame_t;
+
+// Receive FIFO meters (counters saturate)
+typedef struct
+{
+    uint16_t        received;           // Frames put in the FIFO
+    uint16_t        overflows;          // Frames dropped, the FIFO was full
+    uint8_t         max_fill;           // Most frames ever waiting
+    uint16_t        hw_overflows;       // Frames lost in the MCP25625
+} can_rx_stats_t;
+
+// #############################################################################
+// ------------ PUBLIC FUNCTION PROTOTYPES
+// #############################################################################
+
+void Init_CAN_RX_FIFO(void);
+void Put_CAN_RX_Frame(const uint8_t * p_raw_frame);
+bool Get_CAN_RX_Frame(can_frame_t * p_frame);
+uint8_t Get_CAN_RX_Count(void);
+void Get_CAN_RX_Stats(can_rx_stats_t * p_stats);
+void Count_CAN_RX_HW_Overflow(void);
+
+#endif // CAN_RX_FIFO_H
@@ -0,0 +1,423 @@
+/*******************************************************************************
+    File:
+        can_tx_queue.c
+
+    Notes:
+        This file contains the master's transmit queue for CAN frames.
+
+        Put_CAN_TX_Frame() never waits: the frame goes to a free TX Buffer
+        of the MCP25625 at once, or waits in the queue until one is free.
+        Waiting frames are loaded highest priority first, then oldest first.
+
+        The CAN service tells the queue which TX Buffers sent their frame
+        (TXnIF), and checks it periodically for frames that are stuck in
+        a TX Buffer (no ACK, error passive or bus off). A frame not sent
+        CAN_TX_TIMEOUT_MS after it was loaded is aborted, however long it
+        waited in the queue before. Its TX Buffer is only reused at the
+        next check, as a frame already on the bus still completes.
+
+        Each frame's callback, if any, is called from the main loop once it
+        is sent or aborted. A frame refused because the queue is full gets
+        no callback, Put_CAN_TX_Frame() returns false.
+
+        While the error supervisor resets the MCP25625 the queue is stopped:
+        the frames in the TX Buffers are lost with the reset and complete
+        as aborted, and the waiting frames are only loaded once the
+        MCP25625 is set up again.
+
+    External Functions Required:
+        CAN_Send_Message(), CAN_Abort_TX(), CAN_TX_Done(),
+        Get_System_Time_MS()
+
+    Public Functions:
+        void Init_CAN_TX_Queue(void)
+        bool Put_CAN_TX_Frame(uint8_t priority, uint8_t dlc,
+            const uint8_t * p_data, can_tx_done_cb_t p_done_cb)
+        void CAN_TX_Queue_Sent(uint8_t tx_flags)
+        void Check_CAN_TX_Timeouts(void)
+        void Stop_CAN_TX_Queue(void)
+        void Start_CAN_TX_Queue(void)
+        uint8_t Get_CAN_TX_Count(void)
+        void Get_CAN_TX_Stats(can_tx_stats_t * p_stats)
+
+*******************************************************************************/
+
+// #############################################################################
+// ------------ INCLUDES
+// #############################################################################
+
+// Standard ANSI  99 C types for exact integer sizes and booleans
+#include <stdint.h>
+#include <stdbool.h>
+#include <string.h>
+
+// Config file
+#include "config.h"
+
+// Framework
+#include "framework.h"
+
+// This module's header file
+#include "can_tx_queue.h"
+
+// Include other files below:
+
+// CAN driver
+#include "CAN.h"
+
+// MCP25625 definitions
+#include "MCP25625defs.h"
+
+// System time
+#include "timer.h"
+
+// #############################################################################
+// ------------ MODULE DEFINITIONS
+// #############################################################################
+
+#define CAN_MAX_DLC             (8)
+
+// #############################################################################
+// ------------ TYPE DEFINITIONS
+// #############################################################################
+
+// A frame waiting for a TX Buffer
+typedef struct
+{
+    uint8_t             priority;
+    uint8_t             dlc;
+    uint8_t             data[CAN_MAX_DLC];
+    can_tx_done_cb_t    p_done_cb;
+    uint32_t            time_ms;        // When the frame was queued
+} tx_entry_t;
+
+// What a TX Buffer holds
+typedef enum
+{
+    tx_buffer_free,
+    tx_buffer_pending,                  // Loaded, TXREQ set
+    tx_buffer_aborting                  // TXREQ cleared, waiting one check
+} tx_buffer_state_t;
+
+typedef struct
+{
+    tx_buffer_state_t   state;
+    can_tx_done_cb_t    p_done_cb;
+    uint32_t            time_ms;        // When the frame was loaded
+    uint32_t            queued_ms;      // When the frame was queued
+} tx_buffer_t;
+
+// #############################################################################
+// ------------ MODULE VARIABLES
+// #############################################################################
+
+// The waiting frames, in the order they were queued
+static tx_entry_t Frames[CAN_TX_QUEUE_DEPTH];
+static uint8_t Frame_Count = 0;
+
+// The frames in the TX Buffers
+static tx_buffer_t Buffers[MCP_N_TXBUFFERS];
+
+// No frame is loaded while the MCP25625 is reset
+static bool Stopped = false;
+
+// Meters
+static can_tx_stats_t Stats;
+
+// #############################################################################
+// ------------ PRIVATE FUNCTION PROTOTYPES
+// #############################################################################
+
+static void load_waiting_frames(void);
+static void finish_frame(uint8_t buffer, bool sent);
+
+// #############################################################################
+// ------------ PUBLIC FUNCTIONS
+// #############################################################################
+
+/****************************************************************************
+    Public Function
+        Init_CAN_TX_Queue
+
+    Parameters
+        None
+
+    Description
+        Empties the queue and clears its meters
+
+****************************************************************************/
+void Init_CAN_TX_Queue(void)
+{
+    Frame_Count = 0;
+    Stopped = false;
+    memset(Buffers, 0, sizeof(Buffers));
+    memset(&Stats, 0, sizeof(Stats));
+}
+
+/****************************************************************************
+    Public Function
+        Put_CAN_TX_Frame
+
+    Parameters
+        uint8_t priority: transmit priority (0 lowest to 3 highest)
+        uint8_t dlc: number of bytes (0 to 8)
+        const uint8_t * p_data: message bytes, copied
+        can_tx_done_cb_t p_done_cb: called once the frame is sent or
+            aborted, or NULL
+
+    Description
+        Queues a frame to send with the master's identifier. Returns false,
+        and the frame is dropped, if the queue is full.
+
+****************************************************************************/
+bool Put_CAN_TX_Frame(uint8_t priority, uint8_t dlc, const uint8_t * p_data, can_tx_done_cb_t p_done_cb)
+{
+    tx_entry_t * p_entry;
+
+    if (CAN_MAX_DLC < dlc) return false;
+
+    // Full, drop the new frame
+    if (CAN_TX_QUEUE_DEPTH <= Frame_Count)
+    {
+        if (UINT16_MAX != Stats.dropped) Stats.dropped++;
+        return false;
+    }
+
+    p_entry = &Frames[Frame_Count];
+    p_entry->priority = priority;
+    p_entry->dlc = dlc;
+    memcpy(p_entry->data, p_data, dlc);
+    p_entry->p_done_cb = p_done_cb;
+    p_entry->time_ms = Get_System_Time_MS();
+
+    Frame_Count++;
+    if (UINT16_MAX != Stats.queued) Stats.queued++;
+    if (Stats.max_fill < Frame_Count) Stats.max_fill = Frame_Count;
+
+    // Straight to a TX Buffer if one is free
+    load_waiting_frames();
+
+    return true;
+}
+
+/****************************************************************************
+    Public Function
+        CAN_TX_Queue_Sent
+
+    Parameters
+        uint8_t tx_flags: CANINTF as read
+
+    Description
+        Completes the frames of the TX Buffers whose TXnIF is set and loads
+        the waiting frames into them
+
+****************************************************************************/
+void CAN_TX_Queue_Sent(uint8_t tx_flags)
+{
+    for (uint8_t buffer = 0; buffer < MCP_N_TXBUFFERS; buffer++)
+    {
+        if ((tx_flags & CAN_TX_BUFFER_IF(buffer)) && (tx_buffer_free != Buffers[buffer].state))
+        {
+            finish_frame(buffer, true);
+        }
+    }
+
+    // The driver frees the TX Buffers too
+    CAN_TX_Done(tx_flags);
+
+    load_waiting_frames();
+}
+
+/****************************************************************************
+    Public Function
+        Check_CAN_TX_Timeouts
+
+    Parameters
+        None
+
+    Description
+        Aborts the frames not sent CAN_TX_TIMEOUT_MS after they were loaded
+        into a TX Buffer, and frees the TX Buffers aborted at the previous
+        check
+
+****************************************************************************/
+void Check_CAN_TX_Timeouts(void)
+{
+    uint32_t now_ms = Get_System_Time_MS();
+
+    for (uint8_t buffer = 0; buffer < MCP_N_TXBUFFERS; buffer++)
+    {
+        if (tx_buffer_aborting == Buffers[buffer].state)
+        {
+            // Not sent after all
+            if (UINT16_MAX != Stats.timeouts) Stats.timeouts++;
+            CAN_TX_Done(CAN_TX_BUFFER_IF(buffer));
+            finish_frame(buffer, false);
+        }
+        else if ((tx_buffer_pending == Buffers[buffer].state)
+                && (CAN_TX_TIMEOUT_MS <= (now_ms - Buffers[buffer].time_ms)))
+        {
+            // Tried again at the next check if the abort doesn't fit the
+            //  SPI command buffer
+            if (CAN_Abort_TX(buffer)) Buffers[buffer].state = tx_buffer_aborting;
+        }
+    }
+
+    load_waiting_frames();
+}
+
+/****************************************************************************
+    Public Function
+        Stop_CAN_TX_Queue
+
+    Parameters
+        None
+
+    Description
+        Called once the MCP25625 reset is queued. Completes the frames in
+        the TX Buffers as aborted, frees the TX Buffers and keeps the
+        waiting frames until Start_CAN_TX_Queue()
+
+****************************************************************************/
+void Stop_CAN_TX_Queue(void)
+{
+    Stopped = true;
+
+    for (uint8_t buffer = 0; buffer < MCP_N_TXBUFFERS; buffer++)
+    {
+        if (tx_buffer_free != Buffers[buffer].state)
+        {
+            finish_frame(buffer, false);
+        }
+    }
+
+    // The driver frees the TX Buffers too
+    CAN_TX_Done(CAN_TX_BUFFER_IF(0)|CAN_TX_BUFFER_IF(1)|CAN_TX_BUFFER_IF(2));
+}
+
+/****************************************************************************
+    Public Function
+        Start_CAN_TX_Queue
+
+    Parameters
+        None
+
+    Description
+        Called once the MCP25625 set up is queued after a reset, loads the
+        waiting frames
+
+****************************************************************************/
+void Start_CAN_TX_Queue(void)
+{
+    Stopped = false;
+    load_waiting_frames();
+}
+
+/****************************************************************************
+    Public Function
+        Get_CAN_TX_Count
+
+    Parameters
+        None
+
+    Description
+        Returns the number of frames waiting for a TX Buffer
+
+****************************************************************************/
+uint8_t Get_CAN_TX_Count(void)
+{
+    return Frame_Count;
+}
+
+/****************************************************************************
+    Public Function
+        Get_CAN_TX_Stats
+
+    Parameters
+        can_tx_stats_t * p_stats: where to copy the meters
+
+    Description
+        Copies the queue meters
+
+****************************************************************************/
+void Get_CAN_TX_Stats(can_tx_stats_t * p_stats)
+{
+    *p_stats = Stats;
+}
+
+// #############################################################################
+// ------------ PRIVATE FUNCTIONS
+// #############################################################################
+
+/****************************************************************************
+    Private Function
+        load_waiting_frames
+
+    Parameters
+        None
+
+    Description
+        Loads waiting frames into the free TX Buffers, highest priority
+        first. Stops when CAN_Send_Message() has no TX Buffer or no room in
+        the SPI command buffer for the next one.
+
+****************************************************************************/
+static void load_waiting_frames(void)
+{
+    uint8_t next;
+    uint8_t buffer;
+
+    while (!Stopped && (0 != Frame_Count))
+    {
+        // Highest priority, the oldest of those on a tie
+        next = 0;
+        for (uint8_t index = 1; index < Frame_Count; index++)
+        {
+            if (Frames[next].priority < Frames[index].priority) next = index;
+        }
+
+        buffer = CAN_Send_Message(Frames[next].priority, Frames[next].dlc, Frames[next].data);
+        if (CAN_TX_NO_BUFFER == buffer) return;
+
+        Buffers[buffer].state = tx_buffer_pending;
+        Buffers[buffer].p_done_cb = Frames[next].p_done_cb;
+        Buffers[buffer].time_ms = Get_System_Time_MS();
+        Buffers[buffer].queued_ms = Frames[next].time_ms;
+
+        // Close the gap, the order of the others is kept
+        Frame_Count--;
+        memmove(&Frames[next], &Frames[next+1], (Frame_Count-next)*sizeof(tx_entry_t));
+    }
+}
+
+/****************************************************************************
+    Private Function
+        finish_frame
+
+    Parameters
+        uint8_t buffer: TX Buffer the frame was in
+        bool sent: false if it was aborted
+
+    Description
+        Meters a frame that left its TX Buffer and calls its callback
+
+****************************************************************************/
+static void finish_frame(uint8_t buffer, bool sent)
+{
+    uint32_t send_ms;
+    can_tx_done_cb_t p_done_cb = Buffers[buffer].p_done_cb;
+
+    if (sent)
+    {
+        send_ms = Get_System_Time_MS() - Buffers[buffer].queued_ms;
+        if (UINT16_MAX < send_ms) send_ms = UINT16_MAX;
+        Stats.last_send_ms = send_ms;
+        if (Stats.max_send_ms < send_ms) Stats.max_send_ms = send_ms;
+        if (UINT16_MAX != Stats.sent) Stats.sent++;
+    }
+
+    Buffers[buffer].state = tx_buffer_free;
+    Buffers[buffer].p_done_cb = NULL;
+
+    if (NULL != p_done_cb) p_done_cb(sent);
+}
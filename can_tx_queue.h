@@ -0,0 +1,38 @@
+#ifndef CAN_TX_QUEUE_H
+#define CAN_TX_QUEUE_H
+
+// #############################################################################
+// ------------ TYPE DEFINITIONS
+// #############################################################################
+
+// Called from the main loop once a queued frame is sent (true), or aborted
+//  because it wasn't sent CAN_TX_TIMEOUT_MS after it was loaded into a TX
+//  Buffer (false)
+typedef void (*can_tx_done_cb_t) (bool sent);
+
+// Transmit queue meters (counters saturate)
+typedef struct
+{
+    uint16_t        queued;             // Frames put in the queue
+    uint16_t        sent;               // Frames sent
+    uint16_t        dropped;            // Frames refused, the queue was full
+    uint16_t        timeouts;           // Frames aborted, not sent in time
+    uint8_t         max_fill;           // Most frames ever waiting
+    uint16_t        max_send_ms;        // Longest time from queued to sent
+    uint16_t        last_send_ms;       // Time from queued to sent, last frame
+} can_tx_stats_t;
+
+// #############################################################################
+// ------------ PUBLIC FUNCTION PROTOTYPES
+// #############################################################################
+
+void Init_CAN_TX_Queue(void);
+bool Put_CAN_TX_Frame(uint8_t priority, uint8_t dlc, const uint8_t * p_data, can_tx_done_cb_t p_done_cb);
+void CAN_TX_Queue_Sent(uint8_t tx_flags);
+void Check_CAN_TX_Timeouts(void);
+void Stop_CAN_TX_Queue(void);
+void Start_CAN_TX_Queue(void);
+uint8_t Get_CAN_TX_Count(void);
+void Get_CAN_TX_Stats(can_tx_stats_t * p_stats);
+
+#endif // CAN_TX_QUEUE_H
@@ -36,6 +36,9 @@
 // string for memset, memcpy, memcpr
 #include <string.h>
 
+// Atomic Read/Write operations
+#include <util/atomic.h>
+
 // #############################################################################
 // ------------ MODULE DEFINITIONS
 // #############################################################################
@@ -94,6 +97,22 @@ position_data_t Get_Position_Data(uint8_t * p_LIN_packet)
     return result;
 }
 
+/****************************************************************************
+    Public Function
+        Get_Sequence_Data
+
+    Parameters
+        None
+
+    Description
+        This returns an instance of the sequence number in a LIN-sized packet
+
+****************************************************************************/
+sequence_data_t Get_Sequence_Data(uint8_t * p_LIN_packet)
+{
+    return *(p_LIN_packet+SEQUENCE_DATA_INDEX);
+}
+
 /****************************************************************************
     Public Function
         Write_Intensity_Data
@@ -128,6 +147,23 @@ void Write_Position_Data(uint8_t * p_LIN_packet, position_data_t data_to_write)
     memcpy(p_LIN_packet+POSITION_DATA_INDEX, &temp, POSITION_DATA_LEN);
 }
 
+/****************************************************************************
+    Public Function
+        Write_Sequence_Data
+
+    Parameters
+        None
+
+    Description
+        This writes the sequence number to the correct location in the
+        LIN-sized packet
+
+****************************************************************************/
+void Write_Sequence_Data(uint8_t * p_LIN_packet, sequence_data_t data_to_write)
+{
+    *(p_LIN_packet+SEQUENCE_DATA_INDEX) = data_to_write;
+}
+
 /****************************************************************************
     Public Function
         Get_Pointer_To_Slave_Data
@@ -146,6 +182,165 @@ uint8_t * Get_Pointer_To_Slave_Data(uint8_t * p_master_array, uint8_t slave_num)
     return (p_master_array+((slave_num-LOWEST_SLAVE_NUMBER)*LIN_PACKET_LEN));
 }
 
+/****************************************************************************
+    Public Function
+        Init_Data_Store
+
+    Parameters
+        data_store_t * p_store: store to initialize
+        uint8_t * p_buffer_a: first buffer, its contents become the live data
+        uint8_t * p_buffer_b: second buffer, NULL for a single buffered store
+        uint8_t len: length of each buffer
+
+    Description
+        Sets up a double buffered store, both buffers start out equal. A
+        single buffered store is both the live and the shadow buffer.
+
+****************************************************************************/
+void Init_Data_Store(data_store_t * p_store, uint8_t * p_buffer_a, uint8_t * p_buffer_b, uint8_t len)
+{
+    p_store->p_live = p_buffer_a;
+    p_store->p_shadow = (NULL == p_buffer_b) ? p_buffer_a : p_buffer_b;
+    p_store->len = len;
+    p_store->dirty = 0;
+    if (NULL != p_buffer_b) memcpy(p_buffer_b, p_buffer_a, len);
+}
+
+/****************************************************************************
+    Public Function
+        Get_Shadow_Slot
+
+    Parameters
+        data_store_t * p_store: store to write
+        uint8_t slot: packet to write (0 for the first)
+
+    Description
+        Returns a packet of the buffer the writer fills, and marks it as
+        written. Only the writer may use it, and the pointer changes on
+        every commit.
+
+****************************************************************************/
+uint8_t * Get_Shadow_Slot(data_store_t * p_store, uint8_t slot)
+{
+    p_store->dirty |= (1UL<<slot);
+    return (p_store->p_shadow+(slot*LIN_PACKET_LEN));
+}
+
+/****************************************************************************
+    Public Function
+        Write_Data_Slot
+
+    Parameters
+        data_store_t * p_store: store to write
+        uint8_t slot: packet to write (0 for the first)
+        uint8_t * p_packet: the LIN_PACKET_LEN bytes to write
+
+    Description
+        Writes a whole packet to the shadow buffer, at once so a reader
+        of a single buffered store never sees half of it
+
+****************************************************************************/
+void Write_Data_Slot(data_store_t * p_store, uint8_t slot, uint8_t * p_packet)
+{
+    ATOMIC_BLOCK(ATOMIC_RESTORESTATE)
+    {
+        memcpy(Get_Shadow_Slot(p_store, slot), p_packet, LIN_PACKET_LEN);
+    }
+}
+
+/****************************************************************************
+    Public Function
+        Get_Live_Data
+
+    Parameters
+        data_store_t * p_store: store to read
+
+    Description
+        Returns the buffer the reader uses. If the writer can interrupt the
+        reader (it commits from an ISR), use Read_Live_Data() instead.
+
+****************************************************************************/
+uint8_t * Get_Live_Data(data_store_t * p_store)
+{
+    uint8_t * result;
+
+    // The pointer is two bytes, so read it atomically
+    ATOMIC_BLOCK(ATOMIC_RESTORESTATE)
+    {
+        result = p_store->p_live;
+    }
+
+    return result;
+}
+
+/****************************************************************************
+    Public Function
+        Read_Live_Data
+
+    Parameters
+        data_store_t * p_store: store to read
+        uint8_t offset: first byte to read
+        uint8_t * p_dest: where to copy the data
+        uint8_t len: number of bytes to copy
+
+    Description
+        Copies part of the live buffer, so a commit from an ISR can't
+        change it halfway through
+
+****************************************************************************/
+void Read_Live_Data(data_store_t * p_store, uint8_t offset, uint8_t * p_dest, uint8_t len)
+{
+    ATOMIC_BLOCK(ATOMIC_RESTORESTATE)
+    {
+        memcpy(p_dest, p_store->p_live+offset, len);
+    }
+}
+
+/****************************************************************************
+    Public Function
+        Commit_Data_Store
+
+    Parameters
+        data_store_t * p_store: store to commit
+
+    Description
+        Publishes everything written to the shadow buffer by swapping the
+        buffers, then brings the new shadow buffer up to date so the writer
+        can keep making partial updates. The two buffers only differ in the
+        slots written since the last commit, so only those are copied: a
+        commit costs the swap plus LIN_PACKET_LEN bytes per written slot,
+        up to the highest one. A single buffered store has nothing to swap.
+
+****************************************************************************/
+void Commit_Data_Store(data_store_t * p_store)
+{
+    uint8_t * p_temp;
+    uint32_t dirty = p_store->dirty;
+    uint8_t offset = 0;
+
+    p_store->dirty = 0;
+    if (p_store->p_live == p_store->p_shadow) return;
+
+    // Swap the pointers, this is all the reader can see
+    ATOMIC_BLOCK(ATOMIC_RESTORESTATE)
+    {
+        p_temp = p_store->p_live;
+        p_store->p_live = p_store->p_shadow;
+        p_store->p_shadow = p_temp;
+    }
+
+    // The reader no longer uses the old live buffer, update what changed
+    while (dirty)
+    {
+        if (dirty & 1)
+        {
+            memcpy(p_store->p_shadow+offset, p_store->p_live+offset, LIN_PACKET_LEN);
+        }
+        dirty >>= 1;
+        offset += LIN_PACKET_LEN;
+    }
+}
+
 // #############################################################################
 // ------------ PRIVATE FUNCTIONS
 // #############################################################################
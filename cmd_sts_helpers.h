@@ -1,6 +1,26 @@
 #ifndef cmd_sts_helpers_H
 #define cmd_sts_helpers_H
 
+// #############################################################################
+// ------------ TYPE DEFINITIONS
+// #############################################################################
+
+// Double buffered command/status store
+// One side (the writer) fills the shadow buffer and commits it, which swaps
+//  the shadow and live buffers. The other side (the reader) only ever sees
+//  the live buffer, so it never sees a half written update.
+// The buffers are made of LIN_PACKET_LEN slots, and the store remembers
+//  which ones the writer took since the last commit.
+// A store can also have a single buffer, written in place one whole slot
+//  at a time (Write_Data_Slot()), when it is too big to keep twice.
+typedef struct
+{
+    uint8_t *       p_live;         // Buffer the reader uses
+    uint8_t *       p_shadow;       // Buffer the writer fills
+    uint8_t         len;            // Length of each buffer
+    uint32_t        dirty;          // Bit n set if slot n was written
+} data_store_t;
+
 // #############################################################################
 // ------------ PUBLIC FUNCTION PROTOTYPES
 // #############################################################################
@@ -8,11 +28,21 @@
 // These functions expect pointers to data arrays that are LIN_PACKET_LEN long
 intensity_data_t Get_Intensity_Data(uint8_t * p_LIN_packet);
 position_data_t Get_Position_Data(uint8_t * p_LIN_packet);
+sequence_data_t Get_Sequence_Data(uint8_t * p_LIN_packet);
 
 void Write_Intensity_Data(uint8_t * p_LIN_packet, intensity_data_t data_to_write);
 void Write_Position_Data(uint8_t * p_LIN_packet, position_data_t data_to_write);
+void Write_Sequence_Data(uint8_t * p_LIN_packet, sequence_data_t data_to_write);
 
 // For Master Node Only!
 uint8_t * Get_Pointer_To_Slave_Data(uint8_t * p_master_array, uint8_t slave_num);
 
+// Double buffered stores
+void Init_Data_Store(data_store_t * p_store, uint8_t * p_buffer_a, uint8_t * p_buffer_b, uint8_t len);
+uint8_t * Get_Shadow_Slot(data_store_t * p_store, uint8_t slot);
+void Write_Data_Slot(data_store_t * p_store, uint8_t slot, uint8_t * p_packet);
+uint8_t * Get_Live_Data(data_store_t * p_store);
+void Read_Live_Data(data_store_t * p_store, uint8_t offset, uint8_t * p_dest, uint8_t len);
+void Commit_Data_Store(data_store_t * p_store);
+
 #endif // cmd_sts_helpers_H
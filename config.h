@@ -19,13 +19,36 @@
 // ------------ SYSTEM SETTINGS
 // #############################################################################
 
+// The system and node settings can be overridden from the command line
+//      (the host simulator in sim/ builds both node types from one tree)
+
+// Number of slaves the master has room for, up to MAX_NUM_SLAVES.
+//      How many are actually on the bus is set at run time, up to this
+//      many (see CAN_MODEM_SLAVE_COUNT_TYPE). Every slave of room costs the
+//      master about 9 bytes of RAM.
+#ifndef NUM_SLAVES
 #define NUM_SLAVES          9
+#endif
+
+// Staged commands: the slaves hold a new command until the master's commit
+//      frame (LIN_COMMIT_ID), which it sends once every changed command is
+//      out, so the whole scene changes at once. With NO each slave applies
+//      its command as soon as it gets it.
+#ifndef STAGED_COMMANDS
+#define STAGED_COMMANDS     YES
+#endif
+
+// Firmware version reported over diagnostics
+#define FIRMWARE_VERSION_MAJOR  (1)
+#define FIRMWARE_VERSION_MINOR  (1)
 
 // #############################################################################
 // ------------ NODE SETTINGS
 // #############################################################################
 
+#ifndef IS_MASTER_NODE
 #define IS_MASTER_NODE      YES
+#endif
 
 // #############################################################################
 // ------------ INCLUDES
@@ -78,6 +101,14 @@
 #define HIGHEST_SLAVE_NUMBER    (NUM_SLAVES)
 #define INVALID_SLAVE_NUMBER    (0xFF) 
 
+// Node ID of a slave without a number (see auto_addressing.c),
+//  its diagnostic NAD is LIN_DIAG_NAD_UNASSIGNED
+#define UNASSIGNED_NODE_ID      (GET_SLAVE_BASE_ID(LIN_DIAG_NAD_UNASSIGNED))
+
+#if ((1 > NUM_SLAVES) || (MAX_NUM_SLAVES < NUM_SLAVES))
+#error "NUM_SLAVES must be 1 to MAX_NUM_SLAVES"
+#endif
+
 // Request Mask (the LSB will be high for status requests)
 #define REQUEST_MASK            (0x01)
 #define SLAVE_BASE_MASK         ~(0x01)
@@ -94,13 +125,90 @@
 // #############################################################################
 
 // Command/status packet byte indices and lengths
-#define LIN_PACKET_LEN          (3)                 // number of bytes in packet
+#define LIN_PACKET_LEN          (4)                 // number of bytes in packet
 #define INTENSITY_DATA_INDEX    (0)                 // Start index for this command
 #define POSITION_DATA_INDEX     (1)                 // Start index for this command
+#define SEQUENCE_DATA_INDEX     (3)                 // Start index for this command
 #define INTENSITY_DATA_LEN      (1)                 // Number of bytes
 #define POSITION_DATA_LEN       (2)                 // Number of bytes
+#define SEQUENCE_DATA_LEN       (1)                 // Number of bytes
 typedef uint8_t                 intensity_data_t;   // Right now we are encoding % intensity here
 typedef uint16_t                position_data_t;    // Right now we are encoding pulse width here
+typedef uint8_t                 sequence_data_t;    // Rolling command sequence number
+
+// Event-triggered status frame
+//      One status ID shared by all slaves. A slave only answers it when its
+//      status changed since it last sent it, with the ID of its own status
+//      frame followed by its status. If several slaves answer at once the
+//      response collides, and the master polls the status IDs individually
+//      in the next round instead.
+//      It uses the master's (unused) request ID, so it never collides with
+//      a slave ID.
+#define LIN_EVENT_STATUS_ID     (MASTER_NODE_ID|REQUEST_MASK)
+#define LIN_EVENT_FRAME_LEN     (1+LIN_PACKET_LEN)  // number of bytes in frame
+#define EVENT_STATUS_ID_INDEX   (0)                 // Slave's status ID
+#define EVENT_STATUS_DATA_INDEX (1)                 // Slave's status
+
+// Commit frame (STAGED_COMMANDS)
+//      Sent by the master to all slaves at once, after the commands that
+//      changed. Each slave then applies the last command it got, so the
+//      lights change together rather than one after another.
+//      It uses the master's (unused) command ID.
+//      Byte 0:     rolling commit count
+#define LIN_COMMIT_ID           (MASTER_NODE_ID)
+#define LIN_COMMIT_FRAME_LEN    (1)                 // number of bytes in frame
+#define COMMIT_COUNT_INDEX      (0)
+
+// Scene frame
+//      Sent by the master to all slaves at once when a position message
+//      changes the scene, instead of the changed commands. Each slave works
+//      out its own command from the location, as the master does, and
+//      applies it straight away with the next sequence number, so a new
+//      scene takes one slot however many slaves are on the bus. Until a
+//      slave's status shows that command the master sends it in the round,
+//      which puts right a slave that missed the scene frame.
+//      ID 0x3F is reserved for user defined extended frames.
+//      Bytes 0-3:  requested location, x then y, LSB first
+#define LIN_SCENE_ID            (0x3F)
+#define LIN_SCENE_FRAME_LEN     (4)                 // number of bytes in frame
+#define SCENE_X_INDEX           (0)
+#define SCENE_Y_INDEX           (2)
+
+// Extended status frame (telemetry)
+//      Each round the master sends this ID right after one slave's command
+//      (the slaves take turns), and only that slave answers it, so each
+//      of N slaves on the bus reports once every N rounds.
+//      ID 0x3E is reserved for user defined extended frames.
+//      Byte 0:     applied intensity
+//      Bytes 1-3:  commanded then actual servo position, 12 bits each,
+//                  LSB first (0xFFF = SERVO_STAY)
+//      Byte 4:     bit 7 set while the servo is moving,
+//                  bits 0-6 LIN error count (saturating)
+//      Byte 5:     AVcc, the node's regulated rail, in 100 mV
+//                  (0 = not measured yet). Not the vehicle supply: the
+//                  node has no divider input for it, so a low supply
+//                  only shows here once the regulator drops out.
+//      Byte 6:     chip temperature in C, signed (INT8_MIN = not measured yet)
+//      Byte 7:     uptime in minutes (saturating)
+#define LIN_EXT_STATUS_ID       (0x3E)
+#define LIN_EXT_STATUS_LEN      (8)
+#define EXT_STS_INTENSITY_INDEX     (0)
+#define EXT_STS_POSITIONS_INDEX     (1)
+#define EXT_STS_FLAGS_INDEX         (4)
+#define EXT_STS_AVCC_INDEX          (5)
+#define EXT_STS_TEMPERATURE_INDEX   (6)
+#define EXT_STS_UPTIME_INDEX        (7)
+#define EXT_STS_POSITION_MASK       (0x0FFF)
+#define EXT_STS_MOVING_FLAG         (0x80)
+#define EXT_STS_ERROR_COUNT_MASK    (0x7F)
+#define EXT_STS_AVCC_MV_PER_LSB     (100)
+#define EXT_STS_MS_PER_UPTIME_LSB   (60000UL)
+
+// Sequence numbers
+//      The master bumps a slave's sequence number whenever that slave's
+//      command changes. The slave echoes the sequence number of the last
+//      command it applied in its status, so the master knows exactly which
+//      update each slave is on.
 
 // Specific Command Keywords
 #define INTENSITY_NON_COMMAND   (0xFF)       
@@ -117,6 +225,104 @@ typedef uint16_t                position_data_t;    // Right now we are encoding
 //  in POSITION_DATA_LEN
 #define SERVO_STAY              (POSITION_NON_COMMAND)     
 
+// #############################################################################
+// ------------ EEPROM LAYOUT
+// #############################################################################
+
+// Shared by the application and the bootloader. The master's slave count
+//  follows the slave's node ID, so a board that was a slave doesn't take its
+//  old number for the count.
+#define EEPROM_NODE_ID_ADDR         (E2START+0) // Slave's node ID
+#define EEPROM_SLAVE_COUNT_ADDR     (E2START+1) // Master's slave count
+#define EEPROM_APP_VALID_ADDR       (E2START+2) // BOOT_APP_VALID if the image checked out
+#define EEPROM_APP_START_ADDR       (E2START+3) // Application start (word address), LSB first, 2 bytes
+
+// #############################################################################
+// ------------ LIN DIAGNOSTICS
+// #############################################################################
+
+// Diagnostic frames (LIN 2.x transport layer)
+//      The master request frame (0x3C) and slave response frame (0x3D) are
+//      always 8 bytes long: NAD, PCI, then 6 bytes of PDU data.
+//      These two ID's sit above the slave ID's (max 0x3B), so they never
+//      collide with a command or status ID.
+//      The master only broadcasts them in the spare slot at the end of a
+//      schedule round, and only when there is diagnostic traffic pending.
+#define LIN_DIAG_MASTER_REQ_ID      (0x3C)
+#define LIN_DIAG_SLAVE_RESP_ID      (0x3D)
+#define LIN_DIAG_FRAME_LEN          (8)
+#define LIN_DIAG_MAX_PDU_LEN        (24)        // Largest PDU we reassemble
+
+// Node addresses (NAD), a slave's NAD is its slave number
+#define LIN_DIAG_NAD_SLEEP          (0x00)      // Reserved for go-to-sleep
+#define LIN_DIAG_NAD_BROADCAST      (0x7F)
+#define LIN_DIAG_NAD_UNASSIGNED     (0x7E)      // Shared by the slaves without a number
+#define GET_SLAVE_NAD(slave_number)             (slave_number)
+
+// Service ID's and response codes
+#define LIN_DIAG_SID_READ_BY_ID     (0xB2)
+#define LIN_DIAG_RSID_OFFSET        (0x40)      // Positive response SID = SID+0x40
+#define LIN_DIAG_RSID_NEGATIVE      (0x7F)
+#define LIN_DIAG_NRC_NOT_SUPPORTED  (0x12)
+#define LIN_DIAG_NRC_OUT_OF_RANGE   (0x31)
+#define LIN_DIAG_NRC_NO_RESPONSE    (0xFF)      // Master only, slave timed out
+
+// Auto-addressing services (see auto_addressing.c), serials MSB first
+//      Start:  SID, mode (broadcast, no response)
+//      Query:  SID, prefix bits, serial -> RSID, serial
+//              (to LIN_DIAG_NAD_UNASSIGNED, only matching slaves answer)
+//      Assign: SID, serial, new NAD -> RSID
+//              (to LIN_DIAG_NAD_UNASSIGNED, only that slave answers)
+#define LIN_DIAG_SID_ASSIGN_NAD     (0xB0)
+#define LIN_DIAG_SID_ADDR_START     (0xB4)
+#define LIN_DIAG_SID_ADDR_QUERY     (0xB5)
+#define LIN_DIAG_ADDR_MODE_NEW      (0x00)      // Only slaves without a number
+#define LIN_DIAG_ADDR_MODE_ALL      (0x01)      // Every slave gives up its number
+
+// Flashing services (see lin_flasher.c and lin_bootloader.c), handled by the
+//  slave's bootloader once the programming session has started
+//      Session:    SID, LIN_DIAG_SESSION_PROGRAMMING (broadcast, no response)
+//      Transfer:   SID, page, offset, LIN_FLASH_CHUNK_LEN bytes, and on the
+//                  last chunk of a page the CRC of the page, MSB first
+//                  -> RSID, page (only when sent to one slave)
+//      Status:     SID, first page -> RSID, first page, bitmap of the next
+//                  32 pages written and checked (bit n = first page+n)
+//      Exit:       SID, pages, CRC of the image, MSB first -> RSID
+//                  (the slave then resets into the new application)
+//      The CRCs are the CRC-CCITT of _crc_ccitt_update(), starting at 0xFFFF.
+#define LIN_DIAG_SID_SESSION        (0x10)
+#define LIN_DIAG_SID_TRANSFER_DATA  (0x36)
+#define LIN_DIAG_SID_TRANSFER_EXIT  (0x37)
+#define LIN_DIAG_SID_PAGE_STATUS    (0xB6)
+#define LIN_DIAG_SESSION_PROGRAMMING (0x02)
+#define LIN_DIAG_NRC_PROGRAMMING    (0x72)      // Page or image didn't check out
+
+// Slave flash layout for the bootloader
+//      The bootloader sits in the .bootloader section at the top of the flash
+//      (see the FLASH segment in the project's linker settings, in words), the
+//      application gets the pages below it
+#define BOOTLOADER_START_ADDR       (0x3800)
+#define LIN_FLASH_PAGE_SIZE         (128)       // SPM_PAGESIZE
+#define LIN_FLASH_MAX_PAGES         (BOOTLOADER_START_ADDR/LIN_FLASH_PAGE_SIZE)
+#define LIN_FLASH_CHUNK_LEN         (16)        // Page bytes per transfer request
+
+// Read by identifier, identifiers (user defined range 32-63)
+//      Request PDU:  SID, identifier, arg0, arg1
+//      Response PDU: RSID, identifier, data...
+#define DIAG_ID_FW_VERSION          (0x20)      // major, minor, node type
+#define DIAG_ID_LIN_COUNTERS        (0x21)      // LIN error and frame counters
+#define DIAG_ID_EEPROM              (0x22)      // arg0:arg1 = EEPROM address
+#define DIAG_ID_TIMING_STATS        (0x23)      // uptime and LIN frame timing
+#define DIAG_ID_LIN_ERROR_CLASSES   (0x24)      // LIN errors per error class
+#define DIAG_ID_LIN_FRAME_ERRORS    (0x25)      // arg0 = first LIN frame ID
+#define DIAG_ID_SLEEP_STATS         (0x26)      // sleep count and wake up latency
+#define DIAG_ID_EXT_STATUS          (0x27)      // arg0 = slave number (master only)
+#define DIAG_ID_CAN_STATS           (0x28)      // CAN receive FIFO meters (master only)
+#define DIAG_ID_CAN_TX_STATS        (0x29)      // CAN transmit queue meters (master only)
+#define DIAG_ID_CAN_ERRORS          (0x2A)      // CAN error state and counters (master only)
+#define DIAG_EEPROM_READ_LEN        (16)        // Bytes returned per EEPROM read
+#define DIAG_FRAME_ERRORS_READ_LEN  (16)        // Frame IDs returned per read
+
 // #############################################################################
 // ------------ CAN COMMANDS AND STATI
 // #############################################################################
@@ -124,6 +330,50 @@ typedef uint16_t                position_data_t;    // Right now we are encoding
 // CAN Packet Size
 #define CAN_MODEM_PACKET_LEN        5           // 5 bytes
 
+// CAN bit timing, CAN.c derives the MCP25625 CNF registers from these
+//      (125000, 250000 and 500000 bit/s all work with a 16 MHz crystal)
+#define CAN_OSC_HZ                  (16000000UL)    // MCP25625 crystal
+#define CAN_BITRATE                 (250000UL)      // in bit/s
+#define CAN_SAMPLE_POINT_PERMILLE   (625)           // Sample point, in 1/1000 of a bit
+#define CAN_SJW_TQ                  (2)             // Synchronization jump width (1 to 4 TQ)
+
+// Standard identifier of the messages the master sends
+#define CAN_MASTER_TX_SID           (0x001)
+
+// Transmit priorities (MCP25625 TXP, 0 to 3), a pending frame with a
+//      higher priority leaves first whichever TX Buffer it is in
+#define CAN_TX_PRIORITY_REPLY       (3)         // Answers to the modem, flash image fetches
+#define CAN_TX_PRIORITY_REPORT      (1)         // Reports the master sends on its own
+
+// Standard identifier of the modem's messages
+#define CAN_MODEM_RX_SID            (0x000)
+
+// Acceptance masks and filters (MCP25625), standard identifiers
+//      RX Buffer 0 takes the frames that match RXF0 or RXF1 under RXM0,
+//      RX Buffer 1 those that match RXF2 to RXF5 under RXM1. A mask bit of
+//      0 accepts either value of the identifier bit. Other frames are
+//      dropped by the MCP25625 and never interrupt the master.
+//      Unused filters repeat a used one.
+#define CAN_RX_MASKS                { 0x7FF, 0x7FF }                        // RXM0, RXM1
+#define CAN_RX_FILTERS              {   CAN_MODEM_RX_SID, CAN_MODEM_RX_SID, \
+                                        CAN_MODEM_RX_SID, CAN_MODEM_RX_SID, \
+                                        CAN_MODEM_RX_SID, CAN_MODEM_RX_SID } // RXF0 to RXF5
+
+// Received frames that can wait for the master (see can_rx_fifo.c)
+#define CAN_RX_FIFO_DEPTH           (4)
+
+// Frames to send that can wait for a TX Buffer (see can_tx_queue.c), and
+//      how long a frame may stay in a TX Buffer before it's aborted
+#define CAN_TX_QUEUE_DEPTH          (4)
+#define CAN_TX_TIMEOUT_MS           (100)
+
+// CAN error supervisor (see can_error_supervisor.c), how often TEC, REC
+//      and EFLG are read, and how long the MCP25625 may stay bus off
+//      before it's reset, doubled on each reset up to the max
+#define CAN_ERROR_READ_MS           (100)
+#define CAN_BUS_OFF_BACKOFF_MS      (100)
+#define CAN_BUS_OFF_MAX_BACKOFF_MS  (3200)
+
 // Indices in CAN packet
 #define CAN_MODEM_TYPE_IDX          0           // First byte is the type
 #define CAN_MODEM_POS_TYPE          (0xa0)      // Msg to request light in position
@@ -131,6 +381,94 @@ typedef uint16_t                position_data_t;    // Right now we are encoding
 #define CAN_MODEM_POS_VECT_IDX      (1)         // For pos type, the index starts at byte 1
 #define CAN_MODEM_SPEC_NUM_IDX      (1)         // For spec type, the slave num starts at byte 1
 #define CAN_MODEM_SPEC_CMD_INDEX    (2)         // For spec type, the equiv cmd packet starts at byte 2
+#define CAN_MODEM_DIAG_TYPE         (0xd1)      // Msg to read a node's diagnostic data
+#define CAN_MODEM_DIAG_NUM_IDX      (1)         // For diag type, the node num (0 = master) is at byte 1
+#define CAN_MODEM_DIAG_ID_IDX       (2)         // For diag type, the identifier is at byte 2
+#define CAN_MODEM_DIAG_ARG_IDX      (3)         // For diag type, two argument bytes start at byte 3
+#define CAN_MODEM_HEALTH_TYPE       (0xe5)      // Msg to read the slave health report
+#define CAN_MODEM_SLEEP_TYPE        (0x5e)      // Msg to put the LIN bus to sleep,
+                                                //  any other msg wakes it up
+#define CAN_MODEM_BUS_STATS_TYPE    (0xb5)      // Msg to read the LIN bus meters
+#define CAN_MODEM_BUS_STATS_NUM_IDX (1)         // For bus stats type, 0 = bus, n = slave n
+#define CAN_MODEM_SLAVE_COUNT_TYPE  (0x5c)      // Msg to set the number of slaves on the bus,
+                                                //  the master keeps it in EEPROM
+#define CAN_MODEM_SLAVE_COUNT_IDX   (1)         // For slave count type, the count (1 to NUM_SLAVES) is at byte 1
+#define CAN_MODEM_ADDRESSING_TYPE   (0xad)      // Msg to number the slaves automatically
+#define CAN_MODEM_ADDRESSING_MODE_IDX (1)       // For addressing type, LIN_DIAG_ADDR_MODE_NEW or _ALL at byte 1
+#define CAN_MODEM_FLASH_TYPE        (0xf1)      // Msg to flash the slaves with an image the modem holds
+#define CAN_MODEM_FLASH_PAGES_IDX   (1)         // For flash type, the image length in pages is at byte 1
+#define CAN_MODEM_FLASH_DATA_TYPE   (0xfd)      // Msg with image bytes the master fetched (see below)
+#define CAN_MODEM_FLASH_OFFSET_IDX  (1)         // For flash data type, the page offset is at byte 1
+#define CAN_MODEM_FLASH_DATA_IDX    (2)         // For flash data type, 3 image bytes start at byte 2
+#define CAN_MODEM_FLASH_DATA_LEN    (3)
+
+// Diagnostic replies to the modem (8 bytes each)
+//      Byte 0: CAN_MODEM_DIAG_TYPE, byte 1: node number,
+//      byte 2: chunk index (CAN_DIAG_REPLY_LAST_CHUNK set on the last chunk),
+//      bytes 3-7: next 5 bytes of the response PDU
+#define CAN_DIAG_REPLY_LEN          (8)
+#define CAN_DIAG_REPLY_CHUNK_IDX    (2)
+#define CAN_DIAG_REPLY_DATA_IDX     (3)
+#define CAN_DIAG_REPLY_DATA_LEN     (CAN_DIAG_REPLY_LEN-CAN_DIAG_REPLY_DATA_IDX)
+#define CAN_DIAG_REPLY_LAST_CHUNK   (0x80)
+
+// Slave health reports to the modem (8 bytes each), sent when requested and
+//  whenever a slave changes state
+//      Byte 0: CAN_MODEM_HEALTH_TYPE,
+//      bytes 1-4: bitmap of the answering slaves (bit n = slave n, LSB first),
+//      bytes 5-7: number of online, degraded and offline slaves
+#define CAN_HEALTH_REPORT_LEN       (8)
+#define CAN_HEALTH_BITMAP_IDX       (1)
+#define CAN_HEALTH_ONLINE_IDX       (5)
+#define CAN_HEALTH_DEGRADED_IDX     (6)
+#define CAN_HEALTH_OFFLINE_IDX      (7)
+
+// LIN bus meter reports to the modem (8 bytes each), sent when requested
+//      Byte 0: CAN_MODEM_BUS_STATS_TYPE, byte 1: 0 or slave number,
+//      For 0 (the bus), LSB first:
+//          bytes 2-3: utilisation in permille, bytes 4-5: slots that ended
+//          without a complete response, bytes 6-7: longest slot in us
+//      For slave n, the latency of its status responses:
+//          bytes 2-5: responses below 4.25ms, 4.25-4.5ms, 4.5-4.75ms,
+//          4.75ms or more
+//          (0-15, halved whenever one fills up), bytes 6-7: longest in
+//          us (32us resolution)
+#define CAN_BUS_STATS_LEN           (8)
+#define CAN_BUS_STATS_UTIL_IDX      (2)
+#define CAN_BUS_STATS_INCOMPLETE_IDX (4)
+#define CAN_BUS_STATS_MAX_IDX       (6)
+#define CAN_BUS_STATS_BUCKETS_IDX   (2)
+
+// Auto-addressing reports to the modem (8 bytes each), sent when it ends
+//      Byte 0: CAN_MODEM_ADDRESSING_TYPE, byte 1: slaves numbered,
+//      byte 2: slaves on the bus now, byte 3: addressing_result_t,
+//      bytes 4-5: time taken in ms, LSB first
+#define CAN_ADDRESSING_REPORT_LEN   (8)
+#define CAN_ADDRESSING_NUMBERED_IDX (1)
+#define CAN_ADDRESSING_COUNT_IDX    (2)
+#define CAN_ADDRESSING_RESULT_IDX   (3)
+#define CAN_ADDRESSING_TIME_IDX     (4)
+
+// Flashing messages to the modem
+//      Fetch (4 bytes): byte 0: CAN_MODEM_FLASH_TYPE, byte 1:
+//          CAN_FLASH_MSG_FETCH, byte 2: page, byte 3: offset in the page.
+//          The modem answers with a CAN_MODEM_FLASH_DATA_TYPE msg holding
+//          the 3 image bytes from there (padded past the end of the page).
+//          The master fetches again if no answer comes.
+//      Report (8 bytes), sent when flashing ends: byte 0:
+//          CAN_MODEM_FLASH_TYPE, byte 1: CAN_FLASH_MSG_REPORT, byte 2:
+//          lin_flash_result_t, byte 3: pages, bytes 4-7: bitmap of the
+//          slaves that failed (bit n = slave n, LSB first)
+#define CAN_FLASH_MSG_IDX           (1)
+#define CAN_FLASH_MSG_FETCH         (0x01)
+#define CAN_FLASH_MSG_REPORT        (0x02)
+#define CAN_FLASH_FETCH_LEN         (4)
+#define CAN_FLASH_FETCH_PAGE_IDX    (2)
+#define CAN_FLASH_FETCH_OFFSET_IDX  (3)
+#define CAN_FLASH_REPORT_LEN        (8)
+#define CAN_FLASH_RESULT_IDX        (2)
+#define CAN_FLASH_PAGES_IDX         (3)
+#define CAN_FLASH_FAILED_IDX        (4)
 
 // #############################################################################
 // ------------ TYPE DEFINITIONS
@@ -49,7 +49,7 @@ static uint32_t Pending_Events = 0;     // Each bit corresponds to type of event
 // ------------ PRIVATE FUNCTION PROTOTYPES
 // #############################################################################
 
-static void process_event_if_pending(uint32_t event_mask);
+static bool process_event_if_pending(uint32_t event_mask);
 
 // #############################################################################
 // ------------ PUBLIC FUNCTIONS
@@ -92,109 +92,133 @@ void Post_Event(uint32_t event_mask)
 ****************************************************************************/
 void Run_Events(void)
 {
-    // Run no-end main loop
+    // Run no-end main loop, idling once no event is pending
     while (1)
     {
-        // Loop through all events
-        #if (1 <= NUM_EVENTS)
-        process_event_if_pending(EVENT_01);
-        #endif
-        #if (2 <= NUM_EVENTS)
-        process_event_if_pending(EVENT_02);
-        #endif
-        #if (3 <= NUM_EVENTS)
-        process_event_if_pending(EVENT_03);
-        #endif
-        #if (4 <= NUM_EVENTS)
-        process_event_if_pending(EVENT_04);
-        #endif
-        #if (5 <= NUM_EVENTS)
-        process_event_if_pending(EVENT_05);
-        #endif
-        #if (6 <= NUM_EVENTS)
-        process_event_if_pending(EVENT_06);
-        #endif
-        #if (7 <= NUM_EVENTS)
-        process_event_if_pending(EVENT_07);
-        #endif
-        #if (8 <= NUM_EVENTS)
-        process_event_if_pending(EVENT_08);
-        #endif
-        #if (9 <= NUM_EVENTS)
-        process_event_if_pending(EVENT_09);
-        #endif
-        #if (10 <= NUM_EVENTS)
-        process_event_if_pending(EVENT_10);
-        #endif
-        #if (11 <= NUM_EVENTS)
-        process_event_if_pending(EVENT_11);
-        #endif
-        #if (12 <= NUM_EVENTS)
-        process_event_if_pending(EVENT_12);
-        #endif
-        #if (13 <= NUM_EVENTS)
-        process_event_if_pending(EVENT_13);
-        #endif
-        #if (14 <= NUM_EVENTS)
-        process_event_if_pending(EVENT_14);
-        #endif
-        #if (15 <= NUM_EVENTS)
-        process_event_if_pending(EVENT_15);
-        #endif
-        #if (16 <= NUM_EVENTS)
-        process_event_if_pending(EVENT_16);
-        #endif
-        #if (17 <= NUM_EVENTS)
-        process_event_if_pending(EVENT_17);
-        #endif
-        #if (18 <= NUM_EVENTS)
-        process_event_if_pending(EVENT_18);
-        #endif
-        #if (19 <= NUM_EVENTS)
-        process_event_if_pending(EVENT_19);
-        #endif
-        #if (20 <= NUM_EVENTS)
-        process_event_if_pending(EVENT_20);
-        #endif
-        #if (21 <= NUM_EVENTS)
-        process_event_if_pending(EVENT_21);
-        #endif
-        #if (22 <= NUM_EVENTS)
-        process_event_if_pending(EVENT_22);
-        #endif
-        #if (23 <= NUM_EVENTS)
-        process_event_if_pending(EVENT_23);
-        #endif
-        #if (24 <= NUM_EVENTS)
-        process_event_if_pending(EVENT_24);
-        #endif
-        #if (25 <= NUM_EVENTS)
-        process_event_if_pending(EVENT_25);
-        #endif
-        #if (26 <= NUM_EVENTS)
-        process_event_if_pending(EVENT_26);
-        #endif
-        #if (27 <= NUM_EVENTS)
-        process_event_if_pending(EVENT_27);
-        #endif
-        #if (28 <= NUM_EVENTS)
-        process_event_if_pending(EVENT_28);
-        #endif
-        #if (29 <= NUM_EVENTS)
-        process_event_if_pending(EVENT_29);
-        #endif
-        #if (30 <= NUM_EVENTS)
-        process_event_if_pending(EVENT_30);
-        #endif
-        #if (31 <= NUM_EVENTS)
-        process_event_if_pending(EVENT_31);
-        #endif
-        #if (32 <= NUM_EVENTS)
-        process_event_if_pending(EVENT_32);
-        #endif
+        if (false == Run_Pending_Events())
+        {
+            Run_Idle_Service();
+        }
     }
 }
 
+/****************************************************************************
+    Public Function
+        Run_Pending_Events
+
+    Parameters
+        None
+
+    Description
+        Makes one pass through all events, processing and clearing any that
+            are pending. Returns true if any event was processed.
+
+****************************************************************************/
+bool Run_Pending_Events(void)
+{
+    bool processed = false;
+
+    // Loop through all events
+    #if (1 <= NUM_EVENTS)
+    processed |= process_event_if_pending(EVENT_01);
+    #endif
+    #if (2 <= NUM_EVENTS)
+    processed |= process_event_if_pending(EVENT_02);
+    #endif
+    #if (3 <= NUM_EVENTS)
+    processed |= process_event_if_pending(EVENT_03);
+    #endif
+    #if (4 <= NUM_EVENTS)
+    processed |= process_event_if_pending(EVENT_04);
+    #endif
+    #if (5 <= NUM_EVENTS)
+    processed |= process_event_if_pending(EVENT_05);
+    #endif
+    #if (6 <= NUM_EVENTS)
+    processed |= process_event_if_pending(EVENT_06);
+    #endif
+    #if (7 <= NUM_EVENTS)
+    processed |= process_event_if_pending(EVENT_07);
+    #endif
+    #if (8 <= NUM_EVENTS)
+    processed |= process_event_if_pending(EVENT_08);
+    #endif
+    #if (9 <= NUM_EVENTS)
+    processed |= process_event_if_pending(EVENT_09);
+    #endif
+    #if (10 <= NUM_EVENTS)
+    processed |= process_event_if_pending(EVENT_10);
+    #endif
+    #if (11 <= NUM_EVENTS)
+    processed |= process_event_if_pending(EVENT_11);
+    #endif
+    #if (12 <= NUM_EVENTS)
+    processed |= process_event_if_pending(EVENT_12);
+    #endif
+    #if (13 <= NUM_EVENTS)
+    processed |= process_event_if_pending(EVENT_13);
+    #endif
+    #if (14 <= NUM_EVENTS)
+    processed |= process_event_if_pending(EVENT_14);
+    #endif
+    #if (15 <= NUM_EVENTS)
+    processed |= process_event_if_pending(EVENT_15);
+    #endif
+    #if (16 <= NUM_EVENTS)
+    processed |= process_event_if_pending(EVENT_16);
+    #endif
+    #if (17 <= NUM_EVENTS)
+    processed |= process_event_if_pending(EVENT_17);
+    #endif
+    #if (18 <= NUM_EVENTS)
+    processed |= process_event_if_pending(EVENT_18);
+    #endif
+    #if (19 <= NUM_EVENTS)
+    processed |= process_event_if_pending(EVENT_19);
+    #endif
+    #if (20 <= NUM_EVENTS)
+    processed |= process_event_if_pending(EVENT_20);
+    #endif
+    #if (21 <= NUM_EVENTS)
+    processed |= process_event_if_pending(EVENT_21);
+    #endif
+    #if (22 <= NUM_EVENTS)
+    processed |= process_event_if_pending(EVENT_22);
+    #endif
+    #if (23 <= NUM_EVENTS)
+    processed |= process_event_if_pending(EVENT_23);
+    #endif
+    #if (24 <= NUM_EVENTS)
+    processed |= process_event_if_pending(EVENT_24);
+    #endif
+    #if (25 <= NUM_EVENTS)
+    processed |= process_event_if_pending(EVENT_25);
+    #endif
+    #if (26 <= NUM_EVENTS)
+    processed |= process_event_if_pending(EVENT_26);
+    #endif
+    #if (27 <= NUM_EVENTS)
+    processed |= process_event_if_pending(EVENT_27);
+    #endif
+    #if (28 <= NUM_EVENTS)
+    processed |= process_event_if_pending(EVENT_28);
+    #endif
+    #if (29 <= NUM_EVENTS)
+    processed |= process_event_if_pending(EVENT_29);
+    #endif
+    #if (30 <= NUM_EVENTS)
+    processed |= process_event_if_pending(EVENT_30);
+    #endif
+    #if (31 <= NUM_EVENTS)
+    processed |= process_event_if_pending(EVENT_31);
+    #endif
+    #if (32 <= NUM_EVENTS)
+    processed |= process_event_if_pending(EVENT_32);
+    #endif
+
+    return processed;
+}
+
 // #############################################################################
 // ------------ PRIVATE FUNCTIONS
 // #############################################################################
@@ -208,10 +232,11 @@ void Run_Events(void)
 
     Description
         Checks if an particular event is pending and if so, clears it, then
-            calls the run functions to process the event
+            calls the run functions to process the event. Returns true if
+            the event was pending.
 
 ****************************************************************************/
-static void process_event_if_pending(uint32_t event_mask)
+static bool process_event_if_pending(uint32_t event_mask)
 {
     // Initialize event pending flag to false
     bool event_pending = false;
@@ -234,5 +259,7 @@ static void process_event_if_pending(uint32_t event_mask)
 
     // If the event is pending, run all services to process the event.
     if (event_pending) Run_Services(event_mask);
+
+    return event_pending;
 }
 
@@ -45,5 +45,6 @@
 
 void Post_Event(uint32_t event_mask);
 void Run_Events(void);
+bool Run_Pending_Events(void);
 
 #endif // events_H
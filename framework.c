@@ -174,6 +174,25 @@ void Run_Services(uint32_t event)
     #endif
 }
 
+/****************************************************************************
+    Public Function
+        Run_Idle_Service
+
+    Parameters
+        None
+
+    Description
+        Calls the idle service, if there is one, once every pending event
+            has been processed
+
+****************************************************************************/
+void Run_Idle_Service(void)
+{
+    #ifdef IDLE_SERVICE
+    IDLE_SERVICE();
+    #endif
+}
+
 // #############################################################################
 // ------------ PRIVATE FUNCTIONS
 // #############################################################################
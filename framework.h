@@ -14,5 +14,6 @@
 
 void Initialize_Framework(void);
 void Run_Services(uint32_t event);
+void Run_Idle_Service(void);
 
 #endif // framework_H
\ No newline at end of file
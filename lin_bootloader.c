@@ -0,0 +1,917 @@
+/*******************************************************************************
+    File:
+        lin_bootloader.c
+
+    Notes:
+        This file contains the slave's LIN bootloader, which takes a new
+        application image from the master (see lin_flasher.c and the
+        flashing services in config.h).
+
+        The ATtiny167 has no boot section, so the bootloader is linked into
+        the .bootloader section at BOOTLOADER_START_ADDR and owns the reset
+        vector instead:
+            - The first time it runs it points the reset vector at
+              LIN_Bootloader_Start() and keeps the application's start
+              address in EEPROM. Page 0 of a new image is treated the same
+              when it is written.
+            - After a reset it jumps to the application if the last image
+              checked out, otherwise it waits for the master.
+        The application enters it with Enter_LIN_Bootloader() when the
+        master starts a programming session. That call is also what keeps
+        the .bootloader section in the slave image now that unused sections
+        are collected; the master never calls it and links without it.
+
+        The bootloader runs with interrupts off and polls the LIN
+        controller. It must not use anything in the application's flash,
+        which it overwrites: every function here is in the .bootloader
+        section, there are no switch statements (their jump tables go to
+        .progmem) and no initialized variables (the application's start up
+        code sets those). The bootloader itself is never rewritten, it must
+        be the same in every image.
+
+        A page is kept in RAM until all of its chunks and a matching CRC
+        have arrived, then it is written and read back. The CPU is halted
+        while a page is written, so frames sent then are lost. The master
+        leaves a CAN round trip between chunks and asks again for a status
+        that doesn't come.
+
+    External Functions Required:
+        None
+
+    Public Functions:
+        void Enter_LIN_Bootloader(void)
+        void LIN_Bootloader_Start(void)
+
+*******************************************************************************/
+
+// #############################################################################
+// ------------ INCLUDES
+// #############################################################################
+
+// Standard ANSI  99 C types for exact integer sizes and booleans
+#include <stdint.h>
+#include <stdbool.h>
+
+// Config file
+#include "config.h"
+
+// This module's header file
+#include "lin_bootloader.h"
+
+// Include other files below:
+
+// The Atmel AVR LIN driver library (register macros only)
+#include "lin_drv.h"
+
+// Interrupts
+#include <avr/interrupt.h>
+
+// Self programming
+#include <avr/boot.h>
+
+// Reading the flash
+#include <avr/pgmspace.h>
+
+// Watchdog, to reset into the new application
+#include <avr/wdt.h>
+
+// #############################################################################
+// ------------ MODULE DEFINITIONS
+// #############################################################################
+
+// Everything the bootloader runs lives in its own section
+#define BOOTLOADER_CODE             __attribute__((section(".bootloader"), noinline))
+
+// EEPROM layout (see config.h)
+#define NODE_ID_ADDR                (EEPROM_NODE_ID_ADDR)
+#define BOOT_APP_VALID_ADDR         (EEPROM_APP_VALID_ADDR)
+#define BOOT_APP_START_ADDR         (EEPROM_APP_START_ADDR)
+#define BOOT_APP_VALID              (0xA5)
+
+// Left in GPIOR0 by Enter_LIN_Bootloader(), cleared by a reset
+#define BOOT_REQUEST                (0xB7)
+
+// The application's reset vector, a JMP to its start up code
+#define JMP_OPCODE                  (0x940C)
+#define RESET_VECTOR_TARGET_ADDR    (2)
+
+#define BOOT_CRC_INIT               (0xFFFF)
+
+// Diagnostic frame layout (see MS_LIN_top_layer.c)
+#define LIN_DIAG_NAD_INDEX          (0)
+#define LIN_DIAG_PCI_INDEX          (1)
+#define LIN_DIAG_PCI_TYPE_MASK      (0xF0)
+#define LIN_DIAG_PCI_INFO_MASK      (0x0F)
+#define LIN_DIAG_PCI_SF             (0x00)
+#define LIN_DIAG_PCI_FF             (0x10)
+#define LIN_DIAG_PCI_CF             (0x20)
+#define LIN_DIAG_SF_DATA_INDEX      (2)
+#define LIN_DIAG_SF_MAX_LEN         (6)
+#define LIN_DIAG_FF_LEN_INDEX       (2)
+#define LIN_DIAG_FF_DATA_INDEX      (3)
+#define LIN_DIAG_FF_DATA_LEN        (5)
+#define LIN_DIAG_CF_DATA_INDEX      (2)
+#define LIN_DIAG_CF_DATA_LEN        (6)
+#define LIN_DIAG_FIRST_CF_SEQ       (1)
+#define LIN_DIAG_FILL_BYTE          (0xFF)
+
+// Request PDU layouts (see lin_flasher.c)
+#define XFER_PAGE_INDEX             (1)
+#define XFER_OFFSET_INDEX           (2)
+#define XFER_DATA_INDEX             (3)
+#define XFER_CRC_INDEX              (XFER_DATA_INDEX+LIN_FLASH_CHUNK_LEN)
+#define XFER_LEN                    (XFER_CRC_INDEX)
+#define XFER_LAST_LEN               (XFER_CRC_INDEX+2)
+#define STATUS_FIRST_INDEX          (1)
+#define STATUS_LEN                  (2)
+#define STATUS_RSP_BITMAP_INDEX     (2)
+#define STATUS_RSP_LEN              (6)
+#define STATUS_PAGES                (32)
+#define EXIT_PAGES_INDEX            (1)
+#define EXIT_CRC_INDEX              (2)
+#define EXIT_LEN                    (4)
+
+// Chunks of a page
+#define NUM_PAGE_CHUNKS             (LIN_FLASH_PAGE_SIZE/LIN_FLASH_CHUNK_LEN)
+#define ALL_PAGE_CHUNKS             ((uint8_t) ((1U<<NUM_PAGE_CHUNKS)-1))
+#define LAST_CHUNK_OFFSET           (LIN_FLASH_PAGE_SIZE-LIN_FLASH_CHUNK_LEN)
+
+// #############################################################################
+// ------------ TYPE DEFINITIONS
+// #############################################################################
+
+// Everything the bootloader keeps, on its stack
+typedef struct
+{
+    uint8_t         nad;                                // Our NAD
+    uint8_t         rx_pdu[LIN_DIAG_MAX_PDU_LEN];       // Request being put together
+    uint8_t         rx_nad;                             // NAD it was sent to
+    uint8_t         rx_len;                             // Its length, 0 if none
+    uint8_t         rx_count;                           // Bytes received so far
+    uint8_t         rx_seq;                             // Next CF sequence number
+    uint8_t         tx_frame[LIN_DIAG_FRAME_LEN];       // Response frame
+    bool            tx_ready;                           // Response waiting for 0x3D
+    bool            reset_after_tx;                     // Run the new image once answered
+    uint8_t         page;                               // Page being received
+    uint8_t         page_chunks;                        // Its chunks received, bit n = chunk n
+    uint8_t         page_data[LIN_FLASH_PAGE_SIZE];
+    uint8_t         written[(LIN_FLASH_MAX_PAGES+7)/8]; // Pages written and read back
+} boot_state_t;
+
+// #############################################################################
+// ------------ PRIVATE FUNCTION PROTOTYPES
+// #############################################################################
+
+static void boot_main(void) BOOTLOADER_CODE __attribute__((noreturn));
+static void boot_init_state(boot_state_t * p_state) BOOTLOADER_CODE;
+static void boot_own_reset_vector(boot_state_t * p_state) BOOTLOADER_CODE;
+static void boot_lin_init(void) BOOTLOADER_CODE;
+static void boot_poll_lin(boot_state_t * p_state) BOOTLOADER_CODE;
+static void boot_receive_frame(boot_state_t * p_state, uint8_t * p_frame) BOOTLOADER_CODE;
+static void boot_process_request(boot_state_t * p_state, uint8_t nad, uint8_t * p_pdu, \
+    uint8_t pdu_len) BOOTLOADER_CODE;
+static uint8_t boot_transfer_data(boot_state_t * p_state, uint8_t * p_pdu, uint8_t pdu_len, \
+    uint8_t * p_response) BOOTLOADER_CODE;
+static uint8_t boot_page_status(boot_state_t * p_state, uint8_t * p_pdu, uint8_t * p_response) BOOTLOADER_CODE;
+static uint8_t boot_transfer_exit(boot_state_t * p_state, uint8_t * p_pdu, uint8_t * p_response) BOOTLOADER_CODE;
+static uint8_t boot_negative_response(uint8_t sid, uint8_t nrc, uint8_t * p_response) BOOTLOADER_CODE;
+static bool boot_write_image_page(boot_state_t * p_state) BOOTLOADER_CODE;
+static void boot_program_page(uint16_t address, uint8_t * p_data) BOOTLOADER_CODE;
+static uint16_t boot_crc_update(uint16_t crc, uint8_t data) BOOTLOADER_CODE;
+static uint8_t boot_eeprom_read(uint16_t address) BOOTLOADER_CODE;
+static void boot_eeprom_write(uint16_t address, uint8_t value) BOOTLOADER_CODE;
+static void boot_reset(void) BOOTLOADER_CODE __attribute__((noreturn));
+
+// #############################################################################
+// ------------ PUBLIC FUNCTIONS
+// #############################################################################
+
+/****************************************************************************
+    Public Function
+        Enter_LIN_Bootloader
+
+    Parameters
+        None
+
+    Description
+        Leaves the application for the bootloader, which waits for the
+        master to send a new image. Does not return.
+
+****************************************************************************/
+void Enter_LIN_Bootloader(void)
+{
+    cli();
+    GPIOR0 = BOOT_REQUEST;
+    LIN_Bootloader_Start();
+}
+
+/****************************************************************************
+    Public Function
+        LIN_Bootloader_Start
+
+    Parameters
+        None
+
+    Description
+        Entry of the bootloader, from the reset vector or from
+        Enter_LIN_Bootloader(). Starts with a fresh stack.
+
+****************************************************************************/
+__attribute__((section(".bootloader"), naked)) void LIN_Bootloader_Start(void)
+{
+    // Nothing can be assumed of the registers after a reset
+    asm volatile ("clr __zero_reg__");
+    SP = RAMEND;
+
+    boot_main();
+}
+
+// #############################################################################
+// ------------ PRIVATE FUNCTIONS
+// #############################################################################
+
+/****************************************************************************
+    Private Function
+        boot_main
+
+    Parameters
+        None
+
+    Description
+        Runs the application if it is whole and nobody asked for the
+        bootloader, otherwise serves the master until it has sent a new
+        image
+
+****************************************************************************/
+static void boot_main(void)
+{
+    boot_state_t state;
+    uint16_t app_start;
+
+    cli();
+    MCUSR = 0;
+    wdt_disable();
+
+    // Run the application, unless it sent us here or didn't check out
+    app_start = boot_eeprom_read(BOOT_APP_START_ADDR) | (boot_eeprom_read(BOOT_APP_START_ADDR+1)<<8);
+    if ((BOOT_REQUEST != GPIOR0) && (BOOT_APP_VALID == boot_eeprom_read(BOOT_APP_VALID_ADDR)))
+    {
+        asm volatile ("ijmp" :: "z" (app_start));
+    }
+    GPIOR0 = 0;
+
+    // 8 MHz, as in main()
+    CLKPR = 1<<CLKPCE;
+    CLKPR = 0;
+
+    boot_init_state(&state);
+    boot_own_reset_vector(&state);
+    boot_lin_init();
+
+    while (1)
+    {
+        boot_poll_lin(&state);
+    }
+}
+
+/****************************************************************************
+    Private Function
+        boot_init_state
+
+    Parameters
+        boot_state_t * p_state: bootloader state
+
+    Description
+        Clears the state and takes our NAD from our node ID
+
+****************************************************************************/
+static void boot_init_state(boot_state_t * p_state)
+{
+    uint8_t slave_number = GET_SLAVE_NUMBER(boot_eeprom_read(NODE_ID_ADDR));
+
+    p_state->nad = GET_SLAVE_NAD(slave_number);
+    if ((LOWEST_SLAVE_NUMBER > slave_number) || (MAX_NUM_SLAVES < slave_number))
+    {
+        p_state->nad = LIN_DIAG_NAD_UNASSIGNED;
+    }
+
+    p_state->rx_len = 0;
+    p_state->tx_ready = false;
+    p_state->reset_after_tx = false;
+    p_state->page = 0;
+    p_state->page_chunks = 0;
+    for (uint8_t i = 0; i < sizeof(p_state->written); i++)
+    {
+        p_state->written[i] = 0;
+    }
+}
+
+/****************************************************************************
+    Private Function
+        boot_own_reset_vector
+
+    Parameters
+        boot_state_t * p_state: bootloader state, its page buffer is used
+
+    Description
+        Points the reset vector at the bootloader, so a reset while the
+        application is being rewritten ends up here. The application that
+        ran us is good, it is kept as the one to run.
+
+****************************************************************************/
+static void boot_own_reset_vector(boot_state_t * p_state)
+{
+    uint16_t target;
+
+    // Nothing to do if page 0 isn't an application's, or is already ours
+    if (JMP_OPCODE != pgm_read_word(0)) return;
+    target = pgm_read_word(RESET_VECTOR_TARGET_ADDR);
+    if ((uint16_t) LIN_Bootloader_Start == target) return;
+
+    boot_eeprom_write(BOOT_APP_START_ADDR, (uint8_t) target);
+    boot_eeprom_write(BOOT_APP_START_ADDR+1, (uint8_t) (target>>8));
+    boot_eeprom_write(BOOT_APP_VALID_ADDR, BOOT_APP_VALID);
+
+    for (uint8_t i = 0; i < LIN_FLASH_PAGE_SIZE; i++)
+    {
+        p_state->page_data[i] = pgm_read_byte(i);
+    }
+    p_state->page_data[RESET_VECTOR_TARGET_ADDR] = (uint8_t) ((uint16_t) LIN_Bootloader_Start);
+    p_state->page_data[RESET_VECTOR_TARGET_ADDR+1] = (uint8_t) (((uint16_t) LIN_Bootloader_Start)>>8);
+    boot_program_page(0, p_state->page_data);
+}
+
+/****************************************************************************
+    Private Function
+        boot_lin_init
+
+    Parameters
+        None
+
+    Description
+        Sets the LIN controller up as lin_init() does, without interrupts
+
+****************************************************************************/
+static void boot_lin_init(void)
+{
+    LIN_PORT_DIR &= ~(1<<LIN_INPUT_PIN );
+    LIN_PORT_DIR &= ~(1<<LIN_OUTPUT_PIN);
+    LIN_PORT_OUT |=  (1<<LIN_INPUT_PIN );
+    LIN_PORT_OUT |=  (1<<LIN_OUTPUT_PIN);
+
+    Lin_full_reset();
+    Lin_set_baudrate(CONF_LINBRR);
+    Lin_2x_enable();
+}
+
+/****************************************************************************
+    Private Function
+        boot_poll_lin
+
+    Parameters
+        boot_state_t * p_state: bootloader state
+
+    Description
+        Serves the diagnostic frames, as the LIN ISR does in the
+        application
+
+****************************************************************************/
+static void boot_poll_lin(boot_state_t * p_state)
+{
+    uint8_t frame[LIN_DIAG_FRAME_LEN];
+    uint8_t id;
+
+    if (LINSIR & LIN_ERROR)
+    {
+        Lin_clear_err_it();
+    }
+
+    // Receive requests, answer with our response if we have one
+    if (Is_lin_header_ready())
+    {
+        id = Lin_get_id();
+        if (LIN_DIAG_MASTER_REQ_ID == id)
+        {
+            Lin_set_rx_len(LIN_DIAG_FRAME_LEN);
+            Lin_rx_response();
+        }
+        else if ((LIN_DIAG_SLAVE_RESP_ID == id) && p_state->tx_ready)
+        {
+            Lin_set_tx_len(LIN_DIAG_FRAME_LEN);
+            Lin_clear_index();
+            for (uint8_t i = 0; i < LIN_DIAG_FRAME_LEN; i++)
+            {
+                Lin_set_data(p_state->tx_frame[i]);
+            }
+            Lin_tx_response();
+        }
+        Lin_clear_idok_it();
+    }
+
+    if (Is_lin_rx_response_ready())
+    {
+        Lin_clear_index();
+        for (uint8_t i = 0; i < LIN_DIAG_FRAME_LEN; i++)
+        {
+            frame[i] = Lin_get_data();
+        }
+        Lin_clear_rxok_it();
+        boot_receive_frame(p_state, frame);
+    }
+
+    if (Is_lin_tx_response_ready())
+    {
+        Lin_clear_txok_it();
+        p_state->tx_ready = false;
+
+        // The master knows the image checked out, run it
+        if (p_state->reset_after_tx)
+        {
+            boot_reset();
+        }
+    }
+}
+
+/****************************************************************************
+    Private Function
+        boot_receive_frame
+
+    Parameters
+        boot_state_t * p_state: bootloader state
+        uint8_t * p_frame: master request frame
+
+    Description
+        Puts the request together from SF, or FF and CF frames (see
+        MS_LIN_top_layer.c), and processes it once it is whole
+
+****************************************************************************/
+static void boot_receive_frame(boot_state_t * p_state, uint8_t * p_frame)
+{
+    uint8_t nad = p_frame[LIN_DIAG_NAD_INDEX];
+    uint8_t pci = p_frame[LIN_DIAG_PCI_INDEX];
+    uint8_t len;
+
+    // Only requests for us or for everyone
+    if ((p_state->nad != nad) && (LIN_DIAG_NAD_BROADCAST != nad)) return;
+
+    // A new request cancels a response we haven't sent
+    p_state->tx_ready = false;
+
+    if (LIN_DIAG_PCI_SF == (pci & LIN_DIAG_PCI_TYPE_MASK))
+    {
+        p_state->rx_len = 0;
+        len = pci & LIN_DIAG_PCI_INFO_MASK;
+        if ((0 != len) && (LIN_DIAG_SF_MAX_LEN >= len))
+        {
+            boot_process_request(p_state, nad, &p_frame[LIN_DIAG_SF_DATA_INDEX], len);
+        }
+    }
+    else if (LIN_DIAG_PCI_FF == (pci & LIN_DIAG_PCI_TYPE_MASK))
+    {
+        p_state->rx_len = 0;
+        len = p_frame[LIN_DIAG_FF_LEN_INDEX];
+        if (    (0 != (pci & LIN_DIAG_PCI_INFO_MASK))
+                ||
+                (LIN_DIAG_FF_DATA_LEN >= len) || (LIN_DIAG_MAX_PDU_LEN < len)
+           )
+        {
+            return;
+        }
+
+        for (uint8_t i = 0; i < LIN_DIAG_FF_DATA_LEN; i++)
+        {
+            p_state->rx_pdu[i] = p_frame[LIN_DIAG_FF_DATA_INDEX+i];
+        }
+        p_state->rx_nad = nad;
+        p_state->rx_len = len;
+        p_state->rx_count = LIN_DIAG_FF_DATA_LEN;
+        p_state->rx_seq = LIN_DIAG_FIRST_CF_SEQ;
+    }
+    else if (LIN_DIAG_PCI_CF == (pci & LIN_DIAG_PCI_TYPE_MASK))
+    {
+        // Drop the request if a frame went missing
+        if (    (0 == p_state->rx_len) || (p_state->rx_nad != nad)
+                ||
+                ((p_state->rx_seq & LIN_DIAG_PCI_INFO_MASK) != (pci & LIN_DIAG_PCI_INFO_MASK))
+           )
+        {
+            p_state->rx_len = 0;
+            return;
+        }
+
+        for (uint8_t i = 0; (i < LIN_DIAG_CF_DATA_LEN) && (p_state->rx_count < p_state->rx_len); i++)
+        {
+            p_state->rx_pdu[p_state->rx_count++] = p_frame[LIN_DIAG_CF_DATA_INDEX+i];
+        }
+        p_state->rx_seq++;
+
+        if (p_state->rx_count >= p_state->rx_len)
+        {
+            len = p_state->rx_len;
+            p_state->rx_len = 0;
+            boot_process_request(p_state, nad, p_state->rx_pdu, len);
+        }
+    }
+}
+
+/****************************************************************************
+    Private Function
+        boot_process_request
+
+    Parameters
+        boot_state_t * p_state: bootloader state
+        uint8_t nad: NAD the request was sent to
+        uint8_t * p_pdu: request PDU
+        uint8_t pdu_len: its length
+
+    Description
+        Processes a request and queues our response, if the request was
+        for us alone
+
+****************************************************************************/
+static void boot_process_request(boot_state_t * p_state, uint8_t nad, uint8_t * p_pdu, \
+    uint8_t pdu_len)
+{
+    uint8_t * p_response = &p_state->tx_frame[LIN_DIAG_SF_DATA_INDEX];
+    uint8_t response_len;
+    uint8_t sid = p_pdu[0];
+
+    if ((LIN_DIAG_SID_TRANSFER_DATA == sid) && (XFER_LEN <= pdu_len))
+    {
+        response_len = boot_transfer_data(p_state, p_pdu, pdu_len, p_response);
+    }
+    else if ((LIN_DIAG_SID_PAGE_STATUS == sid) && (STATUS_LEN <= pdu_len))
+    {
+        response_len = boot_page_status(p_state, p_pdu, p_response);
+    }
+    else if ((LIN_DIAG_SID_TRANSFER_EXIT == sid) && (EXIT_LEN <= pdu_len))
+    {
+        response_len = boot_transfer_exit(p_state, p_pdu, p_response);
+    }
+    else if ((LIN_DIAG_SID_SESSION == sid) && (LIN_DIAG_SESSION_PROGRAMMING == p_pdu[1]))
+    {
+        // Already in the programming session
+        p_response[0] = sid+LIN_DIAG_RSID_OFFSET;
+        p_response[1] = LIN_DIAG_SESSION_PROGRAMMING;
+        response_len = 2;
+    }
+    else
+    {
+        response_len = boot_negative_response(sid, LIN_DIAG_NRC_NOT_SUPPORTED, p_response);
+    }
+
+    // Nobody answers a broadcast request
+    if (LIN_DIAG_NAD_BROADCAST == nad)
+    {
+        if (p_state->reset_after_tx) boot_reset();
+        return;
+    }
+
+    p_state->tx_frame[LIN_DIAG_NAD_INDEX] = p_state->nad;
+    p_state->tx_frame[LIN_DIAG_PCI_INDEX] = LIN_DIAG_PCI_SF|response_len;
+    for (uint8_t i = LIN_DIAG_SF_DATA_INDEX+response_len; i < LIN_DIAG_FRAME_LEN; i++)
+    {
+        p_state->tx_frame[i] = LIN_DIAG_FILL_BYTE;
+    }
+    p_state->tx_ready = true;
+}
+
+/****************************************************************************
+    Private Function
+        boot_transfer_data
+
+    Parameters
+        boot_state_t * p_state: bootloader state
+        uint8_t * p_pdu: transfer request PDU
+        uint8_t pdu_len: its length
+        uint8_t * p_response: where to build the response
+
+    Description
+        Stores a chunk of a page. With the last chunk of the page the page
+        is written, if every chunk arrived and the CRC matches. Returns the
+        response length.
+
+****************************************************************************/
+static uint8_t boot_transfer_data(boot_state_t * p_state, uint8_t * p_pdu, uint8_t pdu_len, \
+    uint8_t * p_response)
+{
+    uint8_t page = p_pdu[XFER_PAGE_INDEX];
+    uint8_t offset = p_pdu[XFER_OFFSET_INDEX];
+    uint16_t crc = BOOT_CRC_INIT;
+
+    // Pages in the bootloader are never written
+    if (    (LIN_FLASH_MAX_PAGES <= page)
+            ||
+            (LIN_FLASH_PAGE_SIZE <= offset) || (0 != (offset % LIN_FLASH_CHUNK_LEN))
+       )
+    {
+        return boot_negative_response(LIN_DIAG_SID_TRANSFER_DATA, LIN_DIAG_NRC_OUT_OF_RANGE, p_response);
+    }
+
+    p_response[0] = LIN_DIAG_SID_TRANSFER_DATA+LIN_DIAG_RSID_OFFSET;
+    p_response[1] = page;
+
+    // Sent again for another slave, we have it
+    if (p_state->written[page>>3] & (1<<(page&7))) return 2;
+
+    // A new page drops what we had of the last one
+    if (p_state->page != page)
+    {
+        p_state->page = page;
+        p_state->page_chunks = 0;
+    }
+    for (uint8_t i = 0; i < LIN_FLASH_CHUNK_LEN; i++)
+    {
+        p_state->page_data[offset+i] = p_pdu[XFER_DATA_INDEX+i];
+    }
+    p_state->page_chunks |= (1<<(offset/LIN_FLASH_CHUNK_LEN));
+
+    if (LAST_CHUNK_OFFSET != offset) return 2;
+
+    // The last chunk carries the CRC of the page
+    for (uint8_t i = 0; i < LIN_FLASH_PAGE_SIZE; i++)
+    {
+        crc = boot_crc_update(crc, p_state->page_data[i]);
+    }
+    if (    (XFER_LAST_LEN > pdu_len) || (ALL_PAGE_CHUNKS != p_state->page_chunks)
+            ||
+            (p_pdu[XFER_CRC_INDEX] != (uint8_t) (crc>>8)) || (p_pdu[XFER_CRC_INDEX+1] != (uint8_t) crc)
+            ||
+            !boot_write_image_page(p_state)
+       )
+    {
+        return boot_negative_response(LIN_DIAG_SID_TRANSFER_DATA, LIN_DIAG_NRC_PROGRAMMING, p_response);
+    }
+
+    return 2;
+}
+
+/****************************************************************************
+    Private Function
+        boot_page_status
+
+    Parameters
+        boot_state_t * p_state: bootloader state
+        uint8_t * p_pdu: status request PDU
+        uint8_t * p_response: where to build the response
+
+    Description
+        Answers which of STATUS_PAGES pages from the first one asked for
+        were written and read back. Returns the response length.
+
+****************************************************************************/
+static uint8_t boot_page_status(boot_state_t * p_state, uint8_t * p_pdu, uint8_t * p_response)
+{
+    uint16_t page;
+
+    p_response[0] = LIN_DIAG_SID_PAGE_STATUS+LIN_DIAG_RSID_OFFSET;
+    p_response[STATUS_FIRST_INDEX] = p_pdu[STATUS_FIRST_INDEX];
+
+    for (uint8_t i = 0; i < STATUS_PAGES; i++)
+    {
+        if (0 == (i&7)) p_response[STATUS_RSP_BITMAP_INDEX+(i>>3)] = 0;
+
+        page = p_pdu[STATUS_FIRST_INDEX]+i;
+        if ((LIN_FLASH_MAX_PAGES > page) && (p_state->written[page>>3] & (1<<(page&7))))
+        {
+            p_response[STATUS_RSP_BITMAP_INDEX+(i>>3)] |= (1<<(i&7));
+        }
+    }
+
+    return STATUS_RSP_LEN;
+}
+
+/****************************************************************************
+    Private Function
+        boot_transfer_exit
+
+    Parameters
+        boot_state_t * p_state: bootloader state
+        uint8_t * p_pdu: exit request PDU
+        uint8_t * p_response: where to build the response
+
+    Description
+        Checks the CRC of the image in flash, with the application's own
+        reset vector, against the master's. If it matches the application
+        is marked good and we reset into it once we have answered. Returns
+        the response length.
+
+****************************************************************************/
+static uint8_t boot_transfer_exit(boot_state_t * p_state, uint8_t * p_pdu, uint8_t * p_response)
+{
+    uint8_t pages = p_pdu[EXIT_PAGES_INDEX];
+    uint16_t crc = BOOT_CRC_INIT;
+    uint16_t address = 0;
+    uint8_t data;
+
+    if ((0 == pages) || (LIN_FLASH_MAX_PAGES < pages))
+    {
+        return boot_negative_response(LIN_DIAG_SID_TRANSFER_EXIT, LIN_DIAG_NRC_OUT_OF_RANGE, p_response);
+    }
+
+    for (uint8_t page = 0; page < pages; page++)
+    {
+        if (0 == (p_state->written[page>>3] & (1<<(page&7))))
+        {
+            return boot_negative_response(LIN_DIAG_SID_TRANSFER_EXIT, LIN_DIAG_NRC_PROGRAMMING, p_response);
+        }
+
+        for (uint8_t i = 0; i < LIN_FLASH_PAGE_SIZE; i++, address++)
+        {
+            // The image had its own start there, not ours
+            if ((RESET_VECTOR_TARGET_ADDR == address) || ((RESET_VECTOR_TARGET_ADDR+1) == address))
+            {
+                data = boot_eeprom_read(BOOT_APP_START_ADDR+address-RESET_VECTOR_TARGET_ADDR);
+            }
+            else
+            {
+                data = pgm_read_byte(address);
+            }
+            crc = boot_crc_update(crc, data);
+        }
+    }
+
+    if ((p_pdu[EXIT_CRC_INDEX] != (uint8_t) (crc>>8)) || (p_pdu[EXIT_CRC_INDEX+1] != (uint8_t) crc))
+    {
+        return boot_negative_response(LIN_DIAG_SID_TRANSFER_EXIT, LIN_DIAG_NRC_PROGRAMMING, p_response);
+    }
+
+    boot_eeprom_write(BOOT_APP_VALID_ADDR, BOOT_APP_VALID);
+    p_state->reset_after_tx = true;
+
+    p_response[0] = LIN_DIAG_SID_TRANSFER_EXIT+LIN_DIAG_RSID_OFFSET;
+    return 1;
+}
+
+/****************************************************************************
+    Private Function
+        boot_negative_response
+
+    Parameters
+        uint8_t sid: service requested
+        uint8_t nrc: negative response code
+        uint8_t * p_response: where to build the response
+
+    Description
+        Builds a negative response and returns its length
+
+****************************************************************************/
+static uint8_t boot_negative_response(uint8_t sid, uint8_t nrc, uint8_t * p_response)
+{
+    p_response[0] = LIN_DIAG_RSID_NEGATIVE;
+    p_response[1] = sid;
+    p_response[2] = nrc;
+    return 3;
+}
+
+/****************************************************************************
+    Private Function
+        boot_write_image_page
+
+    Parameters
+        boot_state_t * p_state: bootloader state, holding a whole page
+
+    Description
+        Writes the page and reads it back. Page 0 keeps our reset vector,
+        the application's start goes to EEPROM. Returns true if the page
+        was written correctly.
+
+****************************************************************************/
+static bool boot_write_image_page(boot_state_t * p_state)
+{
+    uint16_t address = (uint16_t) p_state->page*LIN_FLASH_PAGE_SIZE;
+    uint8_t * p_data = p_state->page_data;
+
+    // The application isn't whole any more
+    if (BOOT_APP_VALID == boot_eeprom_read(BOOT_APP_VALID_ADDR))
+    {
+        boot_eeprom_write(BOOT_APP_VALID_ADDR, (uint8_t) ~BOOT_APP_VALID);
+    }
+
+    if (0 == p_state->page)
+    {
+        if (((uint8_t) JMP_OPCODE != p_data[0]) || ((uint8_t) (JMP_OPCODE>>8) != p_data[1])) return false;
+
+        boot_eeprom_write(BOOT_APP_START_ADDR, p_data[RESET_VECTOR_TARGET_ADDR]);
+        boot_eeprom_write(BOOT_APP_START_ADDR+1, p_data[RESET_VECTOR_TARGET_ADDR+1]);
+        p_data[RESET_VECTOR_TARGET_ADDR] = (uint8_t) ((uint16_t) LIN_Bootloader_Start);
+        p_data[RESET_VECTOR_TARGET_ADDR+1] = (uint8_t) (((uint16_t) LIN_Bootloader_Start)>>8);
+    }
+
+    boot_program_page(address, p_data);
+
+    for (uint8_t i = 0; i < LIN_FLASH_PAGE_SIZE; i++)
+    {
+        if (pgm_read_byte(address+i) != p_data[i]) return false;
+    }
+
+    p_state->written[p_state->page>>3] |= (1<<(p_state->page&7));
+    return true;
+}
+
+/****************************************************************************
+    Private Function
+        boot_program_page
+
+    Parameters
+        uint16_t address: byte address of the page
+        uint8_t * p_data: LIN_FLASH_PAGE_SIZE bytes to write
+
+    Description
+        Erases and writes a flash page. The CPU is halted meanwhile.
+
+****************************************************************************/
+static void boot_program_page(uint16_t address, uint8_t * p_data)
+{
+    // No self programming while the EEPROM is being written
+    while (EECR & (1<<EEPE));
+
+    boot_page_erase(address);
+    boot_spm_busy_wait();
+
+    for (uint8_t i = 0; i < LIN_FLASH_PAGE_SIZE; i += 2)
+    {
+        boot_page_fill(address+i, p_data[i] | (p_data[i+1]<<8));
+    }
+    boot_page_write(address);
+    boot_spm_busy_wait();
+}
+
+/****************************************************************************
+    Private Function
+        boot_crc_update
+
+    Parameters
+        uint16_t crc: CRC so far
+        uint8_t data: next byte
+
+    Description
+        Same as _crc_ccitt_update(), which isn't in our section
+
+****************************************************************************/
+static uint16_t boot_crc_update(uint16_t crc, uint8_t data)
+{
+    data ^= (uint8_t) crc;
+    data ^= data<<4;
+
+    return ((((uint16_t) data<<8) | (crc>>8)) ^ (uint8_t) (data>>4) ^ ((uint16_t) data<<3));
+}
+
+/****************************************************************************
+    Private Function
+        boot_eeprom_read
+
+    Parameters
+        uint16_t address: EEPROM address
+
+    Description
+        Reads an EEPROM byte
+
+****************************************************************************/
+static uint8_t boot_eeprom_read(uint16_t address)
+{
+    while (EECR & (1<<EEPE));
+
+    EEAR = address;
+    EECR |= (1<<EERE);
+    return EEDR;
+}
+
+/****************************************************************************
+    Private Function
+        boot_eeprom_write
+
+    Parameters
+        uint16_t address: EEPROM address
+        uint8_t value: byte to write
+
+    Description
+        Starts writing an EEPROM byte (erase and write)
+
+****************************************************************************/
+static void boot_eeprom_write(uint16_t address, uint8_t value)
+{
+    while (EECR & (1<<EEPE));
+
+    EEAR = address;
+    EEDR = value;
+    EECR = (1<<EEMPE);
+    EECR |= (1<<EEPE);
+}
+
+/****************************************************************************
+    Private Function
+        boot_reset
+
+    Parameters
+        None
+
+    Description
+        Resets the slave with the watchdog
+
+****************************************************************************/
+static void boot_reset(void)
+{
+    wdt_enable(WDTO_15MS);
+    while (1);
+}
@@ -0,0 +1,11 @@
+#ifndef LIN_BOOTLOADER_H
+#define LIN_BOOTLOADER_H
+
+// #############################################################################
+// ------------ PUBLIC FUNCTION PROTOTYPES
+// #############################################################################
+
+void Enter_LIN_Bootloader(void) __attribute__((noreturn));
+void LIN_Bootloader_Start(void) __attribute__((noreturn));
+
+#endif // LIN_BOOTLOADER_H
@@ -0,0 +1,795 @@
+/*******************************************************************************
+    File:
+        lin_flasher.c
+
+    Notes:
+        This file contains the master side of flashing the slaves over the
+        LIN diagnostic frames (services in config.h). The slaves run the
+        bootloader in lin_bootloader.c while they are flashed.
+
+        The modem holds the image, the master fetches it over CAN 3 bytes at
+        a time (see the flashing messages in config.h) and passes it on to
+        the slaves in chunks of LIN_FLASH_CHUNK_LEN bytes:
+            1.  A broadcast request puts every slave in its bootloader.
+            2.  Every page is broadcast once, so all slaves are flashed at
+                the same time. The last chunk of a page carries the CRC of
+                the page, a slave only writes a page that checks out.
+            3.  Each slave is asked which pages it wrote and read back
+                correctly. The pages any slave lacks are sent again, to
+                that slave alone if only one slave lacks pages, otherwise
+                broadcast (slaves skip the pages they already have). This
+                repeats up to FLASH_MAX_ROUNDS times.
+            4.  Each slave is given the CRC of the whole image. A slave whose
+                flash matches it resets into the new image.
+        Flashing all slaves takes about as long as flashing one, it is
+        bound by fetching the image over CAN. The master runs only the
+        diagnostic slots and polls CAN faster while flashing (see
+        master_service.c).
+
+        A slave that fails stays in its bootloader (also after a reset)
+        until it is flashed successfully.
+
+    External Functions Required:
+        Master_LIN_Diag_Send_Request(), Master_LIN_Diag_Get_Response(),
+        Master_LIN_Diag_Is_Busy(), Put_CAN_TX_Frame()
+
+    Public Functions:
+        bool Start_LIN_Flash(uint8_t pages, uint32_t slave_bitmap)
+        bool LIN_Flash_In_Progress(void)
+        bool Run_LIN_Flash_CAN(uint8_t * p_msg)
+        bool Run_LIN_Flash_Diag(void)
+        void Get_LIN_Flash_Report(lin_flash_report_t * p_report)
+
+*******************************************************************************/
+
+// #############################################################################
+// ------------ INCLUDES
+// #############################################################################
+
+// Standard ANSI  99 C types for exact integer sizes and booleans
+#include <stdint.h>
+#include <stdbool.h>
+
+// Config file
+#include "config.h"
+
+// Framework
+#include "framework.h"
+
+// This module's header file
+#include "lin_flasher.h"
+
+// Include other files below:
+
+// LIN top layer
+#include "MS_LIN_top_layer.h"
+
+// CAN transmit queue
+#include "can_tx_queue.h"
+
+// CRC-CCITT
+#include <util/crc16.h>
+
+// memset
+#include <string.h>
+
+// #############################################################################
+// ------------ MODULE DEFINITIONS
+// #############################################################################
+
+// CAN polls an answer to a fetch may take, and fetches before giving up
+#define FLASH_FETCH_POLLS           (10)
+#define FLASH_FETCH_TRIES           (5)
+
+// Status and exit requests per slave, the slave may still be writing the
+//  last page when it is first asked
+#define FLASH_QUERY_TRIES           (3)
+
+// Rounds of sending the pages the slaves lack
+#define FLASH_MAX_ROUNDS            (8)
+
+#define FLASH_CRC_INIT              (0xFFFF)
+
+// Transfer request PDU layout
+#define XFER_SID_INDEX              (0)
+#define XFER_PAGE_INDEX             (1)
+#define XFER_OFFSET_INDEX           (2)
+#define XFER_DATA_INDEX             (3)
+#define XFER_CRC_INDEX              (XFER_DATA_INDEX+LIN_FLASH_CHUNK_LEN)
+#define XFER_LEN                    (XFER_CRC_INDEX)
+#define XFER_LAST_LEN               (XFER_CRC_INDEX+2)
+
+// Status request and response PDU layout
+#define STATUS_SID_INDEX            (0)
+#define STATUS_FIRST_INDEX          (1)
+#define STATUS_LEN                  (2)
+#define STATUS_RSP_BITMAP_INDEX     (2)
+#define STATUS_RSP_LEN              (6)
+#define STATUS_PAGES                (32)
+
+// Exit request PDU layout
+#define EXIT_SID_INDEX              (0)
+#define EXIT_PAGES_INDEX            (1)
+#define EXIT_CRC_INDEX              (2)
+#define EXIT_LEN                    (4)
+
+// Bit of a slave in a bitmap
+#define GET_SLAVE_BIT(slave_number)     (1UL<<(slave_number))
+
+// #############################################################################
+// ------------ TYPE DEFINITIONS
+// #############################################################################
+
+// Master flashing states
+typedef enum
+{
+    flash_idle = 0,
+    flash_entering,             // Programming session request going out
+    flash_fetching,             // Waiting for image bytes from the modem
+    flash_sending,              // Chunk going out to the slaves
+    flash_checking,             // Asking a slave which pages it has
+    flash_exiting               // Having a slave check the image and reset
+} flash_state_t;
+
+// #############################################################################
+// ------------ MODULE VARIABLES
+// #############################################################################
+
+static flash_state_t Flash_State = flash_idle;
+static uint8_t Page_Count = 0;
+static uint32_t Slave_Bitmap = 0;           // Slaves being flashed
+static uint32_t Failed_Bitmap = 0;          // Slaves given up on
+static uint32_t Incomplete_Bitmap = 0;      // Slaves lacking pages
+static uint8_t Missing_Pages[(LIN_FLASH_MAX_PAGES+7)/8];    // Pages to send
+static bool First_Pass = false;             // Sending every page in order
+static uint8_t Rounds_Left = 0;
+static uint8_t Target_NAD = LIN_DIAG_NAD_BROADCAST;
+
+// Page being sent
+static uint8_t Page = 0;
+static uint8_t Page_Offset = 0;             // Bytes fetched so far
+static uint16_t Page_CRC = FLASH_CRC_INIT;
+static uint16_t Image_CRC = FLASH_CRC_INIT;
+static uint8_t Chunk_PDU[XFER_LAST_LEN];
+static uint8_t Chunk_Len = 0;               // Bytes in the chunk so far
+static uint8_t Fetch_Polls_Left = 0;
+static uint8_t Fetch_Tries_Left = 0;
+
+// Slave being checked or told to exit
+static uint8_t Check_Slave = INVALID_SLAVE_NUMBER;
+static uint8_t Check_First_Page = 0;
+static uint8_t Query_Tries_Left = 0;
+
+static lin_flash_report_t Report = {0};
+
+// #############################################################################
+// ------------ PRIVATE FUNCTION PROTOTYPES
+// #############################################################################
+
+static bool send_next_page(void);
+static void start_page(uint8_t page);
+static void fetch(void);
+static void take_image_bytes(uint8_t * p_data);
+static void send_chunk(void);
+static bool start_check(void);
+static void send_query(void);
+static bool check_response(void);
+static bool start_exit(void);
+static void send_exit(void);
+static bool exit_response(void);
+static bool finish(lin_flash_result_t result);
+static uint8_t next_slave(uint8_t slave_number);
+
+// #############################################################################
+// ------------ PUBLIC FUNCTIONS
+// #############################################################################
+
+/****************************************************************************
+    Public Function
+        Start_LIN_Flash
+
+    Parameters
+        uint8_t pages: image length in pages (1 to LIN_FLASH_MAX_PAGES)
+        uint32_t slave_bitmap: slaves to flash, bit n is set for slave n
+
+    Description
+        Starts flashing the slaves. Returns false if flashing is already
+        running, the image doesn't fit or a diagnostic request is in
+        progress. Run_LIN_Flash_CAN() must be called on every CAN poll and
+        Run_LIN_Flash_Diag() on every EVT_MASTER_DIAG_RESPONSE until one of
+        them returns true.
+
+****************************************************************************/
+bool Start_LIN_Flash(uint8_t pages, uint32_t slave_bitmap)
+{
+    uint8_t request[] = {LIN_DIAG_SID_SESSION, LIN_DIAG_SESSION_PROGRAMMING};
+
+    if (flash_idle != Flash_State) return false;
+    if ((0 == pages) || (LIN_FLASH_MAX_PAGES < pages)) return false;
+    if (Master_LIN_Diag_Is_Busy()) return false;
+
+    Page_Count = pages;
+    Slave_Bitmap = slave_bitmap;
+    Failed_Bitmap = 0;
+    Rounds_Left = FLASH_MAX_ROUNDS;
+    Image_CRC = FLASH_CRC_INIT;
+    Target_NAD = LIN_DIAG_NAD_BROADCAST;
+
+    // The first pass sends every page
+    First_Pass = true;
+    memset(Missing_Pages, 0, sizeof(Missing_Pages));
+    for (uint8_t page = 0; page < Page_Count; page++)
+    {
+        Missing_Pages[page>>3] |= (1<<(page&7));
+    }
+
+    // Put every slave in its bootloader, EVT_MASTER_DIAG_RESPONSE follows
+    //  once the request is out
+    Master_LIN_Diag_Send_Request(LIN_DIAG_NAD_BROADCAST, request, sizeof(request));
+    Flash_State = flash_entering;
+
+    return true;
+}
+
+/****************************************************************************
+    Public Function
+        LIN_Flash_In_Progress
+
+    Parameters
+        None
+
+    Description
+        Returns true while the slaves are being flashed
+
+****************************************************************************/
+bool LIN_Flash_In_Progress(void)
+{
+    return (flash_idle != Flash_State);
+}
+
+/****************************************************************************
+    Public Function
+        Run_LIN_Flash_CAN
+
+    Parameters
+        uint8_t * p_msg: new CAN message from the modem, NULL if none
+
+    Description
+        Takes the image bytes the modem sent, and fetches them again if the
+        modem takes too long. Returns true when flashing has ended (the
+        modem stopped answering).
+
+****************************************************************************/
+bool Run_LIN_Flash_CAN(uint8_t * p_msg)
+{
+    if (flash_fetching != Flash_State) return false;
+
+    // The bytes we asked for
+    if (    (NULL != p_msg)
+            &&
+            (CAN_MODEM_FLASH_DATA_TYPE == p_msg[CAN_MODEM_TYPE_IDX])
+            &&
+            (Page_Offset == p_msg[CAN_MODEM_FLASH_OFFSET_IDX])
+       )
+    {
+        take_image_bytes(&p_msg[CAN_MODEM_FLASH_DATA_IDX]);
+
+        // Send a full chunk, otherwise fetch the rest of it
+        Fetch_Tries_Left = FLASH_FETCH_TRIES;
+        if (LIN_FLASH_CHUNK_LEN == Chunk_Len)
+        {
+            send_chunk();
+        }
+        else
+        {
+            fetch();
+        }
+        return false;
+    }
+
+    // Still waiting
+    if (0 != --Fetch_Polls_Left) return false;
+
+    // Ask again, unless the modem has stopped answering
+    if (0 == Fetch_Tries_Left) return finish(lin_flash_no_image);
+    fetch();
+    return false;
+}
+
+/****************************************************************************
+    Public Function
+        Run_LIN_Flash_Diag
+
+    Parameters
+        None
+
+    Description
+        Moves flashing on after a diagnostic request went out or its
+        response came back. Returns true when flashing has ended.
+
+****************************************************************************/
+bool Run_LIN_Flash_Diag(void)
+{
+    switch (Flash_State)
+    {
+        case flash_entering:
+            // The slaves are in their bootloaders
+            return send_next_page();
+
+        case flash_sending:
+            // The rest of the page, or the next page
+            if (LIN_FLASH_PAGE_SIZE > Page_Offset)
+            {
+                Chunk_Len = 0;
+                Fetch_Tries_Left = FLASH_FETCH_TRIES;
+                fetch();
+                return false;
+            }
+            Missing_Pages[Page>>3] &= ~(1<<(Page&7));
+            return send_next_page();
+
+        case flash_checking:
+            return check_response();
+
+        case flash_exiting:
+            return exit_response();
+
+        default:
+            return false;
+    }
+}
+
+/****************************************************************************
+    Public Function
+        Get_LIN_Flash_Report
+
+    Parameters
+        lin_flash_report_t * p_report: where to copy the outcome
+
+    Description
+        Copies the outcome of the last flashing
+
+****************************************************************************/
+void Get_LIN_Flash_Report(lin_flash_report_t * p_report)
+{
+    memcpy(p_report, &Report, sizeof(Report));
+}
+
+// #############################################################################
+// ------------ PRIVATE FUNCTIONS
+// #############################################################################
+
+/****************************************************************************
+    Private Function
+        send_next_page
+
+    Parameters
+        None
+
+    Description
+        Starts sending the lowest page still missing, or checks the slaves
+        once every page has been sent. Returns true if flashing ended.
+
+****************************************************************************/
+static bool send_next_page(void)
+{
+    for (uint8_t page = 0; page < Page_Count; page++)
+    {
+        if (Missing_Pages[page>>3] & (1<<(page&7)))
+        {
+            start_page(page);
+            return false;
+        }
+    }
+
+    return start_check();
+}
+
+/****************************************************************************
+    Private Function
+        start_page
+
+    Parameters
+        uint8_t page: page to send
+
+    Description
+        Starts fetching a page from the modem
+
+****************************************************************************/
+static void start_page(uint8_t page)
+{
+    Page = page;
+    Page_Offset = 0;
+    Page_CRC = FLASH_CRC_INIT;
+    Chunk_Len = 0;
+    Fetch_Tries_Left = FLASH_FETCH_TRIES;
+    fetch();
+}
+
+/****************************************************************************
+    Private Function
+        fetch
+
+    Parameters
+        None
+
+    Description
+        Asks the modem for the next image bytes of the page
+
+****************************************************************************/
+static void fetch(void)
+{
+    uint8_t msg[CAN_FLASH_FETCH_LEN];
+
+    msg[CAN_MODEM_TYPE_IDX] = CAN_MODEM_FLASH_TYPE;
+    msg[CAN_FLASH_MSG_IDX] = CAN_FLASH_MSG_FETCH;
+    msg[CAN_FLASH_FETCH_PAGE_IDX] = Page;
+    msg[CAN_FLASH_FETCH_OFFSET_IDX] = Page_Offset;
+    Put_CAN_TX_Frame(CAN_TX_PRIORITY_REPLY, CAN_FLASH_FETCH_LEN, msg, NULL);
+
+    Fetch_Tries_Left--;
+    Fetch_Polls_Left = FLASH_FETCH_POLLS;
+    Flash_State = flash_fetching;
+}
+
+/****************************************************************************
+    Private Function
+        take_image_bytes
+
+    Parameters
+        uint8_t * p_data: CAN_MODEM_FLASH_DATA_LEN image bytes
+
+    Description
+        Adds the image bytes to the chunk, up to the end of the chunk, and
+        to the CRCs
+
+****************************************************************************/
+static void take_image_bytes(uint8_t * p_data)
+{
+    uint8_t count = CAN_MODEM_FLASH_DATA_LEN;
+
+    // Chunks end on a page boundary, so this also stops at the page end
+    if ((LIN_FLASH_CHUNK_LEN-Chunk_Len) < count)
+    {
+        count = LIN_FLASH_CHUNK_LEN-Chunk_Len;
+    }
+
+    for (uint8_t i = 0; i < count; i++)
+    {
+        Chunk_PDU[XFER_DATA_INDEX+Chunk_Len++] = p_data[i];
+        Page_CRC = _crc_ccitt_update(Page_CRC, p_data[i]);
+
+        // The pages go out in order the first time
+        if (First_Pass)
+        {
+            Image_CRC = _crc_ccitt_update(Image_CRC, p_data[i]);
+        }
+    }
+    Page_Offset += count;
+}
+
+/****************************************************************************
+    Private Function
+        send_chunk
+
+    Parameters
+        None
+
+    Description
+        Sends the chunk to the slaves, with the CRC of the page if it ends
+        the page
+
+****************************************************************************/
+static void send_chunk(void)
+{
+    uint8_t len = XFER_LEN;
+
+    Chunk_PDU[XFER_SID_INDEX] = LIN_DIAG_SID_TRANSFER_DATA;
+    Chunk_PDU[XFER_PAGE_INDEX] = Page;
+    Chunk_PDU[XFER_OFFSET_INDEX] = Page_Offset-LIN_FLASH_CHUNK_LEN;
+
+    if (LIN_FLASH_PAGE_SIZE == Page_Offset)
+    {
+        Chunk_PDU[XFER_CRC_INDEX] = (uint8_t) (Page_CRC>>8);
+        Chunk_PDU[XFER_CRC_INDEX+1] = (uint8_t) Page_CRC;
+        len = XFER_LAST_LEN;
+    }
+
+    Master_LIN_Diag_Send_Request(Target_NAD, Chunk_PDU, len);
+    Flash_State = flash_sending;
+}
+
+/****************************************************************************
+    Private Function
+        start_check
+
+    Parameters
+        None
+
+    Description
+        Starts asking the slaves which pages they have. Returns true if
+        flashing ended (no slave left).
+
+****************************************************************************/
+static bool start_check(void)
+{
+    First_Pass = false;
+    memset(Missing_Pages, 0, sizeof(Missing_Pages));
+    Incomplete_Bitmap = 0;
+
+    Check_Slave = next_slave(LOWEST_SLAVE_NUMBER-1);
+    if (INVALID_SLAVE_NUMBER == Check_Slave) return finish(lin_flash_slaves_failed);
+
+    Check_First_Page = 0;
+    Query_Tries_Left = FLASH_QUERY_TRIES;
+    send_query();
+    return false;
+}
+
+/****************************************************************************
+    Private Function
+        send_query
+
+    Parameters
+        None
+
+    Description
+        Asks the slave being checked which of the next STATUS_PAGES pages
+        it has
+
+****************************************************************************/
+static void send_query(void)
+{
+    uint8_t request[STATUS_LEN];
+
+    request[STATUS_SID_INDEX] = LIN_DIAG_SID_PAGE_STATUS;
+    request[STATUS_FIRST_INDEX] = Check_First_Page;
+    Master_LIN_Diag_Send_Request(GET_SLAVE_NAD(Check_Slave), request, STATUS_LEN);
+
+    Query_Tries_Left--;
+    Flash_State = flash_checking;
+}
+
+/****************************************************************************
+    Private Function
+        check_response
+
+    Parameters
+        None
+
+    Description
+        Notes the pages the slave lacks, then asks about the next pages or
+        the next slave. Once every slave has answered, sends the missing
+        pages again or has the slaves check the image. Returns true if
+        flashing ended.
+
+****************************************************************************/
+static bool check_response(void)
+{
+    uint8_t response[LIN_DIAG_MAX_PDU_LEN];
+    uint8_t response_len = Master_LIN_Diag_Get_Response(response);
+    uint8_t page;
+
+    if (    (STATUS_RSP_LEN <= response_len)
+            &&
+            ((LIN_DIAG_SID_PAGE_STATUS+LIN_DIAG_RSID_OFFSET) == response[STATUS_SID_INDEX])
+            &&
+            (Check_First_Page == response[STATUS_FIRST_INDEX])
+       )
+    {
+        for (uint8_t i = 0; i < STATUS_PAGES; i++)
+        {
+            page = Check_First_Page+i;
+            if (Page_Count <= page) break;
+
+            if (0 == (response[STATUS_RSP_BITMAP_INDEX+(i>>3)] & (1<<(i&7))))
+            {
+                Missing_Pages[page>>3] |= (1<<(page&7));
+                Incomplete_Bitmap |= GET_SLAVE_BIT(Check_Slave);
+            }
+        }
+        Check_First_Page += STATUS_PAGES;
+        Query_Tries_Left = FLASH_QUERY_TRIES;
+    }
+    else if (0 != Query_Tries_Left)
+    {
+        // Ask again
+        send_query();
+        return false;
+    }
+    else
+    {
+        // Give up on a slave that doesn't answer
+        Failed_Bitmap |= GET_SLAVE_BIT(Check_Slave);
+        Check_First_Page = Page_Count;
+    }
+
+    // The slave's next pages
+    if (Page_Count > Check_First_Page)
+    {
+        send_query();
+        return false;
+    }
+
+    // The next slave
+    Check_Slave = next_slave(Check_Slave);
+    if (INVALID_SLAVE_NUMBER != Check_Slave)
+    {
+        Check_First_Page = 0;
+        Query_Tries_Left = FLASH_QUERY_TRIES;
+        send_query();
+        return false;
+    }
+
+    // Every slave has every page
+    if (0 == Incomplete_Bitmap) return start_exit();
+
+    // Out of rounds, the slaves still lacking pages have failed
+    if (0 == Rounds_Left)
+    {
+        Failed_Bitmap |= Incomplete_Bitmap;
+        return start_exit();
+    }
+    Rounds_Left--;
+
+    // Only send to the slave that lacks pages if it is the only one
+    Target_NAD = LIN_DIAG_NAD_BROADCAST;
+    if (0 == (Incomplete_Bitmap & (Incomplete_Bitmap-1)))
+    {
+        for (uint8_t slave_num = LOWEST_SLAVE_NUMBER; slave_num <= HIGHEST_SLAVE_NUMBER; slave_num++)
+        {
+            if (Incomplete_Bitmap & GET_SLAVE_BIT(slave_num))
+            {
+                Target_NAD = GET_SLAVE_NAD(slave_num);
+            }
+        }
+    }
+
+    return send_next_page();
+}
+
+/****************************************************************************
+    Private Function
+        start_exit
+
+    Parameters
+        None
+
+    Description
+        Starts having the slaves check the image and reset into it. Returns
+        true if flashing ended (no slave left).
+
+****************************************************************************/
+static bool start_exit(void)
+{
+    Check_Slave = next_slave(LOWEST_SLAVE_NUMBER-1);
+    if (INVALID_SLAVE_NUMBER == Check_Slave) return finish(lin_flash_slaves_failed);
+
+    Query_Tries_Left = FLASH_QUERY_TRIES;
+    send_exit();
+    return false;
+}
+
+/****************************************************************************
+    Private Function
+        send_exit
+
+    Parameters
+        None
+
+    Description
+        Gives the slave the length and CRC of the image to check its flash
+        against
+
+****************************************************************************/
+static void send_exit(void)
+{
+    uint8_t request[EXIT_LEN];
+
+    request[EXIT_SID_INDEX] = LIN_DIAG_SID_TRANSFER_EXIT;
+    request[EXIT_PAGES_INDEX] = Page_Count;
+    request[EXIT_CRC_INDEX] = (uint8_t) (Image_CRC>>8);
+    request[EXIT_CRC_INDEX+1] = (uint8_t) Image_CRC;
+    Master_LIN_Diag_Send_Request(GET_SLAVE_NAD(Check_Slave), request, EXIT_LEN);
+
+    Query_Tries_Left--;
+    Flash_State = flash_exiting;
+}
+
+/****************************************************************************
+    Private Function
+        exit_response
+
+    Parameters
+        None
+
+    Description
+        Notes whether the slave took the image, then moves on to the next
+        slave. A slave that doesn't answer is asked again, it resets only
+        once it has answered. Returns true if flashing ended.
+
+****************************************************************************/
+static bool exit_response(void)
+{
+    uint8_t response[LIN_DIAG_MAX_PDU_LEN];
+    uint8_t response_len = Master_LIN_Diag_Get_Response(response);
+
+    if ((0 == response_len) && (0 != Query_Tries_Left))
+    {
+        send_exit();
+        return false;
+    }
+
+    if (    (0 == response_len)
+            ||
+            ((LIN_DIAG_SID_TRANSFER_EXIT+LIN_DIAG_RSID_OFFSET) != response[EXIT_SID_INDEX])
+       )
+    {
+        Failed_Bitmap |= GET_SLAVE_BIT(Check_Slave);
+    }
+
+    Check_Slave = next_slave(Check_Slave);
+    if (INVALID_SLAVE_NUMBER == Check_Slave) return finish(lin_flash_done);
+
+    Query_Tries_Left = FLASH_QUERY_TRIES;
+    send_exit();
+    return false;
+}
+
+/****************************************************************************
+    Private Function
+        finish
+
+    Parameters
+        lin_flash_result_t result: how flashing ended
+
+    Description
+        Ends flashing and fills in the report. Returns true.
+
+****************************************************************************/
+static bool finish(lin_flash_result_t result)
+{
+    if ((lin_flash_done == result) && (0 != Failed_Bitmap))
+    {
+        result = lin_flash_slaves_failed;
+    }
+
+    // Slaves that never got to the end have failed too
+    if (lin_flash_no_image == result)
+    {
+        Failed_Bitmap = Slave_Bitmap;
+    }
+
+    Report.result = result;
+    Report.pages = Page_Count;
+    Report.failed_bitmap = Failed_Bitmap;
+
+    Flash_State = flash_idle;
+    return true;
+}
+
+/****************************************************************************
+    Private Function
+        next_slave
+
+    Parameters
+        uint8_t slave_number: slave to start after
+
+    Description
+        Returns the next slave being flashed that hasn't failed, or
+        INVALID_SLAVE_NUMBER if there is none
+
+****************************************************************************/
+static uint8_t next_slave(uint8_t slave_number)
+{
+    while (HIGHEST_SLAVE_NUMBER > slave_number)
+    {
+        slave_number++;
+        if ((Slave_Bitmap & ~Failed_Bitmap) & GET_SLAVE_BIT(slave_number))
+        {
+            return slave_number;
+        }
+    }
+
+    return INVALID_SLAVE_NUMBER;
+}
@@ -0,0 +1,34 @@
+#ifndef LIN_FLASHER_H
+#define LIN_FLASHER_H
+
+// #############################################################################
+// ------------ TYPE DEFINITIONS
+// #############################################################################
+
+// How flashing the slaves ended
+typedef enum
+{
+    lin_flash_done = 0,             // Every slave runs the new image
+    lin_flash_slaves_failed,        // Some slaves didn't take the image
+    lin_flash_no_image              // The modem stopped sending the image
+} lin_flash_result_t;
+
+// Outcome of the last flashing (master)
+typedef struct
+{
+    lin_flash_result_t result;
+    uint8_t         pages;              // Image length
+    uint32_t        failed_bitmap;      // Slaves that failed, bit n = slave n
+} lin_flash_report_t;
+
+// #############################################################################
+// ------------ PUBLIC FUNCTION PROTOTYPES
+// #############################################################################
+
+bool Start_LIN_Flash(uint8_t pages, uint32_t slave_bitmap);
+bool LIN_Flash_In_Progress(void);
+bool Run_LIN_Flash_CAN(uint8_t * p_msg);
+bool Run_LIN_Flash_Diag(void);
+void Get_LIN_Flash_Report(lin_flash_report_t * p_report);
+
+#endif // LIN_FLASHER_H
@@ -37,6 +37,12 @@
 // CAN layer
 #include "CAN.h"
 
+// CAN receive FIFO
+#include "can_rx_fifo.h"
+
+// CAN transmit queue
+#include "can_tx_queue.h"
+
 // Command and Status Helpers
 #include "cmd_sts_helpers.h"
 
@@ -52,6 +58,21 @@
 // Slave Parameters
 #include "slave_parameters.h"
 
+// Diagnostics
+#include "LIN_diagnostics.h"
+
+// Slave health
+#include "slave_health.h"
+
+// EEPROM
+#include "eeprom_storage.h"
+
+// Auto-addressing
+#include "auto_addressing.h"
+
+// Flashing the slaves
+#include "lin_flasher.h"
+
 // Atomic Read/Write operations
 #include <util/atomic.h>
 
@@ -62,31 +83,84 @@
 // Master array length
 #define MASTER_DATA_LENGTH      (NUM_SLAVES*LIN_PACKET_LEN)
 
-// Schedule Start/End IDs
+// Schedule Start/End IDs (the end moves with the number of slaves on the bus)
 #define SCHEDULE_START_ID       (GET_SLAVE_BASE_ID(LOWEST_SLAVE_NUMBER))
-#define SCHEDULE_END_ID         (GET_SLAVE_BASE_ID(HIGHEST_SLAVE_NUMBER)|REQUEST_MASK)
+#define SCHEDULE_END_ID         (GET_SLAVE_BASE_ID(Round_Slave_Count)|REQUEST_MASK)
+
+// Event-triggered status slot after the last slave
+#define SCHEDULE_EVENT_SLOT     (LIN_EVENT_STATUS_ID)
+
+// Extended status slot, after the command of the slave whose turn it is
+#define SCHEDULE_EXT_SLOT       (LIN_EXT_STATUS_ID)
+
+// Rounds between event-triggered slots while no slave was sent a changed
+//  command, the slot is left out of the rounds in between
+#define EVENT_SLOT_ROUNDS       (4)
+
+// Spare slot at the end of the schedule, only used for diagnostic frames
+#define SCHEDULE_DIAG_SLOT      (LIN_DIAG_MASTER_REQ_ID)
+
+// Bit for a slave in the slave bitmaps, and the bits of the first count slaves
+#define SLAVE_BIT(slave_number)         (1UL<<(slave_number))
+#define SLAVE_BITS(count)               (SLAVE_BIT((count)+LOWEST_SLAVE_NUMBER)-SLAVE_BIT(LOWEST_SLAVE_NUMBER))
+
+// Number of slaves on the bus, kept in EEPROM
+#define SLAVE_COUNT_ADDR        ((uint8_t *) EEPROM_SLAVE_COUNT_ADDR)
+#define SLAVE_COUNT_LEN         (1)
 
 // Schedule Interval
 // Minimum for Interval is:
 //    T_Frame_Nominal = T_Header_Nominal + T_Response_Nominal
 //    T_Header_Nominal = 34*Bit_Time = 34*(1/19200)
-//    T_Response_Nominal = 10*(Num_Data_Bytes+1)*Bit_time = 10*(3+1)*(1/19200)
-//    T_Frame_Nominal = 0.00385 seconds
+//    T_Response_Nominal = 10*(Num_Data_Bytes+1)*Bit_time = 10*(5+1)*(1/19200)
+//    T_Frame_Nominal = 0.00490 seconds
 #define SCHEDULE_INTERVAL_MS    (5)             // Because our system timer
                                                 //  has resolution of 0.5 ms
 
+// 8 byte frames (extended status and diagnostics) need a longer slot:
+//    T_Frame_Nominal = (34+10*(8+1))*(1/19200) = 0.00646 seconds
+#define LONG_SCHEDULE_INTERVAL_MS   (7)
+
 // *Note:
-//      Our schedule service time is then 2*#Slave_Nodes*SCHEDULE_INTERVAL_MS
+//      Our schedule service time is then (#Commands_Due+2)*SCHEDULE_INTERVAL_MS
+//      plus one SCHEDULE_INTERVAL_MS for each status polled that round
+//      (plus one SCHEDULE_INTERVAL_MS while diagnostic traffic is pending,
+//      and one for the commit frame after changed commands).
+//      The extended status and diagnostic slots take LONG_SCHEDULE_INTERVAL_MS.
+//      A changed command waits for at most one slot per other slave with
+//      a changed command (plus the slot in progress), however many slaves
+//      are on the bus.
+
+// Wake up pulse length, the LIN spec asks for 250us to 5ms
+// (our system timer has a resolution of 0.5 ms)
+#define LIN_WAKE_PULSE_MS       (2)
+
+// Time the slaves get to wake up before the schedule restarts
+#define LIN_WAKE_UP_DELAY_MS    (100)
 
 // Time in ms it takes to complete the CAN step 1 initializations
 #define CAN_INIT_1_MS           (200)
 
-// Time interval that passes between polling our volatile instance of the CAN
-// message
+// Time interval that passes between polling the CAN receive FIFO, frames
+//  are processed when they arrive (EVT_CAN_FRAME_RECEIVED) so the poll is a
+//  fallback and paces diagnostic replies
 #define CAN_POLL_INTERVAL_MS    (50)
 
-// MEMCMP equal
-#define MEMCMP_EQUAL            (0)
+// While the slaves are flashed the image comes in one CAN message per poll
+#define CAN_FLASH_POLL_INTERVAL_MS  (5)
+
+// #############################################################################
+// ------------ TYPE DEFINITIONS
+// #############################################################################
+
+// State of the LIN schedule
+typedef enum
+{
+    schedule_running = 0,   // Sending headers
+    schedule_asleep,        // Go-to-sleep command sent, no headers
+    schedule_wake_pulse,    // Sending the wake up pulse
+    schedule_wake_wait      // Waiting for the slaves to wake up
+} schedule_state_t;
 
 // #############################################################################
 // ------------ MODULE VARIABLES
@@ -95,41 +169,112 @@
 // These values should only exist in a single module for each node
 static uint8_t My_Node_ID = 0;                              // This node's ID
 static uint8_t My_Command_Data[MASTER_DATA_LENGTH] = {0};   // Commands for slaves
-static uint8_t My_Status_Data[MASTER_DATA_LENGTH] = {0};    // Slaves' stati
-static uint8_t * p_My_Command_Data = My_Command_Data;
-static uint8_t * p_My_Status_Data = My_Status_Data;
+
+// Single buffered store for the commands, there is no room for two.
+// Each command is written whole, and the schedule handler leaves a staged
+//  one alone until the scene is committed (see Staged_Command_Bitmap).
+static data_store_t My_Command_Store;
+
+// Slaves whose last status echoed the sequence number of their command,
+//  bit n is slave n. It's all we keep of the stati (see take_status()).
+static uint32_t Acked_Bitmap = 0;
 
 // Scheduling Timer
 static uint32_t Scheduling_Timer = NON_EVENT;
 
+// Number of slaves on the bus (1 to NUM_SLAVES), set over CAN
+// The schedule handler takes a new count on at the start of a round
+static uint8_t Slave_Count = NUM_SLAVES;
+static uint8_t Round_Slave_Count = NUM_SLAVES;  // Count this round
+
 // Curr_Schedule_ID
 // The schedule is simple:
-//    1. Command Slave Node #1 (ID = 0x02)
-//    2. Request status from Slave Node #1 (ID = 0x03)
-//    3. Command Slave Node #2 (ID = 0x04)
-//    4. Request status from Slave Node #2 (ID = 0x05)
+//    1. Command Slave Node #1 (ID = 0x02), if due
+//    T. Extended status from Slave Node #1 (ID = 0x3E), if its turn
+//    2. Request status from Slave Node #1 (ID = 0x03), if polled
+//    3. Command Slave Node #2 (ID = 0x04), if due
+//    4. Request status from Slave Node #2 (ID = 0x05), if polled
 //    ...
-//    Y. Command Slave Node #N (ID = NUM_SLAVES*2)
-//    Z. Request status from Slave Node #N (ID = (NUM_SLAVES*2)+1)
+//    Y. Command Slave Node #N (ID = N*2), if due
+//    Z. Request status from Slave Node #N (ID = (N*2)+1), if polled
+//    E. Event-triggered status (ID = 0x01), answered by changed slaves,
+//       every EVENT_SLOT_ROUNDS rounds unless a slave was sent a command
+//    D. Diagnostic request/response (ID = 0x3C/0x3D), skipped if unused
 //    >>> Repeat 1-X.
+// A new scene from a position message goes to every slave at once in the
+//  next slot, in the scene frame (ID = 0x3F), and each slave works out its
+//  own command. Any other command that changes is sent in the next slot,
+//  ahead of the round (see Command_Pending_Bitmap). With STAGED_COMMANDS a
+//  commit frame (ID = 0x00) follows once no changed command is left, for
+//  the slaves to apply them together. In the round a command is only due
+//  until the slave's status shows it applied it, and for the slave whose
+//  turn it is, so a round doesn't grow with the number of slaves that are
+//  settled.
+// A slave reports a changed status in the event-triggered slot. Its status
+//  is only polled individually after a collision in that slot, if it was
+//  sent a changed command that the slot didn't show it applied, while it
+//  is not online (see slave_health.c), and in turn once every N rounds so
+//  its health is still tracked. After a collision only the slaves sent a
+//  changed command are polled, as they are the ones that answered.
+// Offline slaves are skipped, except for their occasional rediscovery polls
+//  (see slave_health.c), so the live slaves are serviced more often.
 static uint8_t Curr_Schedule_ID = SCHEDULE_START_ID;
 
+// Slaves whose status is polled individually next, bit n is slave n
+static uint32_t Status_Poll_Bitmap = 0;
+
+// Slaves whose command changed and hasn't been sent yet, bit n is slave n
+static uint32_t Command_Pending_Bitmap = 0;
+
+// Slaves sent a changed command, the next event-triggered slot should
+//  show that they applied it
+static uint32_t Ack_Wait_Bitmap = 0;
+
+// Rounds since the last event-triggered slot
+static uint8_t Event_Slot_Rounds = 0;
+
+// Slaves whose changed command was sent ahead of this round, so the round
+//  doesn't send it again straight away
+static uint32_t Command_Sent_Bitmap = 0;
+
+// Slaves whose command changed since the last commit, written by the main
+//  thread
+static uint32_t Staged_Command_Bitmap = 0;
+
+// A slave was sent a command it hasn't applied, the commit frame is due
+static bool Commit_Pending = false;
+
+// A new scene is waiting for the scene frame, and the slaves whose command
+//  it changes
+static bool Scene_Pending = false;
+static uint32_t Scene_Changed_Bitmap = 0;
+
+// Slave the last changed command went to, the search for the next one
+//  starts after it so none waits behind slaves whose commands keep changing
+static uint8_t Last_Pending_Slave = LOWEST_SLAVE_NUMBER;
+
+// Slave whose status is polled this round to track its health, it also
+//  sends its extended status this round
+static uint8_t Health_Poll_Slave = LOWEST_SLAVE_NUMBER;
+
+// Last ID broadcast, to check whether its response came back
+static uint8_t Last_Sent_ID = SCHEDULE_DIAG_SLOT;
+
+// Whether the schedule is running, asleep or waking up
+static schedule_state_t Schedule_State = schedule_running;
+
 // CAN_Init_1 Timer
 static uint32_t CAN_Timer = EVT_CAN_INIT_1_COMPLETE;
 
-// Arrays to hold CAN packets
-// @TODO: if the packet is short, we should host
-// a previous copy to reduce compute overhead if the
-// new CAN packet is the same
-static uint8_t CAN_Volatile_Msg[CAN_MODEM_PACKET_LEN] = {0};
-static uint8_t * a_p_CAN_Volatile_Msg[CAN_MODEM_PACKET_LEN] = 
-    {&CAN_Volatile_Msg[0],
-    &CAN_Volatile_Msg[1],
-    &CAN_Volatile_Msg[2],
-    &CAN_Volatile_Msg[3],
-    &CAN_Volatile_Msg[4]};
+// The modem msg being processed, taken from the CAN receive FIFO
 static uint8_t CAN_Last_Processed_Msg[CAN_MODEM_PACKET_LEN] = {0};
 
+// Diagnostic reply being sent to the modem, one chunk per CAN poll
+static uint8_t Diag_Reply_PDU[LIN_DIAG_MAX_PDU_LEN] = {0};
+static uint8_t Diag_Reply_Len = 0;          // 0 if there is nothing to send
+static uint8_t Diag_Reply_Index = 0;        // PDU bytes sent so far
+static uint8_t Diag_Reply_Node = 0;         // Node the reply is from
+
 // TEST TIMER
 static uint32_t Testing_Timer = EVT_TEST_TIMEOUT;
 static uint16_t test_counter = 0;
@@ -157,16 +302,39 @@ static intensity_data_t intensity_2_watch;
 // #############################################################################
 
 static void ID_schedule_handler(uint32_t unused);           // Called from int context
+static void take_status(void);
 static void update_curr_schedule_id(void);
+static uint8_t get_slot_after_last_slave(void);
+static bool is_status_polled(uint8_t slave_number);
+static bool is_command_due(uint8_t slave_number);
+static uint8_t get_next_pending_slave(void);
+static void note_command_sent(uint8_t slave_number);
+static void set_slave_count(uint8_t count);
 static void clear_cmds(void);
 static void update_cmds(rect_vect_t requested_location);
+static void stage_cmd(uint8_t slave_num, uint8_t * p_command);
+static void commit_cmds(void);
+static void send_scene(rect_vect_t requested_location);
+static void note_scene_sent(void);
 static bool did_single_slave_obey(uint8_t slave_number);
 static bool did_all_slaves_obey(void);
 static void put_LIN_to_sleep(void);
+static void wake_LIN_up(void);
 static rect_vect_t get_CAN_pos_vect(void);
 static void write_rect_vect(uint8_t * p_target, rect_vect_t vect);
 static intensity_data_t get_CAN_spec_intensity_data(void);
 static position_data_t get_CAN_spec_position_data(void);
+static void start_CAN_diag_request(void);
+static void send_diag_reply_chunk(void);
+static void send_health_report(void);
+static void send_bus_stats_report(void);
+static void start_auto_addressing(void);
+static void finish_auto_addressing(void);
+static void start_LIN_flash(void);
+static void finish_LIN_flash(void);
+static bool process_CAN_frames(void);
+static bool accept_CAN_frame(const can_frame_t * p_frame);
+static void process_CAN_msg(void);
 
 // #############################################################################
 // ------------ PUBLIC FUNCTIONS
@@ -188,11 +356,25 @@ void Init_Master_Service(void)
     // Set LIN ID, no need for ADC, we are the master node
     My_Node_ID = MASTER_NODE_ID;
 
+    // Set up the command store
+    Init_Data_Store(&My_Command_Store, My_Command_Data, NULL, MASTER_DATA_LENGTH);
+
+    // Number of slaves on the bus, all we have room for if it was never set
+    Read_Data_From_EEPROM(SLAVE_COUNT_ADDR, &Slave_Count, SLAVE_COUNT_LEN);
+    if ((LOWEST_SLAVE_NUMBER > Slave_Count) || (NUM_SLAVES < Slave_Count))
+    {
+        Slave_Count = NUM_SLAVES;
+    }
+    Round_Slave_Count = Slave_Count;
+
     // Initialize the data arrays to proper things
     clear_cmds();
 
+    // All slaves start online
+    Init_Slave_Health();
+
     // Initialize LIN
-    MS_LIN_Initialize(&My_Node_ID, p_My_Command_Data, p_My_Status_Data);
+    MS_LIN_Initialize(&My_Node_ID, &My_Command_Store, NULL);
 
     // Register scheduling timer with ID_schedule_handler as 
     //      callback function
@@ -209,7 +391,8 @@ void Init_Master_Service(void)
 
     // Call 1st step of the CAN initialization
     // This will only start once we exit initialization context
-    CAN_Initialize_1(a_p_CAN_Volatile_Msg);
+    Init_CAN_RX_FIFO();
+    CAN_Initialize_1();
 
     // Register test timer & start
     Register_Timer(&Testing_Timer, Post_Event);
@@ -268,65 +451,74 @@ void Run_Master_Service(uint32_t event_mask)
             #endif
 
             // Restart the CAN polling timer
-            Start_Timer(&CAN_Timer, CAN_POLL_INTERVAL_MS);
+            Start_Timer(&CAN_Timer, LIN_Flash_In_Progress() ? CAN_FLASH_POLL_INTERVAL_MS : CAN_POLL_INTERVAL_MS);
 
-            // Set new message flag to false
+            // Send the next part of a diagnostic reply, if any
+            send_diag_reply_chunk();
+
+            // Frames are processed as they arrive, this only catches one
+            //  whose event was missed
             ;
-            bool new_msg = false;
+            bool new_msg = process_CAN_frames();
+
+            // While the slaves are flashed, a poll without the image counts
+            //  towards asking the modem for it again
+            if ((false == new_msg) && LIN_Flash_In_Progress())
+            {
+                if (Run_LIN_Flash_CAN(NULL))
+                {
+                    finish_LIN_flash();
+                }
+            }
+
+            break;
 
-            // Enter critical section so the message we check is the same as the message we copy
-            ATOMIC_BLOCK(ATOMIC_RESTORESTATE)
+        case EVT_CAN_FRAME_RECEIVED:
+            // The modem sent a msg, act on it right away
+            process_CAN_frames();
+            break;
+
+        case EVT_MASTER_DIAG_RESPONSE:
+            // A slave answered our diagnostic request (or timed out)
+
+            // While numbering the slaves, the requests are auto-addressing's
+            if (Auto_Addressing_In_Progress())
             {
-                // Check to see if the volatile instance of the message is 
-                // different than the last processed instance of the message
-                if (MEMCMP_EQUAL != memcmp(&CAN_Last_Processed_Msg, &CAN_Volatile_Msg, CAN_MODEM_PACKET_LEN))
+                if (Run_Auto_Addressing())
                 {
-                    // The message is new. Process the message.
-                
-                    // If the ID is something we expect...
-                    switch (CAN_Volatile_Msg[CAN_MODEM_TYPE_IDX])
-                    {
-                        case CAN_MODEM_POS_TYPE:
-                        case CAN_MODEM_SPEC_TYPE:
-                            // Copy the message
-                            // @TODO: This might need to be in a critical section
-                            memcpy(&CAN_Last_Processed_Msg, &CAN_Volatile_Msg, CAN_MODEM_PACKET_LEN);
-                            // Set flag to alert us to continue
-                            new_msg = true;
-                            break;
-
-                        default:
-                            break;
-                    }
+                    finish_auto_addressing();
                 }
+                break;
             }
 
-            // If we have a new message
-            if (new_msg)
+            // Likewise while flashing the slaves
+            if (LIN_Flash_In_Progress())
             {
-                // Process based on the message type
-                switch (CAN_Last_Processed_Msg[CAN_MODEM_TYPE_IDX])
+                if (Run_LIN_Flash_Diag())
                 {
-                    case CAN_MODEM_POS_TYPE:
-                        // Run light setting algo for all slave nodes
-                        update_cmds(get_CAN_pos_vect());
-                        break;
-
-                    case CAN_MODEM_SPEC_TYPE:
-                        // Update the command for only the slave specified
-                        Write_Intensity_Data(   Get_Pointer_To_Slave_Data(p_My_Command_Data, CAN_Last_Processed_Msg[CAN_MODEM_SPEC_NUM_IDX]),
-                                                get_CAN_spec_intensity_data()
-                                                );
-                        Write_Position_Data(    Get_Pointer_To_Slave_Data(p_My_Command_Data, CAN_Last_Processed_Msg[CAN_MODEM_SPEC_NUM_IDX]),
-                                                get_CAN_spec_position_data()
-                                                );
-                        break;
-
-                    default:
-                        break;
+                    finish_LIN_flash();
                 }
+                break;
+            }
+
+            // Copy the response, it will be sent to the modem in chunks
+            Diag_Reply_Len = Master_LIN_Diag_Get_Response(Diag_Reply_PDU);
+            Diag_Reply_Index = 0;
+
+            // If the slave didn't answer, reply with a negative response
+            if (0 == Diag_Reply_Len)
+            {
+                Diag_Reply_PDU[0] = LIN_DIAG_RSID_NEGATIVE;
+                Diag_Reply_PDU[1] = LIN_DIAG_SID_READ_BY_ID;
+                Diag_Reply_PDU[2] = LIN_DIAG_NRC_NO_RESPONSE;
+                Diag_Reply_Len = 3;
             }
-        
+
+            break;
+
+        case EVT_MASTER_HEALTH_CHANGE:
+            // A slave went online, degraded or offline, tell the modem
+            send_health_report();
             break;
 
         case EVT_MASTER_NEW_STS:
@@ -351,7 +543,7 @@ void Run_Master_Service(uint32_t event_mask)
         case EVT_TEST_TIMEOUT:
             // Just a test
 
-            if (0 != CAN_Volatile_Msg[0])
+            if (0 != CAN_Last_Processed_Msg[0])
             {
                 position_counter = 400;
             }
@@ -365,7 +557,7 @@ void Run_Master_Service(uint32_t event_mask)
             #if 0
             uint8_t TX_Away[5] = {CAN_MODEM_POS_TYPE, 0x00, 0x00, 0x00, 0x00};
             write_rect_vect(&TX_Away[CAN_MODEM_POS_VECT_IDX], test_positions[test_counter]);
-            CAN_Send_Message(5, TX_Away);
+            Put_CAN_TX_Frame(CAN_TX_PRIORITY_REPORT, 5, TX_Away, NULL);
             test_counter++;
             if (NUM_TEST_POSITIONS <= test_counter) test_counter = 0;
             #endif
@@ -405,38 +597,39 @@ void Run_Master_Service(uint32_t event_mask)
             parity ^= 1;
             if (parity)
             {
-                Write_Intensity_Data(Get_Pointer_To_Slave_Data(p_My_Command_Data, 1),75);
-                Write_Position_Data(Get_Pointer_To_Slave_Data(p_My_Command_Data, 1),2250);
-                Write_Intensity_Data(Get_Pointer_To_Slave_Data(p_My_Command_Data, 2),75);
-                Write_Position_Data(Get_Pointer_To_Slave_Data(p_My_Command_Data, 2),2250);
-                Write_Intensity_Data(Get_Pointer_To_Slave_Data(p_My_Command_Data, 3),75);
-                Write_Position_Data(Get_Pointer_To_Slave_Data(p_My_Command_Data, 3),2250);
-                Write_Intensity_Data(Get_Pointer_To_Slave_Data(p_My_Command_Data, 4),75);
-                Write_Position_Data(Get_Pointer_To_Slave_Data(p_My_Command_Data, 4),2250);
-                Write_Intensity_Data(Get_Pointer_To_Slave_Data(p_My_Command_Data, 5),75);
-                Write_Position_Data(Get_Pointer_To_Slave_Data(p_My_Command_Data, 5),2250);
-                Write_Intensity_Data(Get_Pointer_To_Slave_Data(p_My_Command_Data, 6),75);
-                Write_Position_Data(Get_Pointer_To_Slave_Data(p_My_Command_Data, 6),2250);
-                Write_Intensity_Data(Get_Pointer_To_Slave_Data(p_My_Command_Data, 7),75);
-                Write_Position_Data(Get_Pointer_To_Slave_Data(p_My_Command_Data, 7),2250);
+                Write_Intensity_Data(Get_Pointer_To_Slave_Data(Get_Shadow_Data(&My_Command_Store), 1),75);
+                Write_Position_Data(Get_Pointer_To_Slave_Data(Get_Shadow_Data(&My_Command_Store), 1),2250);
+                Write_Intensity_Data(Get_Pointer_To_Slave_Data(Get_Shadow_Data(&My_Command_Store), 2),75);
+                Write_Position_Data(Get_Pointer_To_Slave_Data(Get_Shadow_Data(&My_Command_Store), 2),2250);
+                Write_Intensity_Data(Get_Pointer_To_Slave_Data(Get_Shadow_Data(&My_Command_Store), 3),75);
+                Write_Position_Data(Get_Pointer_To_Slave_Data(Get_Shadow_Data(&My_Command_Store), 3),2250);
+                Write_Intensity_Data(Get_Pointer_To_Slave_Data(Get_Shadow_Data(&My_Command_Store), 4),75);
+                Write_Position_Data(Get_Pointer_To_Slave_Data(Get_Shadow_Data(&My_Command_Store), 4),2250);
+                Write_Intensity_Data(Get_Pointer_To_Slave_Data(Get_Shadow_Data(&My_Command_Store), 5),75);
+                Write_Position_Data(Get_Pointer_To_Slave_Data(Get_Shadow_Data(&My_Command_Store), 5),2250);
+                Write_Intensity_Data(Get_Pointer_To_Slave_Data(Get_Shadow_Data(&My_Command_Store), 6),75);
+                Write_Position_Data(Get_Pointer_To_Slave_Data(Get_Shadow_Data(&My_Command_Store), 6),2250);
+                Write_Intensity_Data(Get_Pointer_To_Slave_Data(Get_Shadow_Data(&My_Command_Store), 7),75);
+                Write_Position_Data(Get_Pointer_To_Slave_Data(Get_Shadow_Data(&My_Command_Store), 7),2250);
             }
             else
             {
-                Write_Intensity_Data(Get_Pointer_To_Slave_Data(p_My_Command_Data, 1),0);
-                Write_Position_Data(Get_Pointer_To_Slave_Data(p_My_Command_Data, 1),1450);
-                Write_Intensity_Data(Get_Pointer_To_Slave_Data(p_My_Command_Data, 2),0);
-                Write_Position_Data(Get_Pointer_To_Slave_Data(p_My_Command_Data, 2),1450);
-                Write_Intensity_Data(Get_Pointer_To_Slave_Data(p_My_Command_Data, 3),0);
-                Write_Position_Data(Get_Pointer_To_Slave_Data(p_My_Command_Data, 3),1450);
-                Write_Intensity_Data(Get_Pointer_To_Slave_Data(p_My_Command_Data, 4),0);
-                Write_Position_Data(Get_Pointer_To_Slave_Data(p_My_Command_Data, 4),1450);
-                Write_Intensity_Data(Get_Pointer_To_Slave_Data(p_My_Command_Data, 5),0);
-                Write_Position_Data(Get_Pointer_To_Slave_Data(p_My_Command_Data, 5),1450);
-                Write_Intensity_Data(Get_Pointer_To_Slave_Data(p_My_Command_Data, 6),0);
-                Write_Position_Data(Get_Pointer_To_Slave_Data(p_My_Command_Data, 6),1450);
-                Write_Intensity_Data(Get_Pointer_To_Slave_Data(p_My_Command_Data, 7),0);
-                Write_Position_Data(Get_Pointer_To_Slave_Data(p_My_Command_Data, 7),1450);
+                Write_Intensity_Data(Get_Pointer_To_Slave_Data(Get_Shadow_Data(&My_Command_Store), 1),0);
+                Write_Position_Data(Get_Pointer_To_Slave_Data(Get_Shadow_Data(&My_Command_Store), 1),1450);
+                Write_Intensity_Data(Get_Pointer_To_Slave_Data(Get_Shadow_Data(&My_Command_Store), 2),0);
+                Write_Position_Data(Get_Pointer_To_Slave_Data(Get_Shadow_Data(&My_Command_Store), 2),1450);
+                Write_Intensity_Data(Get_Pointer_To_Slave_Data(Get_Shadow_Data(&My_Command_Store), 3),0);
+                Write_Position_Data(Get_Pointer_To_Slave_Data(Get_Shadow_Data(&My_Command_Store), 3),1450);
+                Write_Intensity_Data(Get_Pointer_To_Slave_Data(Get_Shadow_Data(&My_Command_Store), 4),0);
+                Write_Position_Data(Get_Pointer_To_Slave_Data(Get_Shadow_Data(&My_Command_Store), 4),1450);
+                Write_Intensity_Data(Get_Pointer_To_Slave_Data(Get_Shadow_Data(&My_Command_Store), 5),0);
+                Write_Position_Data(Get_Pointer_To_Slave_Data(Get_Shadow_Data(&My_Command_Store), 5),1450);
+                Write_Intensity_Data(Get_Pointer_To_Slave_Data(Get_Shadow_Data(&My_Command_Store), 6),0);
+                Write_Position_Data(Get_Pointer_To_Slave_Data(Get_Shadow_Data(&My_Command_Store), 6),1450);
+                Write_Intensity_Data(Get_Pointer_To_Slave_Data(Get_Shadow_Data(&My_Command_Store), 7),0);
+                Write_Position_Data(Get_Pointer_To_Slave_Data(Get_Shadow_Data(&My_Command_Store), 7),1450);
             }
+            commit_cmds();
             #endif
 
             #if 0
@@ -450,17 +643,16 @@ void Run_Master_Service(uint32_t event_mask)
 //             Start_Timer(&Scheduling_Timer, SCHEDULE_INTERVAL_MS);
             // Begin updating the commands, which will
             //      be sent in the background
-//             Write_Intensity_Data(Get_Pointer_To_Slave_Data(p_My_Command_Data, 1), 98);
-//             Write_Position_Data(Get_Pointer_To_Slave_Data(p_My_Command_Data, 1), 1589);
-            memcpy(&CAN_Last_Processed_Msg, &CAN_Volatile_Msg, CAN_MODEM_PACKET_LEN);
+//             Write_Intensity_Data(Get_Pointer_To_Slave_Data(Get_Shadow_Data(&My_Command_Store), 1), 98);
+//             Write_Position_Data(Get_Pointer_To_Slave_Data(Get_Shadow_Data(&My_Command_Store), 1), 1589);
             vect_2_watch = get_CAN_pos_vect();
             intensity_2_watch = get_CAN_spec_intensity_data();
             position_2_watch = get_CAN_spec_position_data();
             update_cmds(vect_2_watch);
-            //Write_Intensity_Data(Get_Pointer_To_Slave_Data(p_My_Command_Data, 1),intensity_2_watch);
-            //Write_Position_Data(Get_Pointer_To_Slave_Data(p_My_Command_Data, 1),position_2_watch);
-            //position_to_watch = Get_Position_Data(Get_Pointer_To_Slave_Data(p_My_Command_Data, 1));
-            //intensity_to_watch = Get_Intensity_Data(Get_Pointer_To_Slave_Data(p_My_Command_Data, 1));
+            //Write_Intensity_Data(Get_Pointer_To_Slave_Data(Get_Shadow_Data(&My_Command_Store), 1),intensity_2_watch);
+            //Write_Position_Data(Get_Pointer_To_Slave_Data(Get_Shadow_Data(&My_Command_Store), 1),position_2_watch);
+            //position_to_watch = Get_Position_Data(Get_Pointer_To_Slave_Data(Get_Shadow_Data(&My_Command_Store), 1));
+            //intensity_to_watch = Get_Intensity_Data(Get_Pointer_To_Slave_Data(Get_Shadow_Data(&My_Command_Store), 1));
             test_counter++;
             if (NUM_TEST_POSITIONS <= test_counter) test_counter = 0;
             // *Note: While we are sending, we will
@@ -494,260 +686,834 @@ void Run_Master_Service(uint32_t event_mask)
 ****************************************************************************/
 static void ID_schedule_handler(uint32_t unused)
 {
-    // Transmit next header in schedule
-    Master_LIN_Broadcast_ID(Curr_Schedule_ID);
+    // Next header in schedule
+    uint8_t next_id;
+    // The bus idles this slot
+    bool idle_slot = false;
+
+    switch (Schedule_State)
+    {
+        case schedule_wake_pulse:
+            // End the wake up pulse, then give the slaves time to wake up
+            Master_LIN_End_Wake_Up();
+            Schedule_State = schedule_wake_wait;
+            Start_Timer(&Scheduling_Timer, LIN_WAKE_UP_DELAY_MS);
+            return;
+
+        case schedule_wake_wait:
+            // The slaves are awake, start over from the first slave. They
+            //  turned off to sleep, so every command goes out ahead of the
+            //  round and the scene comes back at once, not one slave (the
+            //  one whose turn it is) per round
+            Schedule_State = schedule_running;
+            Curr_Schedule_ID = SCHEDULE_START_ID;
+            for (uint8_t slave_num = LOWEST_SLAVE_NUMBER; slave_num <= Slave_Count; slave_num++)
+            {
+                if (slave_offline != Get_Slave_Health(slave_num))
+                {
+                    Command_Pending_Bitmap |= SLAVE_BIT(slave_num);
+                }
+            }
+            break;
+
+        case schedule_asleep:
+            // Nothing to send
+            return;
+
+        default:
+            break;
+    }
+
+    // If we sent the go-to-sleep command in the last slot, stop here.
+    //  The timer isn't restarted until wake_LIN_up().
+    if (Master_LIN_Is_Asleep())
+    {
+        Schedule_State = schedule_asleep;
+        return;
+    }
+
+    // Note whether the status that came in the last slot shows its command
+    take_status();
+
+    // If we just requested a slave's status, check whether it answered
+    if (    (Last_Sent_ID & REQUEST_MASK)
+            &&
+            (SCHEDULE_START_ID <= Last_Sent_ID) && (SCHEDULE_END_ID >= Last_Sent_ID)
+       )
+    {
+        Slave_Health_Report_Response(GET_SLAVE_NUMBER(Last_Sent_ID), Master_LIN_Last_Frame_OK());
+        Status_Poll_Bitmap &= ~SLAVE_BIT(GET_SLAVE_NUMBER(Last_Sent_ID));
+        Ack_Wait_Bitmap &= ~SLAVE_BIT(GET_SLAVE_NUMBER(Last_Sent_ID));
+    }
+    // If the changed stati collided, poll the slaves that were sent a
+    //  changed command next round, or every slave if none was
+    else if ((SCHEDULE_EVENT_SLOT == Last_Sent_ID) && Master_LIN_Event_Collision())
+    {
+        Status_Poll_Bitmap |= (0 != Ack_Wait_Bitmap) ? Ack_Wait_Bitmap : UINT32_MAX;
+        Ack_Wait_Bitmap = 0;
+    }
+    // Poll the slaves whose applied command the slot didn't show
+    else if (SCHEDULE_EVENT_SLOT == Last_Sent_ID)
+    {
+        Status_Poll_Bitmap |= (Ack_Wait_Bitmap & ~Acked_Bitmap);
+        Ack_Wait_Bitmap = 0;
+    }
+
+    // While the slaves are being numbered or flashed only the diagnostic
+    //  frames run, the bus idles for a slot while the next request is made
+    if (Auto_Addressing_In_Progress() || LIN_Flash_In_Progress())
+    {
+        next_id = Master_LIN_Diag_Slot_ID();
+        if (LIN_DIAG_NO_SLOT == next_id)
+        {
+            next_id = SCHEDULE_DIAG_SLOT;
+            Start_Timer(&Scheduling_Timer, SCHEDULE_INTERVAL_MS);
+        }
+        else
+        {
+            Master_LIN_Broadcast_ID(next_id);
+            Start_Timer(&Scheduling_Timer, LONG_SCHEDULE_INTERVAL_MS);
+        }
+        Last_Sent_ID = next_id;
+        return;
+    }
+
+    // A new scene goes out first, ahead of the round. Not between a slave's
+    //  command and its extended status slot though, the slave only answers
+    //  that right after its command.
+    if (Scene_Pending && (SCHEDULE_EXT_SLOT != Curr_Schedule_ID))
+    {
+        Master_LIN_Broadcast_ID(LIN_SCENE_ID);
+        note_scene_sent();
+        Last_Sent_ID = LIN_SCENE_ID;
+        Start_Timer(&Scheduling_Timer, SCHEDULE_INTERVAL_MS);
+        return;
+    }
+
+    // Then the other changed commands, again not before an extended status
+    //  slot
+    if ((0 != Command_Pending_Bitmap) && (SCHEDULE_EXT_SLOT != Curr_Schedule_ID))
+    {
+        next_id = GET_SLAVE_BASE_ID(get_next_pending_slave());
+        Master_LIN_Broadcast_ID(next_id);
+        note_command_sent(GET_SLAVE_NUMBER(next_id));
+        Last_Sent_ID = next_id;
+        Start_Timer(&Scheduling_Timer, SCHEDULE_INTERVAL_MS);
+        return;
+    }
+
+    // Then the slaves apply them together, not before an extended status
+    //  slot either
+    if (Commit_Pending && (SCHEDULE_EXT_SLOT != Curr_Schedule_ID))
+    {
+        Commit_Pending = false;
+        Master_LIN_Broadcast_ID(LIN_COMMIT_ID);
+        Last_Sent_ID = LIN_COMMIT_ID;
+        Start_Timer(&Scheduling_Timer, SCHEDULE_INTERVAL_MS);
+        return;
+    }
+
+    next_id = Curr_Schedule_ID;
+
+    // The spare slot is only used if there is diagnostic traffic,
+    //  otherwise skip straight to the next slot
+    if (SCHEDULE_DIAG_SLOT == Curr_Schedule_ID)
+    {
+        next_id = Master_LIN_Diag_Slot_ID();
+        if (LIN_DIAG_NO_SLOT == next_id)
+        {
+            update_curr_schedule_id();
+            next_id = Curr_Schedule_ID;
+
+            // Every slave was skipped, we are back at the unused spare slot
+            idle_slot = (SCHEDULE_DIAG_SLOT == next_id);
+        }
+    }
+
+    // Transmit next header in schedule, unless the bus idles this slot
+    if (false == idle_slot)
+    {
+        Master_LIN_Broadcast_ID(next_id);
+    }
+    if (    (0 == (next_id & REQUEST_MASK))
+            &&
+            (SCHEDULE_START_ID <= next_id) && (SCHEDULE_END_ID >= next_id)
+       )
+    {
+        note_command_sent(GET_SLAVE_NUMBER(next_id));
+    }
+    Last_Sent_ID = next_id;
     // Update schedule id
     update_curr_schedule_id();
-    // Restart timer
-    Start_Timer(&Scheduling_Timer, SCHEDULE_INTERVAL_MS);
+    // Restart timer, giving 8 byte frames time to finish
+    if (    (SCHEDULE_EXT_SLOT == next_id)
+            ||
+            (LIN_DIAG_MASTER_REQ_ID == next_id) || (LIN_DIAG_SLAVE_RESP_ID == next_id)
+       )
+    {
+        Start_Timer(&Scheduling_Timer, LONG_SCHEDULE_INTERVAL_MS);
+    }
+    else
+    {
+        Start_Timer(&Scheduling_Timer, SCHEDULE_INTERVAL_MS);
+    }
 }
 
 /****************************************************************************
     Private Function
-        update_curr_schedule_id()
+        take_status()
 
     Parameters
         None
 
     Description
-        Loops through schedule counter
+        Takes the status that came in the last slot, if any, and notes
+        whether the slave applied its latest command. Called from interrupt
+        context.
 
 ****************************************************************************/
-static void update_curr_schedule_id(void)
+static void take_status(void)
 {
-    // If we hit boundary condition, reset counter; otherwise increment
-    if (SCHEDULE_END_ID == Curr_Schedule_ID)
+    uint8_t slave_num;
+    uint8_t status[LIN_PACKET_LEN];
+    uint8_t * p_command;
+
+    if (false == Master_LIN_Get_Status(&slave_num, status)) return;
+
+    p_command = Get_Pointer_To_Slave_Data(Get_Live_Data(&My_Command_Store), slave_num);
+    if (Get_Sequence_Data(status) == Get_Sequence_Data(p_command))
     {
-        Curr_Schedule_ID = SCHEDULE_START_ID;
+        Acked_Bitmap |= SLAVE_BIT(slave_num);
     }
     else
     {
-        Curr_Schedule_ID++;
+        Acked_Bitmap &= ~SLAVE_BIT(slave_num);
     }
 }
 
 /****************************************************************************
     Private Function
-       clear_cmds()
+        update_curr_schedule_id()
 
     Parameters
         None
 
     Description
-        Updates all commands for slaves to be NON_COMMANDs
+        Loops through schedule counter, skipping slaves that are not
+        polled this round
 
 ****************************************************************************/
-static void clear_cmds(void)
+static void update_curr_schedule_id(void)
 {
-    // Loop through all slaves
-    for (int slave_num = LOWEST_SLAVE_NUMBER; slave_num <= NUM_SLAVES; slave_num++)
+    // If we hit boundary condition, go to the event-triggered slot, the
+    //  spare slot, then reset counter; otherwise increment
+    if (SCHEDULE_END_ID == Curr_Schedule_ID)
+    {
+        Curr_Schedule_ID = get_slot_after_last_slave();
+        return;
+    }
+    else if (SCHEDULE_EVENT_SLOT == Curr_Schedule_ID)
+    {
+        Curr_Schedule_ID = SCHEDULE_DIAG_SLOT;
+        return;
+    }
+    // The extended status is followed by the same slave's status
+    else if (SCHEDULE_EXT_SLOT == Curr_Schedule_ID)
+    {
+        Curr_Schedule_ID = GET_SLAVE_BASE_ID(Health_Poll_Slave)|REQUEST_MASK;
+        return;
+    }
+    // It's the turn of the slave we just commanded to send its extended status
+    else if (GET_SLAVE_BASE_ID(Health_Poll_Slave) == Curr_Schedule_ID)
+    {
+        Curr_Schedule_ID = SCHEDULE_EXT_SLOT;
+        return;
+    }
+    else if (SCHEDULE_DIAG_SLOT == Curr_Schedule_ID)
+    {
+        Curr_Schedule_ID = SCHEDULE_START_ID;
+
+        // Take on a new number of slaves, and forget the ones that left
+        Round_Slave_Count = Slave_Count;
+        Command_Pending_Bitmap &= SLAVE_BITS(Round_Slave_Count);
+
+        // Next slave's turn to have its health checked
+        Health_Poll_Slave = (Round_Slave_Count <= Health_Poll_Slave) ? LOWEST_SLAVE_NUMBER : (Health_Poll_Slave+1);
+    }
+    else
+    {
+        Curr_Schedule_ID++;
+    }
+
+    // Skip a slave's command and status IDs if the slave is not polled
+    //  this round, its command ID if it isn't due and its status ID if its
+    //  status isn't polled
+    while (1)
     {
-        // Write non-commands
-        Write_Intensity_Data(Get_Pointer_To_Slave_Data(p_My_Command_Data, slave_num), INTENSITY_NON_COMMAND);
-        Write_Position_Data(Get_Pointer_To_Slave_Data(p_My_Command_Data, slave_num), POSITION_NON_COMMAND);
+        if (Curr_Schedule_ID & REQUEST_MASK)
+        {
+            if (is_status_polled(GET_SLAVE_NUMBER(Curr_Schedule_ID)))
+            {
+                return;
+            }
+        }
+        else if (false == Slave_Health_Poll_This_Round(GET_SLAVE_NUMBER(Curr_Schedule_ID)))
+        {
+            // Skip the status ID too
+            Curr_Schedule_ID++;
+        }
+        else if (is_command_due(GET_SLAVE_NUMBER(Curr_Schedule_ID)))
+        {
+            return;
+        }
+
+        // On to the next ID, or the event-triggered slot after the last one
+        if (SCHEDULE_END_ID == Curr_Schedule_ID)
+        {
+            Curr_Schedule_ID = get_slot_after_last_slave();
+            return;
+        }
+        Curr_Schedule_ID++;
     }
 }
 
 /****************************************************************************
     Private Function
-        update_cmds()
+        get_slot_after_last_slave()
 
     Parameters
         None
 
     Description
-        Updates all commands for slaves based on requested light location
+        Returns the event-triggered slot if a slave was sent a changed
+        command or it's been left out for EVENT_SLOT_ROUNDS rounds, the
+        spare slot otherwise. Unexpected changes wait a few rounds, rather
+        than every round ending in a header nobody answers. Called from
+        interrupt context.
 
 ****************************************************************************/
-static void update_cmds(rect_vect_t requested_location)
+static uint8_t get_slot_after_last_slave(void)
 {
-    // Loop through all slaves
-    for (int slave_num = LOWEST_SLAVE_NUMBER; slave_num <= NUM_SLAVES; slave_num++)
+    if ((0 != Ack_Wait_Bitmap) || (EVENT_SLOT_ROUNDS <= ++Event_Slot_Rounds))
     {
-        // Run algorithm to compute the individual light settings
-        Compute_Individual_Light_Settings(Get_Pointer_To_Slave_Parameters(slave_num),
-            Get_Pointer_To_Slave_Data(p_My_Command_Data, slave_num), requested_location);
+        Event_Slot_Rounds = 0;
+        return SCHEDULE_EVENT_SLOT;
     }
+    return SCHEDULE_DIAG_SLOT;
 }
 
 /****************************************************************************
     Private Function
-        did_single_slave_obey()
+        is_status_polled()
 
     Parameters
-        None
+        uint8_t slave_number: slave whose status ID is next
 
     Description
-        Checks to see if a particular slave has received and executed
-        the command previously commanded from the master.
+        Returns true if the slave's status is requested individually this
+        round, rather than left to the event-triggered slot
 
 ****************************************************************************/
-static bool did_single_slave_obey(uint8_t slave_number)
+static bool is_status_polled(uint8_t slave_number)
 {
-    // Ensure the slave_number is within slave bounds
-    if ((LOWEST_SLAVE_NUMBER > slave_number) || (HIGHEST_SLAVE_NUMBER < slave_number))
-    {
-        // Return false
-        return false;
-    }
-
-    // Check byte by byte, memcmp won't work b/c we ignore non-commands
-
-    // IF The slave's intensity doesn't match my commanded intensity AND my command was valid
-    // (if the command we sent was a NON_COMMAND, then we don't care about the slave's status)
-    if (    (Get_Intensity_Data(Get_Pointer_To_Slave_Data(p_My_Status_Data, slave_number))
-            != Get_Intensity_Data(Get_Pointer_To_Slave_Data(p_My_Command_Data, slave_number)))
-            &&
-            (INTENSITY_NON_COMMAND != Get_Intensity_Data(Get_Pointer_To_Slave_Data(p_My_Command_Data, slave_number)))
-       )
-    {
-        // The slave has not obeyed my intensity command, return false
-        return false;
-    }
-    
-     // IF The slave's position doesn't match my commanded position AND my command was valid
-     // (if the command we sent was a NON_COMMAND, then we don't care about the slave's status)
-     if (    (Get_Position_Data(Get_Pointer_To_Slave_Data(p_My_Status_Data, slave_number))
-             != Get_Position_Data(Get_Pointer_To_Slave_Data(p_My_Command_Data, slave_number)))
-             &&
-             (POSITION_NON_COMMAND != Get_Position_Data(Get_Pointer_To_Slave_Data(p_My_Command_Data, slave_number)))
-        )
-     {
-        // The slave has not obeyed my position command, return false
-        return false;
-     }
-
-     // IF none of the cases above were satisfied, then the slave obeyed my commands
-     return true;
+    return (    (Status_Poll_Bitmap & SLAVE_BIT(slave_number))
+                ||
+                (Health_Poll_Slave == slave_number)
+                ||
+                (slave_online != Get_Slave_Health(slave_number))
+           );
 }
 
 /****************************************************************************
     Private Function
-        did_all_slaves_obey()
+        is_command_due()
 
     Parameters
-        None
+        uint8_t slave_number: slave whose command ID is next
 
     Description
-        Checks if all of the slaves have obeyed
+        Returns true if the slave's command is sent this round: it is the
+        slave whose turn it is, or its status doesn't show the command yet.
+        A command that was just sent ahead of the round isn't sent again
+        in it, nor one that is staged until it is committed. Called from
+        interrupt context.
 
 ****************************************************************************/
-static bool did_all_slaves_obey(void)
+static bool is_command_due(uint8_t slave_number)
 {
-    // Loop through all slaves
-    for (int slave_num = LOWEST_SLAVE_NUMBER; slave_num <= NUM_SLAVES; slave_num++)
+    // Its extended status follows its command
+    if (Health_Poll_Slave == slave_number) return true;
+
+    // Sent ahead of this round, give the slave time to report it
+    if (Command_Sent_Bitmap & SLAVE_BIT(slave_number))
     {
-        // Check individual slave for obedience
-        if (false == did_single_slave_obey(slave_num))
-        {
-            return false;
-        }
+        Command_Sent_Bitmap &= ~SLAVE_BIT(slave_number);
+        return false;
     }
 
-    // Return true if all slaves obeyed
-    return true;
+    // Send it again until the slave has applied it
+    return (0 == ((Acked_Bitmap|Staged_Command_Bitmap) & SLAVE_BIT(slave_number)));
 }
 
 /****************************************************************************
     Private Function
-        put_LIN_to_sleep()
+        get_next_pending_slave()
 
     Parameters
         None
 
     Description
-        Puts the LIN bus to sleep by stopping LIN headers from being sent
-        from the master
+        Returns the next slave with a changed command, after the last one
+        served, and takes it off the pending list. Command_Pending_Bitmap
+        must not be empty. Called from interrupt context.
 
 ****************************************************************************/
-static void put_LIN_to_sleep(void)
+static uint8_t get_next_pending_slave(void)
 {
-    // Stop the scheduling timer
-    Stop_Timer(&Scheduling_Timer);
+    uint8_t slave_num = Last_Pending_Slave;
+
+    // A slave that just joined can be pending before its first round
+    do
+    {
+        slave_num = (HIGHEST_SLAVE_NUMBER <= slave_num) ? LOWEST_SLAVE_NUMBER : (slave_num+1);
+    } while (0 == (Command_Pending_Bitmap & SLAVE_BIT(slave_num)));
+
+    Command_Pending_Bitmap &= ~SLAVE_BIT(slave_num);
+    Command_Sent_Bitmap |= SLAVE_BIT(slave_num);
 
-    // @TODO: More housekeeping to put the bus to sleep
+    // Its status changes once it applies the command, the event-triggered
+    //  slot reports it
+    Ack_Wait_Bitmap |= SLAVE_BIT(slave_num);
+    Last_Pending_Slave = slave_num;
+
+    return slave_num;
 }
 
 /****************************************************************************
     Private Function
-        get_CAN_pos_vect
+        note_command_sent()
 
     Parameters
-        None
+        uint8_t slave_number: slave whose command header was just sent
 
     Description
-        This returns an instance of the rect vect from a CAN user position 
-        frame
+        With staged commands, has the commit frame follow if the slave
+        hasn't applied this command yet. Called from interrupt context.
 
 ****************************************************************************/
-static rect_vect_t get_CAN_pos_vect(void)
+static void note_command_sent(uint8_t slave_number)
 {
-    // Init result position as the origin (all zeros)
-    rect_vect_t result = {0};
-    // Ensure the CAN message type is a position type
-    if (CAN_MODEM_POS_TYPE == CAN_Last_Processed_Msg[CAN_MODEM_TYPE_IDX])
+    if (STAGED_COMMANDS && (0 == (Acked_Bitmap & SLAVE_BIT(slave_number))))
     {
-        // Copy the vector info from CAN message into result
-        memcpy(&result, &CAN_Last_Processed_Msg[CAN_MODEM_POS_VECT_IDX], sizeof(result));
+        Commit_Pending = true;
     }
-    // Return result
-    return result;
 }
 
 /****************************************************************************
     Private Function
-        write_rect_vect
+        set_slave_count()
 
     Parameters
-        None
+        uint8_t count: number of slaves on the bus
 
     Description
-        This writes the vect info to the location of target
+        Changes the number of slaves the schedule services from the next
+        round on, and keeps it in EEPROM. Counts we have no room for are
+        ignored.
 
 ****************************************************************************/
-static void write_rect_vect(uint8_t * p_target, rect_vect_t vect)
+static void set_slave_count(uint8_t count)
 {
-    // Copy the vector into the location provided by the caller
-    memcpy(p_target, &vect, sizeof(vect));
+    if ((LOWEST_SLAVE_NUMBER > count) || (NUM_SLAVES < count)) return;
+    if (Slave_Count == count) return;
+
+    // The schedule handler reads this once per round, a byte is atomic
+    Slave_Count = count;
+    Write_Data_To_EEPROM(SLAVE_COUNT_ADDR, &Slave_Count, SLAVE_COUNT_LEN);
 }
 
 /****************************************************************************
     Private Function
-        get_CAN_spec_intensity_data
+       clear_cmds()
 
     Parameters
         None
 
     Description
-        This returns an instance of the intensity data from a CAN slave spec 
-        frame
+        Updates all commands for slaves to be NON_COMMANDs
 
 ****************************************************************************/
-static intensity_data_t get_CAN_spec_intensity_data(void)
+static void clear_cmds(void)
 {
-    // Ensure the CAN message type is a slave specific type
-    if (CAN_MODEM_SPEC_TYPE == CAN_Last_Processed_Msg[CAN_MODEM_TYPE_IDX])
+    uint8_t command[LIN_PACKET_LEN];
+
+    // Write non-commands
+    Write_Intensity_Data(command, INTENSITY_NON_COMMAND);
+    Write_Position_Data(command, POSITION_NON_COMMAND);
+
+    // Loop through all slaves
+    for (int slave_num = LOWEST_SLAVE_NUMBER; slave_num <= NUM_SLAVES; slave_num++)
     {
-        // Return the intensity data only
-        return Get_Intensity_Data(&CAN_Last_Processed_Msg[CAN_MODEM_SPEC_CMD_INDEX]);
+        stage_cmd(slave_num, command);
     }
-    // Return non command if the message type isn't a slave spec frame
-    return INTENSITY_NON_COMMAND;
+
+    // Send them all at once
+    commit_cmds();
 }
 
 /****************************************************************************
     Private Function
-        get_CAN_spec_position_data
+        update_cmds()
 
     Parameters
         None
 
     Description
-        This returns an instance of the position data from a CAN slave spec 
-        frame
+        Updates all commands for slaves based on requested light location
 
 ****************************************************************************/
-static position_data_t get_CAN_spec_position_data(void)
+static void update_cmds(rect_vect_t requested_location)
+{
+    uint8_t command[LIN_PACKET_LEN];
+
+    // Loop through the slaves on the bus
+    for (int slave_num = LOWEST_SLAVE_NUMBER; slave_num <= Slave_Count; slave_num++)
+    {
+        // Run algorithm to compute the individual light settings, a slave
+        //  without parameters keeps its command
+        memcpy(command, Get_Pointer_To_Slave_Data(Get_Live_Data(&My_Command_Store), slave_num), LIN_PACKET_LEN);
+        Compute_Individual_Light_Settings(Get_Pointer_To_Slave_Parameters(slave_num), command, requested_location);
+        stage_cmd(slave_num, command);
+    }
+
+    // The slaves work out the same commands from the scene frame
+    send_scene(requested_location);
+}
+
+/****************************************************************************
+    Private Function
+        stage_cmd()
+
+    Parameters
+        uint8_t slave_num: slave to command
+        uint8_t * p_command: its new intensity and position (LIN packet)
+
+    Description
+        If the command differs from the one the slave was sent, writes it
+        to the store with the next sequence number. It goes out on the next
+        commit_cmds().
+
+****************************************************************************/
+static void stage_cmd(uint8_t slave_num, uint8_t * p_command)
+{
+    uint8_t * p_sent;
+    uint8_t new_command[LIN_PACKET_LEN];
+
+    if ((LOWEST_SLAVE_NUMBER > slave_num) || (HIGHEST_SLAVE_NUMBER < slave_num)) return;
+
+    // Only the main thread writes commands, so the live copy is stable
+    p_sent = Get_Pointer_To_Slave_Data(Get_Live_Data(&My_Command_Store), slave_num);
+    if (    (Get_Intensity_Data(p_command) == Get_Intensity_Data(p_sent))
+            &&
+            (Get_Position_Data(p_command) == Get_Position_Data(p_sent))
+       )
+    {
+        return;
+    }
+
+    Write_Intensity_Data(new_command, Get_Intensity_Data(p_command));
+    Write_Position_Data(new_command, Get_Position_Data(p_command));
+    Write_Sequence_Data(new_command, Get_Sequence_Data(p_sent)+1);
+
+    // Keep the schedule handler off it, then write it
+    ATOMIC_BLOCK(ATOMIC_RESTORESTATE)
+    {
+        Staged_Command_Bitmap |= SLAVE_BIT(slave_num);
+        Acked_Bitmap &= ~SLAVE_BIT(slave_num);
+    }
+    Write_Data_Slot(&My_Command_Store, slave_num-LOWEST_SLAVE_NUMBER, new_command);
+}
+
+/****************************************************************************
+    Private Function
+        commit_cmds()
+
+    Parameters
+        None
+
+    Description
+        Sends the staged commands, the changed ones ahead of the round
+
+****************************************************************************/
+static void commit_cmds(void)
+{
+    uint32_t changed = Staged_Command_Bitmap;
+
+    if (0 == changed) return;
+    Commit_Data_Store(&My_Command_Store);
+
+    // Offline slaves only get their commands in the round
+    for (int slave_num = LOWEST_SLAVE_NUMBER; slave_num <= NUM_SLAVES; slave_num++)
+    {
+        if ((changed & SLAVE_BIT(slave_num)) && (slave_offline == Get_Slave_Health(slave_num)))
+        {
+            changed &= ~SLAVE_BIT(slave_num);
+        }
+    }
+
+    // Then have the schedule handler send the changed ones first
+    ATOMIC_BLOCK(ATOMIC_RESTORESTATE)
+    {
+        Staged_Command_Bitmap = 0;
+        Command_Pending_Bitmap |= (changed & SLAVE_BITS(Slave_Count));
+    }
+}
+
+/****************************************************************************
+    Private Function
+        send_scene()
+
+    Parameters
+        rect_vect_t requested_location: location the commands were worked
+            out for
+
+    Description
+        Sends the location in the next slot, if it changed any staged
+        command. Every slave works out its own command from it, the
+        commands staged here are what the master expects back.
+
+****************************************************************************/
+static void send_scene(rect_vect_t requested_location)
+{
+    uint8_t scene[LIN_SCENE_FRAME_LEN];
+    uint32_t changed = Staged_Command_Bitmap;
+
+    if (0 == changed) return;
+    Commit_Data_Store(&My_Command_Store);
+
+    write_rect_vect(&scene[SCENE_X_INDEX], requested_location);
+    Master_LIN_Write_Scene(scene);
+
+    // Offline slaves don't answer, they only get their commands in the
+    //  round
+    for (int slave_num = LOWEST_SLAVE_NUMBER; slave_num <= NUM_SLAVES; slave_num++)
+    {
+        if ((changed & SLAVE_BIT(slave_num)) && (slave_offline == Get_Slave_Health(slave_num)))
+        {
+            changed &= ~SLAVE_BIT(slave_num);
+        }
+    }
+
+    // Then have the schedule handler send it first
+    ATOMIC_BLOCK(ATOMIC_RESTORESTATE)
+    {
+        Staged_Command_Bitmap = 0;
+        Scene_Changed_Bitmap |= (changed & SLAVE_BITS(Slave_Count));
+        Scene_Pending = true;
+    }
+}
+
+/****************************************************************************
+    Private Function
+        note_scene_sent()
+
+    Parameters
+        None
+
+    Description
+        The slaves whose command the scene changed apply it now. Their
+        commands aren't sent again in this round, and the next
+        event-triggered slot should show that they applied them. Called
+        from interrupt context.
+
+****************************************************************************/
+static void note_scene_sent(void)
+{
+    Scene_Pending = false;
+    Command_Sent_Bitmap |= Scene_Changed_Bitmap;
+    Ack_Wait_Bitmap |= Scene_Changed_Bitmap;
+    Scene_Changed_Bitmap = 0;
+}
+
+/****************************************************************************
+    Private Function
+        did_single_slave_obey()
+
+    Parameters
+        None
+
+    Description
+        Checks to see if a particular slave has received and executed
+        the command previously commanded from the master.
+
+****************************************************************************/
+static bool did_single_slave_obey(uint8_t slave_number)
+{
+    // Ensure the slave_number is within slave bounds
+    if ((LOWEST_SLAVE_NUMBER > slave_number) || (HIGHEST_SLAVE_NUMBER < slave_number))
+    {
+        // Return false
+        return false;
+    }
+
+    // Its status echoes the sequence number of the last command it applied
+    return (0 != (Acked_Bitmap & SLAVE_BIT(slave_number)));
+}
+
+/****************************************************************************
+    Private Function
+        did_all_slaves_obey()
+
+    Parameters
+        None
+
+    Description
+        Checks if all of the slaves have obeyed
+
+****************************************************************************/
+static bool did_all_slaves_obey(void)
+{
+    // Loop through the slaves on the bus
+    for (int slave_num = LOWEST_SLAVE_NUMBER; slave_num <= Slave_Count; slave_num++)
+    {
+        // Check individual slave for obedience
+        if (false == did_single_slave_obey(slave_num))
+        {
+            return false;
+        }
+    }
+
+    // Return true if all slaves obeyed
+    return true;
+}
+
+/****************************************************************************
+    Private Function
+        put_LIN_to_sleep()
+
+    Parameters
+        None
+
+    Description
+        Puts the LIN bus to sleep by sending the go-to-sleep command in the
+        next spare slot. The schedule stops once it has been sent.
+
+****************************************************************************/
+static void put_LIN_to_sleep(void)
+{
+    // Only a running schedule can send the command, and not while the
+    //  slaves are being numbered
+    if (schedule_running != Schedule_State) return;
+    if (Auto_Addressing_In_Progress()) return;
+
+    // Queue the go-to-sleep command
+    Master_LIN_Go_To_Sleep();
+}
+
+/****************************************************************************
+    Private Function
+        wake_LIN_up()
+
+    Parameters
+        None
+
+    Description
+        Wakes the LIN bus up with a wake up pulse, then restarts the
+        schedule. Does nothing if the bus isn't asleep.
+
+****************************************************************************/
+static void wake_LIN_up(void)
+{
+    // The scheduling timer is stopped while we're asleep, so the
+    //  schedule handler can't change the state under us
+    if (schedule_asleep != Schedule_State) return;
+
+    // Drive the bus dominant, the schedule handler ends the pulse
+    Schedule_State = schedule_wake_pulse;
+    Master_LIN_Start_Wake_Up();
+    Start_Timer(&Scheduling_Timer, LIN_WAKE_PULSE_MS);
+}
+
+/****************************************************************************
+    Private Function
+        get_CAN_pos_vect
+
+    Parameters
+        None
+
+    Description
+        This returns an instance of the rect vect from a CAN user position 
+        frame
+
+****************************************************************************/
+static rect_vect_t get_CAN_pos_vect(void)
+{
+    // Init result position as the origin (all zeros)
+    rect_vect_t result = {0};
+    // Ensure the CAN message type is a position type
+    if (CAN_MODEM_POS_TYPE == CAN_Last_Processed_Msg[CAN_MODEM_TYPE_IDX])
+    {
+        // Copy the vector info from CAN message into result
+        memcpy(&result, &CAN_Last_Processed_Msg[CAN_MODEM_POS_VECT_IDX], sizeof(result));
+    }
+    // Return result
+    return result;
+}
+
+/****************************************************************************
+    Private Function
+        write_rect_vect
+
+    Parameters
+        None
+
+    Description
+        This writes the vect info to the location of target
+
+****************************************************************************/
+static void write_rect_vect(uint8_t * p_target, rect_vect_t vect)
+{
+    // Copy the vector into the location provided by the caller
+    memcpy(p_target, &vect, sizeof(vect));
+}
+
+/****************************************************************************
+    Private Function
+        get_CAN_spec_intensity_data
+
+    Parameters
+        None
+
+    Description
+        This returns an instance of the intensity data from a CAN slave spec 
+        frame
+
+****************************************************************************/
+static intensity_data_t get_CAN_spec_intensity_data(void)
+{
+    // Ensure the CAN message type is a slave specific type
+    if (CAN_MODEM_SPEC_TYPE == CAN_Last_Processed_Msg[CAN_MODEM_TYPE_IDX])
+    {
+        // Return the intensity data only
+        return Get_Intensity_Data(&CAN_Last_Processed_Msg[CAN_MODEM_SPEC_CMD_INDEX]);
+    }
+    // Return non command if the message type isn't a slave spec frame
+    return INTENSITY_NON_COMMAND;
+}
+
+/****************************************************************************
+    Private Function
+        get_CAN_spec_position_data
+
+    Parameters
+        None
+
+    Description
+        This returns an instance of the position data from a CAN slave spec 
+        frame
+
+****************************************************************************/
+static position_data_t get_CAN_spec_position_data(void)
 {
     // Ensure the CAN message type is a slave specific type
     if (CAN_MODEM_SPEC_TYPE == CAN_Last_Processed_Msg[CAN_MODEM_TYPE_IDX])
@@ -758,3 +1524,438 @@ static position_data_t get_CAN_spec_position_data(void)
     // Return non command if the message type isn't a slave spec frame
     return POSITION_NON_COMMAND;
 }
+
+/****************************************************************************
+    Private Function
+        start_CAN_diag_request
+
+    Parameters
+        None
+
+    Description
+        Starts the diagnostic read requested in a CAN diag frame. Node 0 is
+        the master itself and is answered right away, slaves are asked over
+        the LIN diagnostic frames.
+
+****************************************************************************/
+static void start_CAN_diag_request(void)
+{
+    uint8_t request[LIN_DIAG_MAX_PDU_LEN];
+    uint8_t node = CAN_Last_Processed_Msg[CAN_MODEM_DIAG_NUM_IDX];
+
+    // Drop the request if we're still busy with the last one, or
+    //  numbering the slaves
+    if ((0 != Diag_Reply_Len) || Master_LIN_Diag_Is_Busy() || Auto_Addressing_In_Progress()) return;
+
+    // Build the read by identifier request
+    request[0] = LIN_DIAG_SID_READ_BY_ID;
+    request[1] = CAN_Last_Processed_Msg[CAN_MODEM_DIAG_ID_IDX];
+    request[2] = CAN_Last_Processed_Msg[CAN_MODEM_DIAG_ARG_IDX];
+    request[3] = CAN_Last_Processed_Msg[CAN_MODEM_DIAG_ARG_IDX+1];
+
+    // Remember who we asked
+    Diag_Reply_Node = node;
+
+    if (MASTER_NODE_ID == node)
+    {
+        // Answer for ourselves
+        Diag_Reply_Len = Process_Diag_Request(request, 4, Diag_Reply_PDU);
+        Diag_Reply_Index = 0;
+    }
+    else if ((LOWEST_SLAVE_NUMBER <= node) && (Slave_Count >= node))
+    {
+        // Ask the slave, EVT_MASTER_DIAG_RESPONSE will follow
+        Master_LIN_Diag_Send_Request(GET_SLAVE_NAD(node), request, 4);
+    }
+}
+
+/****************************************************************************
+    Private Function
+        send_diag_reply_chunk
+
+    Parameters
+        None
+
+    Description
+        Sends the next chunk of the diagnostic reply to the modem
+
+****************************************************************************/
+static void send_diag_reply_chunk(void)
+{
+    uint8_t reply[CAN_DIAG_REPLY_LEN];
+    uint8_t chunk_len;
+
+    // Nothing to send
+    if (0 == Diag_Reply_Len) return;
+
+    // Header
+    reply[CAN_MODEM_TYPE_IDX] = CAN_MODEM_DIAG_TYPE;
+    reply[CAN_MODEM_DIAG_NUM_IDX] = Diag_Reply_Node;
+    reply[CAN_DIAG_REPLY_CHUNK_IDX] = Diag_Reply_Index/CAN_DIAG_REPLY_DATA_LEN;
+
+    // Copy the next chunk, pad the rest
+    chunk_len = Diag_Reply_Len-Diag_Reply_Index;
+    if (CAN_DIAG_REPLY_DATA_LEN <= chunk_len)
+    {
+        chunk_len = CAN_DIAG_REPLY_DATA_LEN;
+    }
+    memset(&reply[CAN_DIAG_REPLY_DATA_IDX], 0xFF, CAN_DIAG_REPLY_DATA_LEN);
+    memcpy(&reply[CAN_DIAG_REPLY_DATA_IDX], &Diag_Reply_PDU[Diag_Reply_Index], chunk_len);
+    Diag_Reply_Index += chunk_len;
+
+    // Flag the last chunk and free the reply
+    if (Diag_Reply_Len <= Diag_Reply_Index)
+    {
+        reply[CAN_DIAG_REPLY_CHUNK_IDX] |= CAN_DIAG_REPLY_LAST_CHUNK;
+        Diag_Reply_Len = 0;
+    }
+
+    // Send it
+    Put_CAN_TX_Frame(CAN_TX_PRIORITY_REPLY, CAN_DIAG_REPLY_LEN, reply, NULL);
+}
+
+/****************************************************************************
+    Private Function
+        send_health_report
+
+    Parameters
+        None
+
+    Description
+        Sends the slave health report to the modem
+
+****************************************************************************/
+static void send_health_report(void)
+{
+    uint8_t report[CAN_HEALTH_REPORT_LEN] = {0};
+    uint32_t bitmap = Get_Slave_Health_Bitmap() & SLAVE_BITS(Slave_Count);
+
+    // Header and bitmap of answering slaves
+    report[CAN_MODEM_TYPE_IDX] = CAN_MODEM_HEALTH_TYPE;
+    memcpy(&report[CAN_HEALTH_BITMAP_IDX], &bitmap, sizeof(bitmap));
+
+    // Count the slaves on the bus in each state
+    for (uint8_t slave_num = LOWEST_SLAVE_NUMBER; slave_num <= Slave_Count; slave_num++)
+    {
+        switch (Get_Slave_Health(slave_num))
+        {
+            case slave_online:
+                report[CAN_HEALTH_ONLINE_IDX]++;
+                break;
+            case slave_degraded:
+                report[CAN_HEALTH_DEGRADED_IDX]++;
+                break;
+            default:
+                report[CAN_HEALTH_OFFLINE_IDX]++;
+                break;
+        }
+    }
+
+    // Send it
+    Put_CAN_TX_Frame(CAN_TX_PRIORITY_REPORT, CAN_HEALTH_REPORT_LEN, report, NULL);
+}
+
+/****************************************************************************
+    Private Function
+        send_bus_stats_report
+
+    Parameters
+        None
+
+    Description
+        Sends the LIN bus meters, or one slave's response latencies, to
+        the modem (see config.h for the layout)
+
+****************************************************************************/
+static void send_bus_stats_report(void)
+{
+    uint8_t report[CAN_BUS_STATS_LEN];
+    uint8_t node = CAN_Last_Processed_Msg[CAN_MODEM_BUS_STATS_NUM_IDX];
+    lin_bus_stats_t bus_stats;
+    lin_latency_stats_t latency_stats;
+
+    // Header
+    report[CAN_MODEM_TYPE_IDX] = CAN_MODEM_BUS_STATS_TYPE;
+    report[CAN_MODEM_BUS_STATS_NUM_IDX] = node;
+
+    if (MASTER_NODE_ID == node)
+    {
+        Get_LIN_Bus_Stats(&bus_stats);
+        memcpy(&report[CAN_BUS_STATS_UTIL_IDX], &bus_stats.utilisation_permille, sizeof(bus_stats.utilisation_permille));
+        memcpy(&report[CAN_BUS_STATS_INCOMPLETE_IDX], &bus_stats.incomplete_slots, sizeof(bus_stats.incomplete_slots));
+        memcpy(&report[CAN_BUS_STATS_MAX_IDX], &bus_stats.max_latency_us, sizeof(bus_stats.max_latency_us));
+    }
+    else if (Get_LIN_Latency_Stats(node, &latency_stats))
+    {
+        memcpy(&report[CAN_BUS_STATS_BUCKETS_IDX], latency_stats.buckets, NUM_LIN_LATENCY_BUCKETS);
+        memcpy(&report[CAN_BUS_STATS_MAX_IDX], &latency_stats.max_latency_us, sizeof(latency_stats.max_latency_us));
+    }
+    else
+    {
+        // Not a slave we have
+        return;
+    }
+
+    // Send it
+    Put_CAN_TX_Frame(CAN_TX_PRIORITY_REPLY, CAN_BUS_STATS_LEN, report, NULL);
+}
+
+/****************************************************************************
+    Private Function
+        start_auto_addressing
+
+    Parameters
+        None
+
+    Description
+        Starts numbering the slaves as requested in a CAN addressing frame.
+        Slaves that answer keep their numbers, unless every slave is
+        renumbered. Dropped if a diagnostic request is in progress.
+
+****************************************************************************/
+static void start_auto_addressing(void)
+{
+    uint32_t taken = Get_Slave_Health_Bitmap() & SLAVE_BITS(Slave_Count);
+
+    Start_Auto_Addressing(CAN_Last_Processed_Msg[CAN_MODEM_ADDRESSING_MODE_IDX], taken);
+}
+
+/****************************************************************************
+    Private Function
+        finish_auto_addressing
+
+    Parameters
+        None
+
+    Description
+        Takes on the number of slaves found and reports the outcome to the
+        modem
+
+****************************************************************************/
+static void finish_auto_addressing(void)
+{
+    uint8_t report[CAN_ADDRESSING_REPORT_LEN] = {0};
+    addressing_report_t outcome;
+
+    Get_Auto_Addressing_Report(&outcome);
+
+    // Renumbered slaves are 1 to the number found, new ones can go past
+    //  the old count
+    if (outcome.renumbered)
+    {
+        set_slave_count(outcome.numbered);
+    }
+    else if (Slave_Count < outcome.highest_number)
+    {
+        set_slave_count(outcome.highest_number);
+    }
+
+    // Send the report
+    report[CAN_MODEM_TYPE_IDX] = CAN_MODEM_ADDRESSING_TYPE;
+    report[CAN_ADDRESSING_NUMBERED_IDX] = outcome.numbered;
+    report[CAN_ADDRESSING_COUNT_IDX] = Slave_Count;
+    report[CAN_ADDRESSING_RESULT_IDX] = outcome.result;
+    memcpy(&report[CAN_ADDRESSING_TIME_IDX], &outcome.time_ms, sizeof(outcome.time_ms));
+    Put_CAN_TX_Frame(CAN_TX_PRIORITY_REPLY, CAN_ADDRESSING_REPORT_LEN, report, NULL);
+}
+
+/****************************************************************************
+    Private Function
+        start_LIN_flash
+
+    Parameters
+        None
+
+    Description
+        Starts flashing the slaves on the bus with the image the modem
+        holds, as requested in a CAN flash frame. Dropped while the slaves
+        are being numbered or a diagnostic request is in progress.
+
+****************************************************************************/
+static void start_LIN_flash(void)
+{
+    if (Auto_Addressing_In_Progress()) return;
+
+    Start_LIN_Flash(CAN_Last_Processed_Msg[CAN_MODEM_FLASH_PAGES_IDX], SLAVE_BITS(Slave_Count));
+}
+
+/****************************************************************************
+    Private Function
+        finish_LIN_flash
+
+    Parameters
+        None
+
+    Description
+        Reports the outcome of flashing the slaves to the modem
+
+****************************************************************************/
+static void finish_LIN_flash(void)
+{
+    uint8_t report[CAN_FLASH_REPORT_LEN];
+    lin_flash_report_t outcome;
+
+    Get_LIN_Flash_Report(&outcome);
+
+    report[CAN_MODEM_TYPE_IDX] = CAN_MODEM_FLASH_TYPE;
+    report[CAN_FLASH_MSG_IDX] = CAN_FLASH_MSG_REPORT;
+    report[CAN_FLASH_RESULT_IDX] = outcome.result;
+    report[CAN_FLASH_PAGES_IDX] = outcome.pages;
+    memcpy(&report[CAN_FLASH_FAILED_IDX], &outcome.failed_bitmap, sizeof(outcome.failed_bitmap));
+    Put_CAN_TX_Frame(CAN_TX_PRIORITY_REPLY, CAN_FLASH_REPORT_LEN, report, NULL);
+}
+
+/****************************************************************************
+    Private Function
+        process_CAN_frames
+
+    Parameters
+        None
+
+    Description
+        Processes every msg waiting in the CAN receive FIFO, in order.
+        Returns true if there was a msg we expect.
+
+****************************************************************************/
+static bool process_CAN_frames(void)
+{
+    bool new_msg = false;
+    can_frame_t frame;
+
+    while (Get_CAN_RX_Frame(&frame))
+    {
+        if (accept_CAN_frame(&frame))
+        {
+            new_msg = true;
+            process_CAN_msg();
+        }
+    }
+
+    return new_msg;
+}
+
+/****************************************************************************
+    Private Function
+        accept_CAN_frame
+
+    Parameters
+        const can_frame_t * p_frame: frame from the receive FIFO
+
+    Description
+        Copies the frame's modem msg to CAN_Last_Processed_Msg and returns
+        true if it is a msg type we expect
+
+****************************************************************************/
+static bool accept_CAN_frame(const can_frame_t * p_frame)
+{
+    // Only the modem's msgs, whatever else the filters let through
+    if (p_frame->extended || (CAN_MODEM_RX_SID != p_frame->id)) return false;
+    if (CAN_MODEM_PACKET_LEN > p_frame->dlc) return false;
+
+    switch (p_frame->data[CAN_MODEM_TYPE_IDX])
+    {
+        case CAN_MODEM_POS_TYPE:
+        case CAN_MODEM_SPEC_TYPE:
+        case CAN_MODEM_DIAG_TYPE:
+        case CAN_MODEM_HEALTH_TYPE:
+        case CAN_MODEM_SLEEP_TYPE:
+        case CAN_MODEM_BUS_STATS_TYPE:
+        case CAN_MODEM_SLAVE_COUNT_TYPE:
+        case CAN_MODEM_ADDRESSING_TYPE:
+        case CAN_MODEM_FLASH_TYPE:
+        case CAN_MODEM_FLASH_DATA_TYPE:
+            memcpy(&CAN_Last_Processed_Msg, p_frame->data, CAN_MODEM_PACKET_LEN);
+            return true;
+
+        default:
+            return false;
+    }
+}
+
+/****************************************************************************
+    Private Function
+        process_CAN_msg
+
+    Parameters
+        None
+
+    Description
+        Acts on the modem msg in CAN_Last_Processed_Msg
+
+****************************************************************************/
+static void process_CAN_msg(void)
+{
+    uint8_t spec_command[LIN_PACKET_LEN];
+
+    // While the slaves are flashed, the modem only sends the image
+    if (LIN_Flash_In_Progress())
+    {
+        if (Run_LIN_Flash_CAN(CAN_Last_Processed_Msg))
+        {
+            finish_LIN_flash();
+        }
+        return;
+    }
+
+    // Any message other than the sleep message wakes the bus up
+    if (CAN_MODEM_SLEEP_TYPE != CAN_Last_Processed_Msg[CAN_MODEM_TYPE_IDX])
+    {
+        wake_LIN_up();
+    }
+
+    // Process based on the message type
+    switch (CAN_Last_Processed_Msg[CAN_MODEM_TYPE_IDX])
+    {
+        case CAN_MODEM_POS_TYPE:
+            // Run light setting algo for all slave nodes
+            update_cmds(get_CAN_pos_vect());
+            break;
+
+        case CAN_MODEM_SPEC_TYPE:
+            // Update the command for only the slave specified
+            Write_Intensity_Data(spec_command, get_CAN_spec_intensity_data());
+            Write_Position_Data(spec_command, get_CAN_spec_position_data());
+            stage_cmd(CAN_Last_Processed_Msg[CAN_MODEM_SPEC_NUM_IDX], spec_command);
+            // Send it
+            commit_cmds();
+            break;
+
+        case CAN_MODEM_DIAG_TYPE:
+            // Read diagnostic data from the master or a slave
+            start_CAN_diag_request();
+            break;
+
+        case CAN_MODEM_HEALTH_TYPE:
+            // Report which slaves are answering
+            send_health_report();
+            break;
+
+        case CAN_MODEM_SLEEP_TYPE:
+            // Put the slaves to sleep
+            put_LIN_to_sleep();
+            break;
+
+        case CAN_MODEM_BUS_STATS_TYPE:
+            // Report the LIN bus meters
+            send_bus_stats_report();
+            break;
+
+        case CAN_MODEM_SLAVE_COUNT_TYPE:
+            // Change the number of slaves on the bus
+            set_slave_count(CAN_Last_Processed_Msg[CAN_MODEM_SLAVE_COUNT_IDX]);
+            break;
+
+        case CAN_MODEM_ADDRESSING_TYPE:
+            // Number the slaves
+            start_auto_addressing();
+            break;
+
+        case CAN_MODEM_FLASH_TYPE:
+            // Flash the slaves
+            start_LIN_flash();
+            break;
+
+        default:
+            break;
+    }
+}
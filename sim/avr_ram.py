@@ -0,0 +1,151 @@
+#!/usr/bin/env python3
+# Static RAM (.data and .bss) the firmware objects would take on the AVR
+#
+#   avr_ram.py [-v] [-g gc_list] object...
+#
+# The simulator builds the firmware for the host, where int, long, double
+#   and pointers are wider and structures are padded. This walks the debug
+#   information of the host objects (built with -g) and sizes every static
+#   variable with the avr-gcc types instead: int 2, long 4, double 4,
+#   pointers 2, [u]intN_t N/8 and no padding. Enums keep their size, the
+#   firmware is built with -fshort-enums on both. PROGMEM tables (kept in
+#   .progmem.data by include/avr/pgmspace.h) stay in flash and variables
+#   the compiler dropped as unused are left out.
+#
+# gc_list is what the linker printed with --print-gc-sections when it
+#   linked the objects into one image (see the Makefile); variables in the
+#   sections it removed are left out, as they are from the AVR image.
+#
+# With -v every variable is listed, largest first.
+
+import re
+import subprocess
+import sys
+
+AVR_POINTER = 2
+AVR_BASE = {
+    'int': 2, 'unsigned int': 2,
+    'long int': 4, 'long unsigned int': 4,
+    'long long int': 8, 'long long unsigned int': 8,
+    'float': 4, 'double': 4, 'long double': 4,
+}
+STDINT = re.compile(r'^_*u?int(8|16|32|64)_t$')
+
+DIE = re.compile(r'^0x([0-9a-f]+):\s+(DW_TAG_\w+)')
+GC = re.compile(r"removing unused section '([^']+)' in file '([^']+)'")
+ATTR = re.compile(r'^\s+(DW_AT_\w+)\s+\((.*)\)$')
+REF = re.compile(r'^0x([0-9a-f]+)')
+
+
+def parse(obj):
+    # {offset: (tag, {attribute: value})} and the children of each DIE
+    text = subprocess.run(['llvm-dwarfdump', '--debug-info', obj], check=True,
+                          capture_output=True, text=True).stdout
+    dies, children, stack = {}, {}, []
+    cur = None
+    for line in text.splitlines():
+        m = DIE.match(line)
+        if m:
+            indent = len(line) - len(line[line.index(':') + 1:].lstrip(' ')) - (line.index(':') + 1)
+            cur = int(m.group(1), 16)
+            dies[cur] = (m.group(2), {})
+            level = (indent - 1) // 2
+            del stack[level:]
+            if stack:
+                children.setdefault(stack[-1], []).append(cur)
+            stack.append(cur)
+            continue
+        m = ATTR.match(line)
+        if m and cur is not None:
+            dies[cur][1][m.group(1)] = m.group(2)
+    return dies, children
+
+
+def ref(value):
+    return int(REF.match(value).group(1), 16)
+
+
+def number(value):
+    return int(value.split()[0], 0)
+
+
+def avr_size(dies, children, off):
+    tag, attrs = dies[off]
+    name = attrs.get('DW_AT_name', '').strip('"')
+    if tag == 'DW_TAG_typedef' and STDINT.match(name):
+        return int(STDINT.match(name).group(1)) // 8
+    if tag in ('DW_TAG_typedef', 'DW_TAG_const_type', 'DW_TAG_volatile_type'):
+        return avr_size(dies, children, ref(attrs['DW_AT_type']))
+    if tag == 'DW_TAG_pointer_type':
+        return AVR_POINTER
+    if tag == 'DW_TAG_base_type':
+        return AVR_BASE.get(name, number(attrs['DW_AT_byte_size']))
+    if tag == 'DW_TAG_enumeration_type':
+        return number(attrs['DW_AT_byte_size'])
+    if tag in ('DW_TAG_structure_type', 'DW_TAG_union_type'):
+        sizes = [avr_size(dies, children, ref(dies[c][1]['DW_AT_type']))
+                 for c in children.get(off, []) if dies[c][0] == 'DW_TAG_member']
+        if tag == 'DW_TAG_union_type':
+            return max(sizes, default=0)
+        return sum(sizes)
+    if tag == 'DW_TAG_array_type':
+        count = 1
+        for c in children.get(off, []):
+            sub = dies[c][1]
+            if 'DW_AT_count' in sub:
+                count *= number(sub['DW_AT_count'])
+            elif 'DW_AT_upper_bound' in sub:
+                count *= number(sub['DW_AT_upper_bound']) + 1
+        return count * avr_size(dies, children, ref(attrs['DW_AT_type']))
+    raise ValueError('no AVR size for %s at 0x%x' % (tag, off))
+
+
+def data_sections(obj):
+    # {variable: section}, function statics are named variable.N
+    text = subprocess.run(['llvm-objdump', '-t', obj], check=True,
+                          capture_output=True, text=True).stdout
+    sections = {}
+    for line in text.splitlines():
+        fields = line.split()
+        if (6 == len(fields)) and ('O' == fields[2]):
+            sections[fields[5].split('.')[0]] = fields[3]
+    return sections
+
+
+def static_variables(obj, removed):
+    dies, children = parse(obj)
+    sections = data_sections(obj)
+    for off, (tag, attrs) in dies.items():
+        if tag != 'DW_TAG_variable' or 'DW_OP_addr' not in attrs.get('DW_AT_location', ''):
+            continue
+        decl = attrs
+        if 'DW_AT_specification' in attrs:
+            decl = dies[ref(attrs['DW_AT_specification'])][1]
+        name = decl.get('DW_AT_name', '?').strip('"')
+        section = sections.get(name, '')
+        if section.startswith('.progmem') or (section in removed):
+            continue
+        yield name, avr_size(dies, children, ref(decl['DW_AT_type']))
+
+
+def main(args):
+    verbose = bool(args) and args[0] == '-v'
+    if verbose:
+        args = args[1:]
+    removed = {}
+    if args and args[0] == '-g':
+        with open(args[1]) as gc_list:
+            for m in GC.finditer(gc_list.read()):
+                removed.setdefault(m.group(2), set()).add(m.group(1))
+        args = args[2:]
+    found = []
+    for obj in args:
+        found += [(size, name, obj) for name, size in static_variables(obj, removed.get(obj, set()))]
+    if verbose:
+        for size, name, obj in sorted(found, reverse=True):
+            print('%6d  %-32s %s' % (size, name, obj))
+    print(sum(size for size, _, _ in found))
+
+
+if __name__ == '__main__':
+    main(sys.argv[1:])
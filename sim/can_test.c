@@ -0,0 +1,244 @@
+/*******************************************************************************
+    File:
+        can_test.c
+
+    Notes:
+        Host test of the MCP25625 driver. The simulator replaces CAN.c with
+        sim_can.c, so this is what checks the SPI bytes the real CAN.c
+        sends.
+
+        CAN.c and can_rx_fifo.c are built as they are for the AVR, with
+        the SPI command queue stubbed out here. Each command is recorded
+        and its callback is called at once. READ RX BUFFER is answered
+        from RX_Buffer as the MCP25625 would, from RXBnSIDH or RXBnD0
+        depending on the instruction. Expected bytes are written out as
+        datasheet values, not with the driver's own definitions.
+
+        Exits with 1 and names the check if one fails.
+
+    Public Functions:
+        int main(void)
+
+*******************************************************************************/
+
+// #############################################################################
+// ------------ INCLUDES
+// #############################################################################
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <string.h>
+
+#include "config.h"
+#include "SPI.h"
+#include "CAN.h"
+#include "MCP25625defs.h"
+#include "can_rx_fifo.h"
+
+// #############################################################################
+// ------------ MODULE DEFINITIONS
+// #############################################################################
+
+#define MAX_COMMANDS            (16)
+
+#define CHECK(cond)             check((cond), #cond, __LINE__)
+
+// #############################################################################
+// ------------ TYPE DEFINITIONS
+// #############################################################################
+
+// An SPI command as queued by the driver
+typedef struct
+{
+    uint8_t         tx_len;
+    uint8_t         rx_len;
+    uint8_t         tx[MAX_SPI_BURST_TX];
+} command_t;
+
+// #############################################################################
+// ------------ MODULE VARIABLES
+// #############################################################################
+
+static command_t Commands[MAX_COMMANDS];
+static int Command_Count = 0;
+
+// Rows left in the SPI command buffer, a command is refused at 0
+static uint8_t Free_Rows = COMMAND_BUFFER_SIZE;
+
+// RXBnSIDH to RXBnD7 of the receive buffers
+static uint8_t RX_Buffer[CAN_FRAME_LEN];
+
+static int Failures = 0;
+
+// #############################################################################
+// ------------ STUBS
+// #############################################################################
+
+bool Write_SPI_Notify(uint8_t TX_Length, uint8_t RX_Length, uint8_t * Data2Write, uint8_t ** Data2Receive, spi_done_cb_t p_done_cb)
+{
+    command_t * p_command = &Commands[Command_Count % MAX_COMMANDS];
+
+    if (0 == Free_Rows) return false;
+
+    Command_Count++;
+    p_command->tx_len = TX_Length;
+    p_command->rx_len = RX_Length;
+    memcpy(p_command->tx, Data2Write, TX_Length);
+
+    // READ RX BUFFER 1001 0nm0: m set starts at RXBnD0, reads stop at RXBnD7
+    if (0 != RX_Length)
+    {
+        memset(*Data2Receive, 0, RX_Length);
+        if (0x90 == (Data2Write[0] & 0xF9))
+        {
+            uint8_t start = (Data2Write[0] & 0x02) ? CAN_FRAME_DATA_IDX : 0;
+            uint8_t len = CAN_FRAME_LEN - start;
+            memcpy(*Data2Receive, &RX_Buffer[start], (RX_Length < len) ? RX_Length : len);
+        }
+    }
+    if (NULL != p_done_cb) p_done_cb();
+    return true;
+}
+
+bool Write_SPI(uint8_t TX_Length, uint8_t RX_Length, uint8_t * Data2Write, uint8_t ** Data2Receive)
+{
+    return Write_SPI_Notify(TX_Length, RX_Length, Data2Write, Data2Receive, NULL);
+}
+
+uint8_t Get_SPI_Free_Rows(void)
+{
+    return Free_Rows;
+}
+
+void Post_Event(uint32_t event_mask)
+{
+}
+
+uint32_t Get_System_Time_MS(void)
+{
+    return 0;
+}
+
+// #############################################################################
+// ------------ TESTS
+// #############################################################################
+
+static void check(bool cond, const char * p_text, int line)
+{
+    if (!cond)
+    {
+        printf("can_test.c:%d: check failed: %s\n", line, p_text);
+        Failures++;
+    }
+}
+
+static bool command_is(int index, const uint8_t * p_bytes, uint8_t len)
+{
+    return (Commands[index].tx_len == len) && (0 == memcmp(Commands[index].tx, p_bytes, len));
+}
+
+// Frames are loaded from TXBnSIDH, then TXREQ is set with the priority
+static void test_send(void)
+{
+    uint8_t data[8] = {1, 2, 3, 4, 5, 6, 7, 8};
+    // LOAD TX BUFFER 0100 0abc, abc = 000 / 010 for TXB0SIDH / TXB1SIDH
+    const uint8_t load_0[14] = {0x40, CAN_MASTER_TX_SID >> 3, (CAN_MASTER_TX_SID << 5) & 0xE0,
+                                0, 0, 8, 1, 2, 3, 4, 5, 6, 7, 8};
+    const uint8_t request_0[3] = {0x02, 0x30, 0x08|3};              // WRITE TXB0CTRL
+    const uint8_t load_1[7] = {0x42, CAN_MASTER_TX_SID >> 3, (CAN_MASTER_TX_SID << 5) & 0xE0,
+                               0, 0, 1, 9};
+    const uint8_t request_1[3] = {0x02, 0x40, 0x08|1};              // WRITE TXB1CTRL
+
+    Command_Count = 0;
+    CHECK(0 == CAN_Send_Message(3, 8, data));
+    CHECK(2 == Command_Count);
+    CHECK(command_is(0, load_0, sizeof(load_0)));
+    CHECK(command_is(1, request_0, sizeof(request_0)));
+
+    // TX Buffer 0 is busy, the next frame goes to TX Buffer 1
+    data[0] = 9;
+    Command_Count = 0;
+    CHECK(1 == CAN_Send_Message(1, 1, data));
+    CHECK(command_is(0, load_1, sizeof(load_1)));
+    CHECK(command_is(1, request_1, sizeof(request_1)));
+
+    CAN_TX_Done(MCP_TX0IF|MCP_TX1IF);
+}
+
+// A frame is only loaded if its TXREQ fits the SPI command buffer too
+static void test_send_no_room(void)
+{
+    uint8_t data[1] = {0};
+
+    Free_Rows = 1;
+    Command_Count = 0;
+    CHECK(CAN_TX_NO_BUFFER == CAN_Send_Message(0, 1, data));
+    CHECK(0 == Command_Count);
+
+    Free_Rows = 2;
+    CHECK(0 == CAN_Send_Message(0, 1, data));
+    CHECK(2 == Command_Count);
+
+    Free_Rows = 0;
+    CHECK(!CAN_Abort_TX(0));
+
+    Free_Rows = COMMAND_BUFFER_SIZE;
+    CAN_TX_Done(MCP_TX0IF);
+}
+
+// Frames are read from RXBnSIDH and decoded by the receive FIFO
+static void test_receive(void)
+{
+    // READ RX BUFFER 1001 0nm0, nm = 00 / 10 for RXB0SIDH / RXB1SIDH
+    const uint8_t read_0[1] = {0x90};
+    const uint8_t read_1[1] = {0x94};
+    can_frame_t frame;
+
+    // Identifier 0x123, 5 data bytes
+    memset(RX_Buffer, 0, sizeof(RX_Buffer));
+    RX_Buffer[0] = 0x24;
+    RX_Buffer[1] = 0x60;
+    RX_Buffer[4] = 5;
+    memcpy(&RX_Buffer[5], "\xa0\x11\x22\x33\x44", 5);
+
+    Init_CAN_RX_FIFO();
+    Command_Count = 0;
+    CAN_Read_Message(true);
+    CAN_Read_Message(false);
+    CHECK(2 == Command_Count);
+    CHECK(command_is(0, read_0, sizeof(read_0)) && (CAN_FRAME_LEN == Commands[0].rx_len));
+    CHECK(command_is(1, read_1, sizeof(read_1)) && (CAN_FRAME_LEN == Commands[1].rx_len));
+
+    CHECK(Get_CAN_RX_Frame(&frame));
+    CHECK((0x123 == frame.id) && !frame.extended);
+    CHECK(5 == frame.dlc);
+    CHECK(0 == memcmp(frame.data, "\xa0\x11\x22\x33\x44", 5));
+}
+
+// The bit timing registers are written with one burst from CNF3, with
+//  the values MCP2515Calc.xlsx gives for 250 kbit/s from 16 MHz
+static void test_bit_timing(void)
+{
+    const uint8_t cnf[5] = {0x02, 0x28, 0x85, 0xF1, 0x41};
+
+    Command_Count = 0;
+    CAN_Initialize_1();
+    CHECK(0 < Command_Count);
+#if (16000000UL == CAN_OSC_HZ) && (250000UL == CAN_BITRATE)
+    CHECK(command_is(Command_Count-1, cnf, sizeof(cnf)));
+#endif
+}
+
+int main(void)
+{
+    test_send();
+    test_send_no_room();
+    test_receive();
+    test_bit_timing();
+
+    if (0 != Failures) return 1;
+
+    printf("can_test: all checks passed\n");
+    return 0;
+}
@@ -0,0 +1,31 @@
+/*******************************************************************************
+    File:
+        avr/interrupt.h (host simulator)
+
+    Notes:
+        ISRs become plain functions that the simulator HAL calls when the
+        simulated peripheral raises the interrupt. sei() and cli() only
+        track the I-bit; nothing preempts the firmware on the host, so the
+        HAL raises interrupts between calls into the node instead.
+
+*******************************************************************************/
+
+#ifndef SIM_AVR_INTERRUPT_H
+#define SIM_AVR_INTERRUPT_H
+
+#include <avr/io.h>
+
+#define ISR(vector)     void vector(void)
+
+#define sei()           (SREG |= 0x80)
+#define cli()           (SREG &= (uint8_t) ~0x80)
+
+// Vectors the HAL raises
+ISR(ADC_vect);
+ISR(EE_RDY_vect);
+ISR(INT0_vect);
+ISR(LIN_ERR_vect);
+ISR(LIN_TC_vect);
+ISR(TIMER0_COMPA_vect);
+
+#endif // SIM_AVR_INTERRUPT_H
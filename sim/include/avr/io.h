@@ -0,0 +1,291 @@
+/*******************************************************************************
+    File:
+        avr/io.h (host simulator)
+
+    Notes:
+        Stand-in for the ATtiny167 register file when the firmware is built
+        for the host simulator.
+
+        Each register the firmware touches is a plain variable, one set per
+        node library. sim_node_hal.c defines them by setting SIM_REG8 and
+        SIM_REG16 before including this file.
+
+        Registers with side effects on access are routed through the HAL:
+            LINDAT: reads and writes go to the LIN data buffer at the
+                    LINSEL index, which auto-increments like the hardware.
+            EEDR:   reads and writes go straight to the node's EEPROM at
+                    EEAR.
+
+        Bit positions match the ATtiny167 datasheet.
+
+*******************************************************************************/
+
+#ifndef SIM_AVR_IO_H
+#define SIM_AVR_IO_H
+
+#include <stdint.h>
+
+// #############################################################################
+// ------------ REGISTERS
+// #############################################################################
+
+#ifndef SIM_REG8
+#define SIM_REG8(name)      extern volatile uint8_t name;
+#endif
+#ifndef SIM_REG16
+#define SIM_REG16(name)     extern volatile uint16_t name;
+#endif
+
+// Status register
+SIM_REG8(SREG)
+
+// Ports
+SIM_REG8(PINA)      SIM_REG8(DDRA)      SIM_REG8(PORTA)
+SIM_REG8(PINB)      SIM_REG8(DDRB)      SIM_REG8(PORTB)
+
+// Clock, power and sleep
+SIM_REG8(CLKPR)     SIM_REG8(SMCR)      SIM_REG8(PRR)       SIM_REG8(MCUCR)
+
+// External and pin change interrupts
+SIM_REG8(EICRA)     SIM_REG8(EIMSK)     SIM_REG8(EIFR)
+SIM_REG8(PCICR)     SIM_REG8(PCIFR)     SIM_REG8(PCMSK0)    SIM_REG8(PCMSK1)
+
+// Timer 0
+SIM_REG8(TCCR0A)    SIM_REG8(TCCR0B)    SIM_REG8(TCNT0)
+SIM_REG8(OCR0A)     SIM_REG8(TIMSK0)    SIM_REG8(TIFR0)
+
+// Timer 1
+SIM_REG8(TCCR1A)    SIM_REG8(TCCR1B)    SIM_REG8(TCCR1C)    SIM_REG8(TCCR1D)
+SIM_REG8(TIMSK1)    SIM_REG8(TIFR1)
+SIM_REG16(TCNT1)    SIM_REG16(ICR1)     SIM_REG16(OCR1A)    SIM_REG16(OCR1B)
+
+// SPI
+SIM_REG8(SPCR)      SIM_REG8(SPSR)      SIM_REG8(SPDR)
+
+// ADC
+SIM_REG8(ADMUX)     SIM_REG8(ADCSRA)    SIM_REG8(ADCSRB)    SIM_REG8(AMISCR)
+SIM_REG8(DIDR0)     SIM_REG8(DIDR1)     SIM_REG16(ADC)
+
+// EEPROM (EEDR is below)
+SIM_REG8(EECR)      SIM_REG16(EEAR)
+
+// LIN/UART controller (LINDAT is below)
+SIM_REG8(LINCR)     SIM_REG8(LINSIR)    SIM_REG8(LINENIR)   SIM_REG8(LINERR)
+SIM_REG8(LINBTR)    SIM_REG8(LINBRRL)   SIM_REG8(LINBRRH)   SIM_REG8(LINDLR)
+SIM_REG8(LINIDR)    SIM_REG8(LINSEL)
+
+// Registers with side effects
+volatile uint8_t * Sim_LIN_Data_Register(void);
+volatile uint8_t * Sim_EEPROM_Data_Register(void);
+#define LINDAT              (*Sim_LIN_Data_Register())
+#define EEDR                (*Sim_EEPROM_Data_Register())
+
+// #############################################################################
+// ------------ BITS
+// #############################################################################
+
+// Ports
+#define PINA0   0
+#define PINA1   1
+#define PINA2   2
+#define PINA3   3
+#define PINA4   4
+#define PINA5   5
+#define PINA6   6
+#define PINA7   7
+#define PINB0   0
+#define PINB1   1
+#define PINB2   2
+#define PINB3   3
+#define PINB4   4
+#define PINB5   5
+#define PINB6   6
+#define PINB7   7
+#define PORTA0  0
+#define PORTA1  1
+#define PORTA2  2
+#define PORTA3  3
+#define PORTA4  4
+#define PORTA5  5
+#define PORTA6  6
+#define PORTA7  7
+#define PORTB0  0
+#define PORTB1  1
+#define PORTB2  2
+#define PORTB3  3
+#define PORTB4  4
+#define PORTB5  5
+#define PORTB6  6
+#define PORTB7  7
+#define PA0     0
+#define PA1     1
+#define PA2     2
+#define PA3     3
+#define PA4     4
+#define PA5     5
+#define PA6     6
+#define PA7     7
+#define PB0     0
+#define PB1     1
+#define PB2     2
+#define PB3     3
+#define PB4     4
+#define PB5     5
+#define PB6     6
+#define PB7     7
+
+// Pin change interrupts
+#define PCINT0  0
+#define PCINT1  1
+#define PCINT2  2
+#define PCINT3  3
+#define PCINT4  4
+#define PCINT5  5
+#define PCINT6  6
+#define PCINT7  7
+#define PCINT8  0
+#define PCINT9  1
+#define PCINT10 2
+#define PCINT11 3
+#define PCINT12 4
+#define PCINT13 5
+#define PCINT14 6
+#define PCINT15 7
+#define PCIE0   0
+#define PCIE1   1
+
+// Clock and sleep
+#define CLKPCE  7
+#define SE      0
+#define SM0     1
+#define SM1     2
+
+// External interrupts
+#define ISC00   0
+#define ISC01   1
+#define ISC10   2
+#define ISC11   3
+#define INT0    0
+#define INT1    1
+#define INTF0   0
+#define INTF1   1
+
+// Timer 0
+#define CS00    0
+#define CS01    1
+#define CS02    2
+#define OCIE0A  1
+#define OCF0A   1
+
+// Timer 1
+#define WGM10   0
+#define WGM11   1
+#define COM1B0  4
+#define COM1B1  5
+#define COM1A0  6
+#define COM1A1  7
+#define CS10    0
+#define CS11    1
+#define CS12    2
+#define WGM12   3
+#define WGM13   4
+#define OC1AU   0
+#define OC1AV   1
+#define OC1AW   2
+#define OC1AX   3
+#define OC1BU   4
+#define OC1BV   5
+#define OC1BW   6
+#define OC1BX   7
+#define TOIE1   0
+
+// SPI
+#define SPR0    0
+#define SPR1    1
+#define CPHA    2
+#define CPOL    3
+#define MSTR    4
+#define DORD    5
+#define SPE     6
+#define SPIE    7
+#define SPIF    7
+
+// ADC
+#define MUX0    0
+#define MUX1    1
+#define MUX2    2
+#define MUX3    3
+#define MUX4    4
+#define ADLAR   5
+#define REFS0   6
+#define REFS1   7
+#define ADPS0   0
+#define ADPS1   1
+#define ADPS2   2
+#define ADIE    3
+#define ADIF    4
+#define ADATE   5
+#define ADSC    6
+#define ADEN    7
+#define ISRCEN  0
+#define AREFEN  1
+#define XREFEN  2
+
+// EEPROM
+#define EERE    0
+#define EEPE    1
+#define EEMPE   2
+#define EERIE   3
+#define EEPM0   4
+#define EEPM1   5
+
+// LIN/UART controller
+#define LCMD0   0
+#define LCMD1   1
+#define LCMD2   2
+#define LENA    3
+#define LCONF0  4
+#define LCONF1  5
+#define LIN13   6
+#define LSWRES  7
+#define LRXOK   0
+#define LTXOK   1
+#define LIDOK   2
+#define LERR    3
+#define LBUSY   4
+#define LENRXOK 0
+#define LENTXOK 1
+#define LENIDOK 2
+#define LENERR  3
+#define LBERR   0
+#define LCERR   1
+#define LPERR   2
+#define LSERR   3
+#define LFERR   4
+#define LOVERR  5
+#define LTOERR  6
+#define LABORT  7
+#define LDISR   7
+#define LRXDL0  0
+#define LTXDL0  4
+#define LID0    0
+#define LID1    1
+#define LID2    2
+#define LID3    3
+#define LID4    4
+#define LID5    5
+#define LP0     6
+#define LP1     7
+#define LINDX0  0
+#define LAINC   3
+
+// #############################################################################
+// ------------ MEMORIES
+// #############################################################################
+
+#define RAMEND          0x2FF
+#define E2START         0
+#define E2END           0x1FF
+#define SPM_PAGESIZE    128
+
+#endif // SIM_AVR_IO_H
@@ -0,0 +1,23 @@
+/*******************************************************************************
+    File:
+        avr/pgmspace.h (host simulator)
+
+    Notes:
+        Program memory is ordinary memory on the host. PROGMEM data is
+        kept in its own section so avr_ram.py can leave it out.
+
+*******************************************************************************/
+
+#ifndef SIM_AVR_PGMSPACE_H
+#define SIM_AVR_PGMSPACE_H
+
+#include <stdint.h>
+#include <string.h>
+
+#define PROGMEM                 __attribute__((section(".progmem.data")))
+#define PSTR(s)                 (s)
+#define memcpy_P                memcpy
+#define pgm_read_byte(address)  (*(const uint8_t *) (address))
+#define pgm_read_word(address)  (*(const uint16_t *) (address))
+
+#endif // SIM_AVR_PGMSPACE_H
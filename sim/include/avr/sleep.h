@@ -0,0 +1,28 @@
+/*******************************************************************************
+    File:
+        avr/sleep.h (host simulator)
+
+    Notes:
+        Sleep takes no simulated time. sleep_cpu() tells the core the node
+        powered down and returns as if the wake up pulse had come at once:
+        the HAL drives the LIN RXD pin dominant until the main loop is left
+        (see sim_node_hal.c).
+
+*******************************************************************************/
+
+#ifndef SIM_AVR_SLEEP_H
+#define SIM_AVR_SLEEP_H
+
+#define SLEEP_MODE_IDLE         0
+#define SLEEP_MODE_ADC          1
+#define SLEEP_MODE_PWR_DOWN     2
+
+void Sim_Sleep_CPU(void);
+
+#define set_sleep_mode(mode)    ((void) (mode))
+#define sleep_enable()
+#define sleep_disable()
+#define sleep_cpu()             Sim_Sleep_CPU()
+#define sleep_mode()
+
+#endif // SIM_AVR_SLEEP_H
@@ -0,0 +1,19 @@
+/*******************************************************************************
+    File:
+        util/atomic.h (host simulator)
+
+    Notes:
+        The simulator never interrupts a node while it is running, so an
+        atomic block only has to run its body once.
+
+*******************************************************************************/
+
+#ifndef SIM_UTIL_ATOMIC_H
+#define SIM_UTIL_ATOMIC_H
+
+#define ATOMIC_RESTORESTATE     0
+#define ATOMIC_FORCEON          1
+
+#define ATOMIC_BLOCK(type)      for (int sim_atomic_once = 1; sim_atomic_once; sim_atomic_once = 0)
+
+#endif // SIM_UTIL_ATOMIC_H
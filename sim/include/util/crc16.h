@@ -0,0 +1,23 @@
+/*******************************************************************************
+    File:
+        util/crc16.h (host simulator)
+
+    Notes:
+        The C equivalent avr-libc documents for its inline assembly.
+
+*******************************************************************************/
+
+#ifndef SIM_UTIL_CRC16_H
+#define SIM_UTIL_CRC16_H
+
+#include <stdint.h>
+
+static inline uint16_t _crc_ccitt_update(uint16_t crc, uint8_t data)
+{
+    data ^= (uint8_t) crc;
+    data ^= data<<4;
+
+    return ((((uint16_t) data<<8) | (crc>>8)) ^ (uint8_t) (data>>4) ^ ((uint16_t) data<<3));
+}
+
+#endif // SIM_UTIL_CRC16_H
@@ -0,0 +1,634 @@
+/*******************************************************************************
+    File:
+        lin_bus.c
+
+    Notes:
+        Bit-timed model of the LIN wire shared by the simulated nodes.
+
+        Frame timing is nominal LIN 2.x with no inter-byte or response
+        space (the firmware takes no time on the host):
+            header:     break (13) + delimiter (1) + sync (10) + PID (10)
+                        = 34 bits
+            response:   10 bits per data byte plus the checksum byte
+
+        A header goes to every node. Nodes that command a response from
+        their IDOK interrupt take part in the frame:
+            one sender:     TXOK to it, RXOK to every receiver that expects
+                            that many bytes
+            several:        the wire is the AND of what they send (dominant
+                            zeros win). A sender that reads back something
+                            else gets LBERR, receivers get RXOK if the ANDed
+                            data still checks out, otherwise LCERR
+            nobody:         receivers get LTOERR once the LIN 2.x maximum
+                            frame time (1.4 x nominal) for their length has
+                            passed since the break
+
+        A receiver expecting more bytes than were sent times out, one
+        expecting fewer reads a data byte as the checksum.
+
+        A header started while a frame is still running breaks into it.
+        The node sending the header aborted its own part (lin_tx_header()
+        does), every other node still in the frame gets LFERR (receivers)
+        or LBERR (senders).
+
+    Public Functions:
+        void LIN_Bus_Init(const lin_bus_ops_t * p_ops, int num_nodes, uint64_t bit_ns)
+        void LIN_Bus_Command(int node, uint64_t now_ns, const sim_lin_cmd_t * p_cmd)
+        uint64_t LIN_Bus_Next_Event(void)
+        void LIN_Bus_Run(uint64_t now_ns)
+        lin_bus_stats_t LIN_Bus_Get_Stats(uint64_t now_ns)
+
+*******************************************************************************/
+
+// #############################################################################
+// ------------ INCLUDES
+// #############################################################################
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <string.h>
+
+// This module's header file
+#include "lin_bus.h"
+
+// #############################################################################
+// ------------ MODULE DEFINITIONS
+// #############################################################################
+
+#define HEADER_BITS             (34)
+#define BITS_PER_BYTE           (10)
+
+// LINERR bits (ATtiny167)
+#define LIN_ERR_BIT             (1<<0)      // LBERR
+#define LIN_ERR_CHECKSUM        (1<<1)      // LCERR
+#define LIN_ERR_FRAMING         (1<<4)      // LFERR
+#define LIN_ERR_TIMEOUT         (1<<6)      // LTOERR
+
+// Diagnostic frames use the classic checksum
+#define FIRST_CLASSIC_CHECKSUM_ID   (0x3C)
+
+// #############################################################################
+// ------------ TYPE DEFINITIONS
+// #############################################################################
+
+typedef enum
+{
+    bus_idle = 0,
+    bus_header,             // Header on the wire
+    bus_response,           // Response on the wire
+    bus_waiting             // Receivers waiting for a response that isn't coming
+} bus_state_t;
+
+typedef enum
+{
+    role_none = 0,
+    role_receiver,
+    role_sender
+} role_t;
+
+typedef struct
+{
+    role_t role;
+    uint8_t len;
+    uint8_t data[SIM_LIN_MAX_DATA_LEN];
+    uint64_t timeout_ns;
+} part_t;
+
+// #############################################################################
+// ------------ MODULE VARIABLES
+// #############################################################################
+
+static lin_bus_ops_t Ops;
+static int Num_Nodes;
+static uint64_t Bit_NS;
+
+static bus_state_t State = bus_idle;
+static part_t Parts[LIN_BUS_MAX_NODES];
+
+// Frame in progress
+static uint32_t Frame_Seq;
+static uint8_t Frame_ID;
+static uint64_t Header_Start_NS;
+static uint64_t Event_NS;
+static uint64_t Driven_Since_NS;
+
+// True while the header is handed to the nodes, responses can be commanded
+static bool Collecting;
+
+static lin_bus_stats_t Stats;
+
+// #############################################################################
+// ------------ PRIVATE FUNCTION PROTOTYPES
+// #############################################################################
+
+static void start_header(int node, uint64_t now_ns, uint8_t id);
+static void end_header(uint64_t now_ns);
+static void end_response(uint64_t now_ns);
+static void time_out_receivers(uint64_t now_ns);
+static void flag_error(int node, uint64_t now_ns, uint8_t error_status);
+static uint64_t get_frame_max_ns(uint8_t len);
+static uint8_t get_checksum(uint8_t id, const uint8_t * p_data, uint8_t len);
+static uint8_t get_protected_id(uint8_t id);
+
+// #############################################################################
+// ------------ PUBLIC FUNCTIONS
+// #############################################################################
+
+/****************************************************************************
+    Public Function
+        LIN_Bus_Init
+
+    Parameters
+        const lin_bus_ops_t * p_ops: how to reach the nodes
+        int num_nodes: number of nodes on the bus
+        uint64_t bit_ns: bit time
+
+    Description
+        Starts an idle bus with cleared statistics
+
+****************************************************************************/
+void LIN_Bus_Init(const lin_bus_ops_t * p_ops, int num_nodes, uint64_t bit_ns)
+{
+    Ops = *p_ops;
+    Num_Nodes = (LIN_BUS_MAX_NODES < num_nodes) ? LIN_BUS_MAX_NODES : num_nodes;
+    Bit_NS = bit_ns;
+    State = bus_idle;
+    Collecting = false;
+    Frame_Seq = 0;
+    memset(Parts, 0, sizeof(Parts));
+    memset(&Stats, 0, sizeof(Stats));
+}
+
+/****************************************************************************
+    Public Function
+        LIN_Bus_Command
+
+    Parameters
+        int node: node giving the command
+        uint64_t now_ns: current time
+        const sim_lin_cmd_t * p_cmd: the command
+
+    Description
+        A node wrote a command to its LIN controller. Response commands
+            only count while the node is handling the header.
+
+****************************************************************************/
+void LIN_Bus_Command(int node, uint64_t now_ns, const sim_lin_cmd_t * p_cmd)
+{
+    if ((0 > node) || (Num_Nodes <= node)) return;
+
+    switch (p_cmd->type)
+    {
+        case sim_lin_abort:
+            Parts[node].role = role_none;
+            break;
+
+        case sim_lin_tx_header:
+            start_header(node, now_ns, p_cmd->id);
+            break;
+
+        case sim_lin_rx_response:
+            if (!Collecting) break;
+            Parts[node].role = role_receiver;
+            Parts[node].len = p_cmd->len;
+            Parts[node].timeout_ns = Header_Start_NS+get_frame_max_ns(p_cmd->len);
+            break;
+
+        case sim_lin_tx_response:
+            if (!Collecting) break;
+            Parts[node].role = role_sender;
+            Parts[node].len = (SIM_LIN_MAX_DATA_LEN < p_cmd->len) ? SIM_LIN_MAX_DATA_LEN : p_cmd->len;
+            memcpy(Parts[node].data, p_cmd->data, Parts[node].len);
+            break;
+
+        default:
+            break;
+    }
+}
+
+/****************************************************************************
+    Public Function
+        LIN_Bus_Next_Event
+
+    Parameters
+        None
+
+    Description
+        Returns the time of the next thing the bus has to do
+
+****************************************************************************/
+uint64_t LIN_Bus_Next_Event(void)
+{
+    uint64_t next = LIN_BUS_NO_EVENT;
+
+    switch (State)
+    {
+        case bus_header:
+        case bus_response:
+            next = Event_NS;
+            break;
+
+        case bus_waiting:
+            for (int node = 0; node < Num_Nodes; node++)
+            {
+                if ((role_receiver == Parts[node].role) && (next > Parts[node].timeout_ns))
+                {
+                    next = Parts[node].timeout_ns;
+                }
+            }
+            break;
+
+        default:
+            break;
+    }
+
+    return next;
+}
+
+/****************************************************************************
+    Public Function
+        LIN_Bus_Run
+
+    Parameters
+        uint64_t now_ns: time of the event from LIN_Bus_Next_Event()
+
+    Description
+        Ends the header or response on the wire, or times out receivers
+
+****************************************************************************/
+void LIN_Bus_Run(uint64_t now_ns)
+{
+    switch (State)
+    {
+        case bus_header:
+            end_header(now_ns);
+            break;
+
+        case bus_response:
+            end_response(now_ns);
+            break;
+
+        case bus_waiting:
+            time_out_receivers(now_ns);
+            break;
+
+        default:
+            break;
+    }
+}
+
+/****************************************************************************
+    Public Function
+        LIN_Bus_Get_Stats
+
+    Parameters
+        uint64_t now_ns: current time
+
+    Description
+        Returns the statistics, counting the part of the current header or
+            response sent so far as busy
+
+****************************************************************************/
+lin_bus_stats_t LIN_Bus_Get_Stats(uint64_t now_ns)
+{
+    lin_bus_stats_t result = Stats;
+
+    if ((bus_header == State) || (bus_response == State))
+    {
+        result.busy_ns += now_ns-Driven_Since_NS;
+    }
+
+    return result;
+}
+
+// #############################################################################
+// ------------ PRIVATE FUNCTIONS
+// #############################################################################
+
+/****************************************************************************
+    Private Function
+        start_header
+
+    Parameters
+        int node: node sending the header
+        uint64_t now_ns: start of the break
+        uint8_t id: frame ID
+
+    Description
+        Puts a header on the wire, breaking into any frame still running
+
+****************************************************************************/
+static void start_header(int node, uint64_t now_ns, uint8_t id)
+{
+    part_t old_parts[LIN_BUS_MAX_NODES];
+    bus_state_t old_state = State;
+
+    if ((bus_header == old_state) || (bus_response == old_state))
+    {
+        Stats.busy_ns += now_ns-Driven_Since_NS;
+        Stats.aborted++;
+    }
+
+    // The new frame owns the bus before anybody hears about the old one
+    memcpy(old_parts, Parts, sizeof(old_parts));
+    memset(Parts, 0, sizeof(Parts));
+    Frame_Seq++;
+    Frame_ID = id;
+    Header_Start_NS = now_ns;
+    Driven_Since_NS = now_ns;
+    Event_NS = now_ns+(HEADER_BITS*Bit_NS);
+    State = bus_header;
+    Stats.headers++;
+    Stats.ids[id].headers++;
+
+    for (int other = 0; other < Num_Nodes; other++)
+    {
+        if (other == node) continue;
+        if (role_receiver == old_parts[other].role)
+        {
+            flag_error(other, now_ns, LIN_ERR_FRAMING);
+        }
+        else if (role_sender == old_parts[other].role)
+        {
+            flag_error(other, now_ns, LIN_ERR_BIT);
+        }
+    }
+}
+
+/****************************************************************************
+    Private Function
+        end_header
+
+    Parameters
+        uint64_t now_ns: end of the header
+
+    Description
+        Hands the header to every node and starts the response, if any
+
+****************************************************************************/
+static void end_header(uint64_t now_ns)
+{
+    uint32_t seq = Frame_Seq;
+    uint8_t response_len = 0;
+    bool any_sender = false;
+    bool any_receiver = false;
+
+    Stats.busy_ns += now_ns-Driven_Since_NS;
+
+    Collecting = true;
+    for (int node = 0; node < Num_Nodes; node++)
+    {
+        Ops.header(node, now_ns, Frame_ID);
+        if (seq != Frame_Seq) break;
+    }
+    Collecting = false;
+
+    // Somebody started another header in the meantime
+    if (seq != Frame_Seq) return;
+
+    for (int node = 0; node < Num_Nodes; node++)
+    {
+        if (role_sender == Parts[node].role)
+        {
+            any_sender = true;
+            if (response_len < Parts[node].len) response_len = Parts[node].len;
+        }
+        else if (role_receiver == Parts[node].role)
+        {
+            any_receiver = true;
+        }
+    }
+
+    if (any_sender)
+    {
+        State = bus_response;
+        Driven_Since_NS = now_ns;
+        Event_NS = now_ns+((uint64_t) (response_len+1)*BITS_PER_BYTE*Bit_NS);
+    }
+    else if (any_receiver)
+    {
+        State = bus_waiting;
+        Stats.unanswered++;
+    }
+    else
+    {
+        State = bus_idle;
+    }
+}
+
+/****************************************************************************
+    Private Function
+        end_response
+
+    Parameters
+        uint64_t now_ns: end of the checksum byte
+
+    Description
+        Works out what went over the wire and tells each node how its part
+            of the frame went
+
+****************************************************************************/
+static void end_response(uint64_t now_ns)
+{
+    part_t parts[LIN_BUS_MAX_NODES];
+    uint8_t wire[SIM_LIN_MAX_DATA_LEN+1];
+    uint8_t wire_len = 0;
+    uint8_t wire_checksum = 0xFF;
+    int num_senders = 0;
+    bool any_waiting = false;
+    bool any_received = false;
+
+    Stats.busy_ns += now_ns-Driven_Since_NS;
+
+    // Dominant zeros win: the wire is the AND of every sender
+    memset(wire, 0xFF, sizeof(wire));
+    for (int node = 0; node < Num_Nodes; node++)
+    {
+        if (role_sender != Parts[node].role) continue;
+        num_senders++;
+        if (wire_len < Parts[node].len) wire_len = Parts[node].len;
+        for (uint8_t index = 0; index < Parts[node].len; index++)
+        {
+            wire[index] &= Parts[node].data[index];
+        }
+        wire_checksum &= get_checksum(Frame_ID, Parts[node].data, Parts[node].len);
+    }
+    wire[wire_len] = wire_checksum;
+    if (1 < num_senders)
+    {
+        Stats.collisions++;
+        Stats.ids[Frame_ID].collisions++;
+    }
+
+    // Receivers expecting more bytes keep waiting (and will time out)
+    memcpy(parts, Parts, sizeof(parts));
+    for (int node = 0; node < Num_Nodes; node++)
+    {
+        if ((role_receiver == Parts[node].role) && (Parts[node].len > wire_len))
+        {
+            any_waiting = true;
+        }
+        else
+        {
+            Parts[node].role = role_none;
+        }
+    }
+    State = any_waiting ? bus_waiting : bus_idle;
+
+    for (int node = 0; node < Num_Nodes; node++)
+    {
+        if (role_sender == parts[node].role)
+        {
+            if (    (parts[node].len == wire_len)
+                &&  (0 == memcmp(parts[node].data, wire, wire_len))
+                &&  (get_checksum(Frame_ID, parts[node].data, wire_len) == wire_checksum))
+            {
+                Ops.tx_done(node, now_ns);
+            }
+            else
+            {
+                flag_error(node, now_ns, LIN_ERR_BIT);
+            }
+        }
+        else if ((role_receiver == parts[node].role) && (parts[node].len <= wire_len))
+        {
+            // A short receiver takes the next byte as the checksum
+            if (get_checksum(Frame_ID, wire, parts[node].len) == wire[parts[node].len])
+            {
+                any_received = true;
+                Ops.response(node, now_ns, wire, parts[node].len);
+            }
+            else
+            {
+                flag_error(node, now_ns, LIN_ERR_CHECKSUM);
+            }
+        }
+    }
+
+    if (any_received)
+    {
+        Stats.frames++;
+        Stats.ids[Frame_ID].frames++;
+        Stats.data_bytes += wire_len;
+    }
+}
+
+/****************************************************************************
+    Private Function
+        time_out_receivers
+
+    Parameters
+        uint64_t now_ns: current time
+
+    Description
+        Flags LTOERR to receivers whose maximum frame time has passed
+
+****************************************************************************/
+static void time_out_receivers(uint64_t now_ns)
+{
+    bool any_waiting = false;
+    bool timed_out[LIN_BUS_MAX_NODES] = {false};
+
+    for (int node = 0; node < Num_Nodes; node++)
+    {
+        if (role_receiver != Parts[node].role) continue;
+        if (now_ns >= Parts[node].timeout_ns)
+        {
+            Parts[node].role = role_none;
+            timed_out[node] = true;
+        }
+        else
+        {
+            any_waiting = true;
+        }
+    }
+    if (!any_waiting) State = bus_idle;
+
+    for (int node = 0; node < Num_Nodes; node++)
+    {
+        if (timed_out[node]) flag_error(node, now_ns, LIN_ERR_TIMEOUT);
+    }
+}
+
+/****************************************************************************
+    Private Function
+        flag_error
+
+    Parameters
+        int node: node to tell
+        uint64_t now_ns: current time
+        uint8_t error_status: LINERR bits
+
+    Description
+        Raises the LIN error interrupt of a node
+
+****************************************************************************/
+static void flag_error(int node, uint64_t now_ns, uint8_t error_status)
+{
+    Stats.node_errors++;
+    Ops.error(node, now_ns, error_status);
+}
+
+/****************************************************************************
+    Private Function
+        get_frame_max_ns
+
+    Parameters
+        uint8_t len: number of data bytes
+
+    Description
+        Returns the LIN 2.x maximum frame time, 1.4 x nominal
+
+****************************************************************************/
+static uint64_t get_frame_max_ns(uint8_t len)
+{
+    uint64_t nominal_bits = HEADER_BITS+((uint64_t) (len+1)*BITS_PER_BYTE);
+
+    return (nominal_bits*Bit_NS*14)/10;
+}
+
+/****************************************************************************
+    Private Function
+        get_checksum
+
+    Parameters
+        uint8_t id: frame ID
+        const uint8_t * p_data: data bytes
+        uint8_t len: number of bytes
+
+    Description
+        Returns the LIN 2.x checksum, enhanced (with the PID) except for
+            the diagnostic frames
+
+****************************************************************************/
+static uint8_t get_checksum(uint8_t id, const uint8_t * p_data, uint8_t len)
+{
+    uint16_t sum = (FIRST_CLASSIC_CHECKSUM_ID <= id) ? 0 : get_protected_id(id);
+
+    for (uint8_t index = 0; index < len; index++)
+    {
+        sum += p_data[index];
+        if (0xFF < sum) sum -= 0xFF;
+    }
+
+    return (uint8_t) ~sum;
+}
+
+/****************************************************************************
+    Private Function
+        get_protected_id
+
+    Parameters
+        uint8_t id: 6-bit frame ID
+
+    Description
+        Returns the ID with its two parity bits
+
+****************************************************************************/
+static uint8_t get_protected_id(uint8_t id)
+{
+    uint8_t p0 = ((id>>0) ^ (id>>1) ^ (id>>2) ^ (id>>4)) & 0x01;
+    uint8_t p1 = (uint8_t) ~((id>>1) ^ (id>>3) ^ (id>>4) ^ (id>>5)) & 0x01;
+
+    return (id & 0x3F) | (uint8_t) (p0<<6) | (uint8_t) (p1<<7);
+}
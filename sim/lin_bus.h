@@ -0,0 +1,73 @@
+/*******************************************************************************
+    File:
+        lin_bus.h
+
+    Notes:
+        Bit-timed model of the LIN wire shared by the simulated nodes.
+
+*******************************************************************************/
+
+#ifndef LIN_BUS_H
+#define LIN_BUS_H
+
+#include <stdint.h>
+#include <stdbool.h>
+
+#include "sim_node.h"
+
+// #############################################################################
+// ------------ DEFINITIONS
+// #############################################################################
+
+#define LIN_BUS_MAX_NODES       (32)
+
+// Nothing scheduled on the bus
+#define LIN_BUS_NO_EVENT        (UINT64_MAX)
+
+// Frame IDs are 6 bits
+#define LIN_BUS_NUM_IDS         (64)
+
+// #############################################################################
+// ------------ TYPE DEFINITIONS
+// #############################################################################
+
+// How the bus reaches the nodes (indexed as in LIN_Bus_Command())
+typedef struct
+{
+    void (*header)(int node, uint64_t now_ns, uint8_t id);
+    void (*response)(int node, uint64_t now_ns, const uint8_t * p_data, uint8_t len);
+    void (*tx_done)(int node, uint64_t now_ns);
+    void (*error)(int node, uint64_t now_ns, uint8_t error_status);
+} lin_bus_ops_t;
+
+typedef struct
+{
+    uint32_t headers;           // Headers sent with this ID
+    uint32_t frames;            // Responses received by at least one node
+    uint32_t collisions;        // Responses sent by more than one node at once
+} lin_bus_id_stats_t;
+
+typedef struct
+{
+    uint64_t busy_ns;           // Time a header or response was on the wire
+    uint32_t headers;           // Headers sent
+    uint32_t frames;            // Responses received by at least one node
+    uint32_t data_bytes;        // Payload of those responses
+    uint32_t unanswered;        // Headers somebody listened to but nobody answered
+    uint32_t collisions;        // Responses sent by more than one node at once
+    uint32_t aborted;           // Frames cut short by the next header
+    uint32_t node_errors;       // Errors flagged to the nodes
+    lin_bus_id_stats_t ids[LIN_BUS_NUM_IDS];    // The same per frame ID
+} lin_bus_stats_t;
+
+// #############################################################################
+// ------------ PUBLIC FUNCTION PROTOTYPES
+// #############################################################################
+
+void LIN_Bus_Init(const lin_bus_ops_t * p_ops, int num_nodes, uint64_t bit_ns);
+void LIN_Bus_Command(int node, uint64_t now_ns, const sim_lin_cmd_t * p_cmd);
+uint64_t LIN_Bus_Next_Event(void);
+void LIN_Bus_Run(uint64_t now_ns);
+lin_bus_stats_t LIN_Bus_Get_Stats(uint64_t now_ns);
+
+#endif // LIN_BUS_H
@@ -0,0 +1,1054 @@
+/*******************************************************************************
+    File:
+        lin_sim.c
+
+    Notes:
+        Host-side virtual LIN bus: runs the master and slave firmware on one
+        simulated bus and measures it. See read_me.txt for usage.
+
+        Every node is a private copy of libsim_master.so or libsim_slave.so
+        (see sim_node.h). The core is a discrete event loop over simulated
+        time. The events are each node's 0.5ms system tick, the bus model
+        (lin_bus.c) and the CAN messages sent to the master.
+
+        Measurements start after a warm up, so that CAN init and slave
+        discovery are over:
+            latency:    from a CAN position message reaching the master to
+                        each slave's first Set_Light_Intensity() or
+                        Move_Analog_Servo_To_Position() call after it. The
+                        scene latency is the latest of those per message,
+                        the spread the latest less the earliest.
+                        Slaves whose command doesn't change make no call and
+                        give no sample.
+            throughput: bus utilisation, frames and payload per second.
+            RAM:        the AVR master's static RAM with room for the
+                        slaves on the bus, from its images built for one
+                        slave and for NUM_SLAVES, and the slave's (see the
+                        Makefile).
+
+        The master is told how many slaves are on the bus with a CAN slave
+        count message half way through the warm up. With -a the slaves
+        power up without a number instead, and the master is told to number
+        them then (auto_addressing.c).
+
+*******************************************************************************/
+
+// #############################################################################
+// ------------ INCLUDES
+// #############################################################################
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <getopt.h>
+#include <limits.h>
+#include <libgen.h>
+#include <dlfcn.h>
+
+// Firmware configuration (LIN IDs, CAN message layout, bit rate)
+#include "config.h"
+#include "lin_drv.h"
+
+#include "sim_node.h"
+#include "lin_bus.h"
+
+// AVR static RAM measured by the Makefile
+#include "avr_ram.h"
+
+// #############################################################################
+// ------------ MODULE DEFINITIONS
+// #############################################################################
+
+#define MAX_NODES               (1+MAX_NUM_SLAVES)
+#define MASTER_INDEX            (0)
+
+#define NS_PER_MS               (1000000ULL)
+#define NS_PER_S                (1000000000ULL)
+
+// LIN bit time: 32 system clocks per bit, times (LINBRR+1)
+#define LIN_BIT_NS              ((32ULL*(CONF_LINBRR+1)*NS_PER_S)/(FOSC*1000ULL))
+
+// Nodes power up a little apart, within one tick
+#define START_SPREAD_NS         (137000ULL)
+
+// ATtiny167 SRAM, the stack gets what the static RAM leaves
+#define AVR_SRAM_BYTES          (512)
+
+// Master RAM per slave it has room for
+#if (1 < NUM_SLAVES)
+#define MASTER_RAM_PER_SLAVE    ((double) (MASTER_RAM_NUM_SLAVES-MASTER_RAM_ONE_SLAVE)/(NUM_SLAVES-1))
+#else
+#define MASTER_RAM_PER_SLAVE    (0.0)
+#endif
+#define GET_MASTER_RAM(slaves)  (MASTER_RAM_ONE_SLAVE+((slaves)-1)*MASTER_RAM_PER_SLAVE)
+
+// Defaults
+#define DEFAULT_WARM_UP_MS      (1000)
+#define DEFAULT_RUN_S           (10)
+#define DEFAULT_INTERVAL_MS     (250)
+
+// With -z the position message after this many puts the bus to sleep, the
+//  next one wakes it up SLEEP_MS later with the same position again
+#define SLEEP_AT_MESSAGE        (2)
+#define SLEEP_MS                (1000)
+
+// #############################################################################
+// ------------ TYPE DEFINITIONS
+// #############################################################################
+
+typedef struct
+{
+    uint32_t samples;
+    uint64_t sum_ns;
+    uint64_t min_ns;
+    uint64_t max_ns;
+} latency_t;
+
+typedef struct
+{
+    int index;                  // 0 is the master, n is slave number n
+    void * p_handle;
+    sim_node_tick_t tick;
+    sim_node_lin_header_t lin_header;
+    sim_node_lin_response_t lin_response;
+    sim_node_lin_tx_done_t lin_tx_done;
+    sim_node_lin_error_t lin_error;
+    sim_node_can_receive_t can_receive;
+    uint64_t next_tick_ns;
+
+    // Waiting to act on the last CAN message
+    bool pending;
+    latency_t latency;
+
+    // Last light intensity it set, and whether it was on when the bus went
+    //  to sleep and came on again once it woke up
+    uint8_t intensity;
+    bool lit;
+    bool relit;
+} node_t;
+
+typedef struct
+{
+    int num_slaves;
+    uint64_t warm_up_ns;
+    uint64_t run_ns;
+    uint64_t interval_ns;
+    int addressing_mode;        // -1: slaves have numbers, no auto-addressing
+    bool sleep_test;            // Put the bus to sleep and wake it up again
+} scenario_t;
+
+typedef struct
+{
+    int num_slaves;
+    double seconds;
+    lin_bus_stats_t bus;
+    uint32_t can_received;
+    uint32_t can_dropped;
+    uint32_t can_sent;
+    latency_t scene;
+    latency_t spread;               // Earliest to latest slave per scene
+    latency_t slaves[MAX_NODES];
+    bool addressed;                 // The master reported auto-addressing
+    uint8_t addressing[CAN_ADDRESSING_REPORT_LEN];
+    uint64_t addressing_ns;         // CAN message to report
+    uint32_t powered_down;          // Slaves that powered down
+    uint32_t powered_down_lit;      // The same with the light still on
+    uint32_t lit;                   // Slaves with the light on before the sleep
+    uint32_t woken;                 // Those that turned it on again
+    uint64_t wake_first_ns;         // Wake up message to the first of them
+    uint64_t wake_last_ns;          // Wake up message to the last of them
+} result_t;
+
+// #############################################################################
+// ------------ MODULE VARIABLES
+// #############################################################################
+
+static char Library_Dir[PATH_MAX];
+
+static node_t Nodes[MAX_NODES];
+static int Num_Nodes;
+static uint64_t Now_NS;
+
+// Measurement
+static bool Measuring;
+static uint64_t Last_CAN_NS;
+static uint64_t Scene_Earliest_NS;
+static uint64_t Scene_Latest_NS;
+static bool Scene_Open;
+static latency_t Scene_Latency;
+static latency_t Scene_Spread;
+static uint32_t CAN_Sent;
+
+// Auto-addressing
+static bool Slaves_Unnumbered;
+static uint64_t Addressing_Start_NS;
+static uint64_t Addressing_End_NS;
+static uint8_t Addressing_Report[CAN_ADDRESSING_REPORT_LEN];
+
+// Sleep and wake up, the scene of the wake up message is timed on its own
+static bool Bus_Sleeping;
+static bool Wake_Scene;
+static uint32_t Powered_Down;
+static uint32_t Powered_Down_Lit;
+static uint32_t Lit;
+static uint32_t Woken;
+static uint64_t Wake_First_NS;
+static uint64_t Wake_Last_NS;
+
+// Directions the position messages go round (the master's test positions)
+static const rect_vect_t Positions[] = {
+    {.x = 0, .y = -100},
+    {.x = 70, .y = -70},
+    {.x = 100, .y = 0},
+    {.x = 70, .y = 70},
+    {.x = 0, .y = 100},
+    {.x = -70, .y = 70},
+    {.x = -100, .y = 0},
+    {.x = -70, .y = -70},
+};
+#define NUM_POSITIONS   (sizeof(Positions)/sizeof(Positions[0]))
+
+// #############################################################################
+// ------------ PRIVATE FUNCTION PROTOTYPES
+// #############################################################################
+
+static bool load_node(node_t * p_node, int index);
+static void unload_nodes(void);
+static bool run_scenario(const scenario_t * p_scenario, result_t * p_result);
+static bool send_position(uint32_t count);
+static bool send_slave_count(int num_slaves);
+static bool send_addressing(int mode);
+static bool send_sleep(void);
+static void close_scene(void);
+static void add_sample(latency_t * p_latency, uint64_t sample_ns);
+static bool is_addressing_ok(const result_t * p_result, const scenario_t * p_scenario);
+static bool is_sleep_ok(const result_t * p_result, const scenario_t * p_scenario);
+static void print_result(const result_t * p_result, const scenario_t * p_scenario);
+static void print_sweep_line(const result_t * p_result);
+static double get_avg_ms(const latency_t * p_latency);
+
+// Node callbacks
+static void on_lin_command(void * p_context, const sim_lin_cmd_t * p_cmd);
+static void on_light_set(void * p_context, uint8_t intensity);
+static void on_servo_moved(void * p_context, uint16_t position);
+static void on_can_sent(void * p_context, uint8_t len, const uint8_t * p_data);
+static void on_powered_down(void * p_context);
+static void on_actuation(node_t * p_node);
+
+// Bus callbacks
+static void bus_header(int node, uint64_t now_ns, uint8_t id);
+static void bus_response(int node, uint64_t now_ns, const uint8_t * p_data, uint8_t len);
+static void bus_tx_done(int node, uint64_t now_ns);
+static void bus_error(int node, uint64_t now_ns, uint8_t error_status);
+
+// #############################################################################
+// ------------ MAIN
+// #############################################################################
+
+static void usage(FILE * p_file, const char * p_name)
+{
+    fprintf(p_file,
+        "usage: %s [-n slaves] [-t seconds] [-i interval_ms] [-w warm_up_ms] [-l max_ms] [-a mode] [-z] [-s] [-h]\n"
+        "    -n  slaves on the bus (default and maximum %d)\n"
+        "    -t  simulated seconds to measure (default %d)\n"
+        "    -i  time between CAN position messages (default %d ms)\n"
+        "    -w  time before measuring starts (default %d ms)\n"
+        "    -l  exit with 1 if the worst scene latency is over this (ms)\n"
+        "    -a  slaves start without a number and the master numbers them,\n"
+        "        mode 0 for the slaves without one, 1 for all (exits with 1\n"
+        "        if a slave is left out)\n"
+        "    -z  put the bus to sleep after the %d. position message and wake\n"
+        "        it up %d ms later with the same position (exits with 1 if a\n"
+        "        slave doesn't power down with its light off, or a light that\n"
+        "        was on doesn't come on again)\n"
+        "    -s  sweep 1..slaves slaves, one line each\n"
+        "    -h, --help  this help\n",
+        p_name, NUM_SLAVES, DEFAULT_RUN_S, DEFAULT_INTERVAL_MS, DEFAULT_WARM_UP_MS,
+        SLEEP_AT_MESSAGE, SLEEP_MS);
+}
+
+int main(int argc, char ** argv)
+{
+    scenario_t scenario = {
+        .num_slaves = NUM_SLAVES,
+        .warm_up_ns = DEFAULT_WARM_UP_MS*NS_PER_MS,
+        .run_ns = DEFAULT_RUN_S*NS_PER_S,
+        .interval_ns = DEFAULT_INTERVAL_MS*NS_PER_MS,
+        .addressing_mode = -1,
+    };
+    double max_latency_ms = 0;
+    bool sweep = false;
+    bool failed = false;
+    bool unnumbered = false;
+    bool sleepless = false;
+    int option;
+    char exe_path[PATH_MAX];
+    ssize_t len;
+
+    static const struct option long_options[] = {
+        { "help", no_argument, NULL, 'h' },
+        { NULL, 0, NULL, 0 },
+    };
+
+    while (-1 != (option = getopt_long(argc, argv, "n:t:i:w:l:a:zsh", long_options, NULL)))
+    {
+        switch (option)
+        {
+            case 'n': scenario.num_slaves = atoi(optarg); break;
+            case 't': scenario.run_ns = (uint64_t) (atof(optarg)*NS_PER_S); break;
+            case 'i': scenario.interval_ns = (uint64_t) atoi(optarg)*NS_PER_MS; break;
+            case 'w': scenario.warm_up_ns = (uint64_t) atoi(optarg)*NS_PER_MS; break;
+            case 'l': max_latency_ms = atof(optarg); break;
+            case 'a': scenario.addressing_mode = atoi(optarg); break;
+            case 'z': scenario.sleep_test = true; break;
+            case 's': sweep = true; break;
+            case 'h': usage(stdout, argv[0]); return 0;
+            default: usage(stderr, argv[0]); return 2;
+        }
+    }
+    if ((1 > scenario.num_slaves) || (NUM_SLAVES < scenario.num_slaves) || (0 == scenario.interval_ns))
+    {
+        usage(stderr, argv[0]);
+        return 2;
+    }
+
+    // The node libraries sit next to the executable
+    len = readlink("/proc/self/exe", exe_path, sizeof(exe_path)-1);
+    if (0 > len)
+    {
+        perror("readlink");
+        return 2;
+    }
+    exe_path[len] = '\0';
+    snprintf(Library_Dir, sizeof(Library_Dir), "%s", dirname(exe_path));
+
+    printf("LIN bus simulation: master + %d slave(s) built for %d, %.1f kbit/s, "
+        "CAN position message every %llu ms\n",
+        scenario.num_slaves, NUM_SLAVES, 1e6/(double) LIN_BIT_NS,
+        (unsigned long long) (scenario.interval_ns/NS_PER_MS));
+    printf("AVR static RAM (%s): master %d B with room for 1 slave, %.1f B per slave more; "
+        "slave %d B; %d B SRAM\n",
+        RAM_SOURCE, MASTER_RAM_ONE_SLAVE, MASTER_RAM_PER_SLAVE, SLAVE_RAM, AVR_SRAM_BYTES);
+
+    if (sweep)
+    {
+        int max_slaves = scenario.num_slaves;
+
+        printf("\nslaves  util %%  frames/s  bytes/s  unanswered/s  errors/s  scene avg ms  scene max ms  RAM B\n");
+        for (int slaves = 1; slaves <= max_slaves; slaves++)
+        {
+            result_t result;
+
+            scenario.num_slaves = slaves;
+            if (!run_scenario(&scenario, &result)) return 2;
+            print_sweep_line(&result);
+            if ((0 < max_latency_ms) && (result.scene.max_ns > max_latency_ms*NS_PER_MS)) failed = true;
+            if (!is_addressing_ok(&result, &scenario)) unnumbered = true;
+            if (!is_sleep_ok(&result, &scenario)) sleepless = true;
+        }
+    }
+    else
+    {
+        result_t result;
+
+        if (!run_scenario(&scenario, &result)) return 2;
+        print_result(&result, &scenario);
+        if ((0 < max_latency_ms) && (result.scene.max_ns > max_latency_ms*NS_PER_MS)) failed = true;
+        if (!is_addressing_ok(&result, &scenario)) unnumbered = true;
+        if (!is_sleep_ok(&result, &scenario)) sleepless = true;
+    }
+
+    if (failed)
+    {
+        printf("\nFAIL: scene latency over %.1f ms\n", max_latency_ms);
+    }
+    if (unnumbered)
+    {
+        printf("\nFAIL: slaves left without a number\n");
+    }
+    if (sleepless)
+    {
+        printf("\nFAIL: slaves didn't sleep and wake up\n");
+    }
+    if (failed || unnumbered || sleepless) return 1;
+    return 0;
+}
+
+// #############################################################################
+// ------------ PRIVATE FUNCTIONS
+// #############################################################################
+
+/****************************************************************************
+    Private Function
+        run_scenario
+
+    Parameters
+        const scenario_t * p_scenario: what to run
+        result_t * p_result: filled in with the measurements
+
+    Description
+        Powers up a fresh master and slaves, runs them and measures.
+            Returns false if a node library can't be loaded.
+
+****************************************************************************/
+static bool run_scenario(const scenario_t * p_scenario, result_t * p_result)
+{
+    const lin_bus_ops_t bus_ops = {bus_header, bus_response, bus_tx_done, bus_error};
+    const uint64_t end_ns = p_scenario->warm_up_ns+p_scenario->run_ns;
+    uint64_t next_can_ns = p_scenario->warm_up_ns/2;
+    bool count_sent = false;
+    bool slept = false;
+    uint32_t can_count = 0;
+    uint32_t can_dropped = 0;
+    lin_bus_stats_t bus_at_start;
+
+    memset(p_result, 0, sizeof(*p_result));
+    memset(Nodes, 0, sizeof(Nodes));
+    memset(&Scene_Latency, 0, sizeof(Scene_Latency));
+    memset(&Scene_Spread, 0, sizeof(Scene_Spread));
+    Num_Nodes = 1+p_scenario->num_slaves;
+    Now_NS = 0;
+    Measuring = false;
+    Scene_Open = false;
+    CAN_Sent = 0;
+    Slaves_Unnumbered = (0 <= p_scenario->addressing_mode);
+    Addressing_End_NS = 0;
+    Bus_Sleeping = false;
+    Wake_Scene = false;
+    Powered_Down = 0;
+    Powered_Down_Lit = 0;
+    Lit = 0;
+    Woken = 0;
+
+    LIN_Bus_Init(&bus_ops, Num_Nodes, LIN_BIT_NS);
+
+    for (int index = 0; index < Num_Nodes; index++)
+    {
+        if (!load_node(&Nodes[index], index))
+        {
+            unload_nodes();
+            return false;
+        }
+    }
+
+    bus_at_start = LIN_Bus_Get_Stats(0);
+
+    while (1)
+    {
+        uint64_t next_ns = LIN_Bus_Next_Event();
+        int next_tick = -1;
+
+        for (int index = 0; index < Num_Nodes; index++)
+        {
+            if (Nodes[index].next_tick_ns < next_ns)
+            {
+                next_ns = Nodes[index].next_tick_ns;
+                next_tick = index;
+            }
+        }
+        if (next_can_ns < next_ns)
+        {
+            next_ns = next_can_ns;
+            next_tick = -2;
+        }
+        if (end_ns <= next_ns) break;
+        Now_NS = next_ns;
+
+        if ((-2 == next_tick) && !count_sent)
+        {
+            // Tell the master how many slaves there are (or to number
+            //  them), then start the position messages
+            count_sent = true;
+            if (Slaves_Unnumbered)
+            {
+                if (!send_addressing(p_scenario->addressing_mode))
+                {
+                    fprintf(stderr, "sim: the master dropped the addressing message, warm up too short?\n");
+                }
+            }
+            else if (!send_slave_count(p_scenario->num_slaves))
+            {
+                fprintf(stderr, "sim: the master dropped the slave count, warm up too short?\n");
+            }
+            next_can_ns = p_scenario->warm_up_ns;
+        }
+        else if (-2 == next_tick)
+        {
+            // Measuring starts with the first message
+            if (!Measuring)
+            {
+                Measuring = true;
+                bus_at_start = LIN_Bus_Get_Stats(Now_NS);
+            }
+            if (p_scenario->sleep_test && (SLEEP_AT_MESSAGE == can_count) && !slept)
+            {
+                // This one puts the bus to sleep, the next one wakes it up
+                //  with the last position again
+                slept = true;
+                if (!send_sleep()) can_dropped++;
+                can_count--;
+                next_can_ns += SLEEP_MS*NS_PER_MS;
+            }
+            else
+            {
+                if (!send_position(can_count++)) can_dropped++;
+                next_can_ns += p_scenario->interval_ns;
+            }
+        }
+        else if (0 <= next_tick)
+        {
+            Nodes[next_tick].next_tick_ns += SIM_TICK_NS;
+            Nodes[next_tick].tick(Now_NS);
+        }
+        else
+        {
+            LIN_Bus_Run(Now_NS);
+        }
+    }
+    Now_NS = end_ns;
+    close_scene();
+
+    // Collect
+    lin_bus_stats_t bus_now = LIN_Bus_Get_Stats(end_ns);
+    p_result->num_slaves = p_scenario->num_slaves;
+    p_result->seconds = (double) p_scenario->run_ns/NS_PER_S;
+    p_result->bus.busy_ns = bus_now.busy_ns-bus_at_start.busy_ns;
+    p_result->bus.headers = bus_now.headers-bus_at_start.headers;
+    p_result->bus.frames = bus_now.frames-bus_at_start.frames;
+    p_result->bus.data_bytes = bus_now.data_bytes-bus_at_start.data_bytes;
+    p_result->bus.unanswered = bus_now.unanswered-bus_at_start.unanswered;
+    p_result->bus.collisions = bus_now.collisions-bus_at_start.collisions;
+    p_result->bus.aborted = bus_now.aborted-bus_at_start.aborted;
+    p_result->bus.node_errors = bus_now.node_errors-bus_at_start.node_errors;
+    for (int id = 0; id < LIN_BUS_NUM_IDS; id++)
+    {
+        p_result->bus.ids[id].headers = bus_now.ids[id].headers-bus_at_start.ids[id].headers;
+        p_result->bus.ids[id].frames = bus_now.ids[id].frames-bus_at_start.ids[id].frames;
+        p_result->bus.ids[id].collisions = bus_now.ids[id].collisions-bus_at_start.ids[id].collisions;
+    }
+    p_result->can_received = can_count-can_dropped;
+    p_result->can_dropped = can_dropped;
+    p_result->can_sent = CAN_Sent;
+    p_result->scene = Scene_Latency;
+    p_result->spread = Scene_Spread;
+    for (int index = 1; index < Num_Nodes; index++)
+    {
+        p_result->slaves[index] = Nodes[index].latency;
+    }
+    p_result->addressed = (0 != Addressing_End_NS);
+    p_result->addressing_ns = Addressing_End_NS-Addressing_Start_NS;
+    memcpy(p_result->addressing, Addressing_Report, sizeof(Addressing_Report));
+    p_result->powered_down = Powered_Down;
+    p_result->powered_down_lit = Powered_Down_Lit;
+    p_result->lit = Lit;
+    p_result->woken = Woken;
+    p_result->wake_first_ns = Wake_First_NS;
+    p_result->wake_last_ns = Wake_Last_NS;
+
+    unload_nodes();
+    return true;
+}
+
+/****************************************************************************
+    Private Function
+        load_node
+
+    Parameters
+        node_t * p_node: node to fill in
+        int index: 0 for the master, otherwise the slave number
+
+    Description
+        Loads a private copy of the node library and powers the node up
+
+****************************************************************************/
+static bool load_node(node_t * p_node, int index)
+{
+    char source[PATH_MAX+32];
+    char copy[] = "/tmp/lin_sim_node_XXXXXX";
+    const sim_host_t host = {p_node, on_lin_command, on_light_set, on_servo_moved, on_can_sent, on_powered_down};
+    sim_node_start_t start;
+    FILE * p_in;
+    FILE * p_out;
+    char buffer[65536];
+    size_t count;
+    int fd;
+
+    snprintf(source, sizeof(source), "%s/%s", Library_Dir,
+        (MASTER_INDEX == index) ? "libsim_master.so" : "libsim_slave.so");
+
+    // dlopen() shares one copy per file, so every node gets its own file
+    fd = mkstemp(copy);
+    if (0 > fd)
+    {
+        perror("mkstemp");
+        return false;
+    }
+    p_out = fdopen(fd, "wb");
+    p_in = fopen(source, "rb");
+    if ((NULL == p_in) || (NULL == p_out))
+    {
+        fprintf(stderr, "sim: can't copy %s\n", source);
+        if (p_in) fclose(p_in);
+        if (p_out) fclose(p_out);
+        unlink(copy);
+        return false;
+    }
+    while (0 < (count = fread(buffer, 1, sizeof(buffer), p_in)))
+    {
+        fwrite(buffer, 1, count, p_out);
+    }
+    fclose(p_in);
+    fclose(p_out);
+
+    p_node->p_handle = dlopen(copy, RTLD_NOW|RTLD_LOCAL);
+    unlink(copy);
+    if (NULL == p_node->p_handle)
+    {
+        fprintf(stderr, "sim: %s\n", dlerror());
+        return false;
+    }
+
+    start = (sim_node_start_t) dlsym(p_node->p_handle, SIM_NODE_START);
+    p_node->tick = (sim_node_tick_t) dlsym(p_node->p_handle, SIM_NODE_TICK);
+    p_node->lin_header = (sim_node_lin_header_t) dlsym(p_node->p_handle, SIM_NODE_LIN_HEADER);
+    p_node->lin_response = (sim_node_lin_response_t) dlsym(p_node->p_handle, SIM_NODE_LIN_RESPONSE);
+    p_node->lin_tx_done = (sim_node_lin_tx_done_t) dlsym(p_node->p_handle, SIM_NODE_LIN_TX_DONE);
+    p_node->lin_error = (sim_node_lin_error_t) dlsym(p_node->p_handle, SIM_NODE_LIN_ERROR);
+    p_node->can_receive = (sim_node_can_receive_t) dlsym(p_node->p_handle, SIM_NODE_CAN_RECEIVE);
+    if (!start || !p_node->tick || !p_node->lin_header || !p_node->lin_response
+        || !p_node->lin_tx_done || !p_node->lin_error || !p_node->can_receive)
+    {
+        fprintf(stderr, "sim: %s is missing an entry point\n", source);
+        return false;
+    }
+
+    p_node->index = index;
+    p_node->latency.min_ns = UINT64_MAX;
+
+    // Power up, the first tick is one period later
+    Now_NS = (uint64_t) index*START_SPREAD_NS % SIM_TICK_NS;
+    p_node->next_tick_ns = Now_NS+SIM_TICK_NS;
+    if (MASTER_INDEX == index)
+    {
+        start(&host, Now_NS, MASTER_NODE_ID);
+    }
+    else
+    {
+        // A blank EEPROM has no slave number
+        start(&host, Now_NS, Slaves_Unnumbered ? 0xFF : GET_SLAVE_BASE_ID(index));
+    }
+
+    return true;
+}
+
+/****************************************************************************
+    Private Function
+        unload_nodes
+
+    Parameters
+        None
+
+    Description
+        Closes every node library
+
+****************************************************************************/
+static void unload_nodes(void)
+{
+    for (int index = 0; index < MAX_NODES; index++)
+    {
+        if (Nodes[index].p_handle) dlclose(Nodes[index].p_handle);
+        Nodes[index].p_handle = NULL;
+    }
+}
+
+/****************************************************************************
+    Private Function
+        send_position
+
+    Parameters
+        uint32_t count: messages sent so far
+
+    Description
+        Sends the next position message to the master and starts timing
+            the slaves. Returns false if the master dropped it.
+
+****************************************************************************/
+static bool send_position(uint32_t count)
+{
+    uint8_t msg[SIM_CAN_MSG_LEN] = {0};
+
+    msg[CAN_MODEM_TYPE_IDX] = CAN_MODEM_POS_TYPE;
+    memcpy(&msg[CAN_MODEM_POS_VECT_IDX], &Positions[count % NUM_POSITIONS], sizeof(rect_vect_t));
+
+    close_scene();
+    Last_CAN_NS = Now_NS;
+    Scene_Open = true;
+    Scene_Latest_NS = 0;
+    Wake_Scene = Bus_Sleeping;
+    Bus_Sleeping = false;
+    for (int index = 1; index < Num_Nodes; index++)
+    {
+        Nodes[index].pending = true;
+    }
+
+    return Nodes[MASTER_INDEX].can_receive(Now_NS, msg);
+}
+
+/****************************************************************************
+    Private Function
+        send_slave_count
+
+    Parameters
+        int num_slaves: slaves on the bus
+
+    Description
+        Tells the master how many slaves are on the bus. Returns false if
+            the master dropped the message.
+
+****************************************************************************/
+static bool send_slave_count(int num_slaves)
+{
+    uint8_t msg[SIM_CAN_MSG_LEN] = {0};
+
+    msg[CAN_MODEM_TYPE_IDX] = CAN_MODEM_SLAVE_COUNT_TYPE;
+    msg[CAN_MODEM_SLAVE_COUNT_IDX] = (uint8_t) num_slaves;
+
+    return Nodes[MASTER_INDEX].can_receive(Now_NS, msg);
+}
+
+/****************************************************************************
+    Private Function
+        send_addressing
+
+    Parameters
+        int mode: LIN_DIAG_ADDR_MODE_NEW or LIN_DIAG_ADDR_MODE_ALL
+
+    Description
+        Tells the master to number the slaves. Returns false if the master
+            dropped the message.
+
+****************************************************************************/
+static bool send_addressing(int mode)
+{
+    uint8_t msg[SIM_CAN_MSG_LEN] = {0};
+
+    msg[CAN_MODEM_TYPE_IDX] = CAN_MODEM_ADDRESSING_TYPE;
+    msg[CAN_MODEM_ADDRESSING_MODE_IDX] = (uint8_t) mode;
+    Addressing_Start_NS = Now_NS;
+
+    return Nodes[MASTER_INDEX].can_receive(Now_NS, msg);
+}
+
+/****************************************************************************
+    Private Function
+        send_sleep
+
+    Parameters
+        None
+
+    Description
+        Tells the master to put the bus to sleep, the next position message
+            wakes it up. Returns false if the master dropped the message.
+
+****************************************************************************/
+static bool send_sleep(void)
+{
+    uint8_t msg[SIM_CAN_MSG_LEN] = {0};
+
+    msg[CAN_MODEM_TYPE_IDX] = CAN_MODEM_SLEEP_TYPE;
+
+    close_scene();
+    for (int index = 1; index < Num_Nodes; index++)
+    {
+        Nodes[index].pending = false;
+        Nodes[index].lit = (LIGHT_OFF != Nodes[index].intensity);
+        if (Nodes[index].lit) Lit++;
+    }
+    Bus_Sleeping = true;
+
+    return Nodes[MASTER_INDEX].can_receive(Now_NS, msg);
+}
+
+/****************************************************************************
+    Private Function
+        is_addressing_ok
+
+    Parameters
+        const result_t * p_result: measurements
+        const scenario_t * p_scenario: what was run
+
+    Description
+        Returns true if there was no auto-addressing, or every slave was
+            numbered and the master counts them all (renumbering all of
+            them, the master's count is theirs)
+
+****************************************************************************/
+static bool is_addressing_ok(const result_t * p_result, const scenario_t * p_scenario)
+{
+    if (0 > p_scenario->addressing_mode) return true;
+
+    return (    p_result->addressed
+                &&
+                (p_scenario->num_slaves == p_result->addressing[CAN_ADDRESSING_NUMBERED_IDX])
+                &&
+                (p_scenario->num_slaves <= p_result->addressing[CAN_ADDRESSING_COUNT_IDX])
+                &&
+                (   (LIN_DIAG_ADDR_MODE_ALL != p_scenario->addressing_mode)
+                    ||
+                    (p_scenario->num_slaves == p_result->addressing[CAN_ADDRESSING_COUNT_IDX])
+                )
+           );
+}
+
+/****************************************************************************
+    Private Function
+        is_sleep_ok
+
+    Parameters
+        const result_t * p_result: measurements
+        const scenario_t * p_scenario: what was run
+
+    Description
+        Returns true if the bus wasn't put to sleep, or every slave powered
+            down with its light off and every light that was on came on
+            again once the bus woke up
+
+****************************************************************************/
+static bool is_sleep_ok(const result_t * p_result, const scenario_t * p_scenario)
+{
+    if (!p_scenario->sleep_test) return true;
+
+    return (    ((uint32_t) p_scenario->num_slaves == p_result->powered_down)
+                &&
+                (0 == p_result->powered_down_lit)
+                &&
+                (p_result->lit == p_result->woken)
+           );
+}
+
+/****************************************************************************
+    Private Function
+        close_scene
+
+    Parameters
+        None
+
+    Description
+        Records the scene latency of the last CAN message, if any slave
+            acted on it
+
+****************************************************************************/
+static void close_scene(void)
+{
+    if (Scene_Open && (0 < Scene_Latest_NS))
+    {
+        add_sample(&Scene_Latency, Scene_Latest_NS-Last_CAN_NS);
+        add_sample(&Scene_Spread, Scene_Latest_NS-Scene_Earliest_NS);
+    }
+    Scene_Open = false;
+}
+
+static void add_sample(latency_t * p_latency, uint64_t sample_ns)
+{
+    p_latency->samples++;
+    p_latency->sum_ns += sample_ns;
+    if ((1 == p_latency->samples) || (p_latency->min_ns > sample_ns)) p_latency->min_ns = sample_ns;
+    if (p_latency->max_ns < sample_ns) p_latency->max_ns = sample_ns;
+}
+
+static double get_avg_ms(const latency_t * p_latency)
+{
+    if (0 == p_latency->samples) return 0;
+    return (double) p_latency->sum_ns/p_latency->samples/NS_PER_MS;
+}
+
+/****************************************************************************
+    Private Function
+        print_result
+
+    Parameters
+        const result_t * p_result: measurements
+        const scenario_t * p_scenario: what was run
+
+    Description
+        Prints the full report of one run
+
+****************************************************************************/
+static void print_result(const result_t * p_result, const scenario_t * p_scenario)
+{
+    const double seconds = p_result->seconds;
+    const lin_bus_id_stats_t * p_event = &p_result->bus.ids[LIN_EVENT_STATUS_ID];
+    lin_bus_id_stats_t polls = {0};
+
+    for (int slave = LOWEST_SLAVE_NUMBER; slave < (LOWEST_SLAVE_NUMBER+p_scenario->num_slaves); slave++)
+    {
+        polls.headers += p_result->bus.ids[GET_SLAVE_BASE_ID(slave)|REQUEST_MASK].headers;
+        polls.frames += p_result->bus.ids[GET_SLAVE_BASE_ID(slave)|REQUEST_MASK].frames;
+    }
+
+    printf("\nBus over %.1f s:\n", seconds);
+    printf("    utilisation     %.1f %%\n", 100.0*p_result->bus.busy_ns/(seconds*NS_PER_S));
+    printf("    headers         %.1f /s\n", p_result->bus.headers/seconds);
+    printf("    frames          %.1f /s, %.1f data bytes/s\n", p_result->bus.frames/seconds, p_result->bus.data_bytes/seconds);
+    printf("    unanswered      %u\n", p_result->bus.unanswered);
+    printf("    collisions      %u\n", p_result->bus.collisions);
+    printf("    event status    %u headers, %u answered, %u collided\n",
+        p_event->headers, p_event->frames, p_event->collisions);
+    printf("    polled status   %u headers, %u answered\n", polls.headers, polls.frames);
+    printf("    aborted         %u\n", p_result->bus.aborted);
+    printf("    node errors     %u\n", p_result->bus.node_errors);
+    printf("CAN: %u position messages taken by the master, %u dropped, %u sent by it\n",
+        p_result->can_received, p_result->can_dropped, p_result->can_sent);
+    printf("Master static RAM with room for %d slave(s): %.0f B of %d B (AVR)\n",
+        p_scenario->num_slaves, GET_MASTER_RAM(p_scenario->num_slaves), AVR_SRAM_BYTES);
+    if (p_result->addressed)
+    {
+        printf("Auto-addressing: %u slave(s) numbered, %u on the bus, result %u, %.1f ms\n",
+            p_result->addressing[CAN_ADDRESSING_NUMBERED_IDX], p_result->addressing[CAN_ADDRESSING_COUNT_IDX],
+            p_result->addressing[CAN_ADDRESSING_RESULT_IDX], (double) p_result->addressing_ns/NS_PER_MS);
+    }
+    else if (0 <= p_scenario->addressing_mode)
+    {
+        printf("Auto-addressing: not finished\n");
+    }
+    if (p_scenario->sleep_test)
+    {
+        printf("Sleep: %u slave(s) powered down, %u with the light on; %u of %u light(s) on again "
+            "after the wake up message, first %.2f ms, last %.2f ms\n",
+            p_result->powered_down, p_result->powered_down_lit, p_result->woken, p_result->lit,
+            (double) p_result->wake_first_ns/NS_PER_MS, (double) p_result->wake_last_ns/NS_PER_MS);
+    }
+
+    printf("\nLatency from CAN message to actuation (ms):\n");
+    printf("    slave  samples      min      avg      max\n");
+    for (int slave = 1; slave <= p_scenario->num_slaves; slave++)
+    {
+        const latency_t * p_latency = &p_result->slaves[slave];
+
+        if (0 == p_latency->samples)
+        {
+            printf("    %5d  %7u        -        -        -\n", slave, 0u);
+            continue;
+        }
+        printf("    %5d  %7u  %7.2f  %7.2f  %7.2f\n", slave, p_latency->samples,
+            (double) p_latency->min_ns/NS_PER_MS, get_avg_ms(p_latency), (double) p_latency->max_ns/NS_PER_MS);
+    }
+    if (0 < p_result->scene.samples)
+    {
+        printf("    scene  %7u  %7.2f  %7.2f  %7.2f\n", p_result->scene.samples,
+            (double) p_result->scene.min_ns/NS_PER_MS, get_avg_ms(&p_result->scene),
+            (double) p_result->scene.max_ns/NS_PER_MS);
+        printf("   spread  %7u  %7.2f  %7.2f  %7.2f\n", p_result->spread.samples,
+            (double) p_result->spread.min_ns/NS_PER_MS, get_avg_ms(&p_result->spread),
+            (double) p_result->spread.max_ns/NS_PER_MS);
+    }
+}
+
+static void print_sweep_line(const result_t * p_result)
+{
+    const double seconds = p_result->seconds;
+
+    printf("%6d  %6.1f  %8.1f  %7.1f  %12.1f  %8.1f  %12.2f  %12.2f  %5.0f\n",
+        p_result->num_slaves,
+        100.0*p_result->bus.busy_ns/(seconds*NS_PER_S),
+        p_result->bus.frames/seconds,
+        p_result->bus.data_bytes/seconds,
+        p_result->bus.unanswered/seconds,
+        p_result->bus.node_errors/seconds,
+        get_avg_ms(&p_result->scene),
+        (double) p_result->scene.max_ns/NS_PER_MS,
+        GET_MASTER_RAM(p_result->num_slaves));
+}
+
+// #############################################################################
+// ------------ NODE CALLBACKS
+// #############################################################################
+
+static void on_lin_command(void * p_context, const sim_lin_cmd_t * p_cmd)
+{
+    LIN_Bus_Command(((node_t *) p_context)->index, Now_NS, p_cmd);
+}
+
+static void on_light_set(void * p_context, uint8_t intensity)
+{
+    node_t * p_node = (node_t *) p_context;
+
+    p_node->intensity = intensity;
+
+    // A light that was on before the sleep comes on again
+    if (Wake_Scene && p_node->lit && !p_node->relit && (LIGHT_OFF != intensity))
+    {
+        p_node->relit = true;
+        if (0 == Woken++) Wake_First_NS = Now_NS-Last_CAN_NS;
+        Wake_Last_NS = Now_NS-Last_CAN_NS;
+    }
+
+    on_actuation(p_node);
+}
+
+static void on_servo_moved(void * p_context, uint16_t position)
+{
+    on_actuation((node_t *) p_context);
+}
+
+static void on_can_sent(void * p_context, uint8_t len, const uint8_t * p_data)
+{
+    CAN_Sent++;
+
+    // The end of auto-addressing
+    if ((CAN_ADDRESSING_REPORT_LEN == len) && (CAN_MODEM_ADDRESSING_TYPE == p_data[CAN_MODEM_TYPE_IDX]))
+    {
+        Addressing_End_NS = Now_NS;
+        memcpy(Addressing_Report, p_data, CAN_ADDRESSING_REPORT_LEN);
+    }
+}
+
+static void on_powered_down(void * p_context)
+{
+    Powered_Down++;
+    if (LIGHT_OFF != ((node_t *) p_context)->intensity) Powered_Down_Lit++;
+}
+
+static void on_actuation(node_t * p_node)
+{
+    if (!Measuring || !p_node->pending) return;
+
+    p_node->pending = false;
+
+    // The scene of the wake up message is timed on its own
+    if (Wake_Scene) return;
+    add_sample(&p_node->latency, Now_NS-Last_CAN_NS);
+    if (0 == Scene_Latest_NS) Scene_Earliest_NS = Now_NS;
+    Scene_Latest_NS = Now_NS;
+}
+
+// #############################################################################
+// ------------ BUS CALLBACKS
+// #############################################################################
+
+static void bus_header(int node, uint64_t now_ns, uint8_t id)
+{
+    Now_NS = now_ns;
+    Nodes[node].lin_header(now_ns, id);
+}
+
+static void bus_response(int node, uint64_t now_ns, const uint8_t * p_data, uint8_t len)
+{
+    Now_NS = now_ns;
+    Nodes[node].lin_response(now_ns, p_data, len);
+}
+
+static void bus_tx_done(int node, uint64_t now_ns)
+{
+    Now_NS = now_ns;
+    Nodes[node].lin_tx_done(now_ns);
+}
+
+static void bus_error(int node, uint64_t now_ns, uint8_t error_status)
+{
+    Now_NS = now_ns;
+    Nodes[node].lin_error(now_ns, error_status);
+}
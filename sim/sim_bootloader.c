@@ -0,0 +1,41 @@
+/*******************************************************************************
+    File:
+        sim_bootloader.c
+
+    Notes:
+        Stands in for lin_bootloader.c in the simulator. The bootloader polls
+        the LIN controller and writes the flash, neither of which the
+        simulator can run, so a slave asked to enter it ends the run.
+
+    External Functions Required:
+        None
+
+    Public Functions:
+        Those of lin_bootloader.h
+
+*******************************************************************************/
+
+// #############################################################################
+// ------------ INCLUDES
+// #############################################################################
+
+#include <stdio.h>
+#include <stdlib.h>
+
+// This module's header file
+#include "lin_bootloader.h"
+
+// #############################################################################
+// ------------ PUBLIC FUNCTIONS
+// #############################################################################
+
+void Enter_LIN_Bootloader(void)
+{
+    fprintf(stderr, "lin_sim: a slave entered its bootloader, which is not simulated\n");
+    abort();
+}
+
+void LIN_Bootloader_Start(void)
+{
+    Enter_LIN_Bootloader();
+}
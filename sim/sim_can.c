@@ -0,0 +1,247 @@
+/*******************************************************************************
+    File:
+        sim_can.c
+
+    Notes:
+        Stands in for CAN.c in the simulator, at the CAN.h level.
+
+        The MCP25625 and its SPI link are not simulated. The core hands a
+        received message to the node (Sim_Node_CAN_Receive()), which loads
+        it here and raises INT0. The real CAN_Service.c then finds RX0IF set
+        and reads it with CAN_Read_Message(). Messages the master sends are
+        passed to the core at once, their TX Buffer then flags TXnIF and
+        raises INT0 so the transmit queue sees them sent. The remaining
+        MCP25625 commands do nothing.
+
+    External Functions Required:
+        Sim_Get_Host()
+
+    Public Functions:
+        Those of CAN.h
+        void Sim_CAN_Load_Message(const uint8_t * p_msg)
+
+*******************************************************************************/
+
+// #############################################################################
+// ------------ INCLUDES
+// #############################################################################
+
+// Standard ANSI  99 C types for exact integer sizes and booleans
+#include <stdint.h>
+#include <stdbool.h>
+#include <string.h>
+
+// Config file
+#include "config.h"
+
+// Framework
+#include "framework.h"
+
+// This module's header file
+#include "CAN.h"
+
+// MCP25625 registers
+#include "MCP25625defs.h"
+
+// Include other files below:
+
+// Simulator HAL
+#include "sim_hal.h"
+
+// Received frames go to the receive FIFO
+#include "can_rx_fifo.h"
+
+#if (SIM_CAN_MSG_LEN != CAN_MODEM_PACKET_LEN)
+#error "sim_node.h SIM_CAN_MSG_LEN must match CAN_MODEM_PACKET_LEN"
+#endif
+
+// #############################################################################
+// ------------ MODULE VARIABLES
+// #############################################################################
+
+// Frame waiting in the (simulated) receive buffer
+static uint8_t RX_Buffer[CAN_FRAME_LEN];
+
+// RX0IF
+static bool RX_Buffer_Full = false;
+
+// TXnIF of the TX Buffers sent and not yet freed
+static uint8_t TX_Flags_Set = 0;
+
+// #############################################################################
+// ------------ PUBLIC FUNCTIONS
+// #############################################################################
+
+/****************************************************************************
+    Public Function
+        Sim_CAN_Load_Message
+
+    Parameters
+        const uint8_t * p_msg: received message
+
+    Description
+        Puts a message in the receive buffer
+
+****************************************************************************/
+void Sim_CAN_Load_Message(const uint8_t * p_msg)
+{
+    RX_Buffer[CAN_FRAME_SIDH_IDX] = CAN_SIDH(CAN_MODEM_RX_SID);
+    RX_Buffer[CAN_FRAME_SIDL_IDX] = CAN_SIDL(CAN_MODEM_RX_SID);
+    RX_Buffer[CAN_FRAME_DLC_IDX] = CAN_MODEM_PACKET_LEN;
+    memcpy(&RX_Buffer[CAN_FRAME_DATA_IDX], p_msg, CAN_MODEM_PACKET_LEN);
+    RX_Buffer_Full = true;
+}
+
+void CAN_Initialize_1(void)
+{
+}
+
+void CAN_Initialize_2(void)
+{
+}
+
+void CAN_Reset(void)
+{
+}
+
+void CAN_Read(uint8_t Register_2_Read, uint8_t** Variable_2_Set)
+{
+}
+
+void CAN_Read_RX_Buffer(bool choice, uint8_t** Variable_2_Set)
+{
+}
+
+void CAN_Write(uint8_t Register_2_Set, uint8_t* Value_2_Set)
+{
+}
+
+void CAN_Write_Registers(uint8_t First_Register, uint8_t Count, uint8_t* Values_2_Set)
+{
+}
+
+void CAN_Load_TX_Buffer(uint8_t choice, uint8_t* Value_2_Set)
+{
+}
+
+void CAN_RTS(uint8_t choice)
+{
+}
+
+void CAN_Read_Status(uint8_t** Variable_2_Set)
+{
+}
+
+void CAN_RX_Status(uint8_t** Variable_2_Set)
+{
+}
+
+bool CAN_Bit_Modify(uint8_t Register_2_Set, uint8_t Bits_2_Change, uint8_t* Value_2_Set)
+{
+    return true;
+}
+
+bool CAN_Abort_TX(uint8_t Buffer)
+{
+    return true;
+}
+
+void CAN_TX_Done(uint8_t TX_Flags)
+{
+    TX_Flags_Set &= ~TX_Flags;
+}
+
+/****************************************************************************
+    Public Function
+        CAN_Send_Message
+
+    Parameters
+        uint8_t Priority: ignored
+        uint8_t Msg_Length: number of bytes
+        uint8_t * Transmit_Data: message bytes
+
+    Description
+        Passes the message to the core, returns the TX Buffer used
+
+****************************************************************************/
+uint8_t CAN_Send_Message(uint8_t Priority, uint8_t Msg_Length, uint8_t* Transmit_Data)
+{
+    const sim_host_t * p_host = Sim_Get_Host();
+    uint8_t buffer = 0;
+
+    while (TX_Flags_Set & CAN_TX_BUFFER_IF(buffer))
+    {
+        if (MCP_N_TXBUFFERS <= ++buffer) return CAN_TX_NO_BUFFER;
+    }
+
+    p_host->can_sent(p_host->p_context, Msg_Length, Transmit_Data);
+
+    // Sent at once
+    TX_Flags_Set |= CAN_TX_BUFFER_IF(buffer);
+    Post_Event(EVT_CAN_INTERRUPT);
+
+    return buffer;
+}
+
+/****************************************************************************
+    Public Function
+        CAN_Read_Message
+
+    Parameters
+        None
+
+    Description
+        Puts the received frame in the receive FIFO
+
+****************************************************************************/
+void CAN_Read_Message(bool choice)
+{
+    if (!choice || !RX_Buffer_Full) return;
+
+    RX_Buffer_Full = false;
+    Put_CAN_RX_Frame(RX_Buffer);
+}
+
+/****************************************************************************
+    Public Function
+        CAN_Read_Int_Flags
+
+    Parameters
+        uint8_t * p_flags: CANINTF and EFLG
+        spi_done_cb_t p_done_cb: called once they are read
+
+    Description
+        RX0IF is set while a message waits, TXnIF once a TX Buffer is
+        sent, the read completes at once
+
+****************************************************************************/
+bool CAN_Read_Int_Flags(uint8_t * p_flags, spi_done_cb_t p_done_cb)
+{
+    p_flags[0] = (RX_Buffer_Full ? MCP_RX0IF : 0) | TX_Flags_Set;
+    p_flags[1] = 0;
+
+    if (NULL != p_done_cb) p_done_cb();
+    return true;
+}
+
+/****************************************************************************
+    Public Function
+        CAN_Read_Registers
+
+    Parameters
+        uint8_t First_Register: ignored
+        uint8_t Count: number of registers
+        uint8_t * p_values: set to 0, an error free bus
+        spi_done_cb_t p_done_cb: called once they are read
+
+    Description
+        The read completes at once
+
+****************************************************************************/
+bool CAN_Read_Registers(uint8_t First_Register, uint8_t Count, uint8_t * p_values, spi_done_cb_t p_done_cb)
+{
+    memset(p_values, 0, Count);
+
+    if (NULL != p_done_cb) p_done_cb();
+    return true;
+}
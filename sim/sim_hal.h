@@ -0,0 +1,23 @@
+/*******************************************************************************
+    File:
+        sim_hal.h
+
+    Notes:
+        Shared between the files of one node library (sim_node_hal.c and
+        sim_can.c). Not used by the simulator core.
+
+*******************************************************************************/
+
+#ifndef SIM_HAL_H
+#define SIM_HAL_H
+
+#include "sim_node.h"
+
+// #############################################################################
+// ------------ PUBLIC FUNCTION PROTOTYPES
+// #############################################################################
+
+const sim_host_t * Sim_Get_Host(void);
+void Sim_CAN_Load_Message(const uint8_t * p_msg);
+
+#endif // SIM_HAL_H
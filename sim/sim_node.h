@@ -0,0 +1,88 @@
+/*******************************************************************************
+    File:
+        sim_node.h
+
+    Notes:
+        Interface between the simulator core and one node library.
+
+        Every node (master or slave) is a private copy of a shared library
+        built from the firmware sources plus sim_node_hal.c, so each copy has
+        its own firmware statics and register file. The core finds the
+        entry points below with dlsym() and the node calls back into the
+        core through the sim_host_t it is started with.
+
+        All times are in nanoseconds of simulated time. The firmware takes
+        no time to run: a call into a node raises the interrupt, runs the
+        main loop until no events are pending and returns.
+
+*******************************************************************************/
+
+#ifndef SIM_NODE_H
+#define SIM_NODE_H
+
+#include <stdint.h>
+#include <stdbool.h>
+
+// #############################################################################
+// ------------ DEFINITIONS
+// #############################################################################
+
+// Longest LIN response
+#define SIM_LIN_MAX_DATA_LEN    8
+
+// CAN message length (matches CAN_MODEM_PACKET_LEN)
+#define SIM_CAN_MSG_LEN         5
+
+// Timer 0 compare period of the firmware's system tick
+#define SIM_TICK_NS             500000ULL
+
+// #############################################################################
+// ------------ TYPE DEFINITIONS
+// #############################################################################
+
+// LIN commands a node can give its controller
+typedef enum
+{
+    sim_lin_abort = 0,          // Software reset of the controller
+    sim_lin_tx_header,          // Master: send a header with id
+    sim_lin_rx_response,        // Receive a response of len bytes
+    sim_lin_tx_response         // Send a response of len bytes from data
+} sim_lin_cmd_type_t;
+
+typedef struct
+{
+    sim_lin_cmd_type_t  type;
+    uint8_t             id;
+    uint8_t             len;
+    uint8_t             data[SIM_LIN_MAX_DATA_LEN];
+} sim_lin_cmd_t;
+
+// Callbacks from a node into the core, p_context identifies the node
+typedef struct
+{
+    void * p_context;
+    void (*lin_command)(void * p_context, const sim_lin_cmd_t * p_cmd);
+    void (*light_set)(void * p_context, uint8_t intensity);
+    void (*servo_moved)(void * p_context, uint16_t position);
+    void (*can_sent)(void * p_context, uint8_t len, const uint8_t * p_data);
+    void (*powered_down)(void * p_context);
+} sim_host_t;
+
+// Entry points of a node library
+typedef void (*sim_node_start_t)(const sim_host_t * p_host, uint64_t now_ns, uint8_t node_id);
+typedef void (*sim_node_tick_t)(uint64_t now_ns);
+typedef void (*sim_node_lin_header_t)(uint64_t now_ns, uint8_t id);
+typedef void (*sim_node_lin_response_t)(uint64_t now_ns, const uint8_t * p_data, uint8_t len);
+typedef void (*sim_node_lin_tx_done_t)(uint64_t now_ns);
+typedef void (*sim_node_lin_error_t)(uint64_t now_ns, uint8_t error_status);
+typedef bool (*sim_node_can_receive_t)(uint64_t now_ns, const uint8_t * p_msg);
+
+#define SIM_NODE_START          "Sim_Node_Start"
+#define SIM_NODE_TICK           "Sim_Node_Tick"
+#define SIM_NODE_LIN_HEADER     "Sim_Node_LIN_Header"
+#define SIM_NODE_LIN_RESPONSE   "Sim_Node_LIN_Response"
+#define SIM_NODE_LIN_TX_DONE    "Sim_Node_LIN_Tx_Done"
+#define SIM_NODE_LIN_ERROR      "Sim_Node_LIN_Error"
+#define SIM_NODE_CAN_RECEIVE    "Sim_Node_CAN_Receive"
+
+#endif // SIM_NODE_H
@@ -0,0 +1,612 @@
+/*******************************************************************************
+    File:
+        sim_node_hal.c
+
+    Notes:
+        Register-level HAL of one simulated node.
+
+        Defines the node's register file (see include/avr/io.h) and the
+        entry points the simulator core calls (see sim_node.h). Each entry
+        point brings the timer 0 count up to the simulated time, raises the
+        interrupt the peripheral would raise, runs the main loop until no
+        events are pending, then reports the LIN command the firmware left
+        in LINCR to the core.
+
+        LIN flags are write-one-to-clear on the chip, so the HAL sets LINSIR
+        to the single flag of the interrupt it raises and clears it after the
+        ISR. The LIN command bits are cleared once the core has the command,
+        so writing the same command again is seen as a new one.
+
+        Set_Light_Intensity() and Move_Analog_Servo_To_Position() are
+        wrapped at link time (-Wl,--wrap) to timestamp them for the core.
+
+        The LIN RXD pin reads recessive while the main loop runs. Once no
+        event is pending the loop reaches its idle point, where a slave
+        whose bus went to sleep powers down; sleep_cpu() reports it to the
+        core and drives RXD dominant, so the slave wakes up at once.
+
+    External Functions Required:
+        Initialize_Framework()
+        Run_Pending_Events()
+        Run_Idle_Service()
+
+    Public Functions:
+        void Sim_Node_Start(const sim_host_t * p_host, uint64_t now_ns, uint8_t node_id)
+        void Sim_Node_Tick(uint64_t now_ns)
+        void Sim_Node_LIN_Header(uint64_t now_ns, uint8_t id)
+        void Sim_Node_LIN_Response(uint64_t now_ns, const uint8_t * p_data, uint8_t len)
+        void Sim_Node_LIN_Tx_Done(uint64_t now_ns)
+        void Sim_Node_LIN_Error(uint64_t now_ns, uint8_t error_status)
+        bool Sim_Node_CAN_Receive(uint64_t now_ns, const uint8_t * p_msg)
+        const sim_host_t * Sim_Get_Host(void)
+        void Sim_Sleep_CPU(void)
+
+*******************************************************************************/
+
+// #############################################################################
+// ------------ INCLUDES
+// #############################################################################
+
+// Standard ANSI  99 C types for exact integer sizes and booleans
+#include <stdint.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <string.h>
+
+// Define the register file in this file
+#define SIM_REG8(name)      volatile uint8_t name;
+#define SIM_REG16(name)     volatile uint16_t name;
+
+// Config file
+#include "config.h"
+
+// Framework
+#include "framework.h"
+
+// This module's header file
+#include "sim_hal.h"
+
+// Include other files below:
+
+// Interrupt vectors
+#include <avr/interrupt.h>
+
+// LIN command and flag definitions
+#include "lin_drv.h"
+
+// Wrapped firmware calls
+#include "light_drv.h"
+#include "analog_servo_drv.h"
+
+// #############################################################################
+// ------------ MODULE DEFINITIONS
+// #############################################################################
+
+// Entry points are the only symbols a node library exports
+#define SIM_EXPORT          __attribute__((visibility("default")))
+
+// Timer 0 runs at SYSCLK/32, one count every 4us
+#define NS_PER_T0_COUNT     (4000ULL)
+
+// SREG global interrupt enable
+#define SREG_I_BIT          (0x80)
+
+// Size of the LIN data buffer, LINSEL index bits
+#define LIN_BUFFER_LEN      (8)
+#define LIN_INDEX_MASK      (0x07)
+
+// Guards against a service that keeps posting events to itself
+#define MAX_MAIN_LOOP_PASSES    (1000)
+#define MAX_EEPROM_WRITES       (E2END+1)
+
+// #############################################################################
+// ------------ MODULE VARIABLES
+// #############################################################################
+
+// Callbacks into the core
+static sim_host_t Host;
+
+// Simulated time the node was powered up at
+static uint64_t Start_Time_NS;
+
+// LIN data buffer behind LINDAT
+static volatile uint8_t LIN_Buffer[LIN_BUFFER_LEN];
+
+// EEPROM behind EEDR
+static volatile uint8_t EEPROM_Data[E2END+1];
+
+// #############################################################################
+// ------------ PRIVATE FUNCTION PROTOTYPES
+// #############################################################################
+
+static void enter_node(uint64_t now_ns);
+static void leave_node(void);
+static void run_main_loop(void);
+static void report_lin_command(void);
+static void raise_lin_tc(uint8_t flag, uint8_t enable_bit);
+static bool interrupts_enabled(void);
+static uint8_t get_protected_id(uint8_t id);
+
+// Linker wrapped firmware functions
+void __real_Set_Light_Intensity(uint8_t requested_intensity);
+void __real_Move_Analog_Servo_To_Position(position_data_t requested_position);
+void __wrap_Set_Light_Intensity(uint8_t requested_intensity);
+void __wrap_Move_Analog_Servo_To_Position(position_data_t requested_position);
+
+// #############################################################################
+// ------------ PUBLIC FUNCTIONS
+// #############################################################################
+
+/****************************************************************************
+    Public Function
+        Sim_Node_Start
+
+    Parameters
+        const sim_host_t * p_host: callbacks into the core
+        uint64_t now_ns: power up time
+        uint8_t node_id: LIN base ID stored in EEPROM (ignored by the master)
+
+    Description
+        Powers up the node: runs the firmware initializers, enables
+            interrupts and runs the main loop once, like main() does
+
+****************************************************************************/
+SIM_EXPORT void Sim_Node_Start(const sim_host_t * p_host, uint64_t now_ns, uint8_t node_id)
+{
+    Host = *p_host;
+    Start_Time_NS = now_ns;
+
+    // Blank EEPROM with the node ID where slave_service.c keeps it
+    memset((uint8_t *) EEPROM_Data, 0xFF, sizeof(EEPROM_Data));
+    EEPROM_Data[EEPROM_NODE_ID_ADDR] = node_id;
+
+    enter_node(now_ns);
+    Initialize_Framework();
+    sei();
+    leave_node();
+}
+
+/****************************************************************************
+    Public Function
+        Sim_Node_Tick
+
+    Parameters
+        uint64_t now_ns: time of the timer 0 compare match
+
+    Description
+        Raises the system tick (timer 0 compare A)
+
+****************************************************************************/
+SIM_EXPORT void Sim_Node_Tick(uint64_t now_ns)
+{
+    enter_node(now_ns);
+    if (interrupts_enabled() && (TIMSK0 & (1<<OCIE0A)))
+    {
+        TIMER0_COMPA_vect();
+    }
+    leave_node();
+}
+
+/****************************************************************************
+    Public Function
+        Sim_Node_LIN_Header
+
+    Parameters
+        uint64_t now_ns: end of the header
+        uint8_t id: 6-bit frame ID
+
+    Description
+        A header was received (every node sees every header, the master
+            included)
+
+****************************************************************************/
+SIM_EXPORT void Sim_Node_LIN_Header(uint64_t now_ns, uint8_t id)
+{
+    enter_node(now_ns);
+    if (LINCR & (1<<LENA))
+    {
+        LINIDR = get_protected_id(id);
+        raise_lin_tc(LIN_IDOK, LENIDOK);
+    }
+    leave_node();
+}
+
+/****************************************************************************
+    Public Function
+        Sim_Node_LIN_Response
+
+    Parameters
+        uint64_t now_ns: end of the response
+        const uint8_t * p_data: response data
+        uint8_t len: number of bytes
+
+    Description
+        The response this node was receiving arrived with a good checksum
+
+****************************************************************************/
+SIM_EXPORT void Sim_Node_LIN_Response(uint64_t now_ns, const uint8_t * p_data, uint8_t len)
+{
+    enter_node(now_ns);
+    for (uint8_t index = 0; (index < len) && (index < LIN_BUFFER_LEN); index++)
+    {
+        LIN_Buffer[index] = p_data[index];
+    }
+    LINSEL = 0;
+    raise_lin_tc(LIN_RXOK, LENRXOK);
+    leave_node();
+}
+
+/****************************************************************************
+    Public Function
+        Sim_Node_LIN_Tx_Done
+
+    Parameters
+        uint64_t now_ns: end of the response
+
+    Description
+        The response this node was sending went out without a bit error
+
+****************************************************************************/
+SIM_EXPORT void Sim_Node_LIN_Tx_Done(uint64_t now_ns)
+{
+    enter_node(now_ns);
+    raise_lin_tc(LIN_TXOK, LENTXOK);
+    leave_node();
+}
+
+/****************************************************************************
+    Public Function
+        Sim_Node_LIN_Error
+
+    Parameters
+        uint64_t now_ns: time the controller flagged the error
+        uint8_t error_status: LINERR bits
+
+    Description
+        The frame this node took part in failed
+
+****************************************************************************/
+SIM_EXPORT void Sim_Node_LIN_Error(uint64_t now_ns, uint8_t error_status)
+{
+    enter_node(now_ns);
+    if (interrupts_enabled() && (LINENIR & (1<<LENERR)))
+    {
+        LINERR = error_status;
+        LINSIR = LIN_ERROR;
+        LIN_ERR_vect();
+        LINSIR = 0;
+        LINERR = 0;
+    }
+    leave_node();
+}
+
+/****************************************************************************
+    Public Function
+        Sim_Node_CAN_Receive
+
+    Parameters
+        uint64_t now_ns: time the CAN controller raised its interrupt
+        const uint8_t * p_msg: SIM_CAN_MSG_LEN message bytes
+
+    Description
+        The CAN controller received a message and pulled INT0 low. Returns
+            false if the node has INT0 masked (the message is dropped).
+
+****************************************************************************/
+SIM_EXPORT bool Sim_Node_CAN_Receive(uint64_t now_ns, const uint8_t * p_msg)
+{
+    bool taken = false;
+
+    enter_node(now_ns);
+    if (interrupts_enabled() && (EIMSK & (1<<INT0)))
+    {
+        Sim_CAN_Load_Message(p_msg);
+        INT0_vect();
+        taken = true;
+    }
+    leave_node();
+
+    return taken;
+}
+
+/****************************************************************************
+    Public Function
+        Sim_Get_Host
+
+    Parameters
+        None
+
+    Description
+        Returns the callbacks into the core
+
+****************************************************************************/
+const sim_host_t * Sim_Get_Host(void)
+{
+    return &Host;
+}
+
+/****************************************************************************
+    Public Function
+        Sim_Sleep_CPU
+
+    Parameters
+        None
+
+    Description
+        sleep_cpu() of the firmware: tells the core the node powered down,
+            then drives RXD dominant as the wake up pulse would, until the
+            main loop is left
+
+****************************************************************************/
+void Sim_Sleep_CPU(void)
+{
+    Host.powered_down(Host.p_context);
+    LIN_PORT_IN &= (uint8_t) ~(1<<LIN_INPUT_PIN);
+}
+
+/****************************************************************************
+    Public Function
+        Sim_LIN_Data_Register
+
+    Parameters
+        None
+
+    Description
+        Backs LINDAT: returns the buffer byte at the LINSEL index and
+            auto-increments the index unless LAINC is set
+
+****************************************************************************/
+volatile uint8_t * Sim_LIN_Data_Register(void)
+{
+    uint8_t index = LINSEL & LIN_INDEX_MASK;
+
+    if (0 == (LINSEL & (1<<LAINC)))
+    {
+        LINSEL = (LINSEL & (uint8_t) ~LIN_INDEX_MASK) | ((index+1) & LIN_INDEX_MASK);
+    }
+
+    return &LIN_Buffer[index];
+}
+
+/****************************************************************************
+    Public Function
+        Sim_EEPROM_Data_Register
+
+    Parameters
+        None
+
+    Description
+        Backs EEDR: returns the EEPROM byte at EEAR, so reads and writes
+            take effect at once
+
+****************************************************************************/
+volatile uint8_t * Sim_EEPROM_Data_Register(void)
+{
+    return &EEPROM_Data[EEAR & E2END];
+}
+
+// #############################################################################
+// ------------ PRIVATE FUNCTIONS
+// #############################################################################
+
+/****************************************************************************
+    Private Function
+        enter_node
+
+    Parameters
+        uint64_t now_ns: current simulated time
+
+    Description
+        Brings the free running timer 0 count up to now
+
+****************************************************************************/
+static void enter_node(uint64_t now_ns)
+{
+    TCNT0 = (uint8_t) ((now_ns-Start_Time_NS)/NS_PER_T0_COUNT);
+}
+
+/****************************************************************************
+    Private Function
+        leave_node
+
+    Parameters
+        None
+
+    Description
+        Runs the main loop until idle and hands the LIN command to the core
+
+****************************************************************************/
+static void leave_node(void)
+{
+    run_main_loop();
+    report_lin_command();
+}
+
+/****************************************************************************
+    Private Function
+        run_main_loop
+
+    Parameters
+        None
+
+    Description
+        Runs pending events, plus the EEPROM ready and ADC complete
+            interrupts, which the HAL finishes instantly
+
+****************************************************************************/
+static void run_main_loop(void)
+{
+    uint16_t passes = 0;
+    uint16_t eeprom_writes = 0;
+    bool adc_done = false;
+    bool idle_done = false;
+
+    // RXD reads recessive, the bus isn't waking us up
+    LIN_PORT_IN |= (1<<LIN_INPUT_PIN);
+
+    while (MAX_MAIN_LOOP_PASSES > passes++)
+    {
+        if (Run_Pending_Events()) continue;
+
+        // EEPROM ready fires for as long as it is enabled
+        if (interrupts_enabled() && (EECR & (1<<EERIE)) && (MAX_EEPROM_WRITES > eeprom_writes++))
+        {
+            EECR &= (uint8_t) ~(1<<EEPE);
+            EE_RDY_vect();
+            continue;
+        }
+
+        // One conversion per call, reading mid scale
+        if (!adc_done && (ADCSRA & (1<<ADSC)))
+        {
+            adc_done = true;
+            ADC = 0x200;
+            ADCSRA &= (uint8_t) ~(1<<ADSC);
+            if (interrupts_enabled() && (ADCSRA & (1<<ADIE)))
+            {
+                ADC_vect();
+            }
+            continue;
+        }
+
+        // Nothing left to do, the main loop reaches its idle point
+        if (!idle_done)
+        {
+            idle_done = true;
+            Run_Idle_Service();
+            continue;
+        }
+
+        return;
+    }
+
+    fprintf(stderr, "sim: node main loop did not settle\n");
+}
+
+/****************************************************************************
+    Private Function
+        report_lin_command
+
+    Parameters
+        None
+
+    Description
+        Passes a command written to LINCR to the core, then clears the
+            command bits
+
+****************************************************************************/
+static void report_lin_command(void)
+{
+    sim_lin_cmd_t cmd;
+
+    memset(&cmd, 0, sizeof(cmd));
+
+    if (LINCR & (1<<LSWRES))
+    {
+        LINCR &= (uint8_t) ~(1<<LSWRES);
+        cmd.type = sim_lin_abort;
+        Host.lin_command(Host.p_context, &cmd);
+        return;
+    }
+
+    switch (LINCR & LIN_CMD_MASK)
+    {
+        case LIN_TX_HEADER:
+            cmd.type = sim_lin_tx_header;
+            cmd.id = LINIDR & LIN_2X_ID_MASK;
+            break;
+
+        case LIN_RX_RESPONSE:
+            cmd.type = sim_lin_rx_response;
+            cmd.len = LINDLR & (0x0F<<LRXDL0);
+            break;
+
+        case LIN_TX_RESPONSE:
+            cmd.type = sim_lin_tx_response;
+            cmd.len = LINDLR>>LTXDL0;
+            for (uint8_t index = 0; (index < cmd.len) && (index < LIN_BUFFER_LEN); index++)
+            {
+                cmd.data[index] = LIN_Buffer[index];
+            }
+            break;
+
+        default:
+            return;
+    }
+
+    LINCR &= (uint8_t) ~LIN_CMD_MASK;
+    Host.lin_command(Host.p_context, &cmd);
+}
+
+/****************************************************************************
+    Private Function
+        raise_lin_tc
+
+    Parameters
+        uint8_t flag: LINSIR flag (LIN_IDOK, LIN_RXOK or LIN_TXOK)
+        uint8_t enable_bit: matching LINENIR bit
+
+    Description
+        Raises the LIN transfer complete interrupt for one flag
+
+****************************************************************************/
+static void raise_lin_tc(uint8_t flag, uint8_t enable_bit)
+{
+    if (interrupts_enabled() && (LINENIR & (1<<enable_bit)))
+    {
+        LINSIR = flag;
+        LIN_TC_vect();
+        LINSIR = 0;
+    }
+}
+
+/****************************************************************************
+    Private Function
+        interrupts_enabled
+
+    Parameters
+        None
+
+    Description
+        Returns true if the global interrupt enable is set
+
+****************************************************************************/
+static bool interrupts_enabled(void)
+{
+    return (0 != (SREG & SREG_I_BIT));
+}
+
+/****************************************************************************
+    Private Function
+        get_protected_id
+
+    Parameters
+        uint8_t id: 6-bit frame ID
+
+    Description
+        Adds the LIN parity bits, as LINIDR holds them after a header
+
+****************************************************************************/
+static uint8_t get_protected_id(uint8_t id)
+{
+    uint8_t p0 = ((id>>0) ^ (id>>1) ^ (id>>2) ^ (id>>4)) & 0x01;
+    uint8_t p1 = (uint8_t) ~((id>>1) ^ (id>>3) ^ (id>>4) ^ (id>>5)) & 0x01;
+
+    return (id & LIN_2X_ID_MASK) | (uint8_t) (p0<<LP0) | (uint8_t) (p1<<LP1);
+}
+
+// #############################################################################
+// ------------ WRAPPED FIRMWARE FUNCTIONS
+// #############################################################################
+
+void __wrap_Set_Light_Intensity(uint8_t requested_intensity)
+{
+    Host.light_set(Host.p_context, requested_intensity);
+    __real_Set_Light_Intensity(requested_intensity);
+}
+
+void __wrap_Move_Analog_Servo_To_Position(position_data_t requested_position)
+{
+    Host.servo_moved(Host.p_context, requested_position);
+    __real_Move_Analog_Servo_To_Position(requested_position);
+}
@@ -0,0 +1,321 @@
+/*******************************************************************************
+    File:
+        slave_health.c
+
+    Notes:
+        This file contains the master's health table for the slave nodes.
+
+        Each slave is in one of three states, driven by whether it answers
+        its status requests (a missing or corrupted response is a miss):
+            online:     answering.
+            degraded:   missed SLAVE_DEGRADED_MISSES requests in a row, or
+                        was just rediscovered. Goes back online after
+                        SLAVE_RECOVERED_RESPONSES good responses in a row.
+            offline:    missed SLAVE_OFFLINE_MISSES requests in a row. The
+                        slave is then only polled once every
+                        SLAVE_REDISCOVERY_ROUNDS schedule rounds, so its
+                        slots go to the live slaves. One good response
+                        brings it back as degraded.
+
+        EVT_MASTER_HEALTH_CHANGE is posted whenever a slave changes state.
+
+    External Functions Required:
+        Post_Event()
+
+    Public Functions:
+        void Init_Slave_Health(void)
+        void Slave_Health_Report_Response(uint8_t slave_number, bool responded)
+        bool Slave_Health_Poll_This_Round(uint8_t slave_number)
+        slave_health_t Get_Slave_Health(uint8_t slave_number)
+        uint32_t Get_Slave_Health_Bitmap(void)
+
+*******************************************************************************/
+
+// #############################################################################
+// ------------ INCLUDES
+// #############################################################################
+
+// Standard ANSI  99 C types for exact integer sizes and booleans
+#include <stdint.h>
+#include <stdbool.h>
+
+// Config file
+#include "config.h"
+
+// Framework
+#include "framework.h"
+
+// This module's header file
+#include "slave_health.h"
+
+// Include other files below:
+
+// Atomic Read/Write operations
+#include <util/atomic.h>
+
+// #############################################################################
+// ------------ MODULE DEFINITIONS
+// #############################################################################
+
+// State machine thresholds
+#define SLAVE_DEGRADED_MISSES       (1)     // Misses in a row to degrade
+#define SLAVE_OFFLINE_MISSES        (4)     // Misses in a row to go offline
+#define SLAVE_RECOVERED_RESPONSES   (8)     // Responses in a row to recover
+#define SLAVE_REDISCOVERY_ROUNDS    (20)    // Rounds between offline polls
+
+// Index of a slave in the health table
+#define GET_HEALTH_INDEX(slave_number)  ((slave_number)-LOWEST_SLAVE_NUMBER)
+
+// A slave's health entry, one byte: its state, whether its last status
+//  request was missed and its counter
+#define HEALTH_STATE_SHIFT          (6)
+#define HEALTH_LAST_MISSED          (0x20)
+#define HEALTH_COUNT_MASK           (0x1F)
+#define GET_HEALTH_STATE(entry)     ((slave_health_t) ((entry)>>HEALTH_STATE_SHIFT))
+#define GET_HEALTH_COUNT(entry)     ((entry) & HEALTH_COUNT_MASK)
+#define MAKE_HEALTH_ENTRY(state, last_missed, count) \
+    (((state)<<HEALTH_STATE_SHIFT) | ((last_missed) ? HEALTH_LAST_MISSED : 0) | (count))
+
+// #############################################################################
+// ------------ MODULE VARIABLES
+// #############################################################################
+
+// Health of each slave, see MAKE_HEALTH_ENTRY()
+// The counter's meaning depends on the state:
+//      online:     status requests missed in a row
+//      degraded:   misses in a row if the last request was missed,
+//                  otherwise responses in a row
+//      offline:    rounds left until the slave is polled again
+// The last missed flag is only used while the slave is degraded.
+static uint8_t Slave_Health[NUM_SLAVES];
+
+// #############################################################################
+// ------------ PRIVATE FUNCTION PROTOTYPES
+// #############################################################################
+
+static bool is_valid_slave_number(uint8_t slave_number);
+static void set_slave_state(slave_health_t * p_state, slave_health_t new_state);
+
+// #############################################################################
+// ------------ PUBLIC FUNCTIONS
+// #############################################################################
+
+/****************************************************************************
+    Public Function
+        Init_Slave_Health
+
+    Parameters
+        None
+
+    Description
+        Starts all slaves as online, so they are all polled right away
+
+****************************************************************************/
+void Init_Slave_Health(void)
+{
+    for (uint8_t index = 0; index < NUM_SLAVES; index++)
+    {
+        Slave_Health[index] = MAKE_HEALTH_ENTRY(slave_online, false, 0);
+    }
+}
+
+/****************************************************************************
+    Public Function
+        Slave_Health_Report_Response
+
+    Parameters
+        uint8_t slave_number: slave the status was requested from
+        bool responded: true if a good status response was received
+
+    Description
+        Runs the health state machine for one status request. Called from
+        interrupt context by the master schedule.
+
+****************************************************************************/
+void Slave_Health_Report_Response(uint8_t slave_number, bool responded)
+{
+    uint8_t index;
+    slave_health_t state;
+    uint8_t count;
+    bool last_missed;
+
+    if (!is_valid_slave_number(slave_number)) return;
+    index = GET_HEALTH_INDEX(slave_number);
+
+    // Work on a copy of the entry
+    state = GET_HEALTH_STATE(Slave_Health[index]);
+    count = GET_HEALTH_COUNT(Slave_Health[index]);
+    last_missed = (0 != (Slave_Health[index] & HEALTH_LAST_MISSED));
+
+    switch (state)
+    {
+        case slave_online:
+            if (responded)
+            {
+                count = 0;
+            }
+            else if (SLAVE_DEGRADED_MISSES <= ++count)
+            {
+                set_slave_state(&state, slave_degraded);
+                count = SLAVE_DEGRADED_MISSES;
+                last_missed = true;
+            }
+            break;
+
+        case slave_degraded:
+            // Restart the count when the streak changes
+            if (responded == last_missed)
+            {
+                count = 0;
+                last_missed = !responded;
+            }
+            count++;
+
+            if (responded && (SLAVE_RECOVERED_RESPONSES <= count))
+            {
+                set_slave_state(&state, slave_online);
+                count = 0;
+            }
+            else if (!responded && (SLAVE_OFFLINE_MISSES <= count))
+            {
+                set_slave_state(&state, slave_offline);
+                count = SLAVE_REDISCOVERY_ROUNDS;
+            }
+            break;
+
+        case slave_offline:
+            // The slave answered a rediscovery poll
+            if (responded)
+            {
+                set_slave_state(&state, slave_degraded);
+                count = 1;
+                last_missed = false;
+            }
+            break;
+
+        default:
+            break;
+    }
+
+    Slave_Health[index] = MAKE_HEALTH_ENTRY(state, last_missed, count);
+}
+
+/****************************************************************************
+    Public Function
+        Slave_Health_Poll_This_Round
+
+    Parameters
+        uint8_t slave_number: slave the schedule is about to service
+
+    Description
+        Called once per schedule round for each slave (from interrupt
+        context). Returns false if the slave's slots should be skipped
+        this round.
+
+****************************************************************************/
+bool Slave_Health_Poll_This_Round(uint8_t slave_number)
+{
+    uint8_t index;
+
+    if (!is_valid_slave_number(slave_number)) return false;
+    index = GET_HEALTH_INDEX(slave_number);
+
+    // Live slaves are polled every round
+    if (slave_offline != GET_HEALTH_STATE(Slave_Health[index])) return true;
+
+    // Offline slaves are polled when their countdown runs out, the count
+    //  is in the low bits
+    if (0 != GET_HEALTH_COUNT(--Slave_Health[index])) return false;
+    Slave_Health[index] = MAKE_HEALTH_ENTRY(slave_offline, false, SLAVE_REDISCOVERY_ROUNDS);
+    return true;
+}
+
+/****************************************************************************
+    Public Function
+        Get_Slave_Health
+
+    Parameters
+        uint8_t slave_number: slave to look up
+
+    Description
+        Returns the health of a slave, invalid slave numbers read as offline
+
+****************************************************************************/
+slave_health_t Get_Slave_Health(uint8_t slave_number)
+{
+    slave_health_t result;
+
+    if (!is_valid_slave_number(slave_number)) return slave_offline;
+
+    ATOMIC_BLOCK(ATOMIC_RESTORESTATE)
+    {
+        result = GET_HEALTH_STATE(Slave_Health[GET_HEALTH_INDEX(slave_number)]);
+    }
+
+    return result;
+}
+
+/****************************************************************************
+    Public Function
+        Get_Slave_Health_Bitmap
+
+    Parameters
+        None
+
+    Description
+        Returns a bitmap of the slaves that are answering (online or
+        degraded), bit n is set for slave number n
+
+****************************************************************************/
+uint32_t Get_Slave_Health_Bitmap(void)
+{
+    uint32_t result = 0;
+
+    for (uint8_t slave_num = LOWEST_SLAVE_NUMBER; slave_num <= HIGHEST_SLAVE_NUMBER; slave_num++)
+    {
+        if (slave_offline != Get_Slave_Health(slave_num))
+        {
+            result |= (1UL<<slave_num);
+        }
+    }
+
+    return result;
+}
+
+// #############################################################################
+// ------------ PRIVATE FUNCTIONS
+// #############################################################################
+
+/****************************************************************************
+    Private Function
+        is_valid_slave_number
+
+    Parameters
+        uint8_t slave_number: slave number to check
+
+    Description
+        Returns true if the slave number is in the health table
+
+****************************************************************************/
+static bool is_valid_slave_number(uint8_t slave_number)
+{
+    return ((LOWEST_SLAVE_NUMBER <= slave_number) && (HIGHEST_SLAVE_NUMBER >= slave_number));
+}
+
+/****************************************************************************
+    Private Function
+        set_slave_state
+
+    Parameters
+        slave_health_t * p_state: the slave's state
+        slave_health_t new_state: state to move to
+
+    Description
+        Changes a slave's state and tells the master service
+
+****************************************************************************/
+static void set_slave_state(slave_health_t * p_state, slave_health_t new_state)
+{
+    *p_state = new_state;
+    Post_Event(EVT_MASTER_HEALTH_CHANGE);
+}
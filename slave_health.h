@@ -0,0 +1,26 @@
+#ifndef SLAVE_HEALTH_H
+#define SLAVE_HEALTH_H
+
+// #############################################################################
+// ------------ TYPE DEFINITIONS
+// #############################################################################
+
+// Health of a slave as seen by the master
+typedef enum
+{
+    slave_online = 0,       // Answering its status requests
+    slave_degraded,         // Missed some status requests recently
+    slave_offline           // Not answering, only polled to rediscover it
+} slave_health_t;
+
+// #############################################################################
+// ------------ PUBLIC FUNCTION PROTOTYPES
+// #############################################################################
+
+void Init_Slave_Health(void);
+void Slave_Health_Report_Response(uint8_t slave_number, bool responded);
+bool Slave_Health_Poll_This_Round(uint8_t slave_number);
+slave_health_t Get_Slave_Health(uint8_t slave_number);
+uint32_t Get_Slave_Health_Bitmap(void);
+
+#endif // SLAVE_HEALTH_H
@@ -28,6 +28,12 @@
 // This module's header file
 #include "slave_service.h"
 
+// memcpy
+#include <string.h>
+
+// NULL
+#include <stddef.h>
+
 // LIN top layer
 #include "MS_LIN_top_layer.h"
 
@@ -46,6 +52,27 @@
 // EEPROM
 #include "eeprom_storage.h"
 
+// Diagnostics
+#include "LIN_diagnostics.h"
+
+// Auto-addressing
+#include "auto_addressing.h"
+
+// Bootloader
+#include "lin_bootloader.h"
+
+// AVcc and temperature
+#include "ADC.h"
+
+// Light Setting Algorithm
+#include "light_setting_alg.h"
+
+// Slave Parameters
+#include "slave_parameters.h"
+
+// Uptime
+#include "timer.h"
+
 // Atomic Read/Write operations
 #include <util/atomic.h>
 
@@ -54,7 +81,7 @@
 // #############################################################################
 
 #define NODE_ID_LEN         1               // One Byte long
-#define NODE_ID_ADDR        (E2START+0)     // First address in EEPROM
+#define NODE_ID_ADDR        (EEPROM_NODE_ID_ADDR)
 
 // #############################################################################
 // ------------ MODULE VARIABLES
@@ -62,21 +89,33 @@
 
 // These values should only exist in a single module for each node
 static uint8_t My_Node_ID;                              // This node's ID
-static uint8_t My_Command_Data[LIN_PACKET_LEN];         // This node's current command
-static uint8_t My_Status_Data[LIN_PACKET_LEN];          // This node's status
-static uint8_t * p_My_Command_Data = My_Command_Data;
-static uint8_t * p_My_Status_Data = My_Status_Data;
+static uint8_t My_Command_Data[2][LIN_PACKET_LEN];      // This node's current command (live and shadow)
+static uint8_t My_Status_Data[2][LIN_PACKET_LEN];       // This node's status (live and shadow)
+
+// Double buffered stores for the data above
+// The LIN layer writes and commits the command, we write and commit the
+//  status, so the master never reads a half updated status.
+static data_store_t My_Command_Store;
+static data_store_t My_Status_Store;
 
-// *Note: We have set up the system so the slaves don't need their parameters.
-// (We don't need a pointer to our slave parameters.)
+// The bus went to sleep, power down once every event is handled
+static bool Power_Down_Pending = false;
+
+// *Note: Our parameters are only needed for the scene frame, where we work
+// out our own command (see apply_scene()).
 
 // #############################################################################
 // ------------ PRIVATE FUNCTION PROTOTYPES
 // #############################################################################
 
 static void save_our_id_to_flash(uint8_t * p_node_id);
-static void process_intensity_cmd(void);
-static void process_position_cmd(void);
+static void apply_cmd(bool skip_new);
+static void apply_scene(void);
+static void process_intensity_cmd(uint8_t * p_command);
+static void process_position_cmd(uint8_t * p_command);
+static void process_diag_request(void);
+static void set_slave_number(uint8_t slave_number);
+static void update_ext_status(void);
 
 // #############################################################################
 // ------------ PUBLIC FUNCTIONS
@@ -103,16 +142,28 @@ void Init_Slave_Service(void)
     Release_Analog_Servo();
 
     // Initialize command and status arrays to reflect our state
-    Write_Intensity_Data(p_My_Command_Data, INTENSITY_NON_COMMAND);
-    Write_Position_Data(p_My_Command_Data, POSITION_NON_COMMAND);
-    Write_Intensity_Data(p_My_Status_Data, LIGHT_OFF);
-    Write_Position_Data(p_My_Status_Data, SERVO_STAY);
-
-    // Read our slave number from flash
+    Write_Intensity_Data(My_Command_Data[0], INTENSITY_NON_COMMAND);
+    Write_Position_Data(My_Command_Data[0], POSITION_NON_COMMAND);
+    Write_Intensity_Data(My_Status_Data[0], LIGHT_OFF);
+    Write_Position_Data(My_Status_Data[0], SERVO_STAY);
+    Init_Data_Store(&My_Command_Store, My_Command_Data[0], My_Command_Data[1], LIN_PACKET_LEN);
+    Init_Data_Store(&My_Status_Store, My_Status_Data[0], My_Status_Data[1], LIN_PACKET_LEN);
+
+    // Read our slave number from flash, we have none if it was never set
     Read_Data_From_EEPROM(NODE_ID_ADDR, &My_Node_ID, NODE_ID_LEN);
+    if  (   (LOWEST_SLAVE_NUMBER > GET_SLAVE_NUMBER(My_Node_ID))
+            ||
+            (MAX_NUM_SLAVES < GET_SLAVE_NUMBER(My_Node_ID))
+        )
+    {
+        My_Node_ID = UNASSIGNED_NODE_ID;
+    }
 
     // Initialize LIN
-    MS_LIN_Initialize(&My_Node_ID, p_My_Command_Data, p_My_Status_Data);
+    MS_LIN_Initialize(&My_Node_ID, &My_Command_Store, &My_Status_Store);
+
+    // Have telemetry ready for our first turn
+    update_ext_status();
 }
 
 /****************************************************************************
@@ -140,10 +191,7 @@ void Run_Slave_Service(uint32_t event_mask)
                 )
             {
                 // Set our ID based on the user set slave number
-                My_Node_ID = GET_SLAVE_BASE_ID(Get_Last_Set_Slave_Number());
-
-                // Save our new ID in flash memory
-                Write_Data_To_EEPROM(NODE_ID_ADDR, &My_Node_ID, NODE_ID_LEN);
+                set_slave_number(Get_Last_Set_Slave_Number());
             }
 
             break;
@@ -151,15 +199,56 @@ void Run_Slave_Service(uint32_t event_mask)
         case EVT_SLAVE_NEW_CMD:
             // We got a new command.
 
-            // Process commands if we're not in the setting mode
-            if (!In_Slave_Number_Setting_Mode())
-            {
-                // Process the intensity command
-                process_intensity_cmd();
+            // With staged commands a new one waits in the command store
+            //  for the commit frame
+            apply_cmd(STAGED_COMMANDS);
 
-                // Process the position command,
-                process_position_cmd();
-            }
+            break;
+
+        case EVT_SLAVE_COMMIT:
+            // The master committed the scene, apply the last command we got.
+
+            apply_cmd(false);
+
+            break;
+
+        case EVT_SLAVE_SCENE:
+            // The master sent a new scene, apply our part of it.
+
+            apply_scene();
+
+            break;
+
+        case EVT_SLAVE_DIAG_REQUEST:
+            // The master sent us a diagnostic request.
+
+            // Build our response, it is sent when the master polls for it
+            process_diag_request();
+
+            break;
+
+        case EVT_SLAVE_GO_TO_SLEEP:
+            // The master put the bus to sleep.
+
+            // Turn off the light and release the servo so we draw as
+            //  little current as possible
+            Set_Light_Intensity(LIGHT_OFF);
+            Release_Analog_Servo();
+
+            // Our status reflects that, so the master's commands are
+            //  executed again once we wake up
+            Write_Intensity_Data(Get_Shadow_Slot(&My_Status_Store, 0), LIGHT_OFF);
+            Write_Position_Data(Get_Shadow_Slot(&My_Status_Store, 0), SERVO_STAY);
+            Commit_Data_Store(&My_Status_Store);
+
+            // Power down from the main loop once every event is handled
+            Power_Down_Pending = true;
+
+            break;
+
+        case EVT_SLAVE_EXT_STATUS_SENT:
+            // The master read our telemetry, get it ready for next time
+            update_ext_status();
 
             break;
 
@@ -171,41 +260,165 @@ void Run_Slave_Service(uint32_t event_mask)
     }
 }
 
+/****************************************************************************
+    Public Function
+        Run_Slave_Idle
+
+    Parameters
+        None
+
+    Description
+        Runs from the main loop once no event is pending. Powers down if
+        the bus went to sleep, so no event handler blocks while we sleep.
+        Returns once we are awake.
+
+****************************************************************************/
+void Run_Slave_Idle(void)
+{
+    if (Power_Down_Pending)
+    {
+        Power_Down_Pending = false;
+
+        // Power down until the bus wakes up
+        Slave_LIN_Power_Down();
+    }
+}
+
 // #############################################################################
 // ------------ PRIVATE FUNCTIONS
 // #############################################################################
 
+/****************************************************************************
+    Private Function
+        apply_cmd()
+
+    Parameters
+        bool skip_new: leave a command we haven't applied yet for the commit
+            frame, only apply the one we have again
+
+    Description
+        Applies the last command from the master and reports which one it
+        was in our status
+
+****************************************************************************/
+static void apply_cmd(bool skip_new)
+{
+    uint8_t command[LIN_PACKET_LEN];
+
+    // Process commands if we're not in the setting mode
+    if (In_Slave_Number_Setting_Mode()) return;
+
+    // Take a copy of the command, the LIN ISR may update it
+    Read_Live_Data(&My_Command_Store, 0, command, LIN_PACKET_LEN);
+
+    // A repeat of the command we applied, e.g. after we woke up, is
+    //  applied again straight away
+    if (    skip_new
+            &&
+            (Get_Sequence_Data(command) != Get_Sequence_Data(Get_Live_Data(&My_Status_Store)))
+       )
+    {
+        return;
+    }
+
+    // Process the intensity command
+    process_intensity_cmd(command);
+
+    // Process the position command,
+    process_position_cmd(command);
+
+    // Tell the master which command we applied
+    Write_Sequence_Data(Get_Shadow_Slot(&My_Status_Store, 0), Get_Sequence_Data(command));
+
+    // Publish our new status
+    Commit_Data_Store(&My_Status_Store);
+}
+
+/****************************************************************************
+    Private Function
+        apply_scene()
+
+    Parameters
+        None
+
+    Description
+        Works out our command from the location in the scene frame, as the
+        master does, and applies it straight away if it changed. It gets the
+        next sequence number, which is the one the master expects back.
+
+****************************************************************************/
+static void apply_scene(void)
+{
+    uint8_t scene[LIN_SCENE_FRAME_LEN];
+    uint8_t command[LIN_PACKET_LEN];
+    uint8_t new_command[LIN_PACKET_LEN];
+    rect_vect_t location;
+    const slave_parameters_t * p_params = Get_Pointer_To_Slave_Parameters(GET_SLAVE_NUMBER(My_Node_ID));
+
+    // Without a number we have no parameters, and no command
+    if (NULL == p_params) return;
+    if (In_Slave_Number_Setting_Mode()) return;
+
+    Slave_LIN_Get_Scene(scene);
+    memcpy(&location, &scene[SCENE_X_INDEX], sizeof(location));
+
+    // Start from our command, the algorithm keeps what it doesn't set
+    Read_Live_Data(&My_Command_Store, 0, command, LIN_PACKET_LEN);
+    memcpy(new_command, command, LIN_PACKET_LEN);
+    Compute_Individual_Light_Settings(p_params, new_command, location);
+    if (    (Get_Intensity_Data(new_command) == Get_Intensity_Data(command))
+            &&
+            (Get_Position_Data(new_command) == Get_Position_Data(command))
+       )
+    {
+        // The master may have sent us this command already, while it was
+        //  staged, apply it with the others
+        apply_cmd(false);
+        return;
+    }
+    Write_Sequence_Data(new_command, Get_Sequence_Data(command)+1);
+
+    // The LIN ISR writes our command store too. A command that came in
+    //  since we read it is newer than the scene, leave it.
+    ATOMIC_BLOCK(ATOMIC_RESTORESTATE)
+    {
+        if (Get_Sequence_Data(Get_Live_Data(&My_Command_Store)) != Get_Sequence_Data(command)) return;
+        Write_Data_Slot(&My_Command_Store, 0, new_command);
+        Commit_Data_Store(&My_Command_Store);
+    }
+
+    apply_cmd(false);
+}
+
 /****************************************************************************
     Private Function
         process_intensity_cmd()
 
     Parameters
-        none
+        uint8_t * p_command: copy of the command from the master
 
     Description
         processes the intensity command
 
 ****************************************************************************/
-static void process_intensity_cmd(void)
+static void process_intensity_cmd(uint8_t * p_command)
 {
-    // Enter critical section so when we are copying data, we know the data
-    //      we are copying is the same data we checked.
-    ATOMIC_BLOCK(ATOMIC_RESTORESTATE)
+    // Our status is only written here, so we can work on the shadow copy
+    uint8_t * p_status = Get_Shadow_Slot(&My_Status_Store, 0);
+
+    // General Flow:
+    // If the command is valid, then we copy the command to our status
+    //      then we execute whatever is in our status
+    if (INTENSITY_NON_COMMAND != Get_Intensity_Data(p_command))
     {
-        // General Flow:
-        // If the command is valid, then we copy the command to our status
-        //      then we execute whatever is in our status
-        if (INTENSITY_NON_COMMAND != Get_Intensity_Data(p_My_Command_Data))
+        // If command differs from our status execute intensity command
+        if (Get_Intensity_Data(p_status) != Get_Intensity_Data(p_command))
         {
-            // If command differs from our status execute intensity command
-            if (Get_Intensity_Data(p_My_Status_Data) != Get_Intensity_Data(p_My_Command_Data))
-            {
-                // Update our status as the command
-                Write_Intensity_Data(p_My_Status_Data, Get_Intensity_Data(p_My_Command_Data));
+            // Update our status as the command
+            Write_Intensity_Data(p_status, Get_Intensity_Data(p_command));
 
-                // Set light intensity
-                Set_Light_Intensity(Get_Intensity_Data(p_My_Status_Data));
-            }
+            // Set light intensity
+            Set_Light_Intensity(Get_Intensity_Data(p_status));
         }
     }
 }
@@ -215,35 +428,176 @@ static void process_intensity_cmd(void)
         process_position_cmd()
 
     Parameters
-        none
+        uint8_t * p_command: copy of the command from the master
 
     Description
         processes the position command
 
 ****************************************************************************/
-static void process_position_cmd(void)
+static void process_position_cmd(uint8_t * p_command)
 {
-    // Enter critical section so when we are copying data, we know the data
-    //      we are copying is the same data we checked.
-    ATOMIC_BLOCK(ATOMIC_RESTORESTATE)
+    // Our status is only written here, so we can work on the shadow copy
+    uint8_t * p_status = Get_Shadow_Slot(&My_Status_Store, 0);
+
+    // General Flow:
+    // If the command is valid, then we copy the command to our status
+    //      then we execute whatever is in our status
+    if (POSITION_NON_COMMAND != Get_Position_Data(p_command))
     {
-        // General Flow:
-        // If the command is valid, then we copy the command to our status
-        //      then we execute whatever is in our status
-        if (POSITION_NON_COMMAND != Get_Position_Data(p_My_Command_Data))
+        // If command differs from our status and position is valid, execute move command
+        if (Get_Position_Data(p_status) != Get_Position_Data(p_command))
         {
-            // If command differs from our status and position is valid, execute move command
-            if (Get_Position_Data(p_My_Status_Data) != Get_Position_Data(p_My_Command_Data))
-            {
-                // Update our status as the command
-                Write_Position_Data(p_My_Status_Data, Get_Position_Data(p_My_Command_Data));
+            // Update our status as the command
+            Write_Position_Data(p_status, Get_Position_Data(p_command));
 
-                // Change servo position, based on our new status
-                Move_Analog_Servo_To_Position(Get_Position_Data(p_My_Status_Data));
-            }
+            // Change servo position, based on our new status
+            Move_Analog_Servo_To_Position(Get_Position_Data(p_status));
         }
     }
 }
 
+/****************************************************************************
+    Private Function
+        process_diag_request()
+
+    Parameters
+        none
+
+    Description
+        processes a diagnostic request and queues our response
+
+****************************************************************************/
+static void process_diag_request(void)
+{
+    uint8_t request[LIN_DIAG_MAX_PDU_LEN];
+    uint8_t response[LIN_DIAG_MAX_PDU_LEN];
+    uint8_t request_len;
+    uint8_t response_len;
+    uint8_t nad;
+    uint8_t slave_number = GET_SLAVE_NUMBER(My_Node_ID);
+
+    // Get the request
+    request_len = Slave_LIN_Diag_Get_Request(&nad, request);
+    if (0 == request_len) return;
+
+    // The master is about to flash us, turn off and hand over to the
+    //  bootloader (this doesn't return)
+    if (    (2 <= request_len)
+            &&
+            (LIN_DIAG_SID_SESSION == request[0]) && (LIN_DIAG_SESSION_PROGRAMMING == request[1])
+       )
+    {
+        Set_Light_Intensity(LIGHT_OFF);
+        Release_Analog_Servo();
+        Enter_LIN_Bootloader();
+    }
+
+    // Process it, even if it was broadcast. Auto-addressing may give us
+    //  a new number.
+    if (Is_Addressing_Request(request))
+    {
+        response_len = Process_Addressing_Request(request, request_len, response, &slave_number);
+    }
+    else
+    {
+        response_len = Process_Diag_Request(request, request_len, response);
+    }
+
+    // Only respond if the request was for us alone, otherwise
+    //  all the slaves would answer at once
+    if ((LIN_DIAG_NAD_BROADCAST != nad) && (0 != response_len))
+    {
+        Slave_LIN_Diag_Send_Response(response, response_len);
+    }
+
+    // The response goes out from our old NAD, then take on the new one
+    if (GET_SLAVE_NUMBER(My_Node_ID) != slave_number)
+    {
+        set_slave_number(slave_number);
+    }
+}
+
+/****************************************************************************
+    Private Function
+        set_slave_number()
+
+    Parameters
+        uint8_t slave_number: our new slave number, LIN_DIAG_NAD_UNASSIGNED
+            to give up our number until we get a new one
+
+    Description
+        Sets our LIN IDs from our slave number and saves a real number in
+        flash memory
+
+****************************************************************************/
+static void set_slave_number(uint8_t slave_number)
+{
+    My_Node_ID = GET_SLAVE_BASE_ID(slave_number);
 
+    // Save our new ID in flash memory
+    if (LIN_DIAG_NAD_UNASSIGNED != slave_number)
+    {
+        Write_Data_To_EEPROM(NODE_ID_ADDR, &My_Node_ID, NODE_ID_LEN);
+    }
 
+    // Answer to our new LIN IDs
+    MS_LIN_Update_ID_Table();
+}
+
+/****************************************************************************
+    Private Function
+        update_ext_status()
+
+    Parameters
+        none
+
+    Description
+        Builds our extended status frame (see config.h) and starts the next
+        telemetry measurement, whose result goes out on the following turn
+
+****************************************************************************/
+static void update_ext_status(void)
+{
+    uint8_t ext_status[LIN_EXT_STATUS_LEN];
+    uint8_t status[LIN_PACKET_LEN];
+    uint8_t command[LIN_PACKET_LEN];
+    lin_counters_t counters;
+    uint16_t commanded_position;
+    uint16_t actual_position;
+    uint32_t uptime;
+
+    Read_Live_Data(&My_Status_Store, 0, status, LIN_PACKET_LEN);
+    Read_Live_Data(&My_Command_Store, 0, command, LIN_PACKET_LEN);
+    Get_LIN_Counters(&counters);
+
+    // Applied intensity
+    ext_status[EXT_STS_INTENSITY_INDEX] = Get_Intensity_Data(status);
+
+    // Commanded and actual position, 12 bits each
+    commanded_position = Get_Position_Data(command) & EXT_STS_POSITION_MASK;
+    actual_position = Get_Analog_Servo_Position() & EXT_STS_POSITION_MASK;
+    ext_status[EXT_STS_POSITIONS_INDEX] = commanded_position;
+    ext_status[EXT_STS_POSITIONS_INDEX+1] = (commanded_position>>8)|(actual_position<<4);
+    ext_status[EXT_STS_POSITIONS_INDEX+2] = actual_position>>4;
+
+    // Servo moving flag and LIN error count
+    ext_status[EXT_STS_FLAGS_INDEX] = (EXT_STS_ERROR_COUNT_MASK < counters.error_count) ?
+        EXT_STS_ERROR_COUNT_MASK : counters.error_count;
+    if (Is_Analog_Servo_Moving())
+    {
+        ext_status[EXT_STS_FLAGS_INDEX] |= EXT_STS_MOVING_FLAG;
+    }
+
+    // AVcc and temperature
+    ext_status[EXT_STS_AVCC_INDEX] = Get_AVcc_MV()/EXT_STS_AVCC_MV_PER_LSB;
+    ext_status[EXT_STS_TEMPERATURE_INDEX] = (uint8_t) Get_Temperature_C();
+
+    // Uptime in minutes
+    uptime = Get_System_Time_MS()/EXT_STS_MS_PER_UPTIME_LSB;
+    ext_status[EXT_STS_UPTIME_INDEX] = (UINT8_MAX < uptime) ? UINT8_MAX : uptime;
+
+    Slave_LIN_Write_Ext_Status(ext_status);
+
+    // Measure the next telemetry channel
+    Start_ADC_Telemetry_Measurement();
+}
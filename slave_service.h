@@ -7,5 +7,6 @@
 
 void Init_Slave_Service(void);
 void Run_Slave_Service(uint32_t event_mask);
+void Run_Slave_Idle(void);
 
 #endif // slave_service_H
@@ -25,9 +25,10 @@
         void Timer_ISR(void)
         void Register_Timer(uint32_t * pointer_to_timer_expire_event_type)
         void Start_Timer(uint32_t * pointer_to_timer_expire_event_type, uint32_t ms_to_expire)
-        uint32_t Get_Time_Timer(uint32_t * pointer_to_timer_expire_event_type)
         void Stop_Timer(uint32_t * pointer_to_timer_expire_event_type)
         void Start_Short_Timer(uint32_t * pointer_to_timer_expire_event_type, uint32_t ms_div_ten_to_expire)
+        uint32_t Get_System_Time_MS(void)
+        uint32_t Get_System_Time_US(void)
 
 *******************************************************************************/
 
@@ -61,9 +62,13 @@
 // Define number of timers used
 // This should be based on a project wide search for the 
 //  number of unique Register_Timer() calls
-// Master has 5
+// Master has 6
 // Slave has 5
-#define NUM_TIMERS          (5)
+#if IS_MASTER_NODE
+    #define NUM_TIMERS      (6)
+#else
+    #define NUM_TIMERS      (5)
+#endif
 
 // Null cb func
 #define NULL_TIMER_CB       ((timer_cb_t) 0)
@@ -84,6 +89,10 @@
 // Define number of steps per 1 ms
 #define TICK_COUNT_PER_MS   2                               // 0.5ms resolution
 
+// Timer 0 counts per tick and time per count, for sub tick timestamps
+#define US_PER_TICK         (1000/TICK_COUNT_PER_MS)
+#define US_PER_COUNT        (US_PER_TICK/OC_T0_REG_VALUE)   // 4us
+
 // #############################################################################
 // ------------ TYPE DEFINITIONS
 // #############################################################################
@@ -93,7 +102,6 @@ typedef struct
     uint32_t        *p_timer_id;
     timer_cb_t      timer_cb_func;
     bool            timer_running_flag;
-    uint32_t        ticks_since_start;
     uint32_t        ticks_remaining;
 } timer_t;
 
@@ -104,6 +112,14 @@ typedef struct
 // Timer Array
 static timer_t Timers[NUM_TIMERS];
 
+// Free running tick count since the timer module was initialized
+static uint32_t System_Ticks = 0;
+
+// Milliseconds since the timer module was initialized, counted apart from
+//  the ticks so it wraps from UINT32_MAX to 0 like every "now - then" expects
+static uint32_t System_MS = 0;
+static uint8_t Ticks_In_MS = 0;
+
 // #############################################################################
 // ------------ PRIVATE FUNCTION PROTOTYPES
 // #############################################################################
@@ -133,7 +149,6 @@ void Init_Timer_Module(void)
         Timers[i].p_timer_id = 0;
         Timers[i].timer_cb_func = NULL_TIMER_CB;
         Timers[i].timer_running_flag = false;
-        Timers[i].ticks_since_start = 0;
         Timers[i].ticks_remaining = 0;
     }
 
@@ -203,7 +218,6 @@ void Register_Timer(uint32_t * p_new_timer, timer_cb_t new_timer_cb_func)
                     Timers[i].p_timer_id = p_new_timer;
                     Timers[i].timer_cb_func = new_timer_cb_func;
                     Timers[i].timer_running_flag = false;
-                    Timers[i].ticks_since_start = 0;
                     Timers[i].ticks_remaining = 0;
                 }
                 break;
@@ -237,7 +251,6 @@ void Start_Timer(uint32_t * p_this_timer, uint32_t time_in_ms)
             ATOMIC_BLOCK(ATOMIC_RESTORESTATE)
             {
                 Timers[i].timer_running_flag = true;
-                Timers[i].ticks_since_start = 0;
                 Timers[i].ticks_remaining = (time_in_ms*TICK_COUNT_PER_MS);
             }
             break;
@@ -245,35 +258,6 @@ void Start_Timer(uint32_t * p_this_timer, uint32_t time_in_ms)
     }
 }
 
-/****************************************************************************
-    Public Function
-        Get_Time_Timer
-
-    Parameters
-        uint32_t: Pointer to timer variable holding the event type to post
-
-    Description
-        Gets the time since the timer started in milliseconds
-
-****************************************************************************/
-uint32_t Get_Time_Timer(uint32_t * p_this_timer)
-{
-    // Result Val
-    uint32_t return_val = UINT32_MAX;
-    
-    // Get current time of timer
-    for (int i = 0; i < NUM_TIMERS; i++)
-    {
-        if (p_this_timer == Timers[i].p_timer_id)
-        {
-            return_val = ((Timers[i].ticks_since_start)/TICK_COUNT_PER_MS);
-        }
-    }
-    
-    // Return
-    return return_val;
-}
-
 /****************************************************************************
     Public Function
         Stop_Timer
@@ -282,8 +266,7 @@ uint32_t Get_Time_Timer(uint32_t * p_this_timer)
         uint32_t: Pointer to timer variable holding the event type to post
 
     Description
-        Stops the timer, the time remaining is saved, so one could
-            stop the timer, then pull the time value when it was stopped
+        Stops the timer
 
 ****************************************************************************/
 void Stop_Timer(uint32_t * p_this_timer)
@@ -327,7 +310,6 @@ void Start_Short_Timer(uint32_t * p_this_timer, uint32_t time_in_ms_div_ticksper
             ATOMIC_BLOCK(ATOMIC_RESTORESTATE)
             {
                 Timers[i].timer_running_flag = true;
-                Timers[i].ticks_since_start = 0;
                 Timers[i].ticks_remaining = time_in_ms_div_ticksperms;
             }
             break;
@@ -335,6 +317,64 @@ void Start_Short_Timer(uint32_t * p_this_timer, uint32_t time_in_ms_div_ticksper
     }
 }
 
+/****************************************************************************
+    Public Function
+        Get_System_Time_MS
+
+    Parameters
+        None
+
+    Description
+        Gets the time in milliseconds since the timer module was initialized.
+        The value rolls over from UINT32_MAX to 0 after ~49 days, so
+        differences stay right across the roll over.
+
+****************************************************************************/
+uint32_t Get_System_Time_MS(void)
+{
+    // Result Val
+    uint32_t return_val;
+
+    // The ms count is 4 bytes and written in the ISR, so copy it atomically
+    ATOMIC_BLOCK(ATOMIC_RESTORESTATE)
+    {
+        return_val = System_MS;
+    }
+
+    // Return
+    return return_val;
+}
+
+/****************************************************************************
+    Public Function
+        Get_System_Time_US
+
+    Parameters
+        None
+
+    Description
+        Gets the time in microseconds since the timer module was initialized,
+        with the resolution of one timer 0 count (4us). The value rolls over
+        after ~71 minutes, so only use it for differences.
+
+****************************************************************************/
+uint32_t Get_System_Time_US(void)
+{
+    uint32_t ticks;
+    uint8_t counts;
+
+    // Take the tick count and the counts since the last tick together
+    // *Note: If a tick is pending, the counts are simply past
+    //  OC_T0_REG_VALUE, so the result is still right.
+    ATOMIC_BLOCK(ATOMIC_RESTORESTATE)
+    {
+        ticks = System_Ticks;
+        counts = TCNT0-(uint8_t) (OCR0A-OC_T0_REG_VALUE);
+    }
+
+    return ((ticks*US_PER_TICK)+((uint32_t) counts*US_PER_COUNT));
+}
+
 // #############################################################################
 // ------------ PRIVATE FUNCTIONS
 // #############################################################################
@@ -370,6 +410,15 @@ ISR(TIMER0_COMPA_vect)
     // Write new value into output compare reg for next tick
     OCR0A = OCR0A + OC_T0_REG_VALUE;
 
+    // Count the tick for the system time, and a ms every TICK_COUNT_PER_MS
+    System_Ticks++;
+    Ticks_In_MS++;
+    if (TICK_COUNT_PER_MS <= Ticks_In_MS)
+    {
+        Ticks_In_MS = 0;
+        System_MS++;
+    }
+
     // Service the running registered timers
     for (int i = 0; i < NUM_TIMERS; i++)
     {
@@ -379,8 +428,7 @@ ISR(TIMER0_COMPA_vect)
             //      otherwise, process the cb immediately
             if (0 < Timers[i].ticks_remaining)
             {
-                // Add one to time, subtract one from ticks left
-                Timers[i].ticks_since_start += 1;
+                // Subtract one from ticks left
                 Timers[i].ticks_remaining -= 1;
             }
 
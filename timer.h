@@ -14,8 +14,9 @@ typedef void (*timer_cb_t) (uint32_t arg);
 void Init_Timer_Module(void);
 void Register_Timer(uint32_t * p_new_timer, timer_cb_t new_timer_cb_func);
 void Start_Timer(uint32_t * p_this_timer, uint32_t time_in_ms);
-uint32_t Get_Time_Timer(uint32_t * p_this_timer);
 void Stop_Timer(uint32_t * p_this_timer);
 void Start_Short_Timer(uint32_t * p_this_timer, uint32_t time_in_ms_div_ticksperms);
+uint32_t Get_System_Time_MS(void);
+uint32_t Get_System_Time_US(void);
 
 #endif // timer_H